@@ -13,6 +13,7 @@
  */
 
 #include <linux/string.h>
+#include <linux/crc32.h>
 #include <nvram/bcmnvram.h>
 
 extern uint8_t _hndcrc8(uint8_t *p, uint nbytes, uint8_t crc);
@@ -28,8 +29,41 @@ int _nvram_getall(char *buf, int count, int include_temp);
 int _nvram_generate(struct nvram_header *header, int rehash);
 int _nvram_init(struct nvram_header *header);
 void _nvram_uninit(void);
+int _nvram_journal_unset(const char *name);
+int _nvram_journal_generate(char *buf, int count);
+void _nvram_journal_clean(void);
+int _nvram_journal_replay(struct nvram_header *header, int *tail_clean);
+
+/* Record crc covers everything after crc field, torn length fails it too */
+#define nvram_journal_crc(rec) \
+	(~crc32_le(~0, (uint8_t *)&(rec)->len, \
+		   sizeof(*(rec)) - offsetof(struct nvram_journal_rec, len) + (rec)->len))
+
+/* Open addressing (linear probing) table, size is power of 2 */
+struct nvram_slot {
+	uint32_t hash;
+	struct nvram_tuple *t;
+};
+
+static struct nvram_slot *nvram_hash = NULL;
+static uint32_t nvram_hash_size = 0;
+static uint32_t nvram_hash_count = 0;
+
+#define NVRAM_HASH_MIN		1024
+
+/* Names unset since last commit */
+struct nvram_unset_name {
+	struct nvram_unset_name *next;
+	char name[1];
+};
 
-static struct nvram_tuple *nvram_hash[257] = {NULL};
+static struct nvram_unset_name *nvram_unset_list = NULL;
+
+/* Offset for next journal record, 0 if full image must be written */
+static uint32_t nvram_journal_offset = 0;
+static uint32_t nvram_journal_resets = 0;
+
+#define NVRAM_JOURNAL_END	((NVRAM_SPACE - 4) & ~3)
 
 // broadcom fake constants (not used)
 #define SDRAM_INIT	0x419
@@ -40,34 +74,81 @@ static struct nvram_tuple *nvram_hash[257] = {NULL};
 static void
 nvram_free(void)
 {
-	size_t i;
-	struct nvram_tuple *t, *next;
-
-	/* Free hash table */
-	for (i = 0; i < ARRAYSIZE(nvram_hash); i++) {
-		for (t = nvram_hash[i]; t; t = next) {
-			next = t->next;
-			_nvram_free(t);
-		}
-		nvram_hash[i] = NULL;
+	uint32_t i;
+
+	/* Free all tuples, keep table */
+	for (i = 0; i < nvram_hash_size; i++) {
+		if (nvram_hash[i].t)
+			_nvram_free(nvram_hash[i].t);
+		nvram_hash[i].t = NULL;
 	}
+	nvram_hash_count = 0;
 
 	/* Indicate that all tuples have been freed */
 	_nvram_reset();
+
+	/* Flash content is not a base for journal anymore */
+	nvram_journal_offset = 0;
+	nvram_journal_resets++;
 }
 
-/* String hash */
-static inline uint
+/* String hash (FNV-1a) */
+static inline uint32_t
 hash(const char *s)
 {
-	uint hash = 0;
+	uint32_t hash = 2166136261U;
 
-	while (*s)
-		hash = 31 * hash + *s++;
+	while (*s) {
+		hash ^= (uint8_t)*s++;
+		hash *= 16777619U;
+	}
 
 	return hash;
 }
 
+/* Find slot of name, or empty slot to insert. Should be locked. */
+static struct nvram_slot *
+nvram_slot_find(const char *name, uint32_t h)
+{
+	uint32_t i, mask = nvram_hash_size - 1;
+	struct nvram_slot *slot;
+
+	for (i = h & mask; ; i = (i + 1) & mask) {
+		slot = &nvram_hash[i];
+		if (!slot->t)
+			return slot;
+		if (slot->hash == h && !strcmp(slot->t->name, name))
+			return slot;
+	}
+}
+
+/* Resize table keeping load factor under 3/4. Should be locked. */
+static int
+nvram_slot_resize(uint32_t size)
+{
+	uint32_t i, old_size = nvram_hash_size;
+	struct nvram_slot *old_hash = nvram_hash, *slot;
+
+	nvram_hash = kzalloc(size * sizeof(struct nvram_slot), GFP_ATOMIC);
+	if (!nvram_hash) {
+		nvram_hash = old_hash;
+		return -1;
+	}
+
+	nvram_hash_size = size;
+	for (i = 0; i < old_size; i++) {
+		if (!old_hash[i].t)
+			continue;
+		slot = nvram_slot_find(old_hash[i].t->name, old_hash[i].hash);
+		*slot = old_hash[i];
+	}
+
+	if (old_hash)
+		kfree(old_hash);
+
+	return 0;
+}
+
 /* (Re)initialize the hash table. Should be locked. */
 static void
 nvram_rehash(struct nvram_header *header)
@@ -110,34 +191,35 @@ nvram_calc_crc(struct nvram_header *header)
 char *
 _nvram_get(const char *name)
 {
-	uint i;
-	struct nvram_tuple *t;
-	char *value;
+	struct nvram_slot *slot;
 
-	/* Hash the name */
-	i = hash(name) % ARRAYSIZE(nvram_hash);
+	if (!nvram_hash_count)
+		return NULL;
 
 	/* Find the associated tuple in the hash table */
-	for (t = nvram_hash[i]; t && strcmp(t->name, name); t = t->next);
-
-	value = t ? t->value : NULL;
+	slot = nvram_slot_find(name, hash(name));
 
-	return value;
+	return (slot->t) ? slot->t->value : NULL;
 }
 
 /* Set the value of an NVRAM variable. Should be locked. */
 int
 _nvram_set(const char *name, const char *value, int is_temp)
 {
-	uint i;
-	struct nvram_tuple *t, *u, **prev;
-
-	/* Hash the name */
-	i = hash(name) % ARRAYSIZE(nvram_hash);
+	uint32_t h = hash(name);
+	struct nvram_slot *slot;
+	struct nvram_tuple *t, *u;
+
+	/* Grow table before insert */
+	if ((nvram_hash_count + 1) * 4 > nvram_hash_size * 3) {
+		if (nvram_slot_resize((nvram_hash_size) ? (nvram_hash_size << 1) : NVRAM_HASH_MIN) &&
+		    (nvram_hash_count + 1) >= nvram_hash_size)
+			return -1;
+	}
 
 	/* Find the associated tuple in the hash table */
-	for (prev = &nvram_hash[i], t = *prev; t && strcmp(t->name, name);
-	     prev = &t->next, t = *prev);
+	slot = nvram_slot_find(name, h);
+	t = slot->t;
 
 	/* (Re)allocate tuple */
 	if (!(u = _nvram_realloc(t, name, value, is_temp)))
@@ -147,14 +229,15 @@ _nvram_set(const char *name, const char *value, int is_temp)
 	if (t && t == u)
 		return 0;
 
-	/* Store new tuple */
-	*prev = u;
-
 	/* Delete old tuple */
-	if (t) {
-		u->next = t->next;
+	if (t)
 		_nvram_free(t);
-	}
+	else
+		nvram_hash_count++;
+
+	/* Store new tuple */
+	slot->hash = h;
+	slot->t = u;
 
 	return 0;
 }
@@ -163,20 +246,39 @@ _nvram_set(const char *name, const char *value, int is_temp)
 int
 _nvram_unset(const char *name)
 {
-	uint i;
-	struct nvram_tuple *t, **prev;
+	uint32_t i, j, k, mask;
+	struct nvram_slot *slot;
+	struct nvram_tuple *t;
 
-	/* Hash the name */
-	i = hash(name) % ARRAYSIZE(nvram_hash);
+	if (!nvram_hash_count)
+		return 0;
 
 	/* Find the associated tuple in the hash table */
-	for (prev = &nvram_hash[i], t = *prev; t && strcmp(t->name, name);
-	     prev = &t->next, t = *prev);
+	slot = nvram_slot_find(name, hash(name));
+	if (!(t = slot->t))
+		return 0;
+
+	/* Stored in flash, journal it on commit */
+	if ((!t->val_tmp || t->val_dirty) && _nvram_journal_unset(name) != 0) {
+		nvram_journal_offset = 0;
+		nvram_journal_resets++;
+	}
 
 	/* Delete old tuple */
-	if (t) {
-		*prev = t->next;
-		_nvram_free(t);
+	_nvram_free(t);
+	slot->t = NULL;
+	nvram_hash_count--;
+
+	/* Shift back following entries of probe sequence */
+	mask = nvram_hash_size - 1;
+	i = slot - nvram_hash;
+	for (j = (i + 1) & mask; nvram_hash[j].t; j = (j + 1) & mask) {
+		k = nvram_hash[j].hash & mask;
+		if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+			nvram_hash[i] = nvram_hash[j];
+			nvram_hash[j].t = NULL;
+			i = j;
+		}
 	}
 
 	return 0;
@@ -186,20 +288,20 @@ _nvram_unset(const char *name)
 int
 _nvram_getall(char *buf, int count, int include_temp)
 {
-	uint i;
+	uint32_t i;
 	struct nvram_tuple *t;
 	int len = 0;
 
 	/* Write name=value\0 ... \0\0 */
-	for (i = 0; i < ARRAYSIZE(nvram_hash); i++) {
-		for (t = nvram_hash[i]; t; t = t->next) {
-			if (!include_temp && t->val_tmp)
-				continue;
-			if ((count - len) > (strlen(t->name) + 1 + strlen(t->value) + 1))
-				len += sprintf(buf + len, "%s=%s", t->name, t->value) + 1;
-			else
-				break;
-		}
+	for (i = 0; i < nvram_hash_size; i++) {
+		if (!(t = nvram_hash[i].t))
+			continue;
+		if (!include_temp && t->val_tmp)
+			continue;
+		if ((count - len) > (strlen(t->name) + 1 + strlen(t->value) + 1))
+			len += sprintf(buf + len, "%s=%s", t->name, t->value) + 1;
+		else
+			break;
 	}
 
 	return 0;
@@ -209,7 +311,7 @@ _nvram_getall(char *buf, int count, int include_temp)
 int
 _nvram_generate(struct nvram_header *header, int rehash)
 {
-	int i;
+	uint32_t i;
 	char *ptr, *end;
 	struct nvram_tuple *t;
 	uint8_t crc;
@@ -229,14 +331,14 @@ _nvram_generate(struct nvram_header *header, int rehash)
 	end = (char *)header + NVRAM_SPACE - 2;
 
 	/* Write out all tuples */
-	for (i = 0; i < ARRAYSIZE(nvram_hash); i++) {
-		for (t = nvram_hash[i]; t; t = t->next) {
-			if (!rehash && t->val_tmp)
-				continue;
-			if ((ptr + strlen(t->name) + 1 + strlen(t->value) + 1) > end)
-				break;
-			ptr += sprintf(ptr, "%s=%s", t->name, t->value) + 1;
-		}
+	for (i = 0; i < nvram_hash_size; i++) {
+		if (!(t = nvram_hash[i].t))
+			continue;
+		if (!rehash && t->val_tmp)
+			continue;
+		if ((ptr + strlen(t->name) + 1 + strlen(t->value) + 1) > end)
+			break;
+		ptr += sprintf(ptr, "%s=%s", t->name, t->value) + 1;
 	}
 
 	/* End with a double NULL */
@@ -267,6 +369,8 @@ _nvram_generate(struct nvram_header *header, int rehash)
 int
 _nvram_init(struct nvram_header *header)
 {
+	int tail_clean;
+	uint32_t offset;
 	uint8_t crc;
 
 	if (header->magic == 0xFFFFFFFF || header->magic == 0)
@@ -287,6 +391,11 @@ _nvram_init(struct nvram_header *header)
 
 	nvram_rehash(header);
 
+	/* Apply changes committed after image */
+	offset = _nvram_journal_replay(header, &tail_clean);
+	_nvram_journal_clean();
+	nvram_journal_offset = (tail_clean) ? offset : 0;
+
 	return 0;
 }
 
@@ -295,5 +404,164 @@ void
 _nvram_uninit(void)
 {
 	nvram_free();
+	_nvram_journal_clean();
+
+	if (nvram_hash) {
+		kfree(nvram_hash);
+		nvram_hash = NULL;
+	}
+	nvram_hash_size = 0;
+}
+
+/* Remember unset of variable for next journal record. Should be locked. */
+int
+_nvram_journal_unset(const char *name)
+{
+	struct nvram_unset_name *u;
+
+	for (u = nvram_unset_list; u; u = u->next) {
+		if (!strcmp(u->name, name))
+			return 0;
+	}
+
+	if (!(u = kmalloc(sizeof(struct nvram_unset_name) + strlen(name), GFP_ATOMIC)))
+		return -1;
+
+	strcpy(u->name, name);
+	u->next = nvram_unset_list;
+	nvram_unset_list = u;
+
+	return 0;
+}
+
+/* Build journal record of changes since last commit. Should be locked.
+ * Returns record length, 0 if nothing changed, -1 if not fit to count.
+ */
+int
+_nvram_journal_generate(char *buf, int count)
+{
+	struct nvram_journal_rec *rec = (struct nvram_journal_rec *)buf;
+	struct nvram_unset_name *u;
+	struct nvram_tuple *t;
+	char *ptr, *end;
+	uint32_t i;
+	int len;
+
+	if (count > (sizeof(*rec) + 0xFFFC))
+		count = sizeof(*rec) + 0xFFFC;
+
+	ptr = buf + sizeof(*rec);
+	end = buf + count;
+
+	/* Unsets first, variable may be set again after */
+	for (u = nvram_unset_list; u; u = u->next) {
+		len = strlen(u->name) + 1;
+		if ((ptr + len) > end)
+			return -1;
+		ptr += sprintf(ptr, "%s", u->name) + 1;
+	}
+
+	for (i = 0; i < nvram_hash_size; i++) {
+		if (!(t = nvram_hash[i].t) || !t->val_dirty)
+			continue;
+		/* Temp variable is not stored, drop from flash */
+		if (t->val_tmp)
+			len = strlen(t->name) + 1;
+		else
+			len = strlen(t->name) + 1 + strlen(t->value) + 1;
+		if ((ptr + len) > end)
+			return -1;
+		if (t->val_tmp)
+			ptr += sprintf(ptr, "%s", t->name) + 1;
+		else
+			ptr += sprintf(ptr, "%s=%s", t->name, t->value) + 1;
+	}
+
+	len = ptr - (buf + sizeof(*rec));
+	if (len == 0)
+		return 0;
+
+	/* Zero padding also terminates the payload */
+	len = ROUNDUP(len + 1, 4);
+	if ((buf + sizeof(*rec) + len) > end)
+		return -1;
+	memset(ptr, 0, (buf + sizeof(*rec) + len) - ptr);
+
+	rec->magic = NVRAM_JOURNAL_MAGIC;
+	rec->len = len;
+	rec->reserved = 0xFFFF;
+	rec->crc = nvram_journal_crc(rec);
+
+	return sizeof(*rec) + len;
+}
+
+/* Mark all variables as committed. Should be locked. */
+void
+_nvram_journal_clean(void)
+{
+	uint32_t i;
+	struct nvram_tuple *t;
+	struct nvram_unset_name *u, *next;
+
+	for (i = 0; i < nvram_hash_size; i++) {
+		if ((t = nvram_hash[i].t))
+			t->val_dirty = 0;
+	}
+
+	for (u = nvram_unset_list; u; u = next) {
+		next = u->next;
+		kfree(u);
+	}
+	nvram_unset_list = NULL;
+}
+
+/* Apply journal records after image, returns offset for next record.
+ * Torn (CRC failed) record and all after it are ignored. Should be locked.
+ */
+int
+_nvram_journal_replay(struct nvram_header *header, int *tail_clean)
+{
+	struct nvram_journal_rec *rec;
+	char *name, *value, *end;
+	uint32_t offset, i;
+
+	offset = ROUNDUP(header->len, 4);
+
+	while ((offset + sizeof(*rec)) <= NVRAM_JOURNAL_END) {
+		rec = (struct nvram_journal_rec *)((char *)header + offset);
+		if (rec->magic != NVRAM_JOURNAL_MAGIC)
+			break;
+		if (rec->len == 0 || (rec->len & 3) ||
+		    (offset + sizeof(*rec) + rec->len) > NVRAM_JOURNAL_END)
+			break;
+		if (nvram_journal_crc(rec) != rec->crc)
+			break;
+
+		name = (char *)&rec[1];
+		end = name + rec->len;
+		for (; name < end && *name; name = value + strlen(value) + 1) {
+			if ((value = strchr(name, '='))) {
+				*value = '\0';
+				_nvram_set(name, value + 1, 0);
+				*value++ = '=';
+			} else {
+				_nvram_unset(name);
+				value = name;
+			}
+		}
+
+		offset += sizeof(*rec) + rec->len;
+	}
+
+	/* Journal space after last record must be erased */
+	*tail_clean = 1;
+	for (i = offset; i < NVRAM_JOURNAL_END; i++) {
+		if (((uint8_t *)header)[i] != 0xFF) {
+			*tail_clean = 0;
+			break;
+		}
+	}
+
+	return offset;
 }
 
@@ -25,6 +25,8 @@
 #include <linux/version.h>
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
 
 #include <linux/fs.h>
 #include <linux/mtd/mtd.h>
@@ -33,10 +35,11 @@
 
 #include "nvram.c"
 
-#define NVRAM_DRIVER_VERSION	"0.08"
+#define NVRAM_DRIVER_VERSION	"0.13"
 #define PROC_NVRAM_NAME		"nvram"
 #define MTD_NVRAM_NAME		"Config"
 #define NVRAM_VALUES_SPACE	(NVRAM_MTD_SIZE*2)
+#define NVRAM_MULTI_CHUNK	32	/* names per nvram_lock hold in *_MULTI */
 
 extern int ra_mtd_read_nm(char *name, loff_t from, size_t len, u_char *buf);
 extern int ra_mtd_write_nm(char *name, loff_t to, size_t len, const u_char *buf);
@@ -48,6 +51,12 @@ static int nvram_major = -1;
 static struct proc_dir_entry *g_pdentry = NULL;
 static char *nvram_values = NULL;
 static unsigned long nvram_offset = 0;
+static anvram_shm_t *nvram_shm = NULL;
+static struct kmem_cache *nvram_tuple_cache = NULL;
+static LIST_HEAD(nvram_watch_list);
+#if defined (CONFIG_ASUS_NVRAM_JOURNAL)
+static int nvram_journal_mtd = 0;
+#endif
 
 // from src/shared/bcmutils.c
 /*******************************************************************************
@@ -128,27 +137,39 @@ _nvram_realloc(struct nvram_tuple *t, const char *name, const char *value, int i
 {
 	struct nvram_tuple *rt = t;
 	uint32_t val_len = strlen(value);
+	uint32_t name_len;
 
-	/* Copy name */
+	/* Copy name to values arena */
 	if (!rt) {
-		if (!(rt = kmalloc(sizeof(struct nvram_tuple) + strlen(name) + 1, GFP_ATOMIC)))
+		name_len = strlen(name);
+		if ((nvram_offset + name_len + 1) >= NVRAM_VALUES_SPACE)
+			return NULL;
+		if (!(rt = kmem_cache_alloc(nvram_tuple_cache, GFP_ATOMIC)))
 			return NULL;
-		rt->name = (char *) &rt[1];
+		rt->name = &nvram_values[nvram_offset];
 		strcpy(rt->name, name);
+		nvram_offset += (name_len + 1);
 		rt->value = NULL;
 		rt->val_len = 0;
-		rt->next = NULL;
+		rt->val_tmp = 1;
+		rt->val_dirty = 0;
 	}
 
+	/* Persistent state changed, journal it on commit */
+	if (rt->val_tmp != ((is_temp) ? 1 : 0))
+		rt->val_dirty = 1;
+
 	/* Mark for temp tuple */
 	rt->val_tmp = (is_temp) ? 1 : 0;
 
 	/* Copy value */
 	if (!rt->value || strcmp(rt->value, value)) {
+		if (!is_temp)
+			rt->val_dirty = 1;
 		if (!rt->value || val_len > rt->val_len) {
 			if ((nvram_offset + val_len + 1) >= NVRAM_VALUES_SPACE) {
 				if (rt != t)
-					kfree(rt);
+					kmem_cache_free(nvram_tuple_cache, rt);
 				return NULL;
 			}
 			rt->value = &nvram_values[nvram_offset];
@@ -166,7 +187,7 @@ void
 _nvram_free(struct nvram_tuple *t)
 {
 	if (t)
-		kfree(t);
+		kmem_cache_free(nvram_tuple_cache, t);
 }
 
 void
@@ -179,6 +200,126 @@ _nvram_reset(void)
 
 ///////////////////////////////////////////////////////////////////////////
 
+/* Notify userspace caches about changes. Should be locked. */
+static inline void
+nvram_gen_bump(void)
+{
+	if (nvram_shm) {
+		nvram_shm->generation++;
+		smp_wmb();
+	}
+}
+
+/* Change subscriber, one per open file */
+struct nvram_watch {
+	struct list_head list;
+	wait_queue_head_t wq;
+	int num_prefix;
+	int overflow;
+	int len;
+	char prefix[NVRAM_WATCH_PREFIXES][NVRAM_MAX_PARAM_LEN];
+	char buf[NVRAM_WATCH_BUF];	/* pending "name\n" lines */
+};
+
+static int
+nvram_watch_match(struct nvram_watch *w, const char *name)
+{
+	int i;
+
+	for (i = 0; i < w->num_prefix; i++) {
+		if (strncmp(name, w->prefix[i], strlen(w->prefix[i])) == 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+static int
+nvram_watch_pending(struct nvram_watch *w, const char *name, int name_len)
+{
+	char *p, *end = w->buf + w->len;
+
+	for (p = w->buf; p < end; p = strchr(p, '\n') + 1) {
+		if (strncmp(p, name, name_len) == 0 && p[name_len] == '\n')
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Queue changed name (NULL for all) to subscribers. Should be locked. */
+static void
+nvram_watch_notify(const char *name)
+{
+	struct nvram_watch *w;
+	int name_len;
+
+	list_for_each_entry(w, &nvram_watch_list, list) {
+		if (w->overflow)
+			continue;
+		if (!name) {
+			w->overflow = 1;
+		} else {
+			if (!nvram_watch_match(w, name))
+				continue;
+			name_len = strlen(name);
+			if (nvram_watch_pending(w, name, name_len))
+				continue;
+			if (w->len + name_len + 1 > NVRAM_WATCH_BUF) {
+				/* Reader is too slow, report full resync */
+				w->overflow = 1;
+				w->len = 0;
+			} else {
+				memcpy(w->buf + w->len, name, name_len);
+				w->len += name_len;
+				w->buf[w->len++] = '\n';
+			}
+		}
+		wake_up_interruptible(&w->wq);
+	}
+}
+
+/* Set variable, returns 1 if value changed. Should be locked. */
+static int
+nvram_set_locked(const char *name, const char *value, int is_temp)
+{
+	int ret, changed;
+	char *old;
+
+	old = _nvram_get(name);
+	changed = (!old || strcmp(old, value) != 0);
+	if ((ret = _nvram_set(name, value, is_temp))) {
+		struct nvram_header *header;
+		/* Consolidate space and try again */
+		if ((header = kzalloc(NVRAM_SPACE, GFP_ATOMIC))) {
+			if (_nvram_generate(header, 1) == 0)
+				ret = _nvram_set(name, value, is_temp);
+			kfree(header);
+		}
+	}
+
+	if (ret)
+		return ret;
+
+	if (changed)
+		nvram_watch_notify(name);
+
+	return changed;
+}
+
+/* Unset variable, returns 1 if variable existed. Should be locked. */
+static int
+nvram_unset_locked(const char *name)
+{
+	if (!_nvram_get(name))
+		return 0;
+
+	_nvram_unset(name);
+	nvram_watch_notify(name);
+
+	return 1;
+}
+
 static int
 nvram_set_temp(const char *name, const char *value, int is_temp)
 {
@@ -193,14 +334,10 @@ nvram_set_temp(const char *name, const char *value, int is_temp)
 		return 0;
 
 	spin_lock_irqsave(&nvram_lock, flags);
-	if ((ret = _nvram_set(name, value, is_temp))) {
-		struct nvram_header *header;
-		/* Consolidate space and try again */
-		if ((header = kzalloc(NVRAM_SPACE, GFP_ATOMIC))) {
-			if (_nvram_generate(header, 1) == 0)
-				ret = _nvram_set(name, value, is_temp);
-			kfree(header);
-		}
+	ret = nvram_set_locked(name, value, is_temp);
+	if (ret > 0) {
+		nvram_gen_bump();
+		ret = 0;
 	}
 	spin_unlock_irqrestore(&nvram_lock, flags);
 
@@ -227,7 +364,10 @@ nvram_unset(const char *name)
 		return 0;
 
 	spin_lock_irqsave(&nvram_lock, flags);
-	ret = _nvram_unset(name);
+	if ((ret = nvram_unset_locked(name)) > 0) {
+		nvram_gen_bump();
+		ret = 0;
+	}
 	spin_unlock_irqrestore(&nvram_lock, flags);
 
 	return ret;
@@ -275,12 +415,40 @@ nvram_getall(char *buf, int count, int include_temp)
 	return ret;
 }
 
+#if defined (CONFIG_ASUS_NVRAM_JOURNAL)
+/* Program journal record to erased flash space, no erase cycle */
+static int
+nvram_journal_write(loff_t to, size_t len, const u_char *buf)
+{
+	int ret;
+	size_t w_len = 0;
+	struct mtd_info *mtd;
+
+	mtd = get_mtd_device_nm(MTD_NVRAM_NAME);
+	if (IS_ERR(mtd))
+		return PTR_ERR(mtd);
+
+	ret = mtd_write(mtd, NVRAM_MTD_OFFSET + to, len, &w_len, buf);
+	if (ret == 0 && w_len != len)
+		ret = -EIO;
+
+	put_mtd_device(mtd);
+
+	return ret;
+}
+#endif
+
 int
 nvram_commit(void)
 {
 	unsigned long flags;
 	unsigned char *bufw, *bufr;
+	uint32_t resets;
 	int ret;
+#if defined (CONFIG_ASUS_NVRAM_JOURNAL)
+	uint32_t offset;
+	int jr_len = -1;
+#endif
 
 	// Check early commit
 	if (nvram_major < 0)
@@ -292,18 +460,54 @@ nvram_commit(void)
 		return -ENOMEM;
 	}
 
-	bufr = kzalloc(NVRAM_SPACE, GFP_KERNEL);
+	bufr = NULL;
+
+	/* Serialize commits, journal records must go in order */
+	mutex_lock(&nvram_sem);
+
+#if defined (CONFIG_ASUS_NVRAM_JOURNAL)
+	/* Append changed variables only */
+	spin_lock_irqsave(&nvram_lock, flags);
+	resets = nvram_journal_resets;
+	offset = nvram_journal_offset;
+	if (nvram_journal_mtd && offset > 0 && offset < NVRAM_JOURNAL_END) {
+		jr_len = _nvram_journal_generate(bufw, NVRAM_JOURNAL_END - offset);
+		if (jr_len >= 0)
+			_nvram_journal_clean();
+	}
+	spin_unlock_irqrestore(&nvram_lock, flags);
+
+	if (jr_len == 0) {
+		ret = 0;
+		goto done;
+	}
+
+	if (jr_len > 0) {
+		ret = nvram_journal_write(offset, jr_len, bufw);
+		spin_lock_irqsave(&nvram_lock, flags);
+		if (ret == 0 && resets == nvram_journal_resets)
+			nvram_journal_offset = offset + jr_len;
+		else if (ret)
+			nvram_journal_offset = 0;
+		spin_unlock_irqrestore(&nvram_lock, flags);
+		if (ret == 0)
+			goto done;
+		printk("nvram_commit: journal write error, compact\n");
+		memset(bufw, 0, NVRAM_SPACE);
+	}
+#endif
 
 	/* Regenerate NVRAM */
 	spin_lock_irqsave(&nvram_lock, flags);
+	resets = nvram_journal_resets;
 	ret = _nvram_generate((struct nvram_header *)bufw, 0);
+	_nvram_journal_clean();
 	spin_unlock_irqrestore(&nvram_lock, flags);
 	if (ret)
 		goto done;
 
-	mutex_lock(&nvram_sem);
-
 	/* Check partition unchanged */
+	bufr = kzalloc(NVRAM_SPACE, GFP_KERNEL);
 	if (bufr) {
 		ret = ra_mtd_read_nm(MTD_NVRAM_NAME, NVRAM_MTD_OFFSET, NVRAM_SPACE, bufr);
 		if (ret == 0 && memcmp(bufw, bufr, NVRAM_SPACE) == 0)
@@ -317,9 +521,17 @@ nvram_commit(void)
 	}
 
 skip_write:
-	mutex_unlock(&nvram_sem);
+	/* Journal starts right after new image */
+	spin_lock_irqsave(&nvram_lock, flags);
+	if (ret == 0 && resets == nvram_journal_resets)
+		nvram_journal_offset = ((struct nvram_header *)bufw)->len;
+	else if (ret)
+		nvram_journal_offset = 0;
+	spin_unlock_irqrestore(&nvram_lock, flags);
 
 done:
+	mutex_unlock(&nvram_sem);
+
 	kfree(bufw);
 	if (bufr)
 		kfree(bufr);
@@ -339,6 +551,8 @@ nvram_clear(void)
 	/* Reset NVRAM */
 	spin_lock_irqsave(&nvram_lock, flags);
 	_nvram_uninit();
+	nvram_gen_bump();
+	nvram_watch_notify(NULL);
 	spin_unlock_irqrestore(&nvram_lock, flags);
 	
 	return 0;
@@ -472,6 +686,221 @@ user_nvram_get(anvram_ioctl_t __user *nvr)
 	return ret;
 }
 
+int
+user_nvram_set_multi(anvram_ioctl_t __user *nvr)
+{
+	int ret, len, changed, i;
+	unsigned long flags;
+	char *buf, *name, *value, *end;
+
+	if (!nvr)
+		return -EINVAL;
+
+	if (nvr->size != sizeof(anvram_ioctl_t))
+		return -EINVAL;
+
+	if (nvr->len_param > NVRAM_SPACE || nvr->len_param < 1 || !nvr->param)
+		return -EOVERFLOW;
+
+	if (!(buf = kmalloc(nvr->len_param+1, GFP_KERNEL)))
+		return -ENOMEM;
+
+	if (copy_from_user(buf, nvr->param, nvr->len_param)) {
+		ret = -EFAULT;
+		goto done;
+	}
+
+	buf[nvr->len_param] = '\0';
+	end = buf + nvr->len_param;
+
+	/* Validate all "name=value\0" (or "name\0" for unset) before apply */
+	for (name = buf; name < end && *name; name += len + 1) {
+		len = strlen(name);
+		value = strchr(name, '=');
+		if ((value ? (value - name) : len) > (NVRAM_MAX_PARAM_LEN-1) ||
+		    (value && strlen(value + 1) > (NVRAM_MAX_VALUE_LEN-1))) {
+			ret = -EOVERFLOW;
+			goto done;
+		}
+		if (name == value) {
+			ret = -EINVAL;
+			goto done;
+		}
+	}
+	end = name;
+
+	// Check early write
+	if (nvram_major < 0) {
+		ret = 0;
+		goto done;
+	}
+
+	ret = 0;
+	changed = 0;
+
+	spin_lock_irqsave(&nvram_lock, flags);
+	for (i = 0, name = buf; name < end; name += len + 1, i++) {
+		/* Let irqs and other CPUs in between chunks, readers may see
+		 * a part of batch (each variable is still set atomically) */
+		if (i > 0 && (i % NVRAM_MULTI_CHUNK) == 0) {
+			if (changed)
+				nvram_gen_bump();
+			changed = 0;
+			spin_unlock_irqrestore(&nvram_lock, flags);
+			spin_lock_irqsave(&nvram_lock, flags);
+		}
+		len = strlen(name);
+		value = strchr(name, '=');
+		if (value) {
+			*value = '\0';
+			ret = nvram_set_locked(name, value + 1, nvr->is_temp);
+			*value = '=';
+		} else {
+			ret = nvram_unset_locked(name);
+		}
+		if (ret < 0)
+			break;
+		changed |= ret;
+		ret = 0;
+	}
+	if (changed)
+		nvram_gen_bump();
+	spin_unlock_irqrestore(&nvram_lock, flags);
+
+done:
+	kfree(buf);
+
+	return ret;
+}
+
+int
+user_nvram_get_multi(anvram_ioctl_t __user *nvr)
+{
+	int ret, len, need, len_out, len_value, i;
+	unsigned long flags;
+	char *names, *name, *end, *value, *out;
+
+	if (!nvr)
+		return -EINVAL;
+
+	if (nvr->size != sizeof(anvram_ioctl_t))
+		return -EINVAL;
+
+	if (nvr->len_value < 1 || !nvr->value)
+		return -EINVAL;
+
+	if (nvr->len_param > NVRAM_SPACE || nvr->len_param < 1 || !nvr->param)
+		return -EOVERFLOW;
+
+	len_value = min_t(int, nvr->len_value, NVRAM_SPACE);
+
+	if (!(names = kmalloc(nvr->len_param+1, GFP_KERNEL)))
+		return -ENOMEM;
+
+	if (!(out = kmalloc(len_value, GFP_KERNEL))) {
+		kfree(names);
+		return -ENOMEM;
+	}
+
+	if (copy_from_user(names, nvr->param, nvr->len_param)) {
+		ret = -EFAULT;
+		goto done;
+	}
+
+	names[nvr->len_param] = '\0';
+	end = names + nvr->len_param;
+
+	/* Write "name=value\0 ... \0" for each existing variable */
+	len_out = 0;
+	need = 1;
+
+	spin_lock_irqsave(&nvram_lock, flags);
+	for (i = 0, name = names; name < end && *name; name += len + 1, i++) {
+		if (i > 0 && (i % NVRAM_MULTI_CHUNK) == 0) {
+			spin_unlock_irqrestore(&nvram_lock, flags);
+			spin_lock_irqsave(&nvram_lock, flags);
+		}
+		len = strlen(name);
+		if (!(value = _nvram_get(name)))
+			continue;
+		need += len + 1 + strlen(value) + 1;
+		if (need <= len_value)
+			len_out += sprintf(out + len_out, "%s=%s", name, value) + 1;
+	}
+	spin_unlock_irqrestore(&nvram_lock, flags);
+
+	if (need > len_value) {
+		nvr->len_value = need;
+		ret = -EOVERFLOW;
+		goto done;
+	}
+
+	out[len_out++] = '\0';
+
+	ret = 0;
+	if (copy_to_user(nvr->value, out, len_out))
+		ret = -EFAULT;
+	nvr->len_value = len_out;
+
+done:
+	kfree(out);
+	kfree(names);
+
+	return ret;
+}
+
+int
+user_nvram_watch(struct file *file, anvram_ioctl_t __user *nvr)
+{
+	struct nvram_watch *w, *w_new = NULL;
+	char param[NVRAM_MAX_PARAM_LEN];
+	unsigned long flags;
+	int ret;
+
+	if (!nvr)
+		return -EINVAL;
+
+	if (nvr->size != sizeof(anvram_ioctl_t))
+		return -EINVAL;
+
+	if (nvr->len_param > (NVRAM_MAX_PARAM_LEN-1) || nvr->len_param < 0)
+		return -EOVERFLOW;
+
+	if (nvr->len_param > 0 && nvr->param) {
+		if (copy_from_user(param, nvr->param, nvr->len_param))
+			return -EFAULT;
+		param[nvr->len_param] = '\0';
+	} else {
+		param[0] = '\0';
+	}
+
+	if (!file->private_data) {
+		if (!(w_new = kzalloc(sizeof(struct nvram_watch), GFP_KERNEL)))
+			return -ENOMEM;
+		init_waitqueue_head(&w_new->wq);
+	}
+
+	ret = 0;
+
+	spin_lock_irqsave(&nvram_lock, flags);
+	if (!(w = file->private_data)) {
+		w = w_new;
+		w_new = NULL;
+		file->private_data = w;
+		list_add(&w->list, &nvram_watch_list);
+	}
+	if (w->num_prefix < NVRAM_WATCH_PREFIXES)
+		strcpy(w->prefix[w->num_prefix++], param);
+	else
+		ret = -ENOSPC;
+	spin_unlock_irqrestore(&nvram_lock, flags);
+
+	if (w_new)
+		kfree(w_new);
+
+	return ret;
+}
+
 static long
 dev_nvram_ioctl(struct file *file, unsigned int req, unsigned long arg)
 {
@@ -485,11 +914,111 @@ dev_nvram_ioctl(struct file *file, unsigned int req, unsigned long arg)
 		return user_nvram_set((anvram_ioctl_t __user *)arg);
 	case NVRAM_IOCTL_GET:
 		return user_nvram_get((anvram_ioctl_t __user *)arg);
+	case NVRAM_IOCTL_SET_MULTI:
+		return user_nvram_set_multi((anvram_ioctl_t __user *)arg);
+	case NVRAM_IOCTL_GET_MULTI:
+		return user_nvram_get_multi((anvram_ioctl_t __user *)arg);
+	case NVRAM_IOCTL_WATCH:
+		return user_nvram_watch(file, (anvram_ioctl_t __user *)arg);
 	}
 	
 	return -EINVAL;
 }
 
+static int
+dev_nvram_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	unsigned long size = vma->vm_end - vma->vm_start;
+
+	if (!nvram_shm)
+		return -ENODEV;
+
+	/* Shared page is read-only for userspace */
+	if (vma->vm_pgoff != 0 || size > PAGE_SIZE || (vma->vm_flags & VM_WRITE))
+		return -EINVAL;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return remap_pfn_range(vma, vma->vm_start, virt_to_phys(nvram_shm) >> PAGE_SHIFT,
+			       size, vma->vm_page_prot);
+}
+
+static ssize_t
+dev_nvram_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
+{
+	struct nvram_watch *w = file->private_data;
+	unsigned long flags;
+	char *out, *p;
+	int len;
+
+	if (!w)
+		return -EINVAL;
+
+	/* Any name fits in one read */
+	if (count < NVRAM_MAX_PARAM_LEN)
+		return -EINVAL;
+
+	if (!(out = kmalloc(NVRAM_WATCH_BUF, GFP_KERNEL)))
+		return -ENOMEM;
+
+	for (;;) {
+		spin_lock_irqsave(&nvram_lock, flags);
+		if (w->overflow) {
+			/* "*" means any variable may have changed */
+			w->overflow = 0;
+			w->len = 0;
+			strcpy(out, "*\n");
+			len = 2;
+			break;
+		}
+		if (w->len > 0) {
+			/* Return whole lines only */
+			len = min_t(int, w->len, count);
+			for (p = w->buf + len; p > w->buf && p[-1] != '\n'; p--);
+			len = p - w->buf;
+			memcpy(out, w->buf, len);
+			w->len -= len;
+			memmove(w->buf, w->buf + len, w->len);
+			break;
+		}
+		spin_unlock_irqrestore(&nvram_lock, flags);
+		
+		if (file->f_flags & O_NONBLOCK) {
+			kfree(out);
+			return -EAGAIN;
+		}
+		
+		if (wait_event_interruptible(w->wq, w->len > 0 || w->overflow)) {
+			kfree(out);
+			return -ERESTARTSYS;
+		}
+	}
+	spin_unlock_irqrestore(&nvram_lock, flags);
+
+	if (copy_to_user(buf, out, len))
+		len = -EFAULT;
+
+	kfree(out);
+
+	return len;
+}
+
+static unsigned int
+dev_nvram_poll(struct file *file, poll_table *wait)
+{
+	struct nvram_watch *w = file->private_data;
+
+	if (!w)
+		return POLLERR;
+
+	poll_wait(file, &w->wq, wait);
+
+	if (w->len > 0 || w->overflow)
+		return POLLIN | POLLRDNORM;
+
+	return 0;
+}
+
 static int
 nvram_ver_seq_show(struct seq_file *m, void *v)
 {
@@ -498,6 +1027,12 @@ nvram_ver_seq_show(struct seq_file *m, void *v)
 	seq_printf(m, "nvram driver : v%s\n", NVRAM_DRIVER_VERSION);
 	seq_printf(m, "nvram space  : %d\n", NVRAM_SPACE);
 	seq_printf(m, "major number : %d\n", nvram_major);
+	if (nvram_shm)
+		seq_printf(m, "generation   : %u\n", nvram_shm->generation);
+#if defined (CONFIG_ASUS_NVRAM_JOURNAL)
+	seq_printf(m, "journal      : %s, offset 0x%x\n",
+		(nvram_journal_mtd) ? "on" : "off", nvram_journal_offset);
+#endif
 
 	nvram_mtd = get_mtd_device_nm(MTD_NVRAM_NAME);
 	if (!IS_ERR(nvram_mtd)) {
@@ -552,6 +1087,16 @@ dev_nvram_open(struct inode *inode, struct file * file)
 static int
 dev_nvram_release(struct inode *inode, struct file * file)
 {
+	struct nvram_watch *w = file->private_data;
+	unsigned long flags;
+
+	if (w) {
+		spin_lock_irqsave(&nvram_lock, flags);
+		list_del(&w->list);
+		spin_unlock_irqrestore(&nvram_lock, flags);
+		kfree(w);
+	}
+
 	module_put(THIS_MODULE);
 	return 0;
 }
@@ -560,7 +1105,10 @@ static const struct file_operations dev_nvram_fops = {
 	owner:		THIS_MODULE,
 	open:		dev_nvram_open,
 	release:	dev_nvram_release,
+	read:		dev_nvram_read,
+	poll:		dev_nvram_poll,
 	unlocked_ioctl:	dev_nvram_ioctl,
+	mmap:		dev_nvram_mmap,
 };
 
 static void
@@ -582,6 +1130,17 @@ dev_nvram_exit(void)
 		kfree(nvram_values);
 		nvram_values = NULL;
 	}
+
+	if (nvram_tuple_cache) {
+		kmem_cache_destroy(nvram_tuple_cache);
+		nvram_tuple_cache = NULL;
+	}
+
+	if (nvram_shm) {
+		ClearPageReserved(virt_to_page(nvram_shm));
+		free_page((unsigned long)nvram_shm);
+		nvram_shm = NULL;
+	}
 }
 
 static int __init
@@ -598,6 +1157,20 @@ dev_nvram_init(void)
 	if (!nvram_values)
 		return -ENOMEM;
 
+	nvram_tuple_cache = kmem_cache_create("nvram_tuple", sizeof(struct nvram_tuple), 0, 0, NULL);
+	if (!nvram_tuple_cache) {
+		kfree(nvram_values);
+		nvram_values = NULL;
+		return -ENOMEM;
+	}
+
+	/* Page for userspace caches (optional) */
+	nvram_shm = (anvram_shm_t *)get_zeroed_page(GFP_KERNEL);
+	if (nvram_shm) {
+		SetPageReserved(virt_to_page(nvram_shm));
+		nvram_shm->magic = NVRAM_MAGIC;
+	}
+
 	/* Initialize hash table */
 	header = kzalloc(NVRAM_SPACE, GFP_KERNEL);
 	if (header) {
@@ -617,6 +1190,17 @@ dev_nvram_init(void)
 
 	nvram_major = NVRAM_MAJOR;
 
+#if defined (CONFIG_ASUS_NVRAM_JOURNAL)
+	/* NOR can program erased bytes w/o erase cycle */
+	{
+		struct mtd_info *nvram_mtd = get_mtd_device_nm(MTD_NVRAM_NAME);
+		if (!IS_ERR(nvram_mtd)) {
+			nvram_journal_mtd = (nvram_mtd->type == MTD_NORFLASH && nvram_mtd->writesize == 1);
+			put_mtd_device(nvram_mtd);
+		}
+	}
+#endif
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,10,0)
 	g_pdentry = proc_create(PROC_NVRAM_NAME, S_IRUGO, NULL, &nvram_ver_seq_fops);
 #else
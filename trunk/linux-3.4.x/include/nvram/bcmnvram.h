@@ -16,6 +16,7 @@
 #define _bcmnvram_h_
 
 #define NVRAM_MAGIC		0x48534C46	/* 'FLSH' */
+#define NVRAM_JOURNAL_MAGIC	0x4C4E524A	/* 'JRNL' */
 #define NVRAM_CLEAR_MAGIC	0x0
 #define NVRAM_INVALID_MAGIC	0xFFFFFFFF
 #define NVRAM_VERSION		1
@@ -44,6 +45,12 @@
 #define NVRAM_IOCTL_CLEAR	20
 #define NVRAM_IOCTL_SET		30
 #define NVRAM_IOCTL_GET		40
+#define NVRAM_IOCTL_SET_MULTI	50	/* param: "name=value\0...", no '=' for unset */
+#define NVRAM_IOCTL_GET_MULTI	60	/* param: "name\0...", value: "name=value\0...\0" */
+#define NVRAM_IOCTL_WATCH	70	/* param: name prefix ("" for all), read() returns "name\n..." */
+
+#define NVRAM_WATCH_PREFIXES	16
+#define NVRAM_WATCH_BUF		4096
 
 #ifdef __KERNEL__
 
@@ -57,9 +64,9 @@
 struct nvram_tuple {
 	char *name;
 	char *value;
-	uint32_t val_len:31,
-	         val_tmp:1;
-	struct nvram_tuple *next;
+	uint32_t val_len:30,
+	         val_tmp:1,
+	         val_dirty:1;		/* changed since last commit */
 };
 
 #endif
@@ -72,6 +79,17 @@ struct nvram_header {
 	uint32_t config_ncdl;		/* ncdl values for memc */
 };
 
+/*
+ * Journal records are appended (w/o erase) to the 0xFF filled space after
+ * header->len, payload is "name=value\0" or "name\0" (unset), 0 padded.
+ */
+struct nvram_journal_rec {
+	uint32_t magic;
+	uint32_t crc;			/* crc32 of len, reserved and payload */
+	uint16_t len;			/* payload length, 4 bytes aligned */
+	uint16_t reserved;
+};
+
 typedef struct anvram_ioctl_s {
 	int size;
 	int is_temp;
@@ -81,5 +99,11 @@ typedef struct anvram_ioctl_s {
 	char *value;
 } anvram_ioctl_t;
 
+/* read-only page shared with userspace via mmap(/dev/nvram) */
+typedef struct anvram_shm_s {
+	uint32_t magic;
+	uint32_t generation;		/* bumped on every change of variables */
+} anvram_shm_t;
+
 #endif /* _bcmnvram_h_ */
 
@@ -0,0 +1,200 @@
+#define _GNU_SOURCE
+#include "cacheutils.h"
+#include "logutils.h"
+#include "uthash.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <netinet/in.h>
+#undef _GNU_SOURCE
+
+#define DNS_RCODE_NOERROR 0
+#define DNS_RCODE_NXDOMAIN 3
+#define CACHE_TTL_MAXSEC 86400 /* cap the ttl of cached replies */
+#define CACHE_STALE_MAXSEC 86400 /* drop entries that expired longer ago */
+#define CACHE_PREFETCH_MINHITS 2 /* only prefetch entries hit at least this many times */
+#define CACHE_PREFETCH_RATIO 10 /* prefetch in the last 1/10 of the ttl */
+
+/* cache entry typedef (key and reply stored inline) */
+typedef struct cacheentry {
+    struct cacheentry *lru_prev;    /* towards the most recently used */
+    struct cacheentry *lru_next;    /* towards the least recently used */
+    time_t             store_time;  /* monotonic second of cache_put() */
+    uint32_t           ttl;         /* min ttl of the reply records */
+    uint32_t           hit_count;   /* hits since cache_put() */
+    bool               prefetching; /* refresh query sent */
+    uint16_t           key_len;     /* qtype + lowercase wire qname */
+    uint16_t           reply_len;   /* reply follows the key */
+    UT_hash_handle     hh;          /* metadata, used internally by uthash */
+    uint8_t            data[];      /* key, reply */
+} cacheentry_t;
+
+/* hash table, lru list and memory cap */
+static cacheentry_t *g_cache_headentry = NULL;
+static cacheentry_t *g_cache_lru_head  = NULL;
+static cacheentry_t *g_cache_lru_tail  = NULL;
+static size_t        g_cache_max_size  = 0;
+static size_t        g_cache_cur_size  = 0;
+
+/* counters for cache_dump_stats() */
+static uint64_t g_cache_hits      = 0;
+static uint64_t g_cache_misses    = 0;
+static uint64_t g_cache_stales    = 0;
+static uint64_t g_cache_prefetchs = 0;
+static uint64_t g_cache_evictions = 0;
+
+static inline time_t cache_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+static inline size_t cache_entry_size(const cacheentry_t *entry) {
+    return sizeof(cacheentry_t) + entry->key_len + entry->reply_len;
+}
+
+static void cache_lru_unlink(cacheentry_t *entry) {
+    if (entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+    else g_cache_lru_head = entry->lru_next;
+    if (entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+    else g_cache_lru_tail = entry->lru_prev;
+}
+
+static void cache_lru_push(cacheentry_t *entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = g_cache_lru_head;
+    if (g_cache_lru_head) g_cache_lru_head->lru_prev = entry;
+    else g_cache_lru_tail = entry;
+    g_cache_lru_head = entry;
+}
+
+static void cache_del(cacheentry_t *entry) {
+    MYHASH_DEL(g_cache_headentry, entry);
+    cache_lru_unlink(entry);
+    g_cache_cur_size -= cache_entry_size(entry);
+    free(entry);
+}
+
+/* initialize the reply cache, max_size is the memory cap (in bytes) */
+void cache_init(size_t max_size) {
+    g_cache_max_size = max_size;
+}
+
+/* build the cache key of a (checked) query, return the key length */
+size_t cache_get_key(const void *query_buf, void *key_buf) {
+    const uint8_t *qname = query_buf + sizeof(dns_header_t);
+    size_t qname_len = strlen((const char *)qname) + 1;
+    uint8_t *key = key_buf;
+    memcpy(key, qname + qname_len, 2); /* qtype */
+    for (size_t i = 0; i < qname_len; ++i) key[2 + i] = tolower(qname[i]);
+    return 2 + qname_len;
+}
+
+static cacheentry_t* cache_find(const void *key_buf, size_t key_len) {
+    cacheentry_t *entry = NULL;
+    MYHASH_GET(g_cache_headentry, entry, key_buf, key_len);
+    return entry;
+}
+
+/* look up the reply of a (checked) query, reply_buf is DNS_PACKET_MAXSIZE bytes */
+uint8_t cache_get(const void *query_buf, void *reply_buf, size_t *reply_len) {
+    uint8_t key_buf[CACHE_KEY_MAXLEN];
+    size_t key_len = cache_get_key(query_buf, key_buf);
+    cacheentry_t *entry = cache_find(key_buf, key_len);
+    if (!entry) {
+        ++g_cache_misses;
+        return CACHE_RESULT_MISS;
+    }
+
+    uint32_t elapsed = cache_now() - entry->store_time;
+    if (elapsed >= entry->ttl) {
+        ++g_cache_misses;
+        if (elapsed - entry->ttl < CACHE_STALE_MAXSEC) return CACHE_RESULT_STALE;
+        cache_del(entry);
+        return CACHE_RESULT_MISS;
+    }
+
+    /* the client's msgid, flags and qname case; the cached answers with the remaining ttl */
+    memcpy(reply_buf, entry->data + entry->key_len, entry->reply_len);
+    memcpy(reply_buf, query_buf, sizeof(uint16_t));
+    memcpy(reply_buf + sizeof(dns_header_t), query_buf + sizeof(dns_header_t), key_len - 2);
+    ((dns_header_t *)reply_buf)->rd = ((const dns_header_t *)query_buf)->rd;
+    dns_reply_sub_ttl(reply_buf, entry->reply_len, elapsed);
+    *reply_len = entry->reply_len;
+
+    ++g_cache_hits;
+    ++entry->hit_count;
+    cache_lru_unlink(entry);
+    cache_lru_push(entry);
+
+    if (!entry->prefetching && entry->hit_count >= CACHE_PREFETCH_MINHITS && (entry->ttl - elapsed) * CACHE_PREFETCH_RATIO <= entry->ttl) {
+        entry->prefetching = true;
+        ++g_cache_prefetchs;
+        return CACHE_RESULT_PREFETCH;
+    }
+    return CACHE_RESULT_HIT;
+}
+
+/* copy the expired reply of key to reply_buf (ttl set to CACHE_STALE_TTL) */
+bool cache_get_stale(const void *key_buf, size_t key_len, uint16_t msgid, void *reply_buf, size_t *reply_len) {
+    cacheentry_t *entry = cache_find(key_buf, key_len);
+    if (!entry) return false;
+    memcpy(reply_buf, entry->data + entry->key_len, entry->reply_len);
+    ((dns_header_t *)reply_buf)->id = msgid;
+    dns_reply_set_ttl(reply_buf, entry->reply_len, CACHE_STALE_TTL);
+    *reply_len = entry->reply_len;
+    ++g_cache_stales;
+    return true;
+}
+
+/* store an accepted (checked) reply */
+void cache_put(const void *reply_buf, size_t reply_len) {
+    const dns_header_t *header = reply_buf;
+    if (!header->qr || header->tc || (header->rcode != DNS_RCODE_NOERROR && header->rcode != DNS_RCODE_NXDOMAIN)) return;
+
+    /* the reply may have been accepted without a full check (fast-mode trust-dns) */
+    if (ntohs(header->question_count) != 1) return;
+    const void *qname_endptr = memchr(reply_buf + sizeof(dns_header_t), 0, reply_len - sizeof(dns_header_t));
+    if (!qname_endptr || qname_endptr - (reply_buf + sizeof(dns_header_t)) >= DNS_DOMAIN_NAME_MAXLEN + 1) return;
+    if (qname_endptr + 1 + sizeof(dns_query_t) > reply_buf + reply_len) return;
+
+    /* negative replies are cached by the ttl of the SOA record (rfc2308) */
+    uint32_t ttl = dns_reply_get_ttl(reply_buf, reply_len);
+    if (ttl == 0) return;
+    if (ttl > CACHE_TTL_MAXSEC) ttl = CACHE_TTL_MAXSEC;
+
+    uint8_t key_buf[CACHE_KEY_MAXLEN];
+    size_t key_len = cache_get_key(reply_buf, key_buf);
+    cacheentry_t *entry = cache_find(key_buf, key_len);
+    if (entry) cache_del(entry);
+
+    size_t entry_size = sizeof(cacheentry_t) + key_len + reply_len;
+    if (entry_size > g_cache_max_size) return;
+    while (g_cache_cur_size + entry_size > g_cache_max_size) {
+        cache_del(g_cache_lru_tail);
+        ++g_cache_evictions;
+    }
+
+    entry = malloc(entry_size);
+    if (!entry) return; /* out of memory, the reply is just not cached */
+    entry->store_time = cache_now();
+    entry->ttl = ttl;
+    entry->hit_count = 0;
+    entry->prefetching = false;
+    entry->key_len = key_len;
+    entry->reply_len = reply_len;
+    memcpy(entry->data, key_buf, key_len);
+    memcpy(entry->data + key_len, reply_buf, reply_len);
+    MYHASH_ADD(g_cache_headentry, entry, entry->data, key_len);
+    cache_lru_push(entry);
+    g_cache_cur_size += entry_size;
+}
+
+/* print the counters and the memory usage */
+void cache_dump_stats(void) {
+    uint64_t lookups = g_cache_hits + g_cache_misses;
+    LOGINF("[cache_dump_stats] entries: %u, memory: %zu/%zu bytes", (unsigned)MYHASH_LEN(g_cache_headentry), g_cache_cur_size, g_cache_max_size);
+    LOGINF("[cache_dump_stats] hits: %llu, misses: %llu, hit rate: %.1f%%", (unsigned long long)g_cache_hits, (unsigned long long)g_cache_misses, lookups ? g_cache_hits * 100.0 / lookups : 0.0);
+    LOGINF("[cache_dump_stats] stale replies: %llu, prefetches: %llu, evictions: %llu", (unsigned long long)g_cache_stales, (unsigned long long)g_cache_prefetchs, (unsigned long long)g_cache_evictions);
+}
@@ -0,0 +1,41 @@
+#ifndef CHINADNS_NG_CACHEUTILS_H
+#define CHINADNS_NG_CACHEUTILS_H
+
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "dnsutils.h"
+#undef _GNU_SOURCE
+
+/* cache_get() return value */
+#define CACHE_RESULT_MISS 0 // not cached, forward it
+#define CACHE_RESULT_HIT 1 // reply_buf is filled
+#define CACHE_RESULT_PREFETCH 2 // reply_buf is filled, forward it to refresh the entry
+#define CACHE_RESULT_STALE 3 // expired entry, forward it and keep the key for cache_get_stale()
+
+/* cache key max length: qtype + wire format qname */
+#define CACHE_KEY_MAXLEN (2 + DNS_DOMAIN_NAME_MAXLEN + 1)
+
+/* ttl of the records in a stale reply (rfc8767) */
+#define CACHE_STALE_TTL 30
+
+/* initialize the reply cache, max_size is the memory cap (in bytes) */
+void cache_init(size_t max_size);
+
+/* look up the reply of a (checked) query, reply_buf is DNS_PACKET_MAXSIZE bytes */
+uint8_t cache_get(const void *query_buf, void *reply_buf, size_t *reply_len);
+
+/* build the cache key of a (checked) query, return the key length */
+size_t cache_get_key(const void *query_buf, void *key_buf);
+
+/* copy the expired reply of key to reply_buf (ttl set to CACHE_STALE_TTL) */
+bool cache_get_stale(const void *key_buf, size_t key_len, uint16_t msgid, void *reply_buf, size_t *reply_len);
+
+/* store an accepted (checked) reply */
+void cache_put(const void *reply_buf, size_t reply_len);
+
+/* print the counters and the memory usage */
+void cache_dump_stats(void);
+
+#endif
@@ -4,7 +4,9 @@
 #include "netutils.h"
 #include "dnsutils.h"
 #include "dnlutils.h"
+#include "iplutils.h"
 #include "maputils.h"
+#include "cacheutils.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -18,25 +20,27 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/epoll.h>
+#include <sys/prctl.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <linux/limits.h>
 #undef _GNU_SOURCE
 
-/* left-16-bit:MSGID; right-16-bit:IDX/MARK */
+/* epoll event data: IDX/MARK */
 #define CHINADNS1_IDX 0
 #define CHINADNS2_IDX 1
 #define TRUSTDNS1_IDX 2
 #define TRUSTDNS2_IDX 3
 #define BINDSOCK_MARK 4
 #define TIMER_FD_MARK 5
-#define BIT_SHIFT_LEN 16
 #define IDX_MARK_MASK 0xffff
 
 /* constant macro definition */
 #define EPOLL_MAXEVENTS 8
 #define SERVER_MAXCOUNT 4
+#define WORKER_MAXCOUNT 16
 #define SOCKBUFF_MAXSIZE DNS_PACKET_MAXSIZE
+#define PACKET_BATCH_SIZE 16 /* datagrams per recvmmsg/sendmmsg */
 #define PORTSTR_MAXLEN 6 /* "65535\0" (including '\0') */
 #define ADDRPORT_STRLEN (INET6_ADDRSTRLEN + PORTSTR_MAXLEN) /* "addr#port\0" */
 #define CHINADNS_VERSION "ChinaDNS-NG v1.0-beta.17 <https://github.com/zfl9/chinadns-ng>"
@@ -48,11 +52,20 @@
 static int             g_epollfd                                          = -1;
 static bool            g_verbose                                          = false;
 static bool            g_reuse_port                                       = false;
+static int             g_worker_count                                     = 1; /* event loop processes */
+static pid_t           g_worker_pids[WORKER_MAXCOUNT]                     = {0}; /* forked by the first worker */
 static bool            g_fair_mode                                        = false; /* default: fast-mode */
 static uint8_t         g_repeat_times                                     = 1; /* used by trust-dns only */
 static const char     *g_gfwlist_fname                                    = NULL; /* gfwlist dnamelist filename */
 static const char     *g_chnlist_fname                                    = NULL; /* chnlist dnamelist filename */
+static const char     *g_binlist_fname                                    = NULL; /* precompiled dnamelist filename */
+static bool            g_dnl_enabled                                      = false; /* gfwlist or chnlist loaded */
 static bool            g_gfwlist_first                                    = true; /* match gfwlist dnamelist first */
+       const char     *g_chnroute_fname4                                  = NULL; /* ipv4 ip-prefix-list filename */
+       const char     *g_chnroute_fname6                                  = NULL; /* ipv6 ip-prefix-list filename */
+static volatile sig_atomic_t g_reload_iplist                              = 0; /* set by SIGHUP */
+static volatile sig_atomic_t g_dump_cache                                 = 0; /* set by SIGUSR1 */
+static size_t          g_cache_size                                       = 0; /* reply cache cap (bytes), 0: disabled */
        bool            g_noip_as_chnip                                    = false; /* default: see as not-chnip */
        char            g_ipset_setname4[IPSET_MAXNAMELEN]                 = "chnroute"; /* ipset setname for ipv4 */
        char            g_ipset_setname6[IPSET_MAXNAMELEN]                 = "chnroute6"; /* ipset setname for ipv6 */
@@ -63,10 +76,20 @@ static int             g_bind_socket                                      = -1;
 static int             g_remote_sockets[SERVER_MAXCOUNT]                  = {-1, -1, -1, -1};
 static char            g_remote_servers[SERVER_MAXCOUNT][ADDRPORT_STRLEN] = {"114.114.114.114#53", "", "8.8.8.8#53", ""};
 static inet6_skaddr_t  g_remote_skaddrs[SERVER_MAXCOUNT]                  = {{0}};
-static char            g_socket_buffer[SOCKBUFF_MAXSIZE]                  = {0};
+static struct mmsghdr  g_recv_msgs[PACKET_BATCH_SIZE]                     = {{{0}, 0}};
+static struct iovec    g_recv_iovs[PACKET_BATCH_SIZE]                     = {{0}};
+static char            g_recv_bufs[PACKET_BATCH_SIZE][SOCKBUFF_MAXSIZE]    = {{0}};
+static inet6_skaddr_t  g_recv_skaddrs[PACKET_BATCH_SIZE]                  = {{0}};
+static struct mmsghdr  g_send_msgs[PACKET_BATCH_SIZE]                     = {{{0}, 0}};
+static struct iovec    g_send_iovs[PACKET_BATCH_SIZE]                     = {{0}};
+static inet6_skaddr_t  g_send_skaddrs[PACKET_BATCH_SIZE]                  = {{0}};
+static char            g_reply_bufs[PACKET_BATCH_SIZE][SOCKBUFF_MAXSIZE]   = {{0}}; /* replies from cache */
+static int             g_send_count                                       = 0; /* queued datagrams */
 static time_t          g_upstream_timeout_sec                             = 3;
 static uint16_t        g_current_message_id                               = 0;
 static hashmap_t      *g_message_id_hashmap                               = NULL;
+static int             g_timer_fd                                         = -1; /* drives the timing wheel */
+static bool            g_timer_armed                                      = false; /* disarmed while idle */
 static char            g_domain_name_buffer[DNS_DOMAIN_NAME_MAXLEN]       = {0};
 static char            g_ipaddrstring_buffer[INET6_ADDRSTRLEN]            = {0};
 
@@ -79,13 +102,18 @@ static void print_command_help(void) {
            " -t, --trust-dns <ip[#port],...>      trust dns server, default: <GoogleDNS>\n"
            " -4, --ipset-name4 <ipv4-setname>     ipset ipv4 set name, default: chnroute\n"
            " -6, --ipset-name6 <ipv6-setname>     ipset ipv6 set name, default: chnroute6\n"
+           " -i, --chnroute-file <file-path>      load ipv4 list into memory instead of ipset\n"
+           " -I, --chnroute6-file <file-path>     load ipv6 list into memory instead of ipset\n"
            " -g, --gfwlist-file <file-path>       filepath of gfwlist, '-' indicate stdin\n"
            " -m, --chnlist-file <file-path>       filepath of chnlist, '-' indicate stdin\n"
+           " -B, --binlist-file <file-path>       precompiled gfwlist+chnlist, mmap'd if up to date\n"
            " -o, --timeout-sec <query-timeout>    timeout of the upstream dns, default: 3\n"
            " -p, --repeat-times <repeat-times>    it is only used for trustdns, default: 1\n"
+           " -C, --cache-size <size-in-KiB>       reply cache memory cap, default: 0 (off)\n"
            " -M, --chnlist-first                  match chnlist first, default: <disabled>\n"
            " -f, --fair-mode                      enable `fair` mode, default: <fast-mode>\n"
            " -r, --reuse-port                     enable SO_REUSEPORT, default: <disabled>\n"
+           " -w, --worker-count <count>           SO_REUSEPORT worker processes, default: 1\n"
            " -n, --noip-as-chnip                  accept reply without ipaddr (A/AAAA query)\n"
            " -v, --verbose                        print the verbose log, default: <disabled>\n"
            " -V, --version                        print `chinadns-ng` version number and exit\n"
@@ -142,7 +170,7 @@ PRINT_HELP_AND_EXIT:
 
 /* parse and check command arguments */
 static void parse_command_args(int argc, char *argv[]) {
-    const char *optstr = ":b:l:c:t:4:6:g:m:o:p:MfrnvVh";
+    const char *optstr = ":b:l:c:t:4:6:i:I:g:m:B:o:p:C:Mfrw:nvVh";
     const struct option options[] = {
         {"bind-addr",     required_argument, NULL, 'b'},
         {"bind-port",     required_argument, NULL, 'l'},
@@ -150,13 +178,18 @@ static void parse_command_args(int argc, char *argv[]) {
         {"trust-dns",     required_argument, NULL, 't'},
         {"ipset-name4",   required_argument, NULL, '4'},
         {"ipset-name6",   required_argument, NULL, '6'},
+        {"chnroute-file", required_argument, NULL, 'i'},
+        {"chnroute6-file", required_argument, NULL, 'I'},
         {"gfwlist-file",  required_argument, NULL, 'g'},
         {"chnlist-file",  required_argument, NULL, 'm'},
+        {"binlist-file",  required_argument, NULL, 'B'},
         {"timeout-sec",   required_argument, NULL, 'o'},
         {"repeat-times",  required_argument, NULL, 'p'},
+        {"cache-size",    required_argument, NULL, 'C'},
         {"chnlist-first", no_argument,       NULL, 'M'},
         {"fair-mode",     no_argument,       NULL, 'f'},
         {"reuse-port",    no_argument,       NULL, 'r'},
+        {"worker-count",  required_argument, NULL, 'w'},
         {"noip-as-chnip", no_argument,       NULL, 'n'},
         {"verbose",       no_argument,       NULL, 'v'},
         {"version",       no_argument,       NULL, 'V'},
@@ -212,6 +245,20 @@ static void parse_command_args(int argc, char *argv[]) {
                 }
                 strcpy(g_ipset_setname6, optarg);
                 break;
+            case 'i':
+                if (strlen(optarg) + 1 > PATH_MAX) {
+                    printf("[parse_command_args] file path max length is 4095: %s\n", optarg);
+                    goto PRINT_HELP_AND_EXIT;
+                }
+                g_chnroute_fname4 = optarg;
+                break;
+            case 'I':
+                if (strlen(optarg) + 1 > PATH_MAX) {
+                    printf("[parse_command_args] file path max length is 4095: %s\n", optarg);
+                    goto PRINT_HELP_AND_EXIT;
+                }
+                g_chnroute_fname6 = optarg;
+                break;
             case 'g':
                 if (strlen(optarg) + 1 > PATH_MAX) {
                     printf("[parse_command_args] file path max length is 4095: %s\n", optarg);
@@ -226,6 +273,13 @@ static void parse_command_args(int argc, char *argv[]) {
                 }
                 g_chnlist_fname = optarg;
                 break;
+            case 'B':
+                if (strlen(optarg) + 1 > PATH_MAX) {
+                    printf("[parse_command_args] file path max length is 4095: %s\n", optarg);
+                    goto PRINT_HELP_AND_EXIT;
+                }
+                g_binlist_fname = optarg;
+                break;
             case 'o':
                 g_upstream_timeout_sec = strtol(optarg, NULL, 10);
                 if (g_upstream_timeout_sec <= 0) {
@@ -240,6 +294,13 @@ static void parse_command_args(int argc, char *argv[]) {
                     goto PRINT_HELP_AND_EXIT;
                 }
                 break;
+            case 'C':
+                if (strtol(optarg, NULL, 10) < 0) {
+                    printf("[parse_command_args] invalid reply cache size: %s\n", optarg);
+                    goto PRINT_HELP_AND_EXIT;
+                }
+                g_cache_size = strtol(optarg, NULL, 10) * 1024;
+                break;
             case 'M':
                 g_gfwlist_first = false;
                 break;
@@ -249,6 +310,13 @@ static void parse_command_args(int argc, char *argv[]) {
             case 'r':
                 g_reuse_port = true;
                 break;
+            case 'w':
+                g_worker_count = strtol(optarg, NULL, 10);
+                if (g_worker_count < 1 || g_worker_count > WORKER_MAXCOUNT) {
+                    printf("[parse_command_args] worker count must be 1..%d: %s\n", WORKER_MAXCOUNT, optarg);
+                    goto PRINT_HELP_AND_EXIT;
+                }
+                break;
             case 'n':
                 g_noip_as_chnip = true;
                 break;
@@ -305,83 +373,155 @@ PRINT_HELP_AND_EXIT:
     exit(1);
 }
 
+/* send the queued datagrams with as few syscalls as possible */
+static void flush_packets(int sockfd) {
+    int sent_count = 0;
+    while (sent_count < g_send_count) {
+        int ret = sendmmsg(sockfd, g_send_msgs + sent_count, g_send_count - sent_count, 0);
+        if (ret > 0) {
+            sent_count += ret;
+            continue;
+        }
+        if (ret < 0 && errno == EINTR) continue;
+        /* the datagram at sent_count failed, report it and go on with the rest */
+        const inet6_skaddr_t *dest_addr = &g_send_skaddrs[sent_count];
+        sock_port_t dest_port = 0;
+        if (dest_addr->sin6_family == AF_INET) {
+            parse_ipv4_addr((void *)dest_addr, g_ipaddrstring_buffer, &dest_port);
+        } else {
+            parse_ipv6_addr((void *)dest_addr, g_ipaddrstring_buffer, &dest_port);
+        }
+        LOGERR("[flush_packets] failed to send dns packet to %s#%hu: (%d) %s", g_ipaddrstring_buffer, dest_port, errno, strerror(errno));
+        ++sent_count;
+    }
+    g_send_count = 0;
+}
+
+/* queue a datagram for flush_packets(), flush first if the queue is full */
+static void queue_packet(int sockfd, void *packet_buf, size_t packet_len, const inet6_skaddr_t *dest_addr) {
+    if (g_send_count == PACKET_BATCH_SIZE) flush_packets(sockfd);
+    int index = g_send_count++;
+    memcpy(&g_send_skaddrs[index], dest_addr, sizeof(inet6_skaddr_t));
+    g_send_iovs[index].iov_base = packet_buf;
+    g_send_iovs[index].iov_len = packet_len;
+    g_send_msgs[index].msg_hdr = (struct msghdr){
+        .msg_name = &g_send_skaddrs[index],
+        .msg_namelen = (dest_addr->sin6_family == AF_INET) ? sizeof(inet4_skaddr_t) : sizeof(inet6_skaddr_t),
+        .msg_iov = &g_send_iovs[index],
+        .msg_iovlen = 1,
+    };
+}
+
+/* receive up to PACKET_BATCH_SIZE datagrams into g_recv_bufs, -1 on error */
+static int recv_packets(int sockfd) {
+    for (int i = 0; i < PACKET_BATCH_SIZE; ++i) {
+        g_recv_iovs[i].iov_base = g_recv_bufs[i];
+        g_recv_iovs[i].iov_len = SOCKBUFF_MAXSIZE;
+        g_recv_msgs[i].msg_hdr = (struct msghdr){
+            .msg_name = &g_recv_skaddrs[i],
+            .msg_namelen = sizeof(inet6_skaddr_t),
+            .msg_iov = &g_recv_iovs[i],
+            .msg_iovlen = 1,
+        };
+    }
+    return recvmmsg(sockfd, g_recv_msgs, PACKET_BATCH_SIZE, 0, NULL);
+}
+
 /* handle local socket readable event */
 static void handle_local_packet(void) {
-    inet6_skaddr_t source_addr = {0};
-    socklen_t source_addrlen = sizeof(inet6_skaddr_t);
-    ssize_t packet_len = recvfrom(g_bind_socket, g_socket_buffer, SOCKBUFF_MAXSIZE, 0, (void *)&source_addr, &source_addrlen);
+    int packet_count = recv_packets(g_bind_socket);
 
-    if (packet_len < 0) {
+    if (packet_count < 0) {
         if (errno == EAGAIN || errno == EINTR) return;
         LOGERR("[handle_local_packet] failed to recv data from bind socket: (%d) %s", errno, strerror(errno));
         return;
     }
 
-    if (!dns_query_check(g_socket_buffer, packet_len, (g_verbose || g_gfwlist_fname || g_chnlist_fname) ? g_domain_name_buffer : NULL)) return;
+    /* +1: the first tick comes anywhere within one interval */
+    uint32_t timeout_ticks = g_upstream_timeout_sec * 1000 / TIMEWHEEL_TICK_MSEC + 1;
+    uint8_t dnlmatch_rets[PACKET_BATCH_SIZE];
+    const inet6_skaddr_t no_client_addr = {0}; /* AF_UNSPEC: cache prefetch query */
+    size_t reply_len = 0;
 
-    IF_VERBOSE {
-        sock_port_t source_port = 0;
-        if (source_addr.sin6_family == AF_INET) {
-            parse_ipv4_addr((void *)&source_addr, g_ipaddrstring_buffer, &source_port);
-        } else {
-            parse_ipv6_addr((void *)&source_addr, g_ipaddrstring_buffer, &source_port);
+    for (int k = 0; k < packet_count; ++k) {
+        char *packet_buf = g_recv_bufs[k];
+        size_t packet_len = g_recv_msgs[k].msg_len;
+        const inet6_skaddr_t *source_addr = &g_recv_skaddrs[k];
+
+        if (!dns_query_check(packet_buf, packet_len, (g_verbose || g_dnl_enabled) ? g_domain_name_buffer : NULL)) {
+            g_recv_msgs[k].msg_len = 0; /* not forwarded */
+            continue;
         }
-        LOGINF("[handle_local_packet] query [%s] from %s#%hu", g_domain_name_buffer, g_ipaddrstring_buffer, source_port);
-    }
 
-    uint16_t unique_msgid = g_current_message_id++;
-    dns_header_t *dns_header = (dns_header_t *)g_socket_buffer;
-    uint16_t origin_msgid = dns_header->id;
-    dns_header->id = unique_msgid; /* replace with new msgid */
-    uint8_t dnlmatch_ret = (g_gfwlist_fname || g_chnlist_fname) ? dnl_ismatch(g_domain_name_buffer, g_gfwlist_first) : DNL_MRESULT_NOMATCH;
+        IF_VERBOSE {
+            sock_port_t source_port = 0;
+            if (source_addr->sin6_family == AF_INET) {
+                parse_ipv4_addr((void *)source_addr, g_ipaddrstring_buffer, &source_port);
+            } else {
+                parse_ipv6_addr((void *)source_addr, g_ipaddrstring_buffer, &source_port);
+            }
+            LOGINF("[handle_local_packet] query [%s] from %s#%hu", g_domain_name_buffer, g_ipaddrstring_buffer, source_port);
+        }
+
+        uint8_t cache_ret = g_cache_size ? cache_get(packet_buf, g_reply_bufs[k], &reply_len) : CACHE_RESULT_MISS;
+        if (cache_ret == CACHE_RESULT_HIT || cache_ret == CACHE_RESULT_PREFETCH) {
+            IF_VERBOSE LOGINF("[handle_local_packet] reply [%s] from <cache>, result: %s", g_domain_name_buffer, cache_ret == CACHE_RESULT_HIT ? "accept" : "accept, prefetch");
+            queue_packet(g_bind_socket, g_reply_bufs[k], reply_len, source_addr);
+            if (cache_ret == CACHE_RESULT_HIT) {
+                g_recv_msgs[k].msg_len = 0; /* not forwarded */
+                continue;
+            }
+            source_addr = &no_client_addr; /* refresh the cache only */
+        }
+
+        uint16_t unique_msgid = g_current_message_id++;
+        dns_header_t *dns_header = (dns_header_t *)packet_buf;
+        uint16_t origin_msgid = dns_header->id;
+        dns_header->id = unique_msgid; /* replace with new msgid */
+        dnlmatch_rets[k] = g_dnl_enabled ? dnl_ismatch(g_domain_name_buffer, g_gfwlist_first) : DNL_MRESULT_NOMATCH;
+        hashentry_t *entry = hashmap_put(&g_message_id_hashmap, unique_msgid, origin_msgid, dnlmatch_rets[k], source_addr, timeout_ticks);
+        if (cache_ret == CACHE_RESULT_STALE) {
+            uint8_t key_buf[CACHE_KEY_MAXLEN];
+            hashmap_save_cachekey(entry, key_buf, cache_get_key(packet_buf, key_buf)); /* serve stale on timeout */
+        }
+    }
+    flush_packets(g_bind_socket); /* replies from cache */
 
     for (int i = 0; i < SERVER_MAXCOUNT; ++i) {
         if (g_remote_sockets[i] < 0) continue;
-        uint8_t repeat_times = 0;
-        if (i == CHINADNS1_IDX || i == CHINADNS2_IDX) {
-            repeat_times = (dnlmatch_ret == DNL_MRESULT_GFWLIST) ? 0 : 1;
-        } else {
-            repeat_times = (dnlmatch_ret == DNL_MRESULT_CHNLIST) ? 0 : g_repeat_times;
-        }
-        socklen_t remote_addrlen = g_remote_skaddrs[i].sin6_family == AF_INET ? sizeof(inet4_skaddr_t) : sizeof(inet6_skaddr_t);
-        for (int j = 0; j < repeat_times; ++j) {
-            if (sendto(g_remote_sockets[i], g_socket_buffer, packet_len, 0, (void *)&g_remote_skaddrs[i], remote_addrlen) < 0) {
-                LOGERR("[handle_local_packet] failed to send dns query packet to %s: (%d) %s", g_remote_servers[i], errno, strerror(errno));
+        for (int k = 0; k < packet_count; ++k) {
+            if (!g_recv_msgs[k].msg_len) continue;
+            uint8_t repeat_times = 0;
+            if (i == CHINADNS1_IDX || i == CHINADNS2_IDX) {
+                repeat_times = (dnlmatch_rets[k] == DNL_MRESULT_GFWLIST) ? 0 : 1;
+            } else {
+                repeat_times = (dnlmatch_rets[k] == DNL_MRESULT_CHNLIST) ? 0 : g_repeat_times;
+            }
+            for (int j = 0; j < repeat_times; ++j) {
+                queue_packet(g_remote_sockets[i], g_recv_bufs[k], g_recv_msgs[k].msg_len, &g_remote_skaddrs[i]);
             }
         }
+        flush_packets(g_remote_sockets[i]);
     }
 
-    int query_timerfd = new_once_timerfd(g_upstream_timeout_sec);
-    struct epoll_event ev = {.events = EPOLLIN, .data.u32 = (unique_msgid << BIT_SHIFT_LEN) | TIMER_FD_MARK};
-    if (epoll_ctl(g_epollfd, EPOLL_CTL_ADD, query_timerfd, &ev)) {
-        LOGERR("[handle_local_packet] failed to register timeout event: (%d) %s", errno, strerror(errno));
-        close(query_timerfd);
-        return;
+    if (!g_timer_armed && g_message_id_hashmap) {
+        set_timerfd_interval(g_timer_fd, TIMEWHEEL_TICK_MSEC);
+        g_timer_armed = true;
     }
-
-    hashmap_put(&g_message_id_hashmap, unique_msgid, origin_msgid, query_timerfd, dnlmatch_ret, &source_addr);
 }
 
-/* handle remote socket readable event */
-static void handle_remote_packet(int index) {
-    int remote_socket = g_remote_sockets[index];
+/* handle a reply from upstream, the accepted reply is queued for the client */
+static void handle_remote_reply(int index, char *packet_buf, size_t packet_len) {
     const char *remote_servers = g_remote_servers[index];
-    ssize_t packet_len = recvfrom(remote_socket, g_socket_buffer, SOCKBUFF_MAXSIZE, 0, NULL, NULL);
 
-    if (packet_len < 0) {
-        if (errno == EAGAIN || errno == EINTR) return;
-        LOGERR("[handle_remote_packet] failed to recv data from %s: (%d) %s", remote_servers, errno, strerror(errno));
+    if (packet_len < sizeof(dns_header_t) + sizeof(dns_query_t) + 1) {
+        LOGERR("[handle_remote_packet] received bad packet from %s, packet too small: %zu", remote_servers, packet_len);
         return;
     }
 
-    if (packet_len < (ssize_t)sizeof(dns_header_t) + (ssize_t)sizeof(dns_query_t) + 1) {
-        LOGERR("[handle_remote_packet] received bad packet from %s, packet too small: %zd", remote_servers, packet_len);
-        return;
-    }
-
-    bool is_chnip = dns_reply_check(g_socket_buffer, packet_len, g_verbose ? g_domain_name_buffer : NULL);
+    bool is_chnip = dns_reply_check(packet_buf, packet_len, g_verbose ? g_domain_name_buffer : NULL);
 
-    dns_header_t *dns_header = (dns_header_t *)g_socket_buffer;
+    dns_header_t *dns_header = (dns_header_t *)packet_buf;
     hashentry_t *entry = hashmap_get(g_message_id_hashmap, dns_header->id);
     if (!entry) {
         IF_VERBOSE LOGINF("[handle_remote_packet] reply [%s] from %s, result: ignore", g_domain_name_buffer, remote_servers);
@@ -400,7 +540,7 @@ static void handle_remote_packet(int index) {
         if (is_chnip) {
             /* return the china-ip, accept it */
             IF_VERBOSE LOGINF("[handle_remote_packet] reply [%s] from %s, result: accept", g_domain_name_buffer, remote_servers);
-            reply_buffer = g_socket_buffer;
+            reply_buffer = packet_buf;
             reply_length = packet_len;
             goto SEND_REPLY;
         } else {
@@ -424,7 +564,7 @@ static void handle_remote_packet(int index) {
         if (is_chnip || entry->chinadns_got) {
             /* return the china-ip, or china-dns returns first than trust-dns, accept it */
             IF_VERBOSE LOGINF("[handle_remote_packet] reply [%s] from %s, result: accept", g_domain_name_buffer, remote_servers);
-            reply_buffer = g_socket_buffer;
+            reply_buffer = packet_buf;
             reply_length = packet_len;
             goto SEND_REPLY;
         } else {
@@ -435,9 +575,7 @@ static void handle_remote_packet(int index) {
             } else {
                 /* trust-dns returns first than china-dns, delay it */
                 IF_VERBOSE LOGINF("[handle_remote_packet] reply [%s] from %s, result: delay", g_domain_name_buffer, remote_servers);
-                entry->trustdns_buf = malloc(packet_len + sizeof(uint16_t));
-                *(uint16_t *)entry->trustdns_buf = packet_len;
-                memcpy(entry->trustdns_buf + sizeof(uint16_t), g_socket_buffer, packet_len);
+                hashmap_save_reply(entry, packet_buf, packet_len);
                 return;
             }
             return;
@@ -446,30 +584,69 @@ static void handle_remote_packet(int index) {
     return;
 
 SEND_REPLY:
-    dns_header = reply_buffer;
+    /* the entry (and the saved trust-dns reply) is freed before the queue is flushed */
+    if (reply_buffer != packet_buf) memcpy(packet_buf, reply_buffer, reply_length);
+    if (g_cache_size) cache_put(packet_buf, reply_length);
+    if (entry->source_addr.sin6_family == AF_UNSPEC) {
+        hashmap_del(&g_message_id_hashmap, entry); /* cache prefetch query, no client */
+        return;
+    }
+    dns_header = (dns_header_t *)packet_buf;
     dns_header->id = entry->origin_msgid; /* replace with old msgid */
+    queue_packet(g_bind_socket, packet_buf, reply_length, &entry->source_addr);
+    hashmap_del(&g_message_id_hashmap, entry);
+}
+
+/* handle remote socket readable event */
+static void handle_remote_packet(int index) {
+    int packet_count = recv_packets(g_remote_sockets[index]);
+
+    if (packet_count < 0) {
+        if (errno == EAGAIN || errno == EINTR) return;
+        LOGERR("[handle_remote_packet] failed to recv data from %s: (%d) %s", g_remote_servers[index], errno, strerror(errno));
+        return;
+    }
+
+    for (int k = 0; k < packet_count; ++k) {
+        handle_remote_reply(index, g_recv_bufs[k], g_recv_msgs[k].msg_len);
+    }
+    flush_packets(g_bind_socket);
+}
+
+/* reload the ip-prefix-lists on SIGHUP */
+static void handle_reload_signal(int signum) {
+    (void)signum;
+    g_reload_iplist = 1;
+}
+
+/* print the reply cache counters on SIGUSR1 */
+static void handle_dump_signal(int signum) {
+    (void)signum;
+    g_dump_cache = 1;
+}
+
+/* log the query that is about to be dropped, reply with the stale cache entry if any */
+static void handle_query_timeout(hashentry_t *entry) {
+    LOGERR("[handle_query_timeout] upstream dns server reply timeout, unique msgid: %hu", entry->unique_msgid);
+    if (!entry->cachekey_buf) return;
+    size_t reply_len = 0;
+    if (!cache_get_stale(entry->cachekey_buf + sizeof(uint16_t), *(uint16_t *)entry->cachekey_buf, entry->origin_msgid, g_reply_bufs[0], &reply_len)) return;
+    IF_VERBOSE LOGINF("[handle_query_timeout] reply from <stale-cache>, unique msgid: %hu", entry->unique_msgid);
     socklen_t source_addrlen = (entry->source_addr.sin6_family == AF_INET) ? sizeof(inet4_skaddr_t) : sizeof(inet6_skaddr_t);
-    if (sendto(g_bind_socket, reply_buffer, reply_length, 0, (void *)&entry->source_addr, source_addrlen) < 0) {
-        sock_port_t source_port = 0;
-        if (entry->source_addr.sin6_family == AF_INET) {
-            parse_ipv4_addr((void *)&entry->source_addr, g_ipaddrstring_buffer, &source_port);
-        } else {
-            parse_ipv6_addr((void *)&entry->source_addr, g_ipaddrstring_buffer, &source_port);
-        }
-        LOGERR("[handle_remote_packet] failed to send dns reply packet to %s#%hu: (%d) %s", g_ipaddrstring_buffer, source_port, errno, strerror(errno));
+    if (sendto(g_bind_socket, g_reply_bufs[0], reply_len, 0, (void *)&entry->source_addr, source_addrlen) < 0) {
+        LOGERR("[handle_query_timeout] failed to send stale reply, unique msgid: %hu: (%d) %s", entry->unique_msgid, errno, strerror(errno));
     }
-    free(entry->trustdns_buf);
-    close(entry->query_timerfd);
-    hashmap_del(&g_message_id_hashmap, entry);
 }
 
-/* handle upstream reply timeout event */
-static void handle_timeout_event(uint16_t msg_id) {
-    LOGERR("[handle_timeout_event] upstream dns server reply timeout, unique msgid: %hu", msg_id);
-    hashentry_t *entry = hashmap_get(g_message_id_hashmap, msg_id);
-    free(entry->trustdns_buf); /* release the buffer that stores the trust-dns reply */
-    close(entry->query_timerfd); /* epoll will automatically remove the associated event */
-    hashmap_del(&g_message_id_hashmap, entry); /* delete and free the associated hash entry */
+/* handle timing wheel tick event */
+static void handle_timeout_event(void) {
+    uint64_t expirations = 0;
+    if (read(g_timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) return;
+    hashmap_tick(&g_message_id_hashmap, expirations, handle_query_timeout); /* entries are deleted after callback */
+    if (!g_message_id_hashmap) {
+        set_timerfd_interval(g_timer_fd, 0); /* no query in flight, stop ticking */
+        g_timer_armed = false;
+    }
 }
 
 int main(int argc, char *argv[]) {
@@ -483,19 +660,69 @@ int main(int argc, char *argv[]) {
     if (strlen(g_remote_servers[CHINADNS2_IDX])) LOGINF("[main] chinadns server#2: %s", g_remote_servers[CHINADNS2_IDX]);
     if (strlen(g_remote_servers[TRUSTDNS1_IDX])) LOGINF("[main] trustdns server#1: %s", g_remote_servers[TRUSTDNS1_IDX]);
     if (strlen(g_remote_servers[TRUSTDNS2_IDX])) LOGINF("[main] trustdns server#2: %s", g_remote_servers[TRUSTDNS2_IDX]);
-    LOGINF("[main] ipset ip4 setname: %s", g_ipset_setname4);
-    LOGINF("[main] ipset ip6 setname: %s", g_ipset_setname6);
+    if (g_chnroute_fname4) LOGINF("[main] chnroute entries count: %zu", ipl_init(g_chnroute_fname4, true));
+    else LOGINF("[main] ipset ip4 setname: %s", g_ipset_setname4);
+    if (g_chnroute_fname6) LOGINF("[main] chnroute6 entries count: %zu", ipl_init(g_chnroute_fname6, false));
+    else LOGINF("[main] ipset ip6 setname: %s", g_ipset_setname6);
     LOGINF("[main] dns query timeout: %ld seconds", g_upstream_timeout_sec);
-    if (g_gfwlist_fname) LOGINF("[main] gfwlist entries count: %zu", dnl_init(g_gfwlist_fname, true));
-    if (g_chnlist_fname) LOGINF("[main] chnlist entries count: %zu", dnl_init(g_chnlist_fname, false));
+    size_t gfwlist_count = 0, chnlist_count = 0;
+    if (g_binlist_fname && dnl_load_binary(g_binlist_fname, g_gfwlist_fname, g_chnlist_fname, &gfwlist_count, &chnlist_count)) {
+        LOGINF("[main] mapped precompiled dnamelist: %s", g_binlist_fname);
+        g_dnl_enabled = true;
+    } else if (g_gfwlist_fname || g_chnlist_fname) {
+        if (g_gfwlist_fname) gfwlist_count = dnl_init(g_gfwlist_fname, true);
+        if (g_chnlist_fname) chnlist_count = dnl_init(g_chnlist_fname, false);
+        if (g_binlist_fname) dnl_save_binary(g_binlist_fname, g_gfwlist_fname, g_chnlist_fname);
+        g_dnl_enabled = true;
+    } else if (g_binlist_fname) {
+        LOGERR("[main] invalid precompiled dnamelist: %s", g_binlist_fname);
+        return 1;
+    }
+    if (g_dnl_enabled) LOGINF("[main] gfwlist entries count: %zu", gfwlist_count);
+    if (g_dnl_enabled) LOGINF("[main] chnlist entries count: %zu", chnlist_count);
+    if (g_cache_size) LOGINF("[main] reply cache size: %zu KiB", g_cache_size / 1024);
     if (g_repeat_times != 1) LOGINF("[main] enable repeat mode, times: %hhu", g_repeat_times);
     if (g_noip_as_chnip) LOGINF("[main] accept reply without ip addr");
     LOGINF("[main] core judgment mode: %s mode", g_fair_mode ? "fair" : "fast");
+    if (g_worker_count > 1) g_reuse_port = true; /* workers share the listen port */
     if (g_reuse_port) LOGINF("[main] enable `SO_REUSEPORT` feature");
+    if (g_worker_count > 1) LOGINF("[main] worker process count: %d", g_worker_count);
     if (g_verbose) LOGINF("[main] print the verbose running log");
 
+    /* fork the other workers, each one has its own sockets and msgid hashmap */
+    pid_t first_worker = getpid();
+    if (g_worker_count > 1) signal(SIGCHLD, SIG_IGN); /* no zombie workers */
+    for (int i = 1; i < g_worker_count; ++i) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            LOGERR("[main] failed to fork worker process: (%d) %s", errno, strerror(errno));
+            return errno;
+        }
+        if (pid == 0) {
+            memset(g_worker_pids, 0, sizeof(g_worker_pids));
+            prctl(PR_SET_PDEATHSIG, SIGTERM); /* exit together with the first worker */
+            if (getppid() != first_worker) return 0;
+            break;
+        }
+        g_worker_pids[i] = pid;
+    }
+
     /* init ipset netlink socket */
-    ipset_init_nlsocket();
+    if (!g_chnroute_fname4 || !g_chnroute_fname6) ipset_init_nlsocket();
+
+    /* init reply cache */
+    cache_init(g_cache_size);
+
+    /* SIGHUP and SIGUSR1 are only delivered inside epoll_pwait() */
+    sigset_t signal_mask, epoll_sigmask;
+    sigemptyset(&signal_mask);
+    sigaddset(&signal_mask, SIGHUP);
+    sigaddset(&signal_mask, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &signal_mask, &epoll_sigmask);
+    sigdelset(&epoll_sigmask, SIGHUP);
+    sigdelset(&epoll_sigmask, SIGUSR1);
+    signal(SIGHUP, handle_reload_signal);
+    signal(SIGUSR1, handle_dump_signal);
 
     /* create listen socket */
     g_bind_socket = (g_bind_skaddr.sin6_family == AF_INET) ? new_udp4_socket() : new_udp6_socket();
@@ -544,13 +771,39 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    /* timing wheel tick event */
+    g_timer_fd = new_timerfd();
+    ev.events = EPOLLIN;
+    ev.data.u32 = TIMER_FD_MARK;
+    if (epoll_ctl(g_epollfd, EPOLL_CTL_ADD, g_timer_fd, &ev)) {
+        LOGERR("[main] failed to register epoll event: (%d) %s", errno, strerror(errno));
+        return errno;
+    }
+
     /* run event loop (blocking here) */
     while (true) {
-        int event_count = epoll_wait(g_epollfd, events, EPOLL_MAXEVENTS, -1);
+        int event_count = epoll_pwait(g_epollfd, events, EPOLL_MAXEVENTS, -1, &epoll_sigmask);
 
         if (event_count < 0) {
-            LOGERR("[main] epoll_wait() reported an error: (%d) %s", errno, strerror(errno));
-            continue;
+            if (errno != EINTR) LOGERR("[main] epoll_wait() reported an error: (%d) %s", errno, strerror(errno));
+            event_count = 0;
+        }
+
+        if (g_reload_iplist) {
+            g_reload_iplist = 0;
+            ipl_reload(true);
+            ipl_reload(false);
+            for (int i = 1; i < WORKER_MAXCOUNT; ++i) {
+                if (g_worker_pids[i] > 0) kill(g_worker_pids[i], SIGHUP);
+            }
+        }
+
+        if (g_dump_cache) {
+            g_dump_cache = 0;
+            cache_dump_stats();
+            for (int i = 1; i < WORKER_MAXCOUNT; ++i) {
+                if (g_worker_pids[i] > 0) kill(g_worker_pids[i], SIGUSR1);
+            }
         }
 
         for (int i = 0; i < event_count; ++i) {
@@ -603,7 +856,7 @@ int main(int argc, char *argv[]) {
                     handle_local_packet();
                     break;
                 case TIMER_FD_MARK:
-                    handle_timeout_event(curr_data >> BIT_SHIFT_LEN);
+                    handle_timeout_event();
                     break;
             }
         }
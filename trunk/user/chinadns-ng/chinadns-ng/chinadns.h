@@ -10,5 +10,7 @@
 extern bool g_noip_as_chnip; /* used by dnsutils.h */
 extern char g_ipset_setname4[IPSET_MAXNAMELEN]; /* used by netutils.h */
 extern char g_ipset_setname6[IPSET_MAXNAMELEN]; /* used by netutils.h */
+extern const char *g_chnroute_fname4; /* used by dnsutils.h */
+extern const char *g_chnroute_fname6; /* used by dnsutils.h */
 
 #endif
@@ -2,97 +2,150 @@
 #include "dnlutils.h"
 #include "dnsutils.h"
 #include "logutils.h"
-#include "uthash.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #undef _GNU_SOURCE
 
-/* a very simple memory pool (alloc only) */
-static void* mempool_alloc(size_t length) {
-    static void  *mempool_buffer = NULL;
-    static size_t mempool_length = 0;
-    if (mempool_length < length) {
-        /* arg.length must be <= 4096 */
-        mempool_length = 4096; /* block size */
-        mempool_buffer = malloc(mempool_length);
+/*
+ * reversed-label trie: every node is one label below its parent, the root
+ * (node 0) is the empty name, so "www.google.com" is root->com->google->www.
+ * the children are found through one open addressing table keyed by
+ * (parent-node, label), so a lookup costs one probe per label of the query
+ * and the deepest node that carries a list flag is the most specific match.
+ * everything is stored as indexes and offsets, which lets the binary list
+ * file be mmap'd and used as is.
+ */
+#define DNL_FLAG_GFWLIST 0x80000000u
+#define DNL_FLAG_CHNLIST 0x40000000u
+#define DNL_FLAG_MASK (DNL_FLAG_GFWLIST | DNL_FLAG_CHNLIST)
+#define DNL_LABEL_MAXLEN 63
+
+/* trie node typedef */
+typedef struct {
+    uint32_t parent; /* parent node index */
+    uint32_t label;  /* offset of the label (length byte + lowercase chars) in the pool, or'ed with flags */
+} dnlnode_t;
+
+/* binary list file header typedef */
+#define DNL_BINARY_MAGIC "CDNGDNL1"
+#define DNL_BINARY_BYTEORDER 0x01020304u
+typedef struct {
+    char     magic[8];       /* DNL_BINARY_MAGIC */
+    uint32_t byte_order;     /* DNL_BINARY_BYTEORDER */
+    uint32_t node_count;     /* nodes follow the header */
+    uint32_t slot_mask;      /* slots follow the nodes */
+    uint32_t pool_size;      /* label pool follows the slots */
+    uint32_t gfwlist_count;  /* gfwlist entries count */
+    uint32_t chnlist_count;  /* chnlist entries count */
+    int64_t  gfwlist_mtime;  /* source file stamp, 0 if not loaded */
+    int64_t  gfwlist_size;   /* source file stamp, 0 if not loaded */
+    int64_t  chnlist_mtime;  /* source file stamp, 0 if not loaded */
+    int64_t  chnlist_size;   /* source file stamp, 0 if not loaded */
+} dnlbinary_t;
+
+/* trie storage (malloc'd while building, or mmap'd from the binary file) */
+static dnlnode_t *g_dnl_nodes       = NULL;
+static uint32_t  *g_dnl_slots       = NULL; /* node index, 0 means empty (root is never a child) */
+static uint8_t   *g_dnl_pool        = NULL;
+static uint32_t   g_dnl_node_count  = 0;
+static uint32_t   g_dnl_slot_mask   = 0;
+static uint32_t   g_dnl_pool_size   = 0;
+static uint32_t   g_dnl_node_alloc  = 0;
+static uint32_t   g_dnl_pool_alloc  = 0;
+static size_t     g_gfwlist_count   = 0;
+static size_t     g_chnlist_count   = 0;
+
+/* hash of (parent, lowercase label) */
+static inline uint32_t dnl_hash(uint32_t parent, const char *label, size_t label_len) {
+    uint32_t hash = 2166136261u ^ parent;
+    for (size_t i = 0; i < label_len; ++i) hash = (hash ^ (uint8_t)tolower((uint8_t)label[i])) * 16777619u;
+    return hash;
+}
+
+/* find the child of parent by label (case insensitive), 0 if not found */
+static inline uint32_t dnl_find(uint32_t parent, const char *label, size_t label_len, uint32_t hash) {
+    for (uint32_t slot = hash & g_dnl_slot_mask; g_dnl_slots[slot]; slot = (slot + 1) & g_dnl_slot_mask) {
+        const dnlnode_t *node = &g_dnl_nodes[g_dnl_slots[slot]];
+        if (node->parent != parent) continue;
+        const uint8_t *node_label = g_dnl_pool + (node->label & ~DNL_FLAG_MASK);
+        if (node_label[0] != label_len) continue;
+        size_t i = 0;
+        while (i < label_len && node_label[1 + i] == (uint8_t)tolower((uint8_t)label[i])) ++i;
+        if (i == label_len) return g_dnl_slots[slot];
     }
-    mempool_buffer += length;
-    mempool_length -= length;
-    return mempool_buffer - length;
+    return 0;
 }
 
-/* hash entry typedef */
-typedef struct {
-    UT_hash_handle hh;
-    char dname[];
-} dnlentry_t;
-
-/* hash table (head entry) */
-static dnlentry_t *g_gfwlist_headentry = NULL;
-static dnlentry_t *g_chnlist_headentry = NULL;
-
-/* handling dname matching pattern */
-static inline char* dnl_pattern_strip(char *pattern) {
-    if (pattern[0] == '.' || pattern[strlen(pattern) - 1] == '.') return NULL;
-    for (int i = 0; i < 4; ++i) {
-        char *sepptr = strrchr(pattern, '.');
-        if (sepptr) {
-            *sepptr = '/';
-            if (i == 3) pattern = sepptr + 1;
-        } else if (i == 0) {
-            return NULL;
-        } else {
-            break;
-        }
+/* put node into the slot table */
+static void dnl_link(uint32_t node_index, uint32_t hash) {
+    uint32_t slot = hash & g_dnl_slot_mask;
+    while (g_dnl_slots[slot]) slot = (slot + 1) & g_dnl_slot_mask;
+    g_dnl_slots[slot] = node_index;
+}
+
+/* double the slot table (load factor <= 3/4) */
+static void dnl_grow_slots(void) {
+    free(g_dnl_slots);
+    g_dnl_slot_mask = g_dnl_slot_mask ? (g_dnl_slot_mask << 1) | 1 : 1023;
+    g_dnl_slots = calloc(g_dnl_slot_mask + 1, sizeof(uint32_t));
+    for (uint32_t i = 1; i < g_dnl_node_count; ++i) {
+        const uint8_t *label = g_dnl_pool + (g_dnl_nodes[i].label & ~DNL_FLAG_MASK);
+        dnl_link(i, dnl_hash(g_dnl_nodes[i].parent, (const char *)label + 1, label[0]));
     }
-    return pattern;
 }
 
-/* split dname pattern, array length is 2 */
-static inline void dnl_pattern_split(const char *pattern, const char* subpattern_array[]) {
-    int slashchar_count = 0;
-    for (int i = 0; pattern[i]; ++i) {
-        if (pattern[i] == '/') ++slashchar_count;
+/* append a child node */
+static uint32_t dnl_new_node(uint32_t parent, const char *label, size_t label_len, uint32_t hash) {
+    if (g_dnl_node_count == g_dnl_node_alloc) {
+        g_dnl_node_alloc = g_dnl_node_alloc ? g_dnl_node_alloc * 2 : 4096;
+        g_dnl_nodes = realloc(g_dnl_nodes, g_dnl_node_alloc * sizeof(dnlnode_t));
+    }
+    if (g_dnl_pool_size + 1 + label_len > g_dnl_pool_alloc) {
+        g_dnl_pool_alloc = g_dnl_pool_alloc ? g_dnl_pool_alloc * 2 : 65536;
+        g_dnl_pool = realloc(g_dnl_pool, g_dnl_pool_alloc);
     }
-    if (slashchar_count == 2) {
-        subpattern_array[0] = strchr(pattern, '/') + 1;
-    } else if (slashchar_count == 3) {
-        subpattern_array[1] = strchr(pattern, '/') + 1;
-        subpattern_array[0] = strchr(subpattern_array[1], '/') + 1;
+    uint32_t node_index = g_dnl_node_count++;
+    g_dnl_nodes[node_index].parent = parent;
+    g_dnl_nodes[node_index].label = g_dnl_pool_size;
+    g_dnl_pool[g_dnl_pool_size++] = label_len;
+    for (size_t i = 0; i < label_len; ++i) g_dnl_pool[g_dnl_pool_size++] = tolower((uint8_t)label[i]);
+    if (node_index == 0) return 0; /* the root is never looked up */
+    if (g_dnl_node_count * 4 > (g_dnl_slot_mask + 1) * 3) {
+        dnl_grow_slots(); /* also links the new node */
+    } else {
+        dnl_link(node_index, hash);
     }
+    return node_index;
 }
 
-/* convert domain name, array length is 3 */
-static inline void dnl_input_convert(char *fulldomain, const char* subdomain_array[]) {
-    if (fulldomain[0] == '.') return;
-    int replace_count = 0;
-    while (replace_count < 4) {
-        char *sepptr = strrchr(fulldomain, '.');
-        if (!sepptr) break;
-        *sepptr = '/';
-        ++replace_count;
-    }
-    switch (replace_count) {
-        case 1:
-            subdomain_array[0] = fulldomain;
-            break;
-        case 2:
-            subdomain_array[1] = fulldomain;
-            subdomain_array[0] = strchr(fulldomain, '/') + 1;
-            break;
-        case 3:
-            subdomain_array[2] = fulldomain;
-            subdomain_array[1] = strchr(fulldomain, '/') + 1;
-            subdomain_array[0] = strchr(subdomain_array[1], '/') + 1;
-            break;
-        case 4:
-            subdomain_array[2] = strchr(fulldomain, '/') + 1;
-            subdomain_array[1] = strchr(subdomain_array[2], '/') + 1;
-            subdomain_array[0] = strchr(subdomain_array[1], '/') + 1;
-            break;
+/* add "www.google.com" style pattern, false if it is invalid or already exists */
+static bool dnl_add_pattern(const char *pattern, uint32_t flag) {
+    size_t pattern_len = strlen(pattern);
+    if (pattern[0] == '.' || pattern[pattern_len - 1] == '.' || !strchr(pattern, '.')) return false;
+    if (pattern_len + 1 > DNS_DOMAIN_NAME_MAXLEN) return false;
+
+    uint32_t parent = 0;
+    const char *label_end = pattern + pattern_len;
+    while (label_end > pattern) {
+        const char *label = label_end;
+        while (label > pattern && label[-1] != '.') --label;
+        size_t label_len = label_end - label;
+        if (label_len == 0 || label_len > DNL_LABEL_MAXLEN) return false;
+        uint32_t hash = dnl_hash(parent, label, label_len);
+        uint32_t child = dnl_find(parent, label, label_len, hash);
+        parent = child ? child : dnl_new_node(parent, label, label_len, hash);
+        label_end = label > pattern ? label - 1 : pattern;
     }
+    if (g_dnl_nodes[parent].label & flag) return false;
+    g_dnl_nodes[parent].label |= flag;
+    return true;
 }
 
 /* initialize domain-name-list from file */
@@ -108,60 +161,127 @@ size_t dnl_init(const char *filename, bool is_gfwlist) {
         }
     }
 
-    dnlentry_t **headentry = is_gfwlist ? &g_gfwlist_headentry : &g_chnlist_headentry;
-    char strbuf[DNS_DOMAIN_NAME_MAXLEN];
-    while (fscanf(fp, "%253s", strbuf) > 0) {
-        char *dname = dnl_pattern_strip(strbuf);
-        if (!dname) continue;
-
-        dnlentry_t *entry = NULL;
-        MYHASH_GET(*headentry, entry, dname, strlen(dname));
-        if (entry) continue;
+    /* the root node and an empty slot table */
+    if (!g_dnl_node_count) {
+        dnl_new_node(0, "", 0, 0);
+        dnl_grow_slots();
+    }
 
-        entry = mempool_alloc(sizeof(dnlentry_t) + strlen(dname) + 1);
-        strcpy(entry->dname, dname);
-        MYHASH_ADD(*headentry, entry, entry->dname, strlen(entry->dname));
+    size_t *entry_count = is_gfwlist ? &g_gfwlist_count : &g_chnlist_count;
+    uint32_t flag = is_gfwlist ? DNL_FLAG_GFWLIST : DNL_FLAG_CHNLIST;
+    char linebuf[512];
+    while (fgets(linebuf, sizeof(linebuf), fp)) {
+        for (char *token = strtok(linebuf, " \t\r\n"); token; token = strtok(NULL, " \t\r\n")) {
+            if (dnl_add_pattern(token, flag)) ++*entry_count;
+        }
     }
     if (fp != stdin) fclose(fp);
+    return *entry_count;
+}
 
-    dnlentry_t *curentry = NULL, *tmpentry = NULL;
-    MYHASH_FOR(*headentry, curentry, tmpentry) {
-        const char* subpattern_array[2] = {0};
-        dnl_pattern_split(curentry->dname, subpattern_array);
-        for (int i = 0; i < 2 && subpattern_array[i]; ++i) {
-            dnlentry_t *findentry = NULL;
-            MYHASH_GET(*headentry, findentry, subpattern_array[i], strlen(subpattern_array[i]));
-            if (findentry) {
-                MYHASH_DEL(*headentry, curentry);
-                break;
-            }
-        }
+/* source list stamp, false if it cannot be stat'ed (or is stdin) */
+static bool dnl_source_stamp(const char *filename, int64_t *mtime, int64_t *size) {
+    *mtime = *size = 0;
+    if (!filename) return true;
+    struct stat st;
+    if (strcmp(filename, "-") == 0 || stat(filename, &st)) return false;
+    *mtime = st.st_mtime;
+    *size = st.st_size;
+    return true;
+}
+
+/* load precompiled domain-name-lists, false if it is missing or older than the source lists */
+bool dnl_load_binary(const char *binfile, const char *gfwlist_fname, const char *chnlist_fname, size_t *gfwlist_count, size_t *chnlist_count) {
+    dnlbinary_t stamp;
+    memset(&stamp, 0, sizeof(stamp));
+    if (!dnl_source_stamp(gfwlist_fname, &stamp.gfwlist_mtime, &stamp.gfwlist_size)) return false;
+    if (!dnl_source_stamp(chnlist_fname, &stamp.chnlist_mtime, &stamp.chnlist_size)) return false;
+
+    int fd = open(binfile, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    void *mapped = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(dnlbinary_t)) {
+        mapped = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapped == MAP_FAILED) return false;
+
+    const dnlbinary_t *header = mapped;
+    size_t expect_size = sizeof(dnlbinary_t) + (size_t)header->node_count * sizeof(dnlnode_t) + ((size_t)header->slot_mask + 1) * sizeof(uint32_t) + header->pool_size;
+    bool is_valid = memcmp(header->magic, DNL_BINARY_MAGIC, sizeof(header->magic)) == 0 && header->byte_order == DNL_BINARY_BYTEORDER && (size_t)st.st_size == expect_size;
+    /* without source lists on the command line, the binary file is used as is */
+    if (is_valid && (gfwlist_fname || chnlist_fname)) {
+        is_valid = header->gfwlist_mtime == stamp.gfwlist_mtime && header->gfwlist_size == stamp.gfwlist_size &&
+                   header->chnlist_mtime == stamp.chnlist_mtime && header->chnlist_size == stamp.chnlist_size;
     }
-    return MYHASH_LEN(*headentry);
+    if (!is_valid) {
+        munmap(mapped, st.st_size);
+        return false;
+    }
+
+    g_dnl_node_count = header->node_count;
+    g_dnl_slot_mask = header->slot_mask;
+    g_dnl_pool_size = header->pool_size;
+    g_dnl_nodes = (void *)(header + 1);
+    g_dnl_slots = (void *)(g_dnl_nodes + g_dnl_node_count);
+    g_dnl_pool = (void *)(g_dnl_slots + g_dnl_slot_mask + 1);
+    g_gfwlist_count = *gfwlist_count = header->gfwlist_count;
+    g_chnlist_count = *chnlist_count = header->chnlist_count;
+    return true;
 }
 
-/* check if the given domain name matches */
-uint8_t dnl_ismatch(char *domainname, bool is_gfwlist_first) {
-    const char* subdomain_array[3] = {0};
-    dnl_input_convert(domainname, subdomain_array);
-
-    dnlentry_t *headentry = is_gfwlist_first ? g_gfwlist_headentry : g_chnlist_headentry;
-    if (headentry) {
-        for (int i = 0; i < 3 && subdomain_array[i]; ++i) {
-            dnlentry_t *findentry = NULL;
-            MYHASH_GET(headentry, findentry, subdomain_array[i], strlen(subdomain_array[i]));
-            if (findentry) return is_gfwlist_first ? DNL_MRESULT_GFWLIST : DNL_MRESULT_CHNLIST;
-        }
+/* save the domain-name-lists loaded by dnl_init() to binary file */
+void dnl_save_binary(const char *binfile, const char *gfwlist_fname, const char *chnlist_fname) {
+    dnlbinary_t header;
+    memset(&header, 0, sizeof(header));
+    if (!dnl_source_stamp(gfwlist_fname, &header.gfwlist_mtime, &header.gfwlist_size)) return;
+    if (!dnl_source_stamp(chnlist_fname, &header.chnlist_mtime, &header.chnlist_size)) return;
+    memcpy(header.magic, DNL_BINARY_MAGIC, sizeof(header.magic));
+    header.byte_order = DNL_BINARY_BYTEORDER;
+    header.node_count = g_dnl_node_count;
+    header.slot_mask = g_dnl_slot_mask;
+    header.pool_size = g_dnl_pool_size;
+    header.gfwlist_count = g_gfwlist_count;
+    header.chnlist_count = g_chnlist_count;
+
+    /* write to a temporary file and rename it, a running instance may have mapped the old one */
+    char tmpfile[strlen(binfile) + sizeof(".tmp")];
+    sprintf(tmpfile, "%s.tmp", binfile);
+    FILE *fp = fopen(tmpfile, "wb");
+    if (!fp) {
+        LOGERR("[dnl_save_binary] failed to open '%s': (%d) %s", tmpfile, errno, strerror(errno));
+        return;
     }
+    bool is_ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                 fwrite(g_dnl_nodes, sizeof(dnlnode_t), g_dnl_node_count, fp) == g_dnl_node_count &&
+                 fwrite(g_dnl_slots, sizeof(uint32_t), g_dnl_slot_mask + 1, fp) == g_dnl_slot_mask + 1 &&
+                 fwrite(g_dnl_pool, 1, g_dnl_pool_size, fp) == g_dnl_pool_size;
+    if (fclose(fp)) is_ok = false;
+    if (!is_ok || rename(tmpfile, binfile)) {
+        LOGERR("[dnl_save_binary] failed to write '%s': (%d) %s", binfile, errno, strerror(errno));
+        unlink(tmpfile);
+    }
+}
 
-    headentry = is_gfwlist_first ? g_chnlist_headentry : g_gfwlist_headentry;
-    if (headentry) {
-        for (int i = 0; i < 3 && subdomain_array[i]; ++i) {
-            dnlentry_t *findentry = NULL;
-            MYHASH_GET(headentry, findentry, subdomain_array[i], strlen(subdomain_array[i]));
-            if (findentry) return is_gfwlist_first ? DNL_MRESULT_CHNLIST : DNL_MRESULT_GFWLIST;
-        }
+/* check if the given domain name matches (the most specific pattern wins) */
+uint8_t dnl_ismatch(const char *domainname, bool is_gfwlist_first) {
+    if (!g_dnl_node_count || domainname[0] == '.') return DNL_MRESULT_NOMATCH;
+
+    uint32_t parent = 0, match_flags = 0;
+    const char *label_end = domainname + strlen(domainname);
+    while (label_end > domainname) {
+        const char *label = label_end;
+        while (label > domainname && label[-1] != '.') --label;
+        size_t label_len = label_end - label;
+        parent = dnl_find(parent, label, label_len, dnl_hash(parent, label, label_len));
+        if (!parent) break;
+        if (g_dnl_nodes[parent].label & DNL_FLAG_MASK) match_flags = g_dnl_nodes[parent].label & DNL_FLAG_MASK;
+        label_end = label > domainname ? label - 1 : domainname;
     }
 
+    if (match_flags == DNL_FLAG_MASK) return is_gfwlist_first ? DNL_MRESULT_GFWLIST : DNL_MRESULT_CHNLIST;
+    if (match_flags == DNL_FLAG_GFWLIST) return DNL_MRESULT_GFWLIST;
+    if (match_flags == DNL_FLAG_CHNLIST) return DNL_MRESULT_CHNLIST;
     return DNL_MRESULT_NOMATCH;
 }
@@ -15,7 +15,13 @@
 /* initialize domain-name-list from file */
 size_t dnl_init(const char *filename, bool is_gfwlist);
 
-/* check if the given domain name matches */
-uint8_t dnl_ismatch(char *domainname, bool is_gfwlist_first);
+/* load precompiled domain-name-lists, false if it is missing or older than the source lists */
+bool dnl_load_binary(const char *binfile, const char *gfwlist_fname, const char *chnlist_fname, size_t *gfwlist_count, size_t *chnlist_count);
+
+/* save the domain-name-lists loaded by dnl_init() to binary file */
+void dnl_save_binary(const char *binfile, const char *gfwlist_fname, const char *chnlist_fname);
+
+/* check if the given domain name matches (the most specific pattern wins) */
+uint8_t dnl_ismatch(const char *domainname, bool is_gfwlist_first);
 
 #endif
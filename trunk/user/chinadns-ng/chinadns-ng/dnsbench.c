@@ -0,0 +1,271 @@
+/*
+ * local load generator for chinadns-ng, nothing leaves the loopback:
+ * forks a fake china-dns and a fake trust-dns upstream, then sends A queries
+ * (AAAA with -6) to chinadns-ng from several client sockets (so that
+ * SO_REUSEPORT workers all get a share), keeping a fixed number of queries
+ * in flight.
+ *
+ * the fake china-dns answers 114.114.114.114 and 8.8.8.8 alternately, so
+ * both the `accept` and the `filter, wait for trust-dns` paths are taken;
+ * the fake trust-dns always answers 8.8.8.8. with -r <chnroute-file> the
+ * china-dns answers are spread over the whole address space instead: every
+ * other one is a random host inside a random network of the file, the rest
+ * are random addresses, so that each reply is a real chnroute lookup.
+ * load chnroute for the results to be meaningful, e.g. (in-memory lookup):
+ *   chinadns-ng -l 65353 -c 127.0.0.1#65301 -t 127.0.0.1#65302 -i chnroute.ipset -I chnroute6.ipset
+ *   dnsbench -r chnroute.ipset 65353 65301 65302 200000 64 4
+ *   dnsbench -6 -r chnroute6.ipset 65353 65301 65302 200000 64 4
+ * drop -i/-I (and load the sets with ipset) to compare with the kernel path.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#undef _GNU_SOURCE
+
+#define BATCH_SIZE 32
+#define PACKET_MAXSIZE 1472
+#define CLIENT_MAXCOUNT 64
+#define LOST_TIMEOUT_NSEC 1000000000LL /* a query without reply for 1s is lost */
+#define ANSWER_MAXCOUNT 65536 /* distinct china-dns answers with -r */
+
+#define DNS_TYPE_A 1
+#define DNS_TYPE_AAAA 28
+
+static bool     g_ipv6         = false; /* -6: AAAA queries and answers */
+static uint8_t (*g_answers)[16] = NULL; /* china-dns answers, -r */
+static uint32_t g_answer_count = 0;
+
+static int64_t now_nsec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int new_loopback_socket(uint16_t bind_port) {
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    int bufsize = 4 << 20;
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+    setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(bind_port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    if (bind(sockfd, (void *)&addr, sizeof(addr))) {
+        printf("[new_loopback_socket] failed to bind 127.0.0.1#%hu: (%d) %s\n", bind_port, errno, strerror(errno));
+        exit(1);
+    }
+    return sockfd;
+}
+
+/* xorshift, the answer table need not be unpredictable */
+static uint32_t rand32(void) {
+    static uint32_t state = 2463534242u;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+/* fill g_answers from an ipset-style chnroute file ("add <set> <net>/<len>") */
+static void load_answers(const char *fname) {
+    FILE *fp = fopen(fname, "r");
+    if (!fp) {
+        printf("[load_answers] failed to open %s: (%d) %s\n", fname, errno, strerror(errno));
+        exit(1);
+    }
+    uint8_t (*nets)[16] = NULL;
+    int *prefixes = NULL;
+    size_t net_count = 0, net_alloc = 0;
+    char line[256], setname[64], netstr[64];
+    int family = g_ipv6 ? AF_INET6 : AF_INET, addrlen = g_ipv6 ? 16 : 4;
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "add %63s %63s", setname, netstr) != 2) continue;
+        char *slash = strchr(netstr, '/');
+        int prefix = slash ? strtol(slash + 1, NULL, 10) : addrlen * 8;
+        if (slash) *slash = 0;
+        if (net_count == net_alloc) {
+            net_alloc = net_alloc ? net_alloc * 2 : 1024;
+            nets = realloc(nets, net_alloc * sizeof(*nets));
+            prefixes = realloc(prefixes, net_alloc * sizeof(*prefixes));
+        }
+        if (inet_pton(family, netstr, nets[net_count]) != 1 || prefix < 0 || prefix > addrlen * 8) continue;
+        prefixes[net_count++] = prefix;
+    }
+    fclose(fp);
+    if (!net_count) {
+        printf("[load_answers] no %s network found in %s\n", g_ipv6 ? "ipv6" : "ipv4", fname);
+        exit(1);
+    }
+
+    g_answer_count = ANSWER_MAXCOUNT;
+    g_answers = malloc(g_answer_count * sizeof(*g_answers));
+    for (uint32_t i = 0; i < g_answer_count; ++i) {
+        uint8_t *addr = g_answers[i];
+        for (int j = 0; j < 16; j += 4) {
+            uint32_t r = rand32();
+            memcpy(addr + j, &r, 4);
+        }
+        if (i & 1) continue; /* random address, mostly outside chnroute */
+        size_t n = rand32() % net_count;
+        int prefix = prefixes[n];
+        for (int j = 0; j < prefix / 8; ++j) addr[j] = nets[n][j];
+        if (prefix % 8) {
+            uint8_t mask = 0xff << (8 - prefix % 8);
+            addr[prefix / 8] = (nets[n][prefix / 8] & mask) | (addr[prefix / 8] & ~mask);
+        }
+    }
+    free(nets);
+    free(prefixes);
+}
+
+/* fake upstream: answer every query with a single A/AAAA record */
+static void run_upstream(uint16_t port, bool is_chinadns) {
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    int sockfd = new_loopback_socket(port);
+    static char bufs[BATCH_SIZE][PACKET_MAXSIZE + 28];
+    static struct sockaddr_in addrs[BATCH_SIZE];
+    struct mmsghdr msgs[BATCH_SIZE];
+    struct iovec iovs[BATCH_SIZE];
+    int family = g_ipv6 ? AF_INET6 : AF_INET, rdlen = g_ipv6 ? 16 : 4;
+    uint8_t answer_ips[2][16];
+    inet_pton(family, g_ipv6 ? "2001:4860:4860::8888" : "8.8.8.8", answer_ips[0]);
+    inet_pton(family, g_ipv6 ? "240c::6666" : "114.114.114.114", answer_ips[1]);
+    /* ptr-to-qname, A/AAAA, IN, ttl 60, rdlen */
+    uint8_t answer_rr[28] = {0xc0, 0x0c, 0, g_ipv6 ? DNS_TYPE_AAAA : DNS_TYPE_A, 0, 1, 0, 0, 0, 60, 0, rdlen};
+    size_t answer_len = 12 + rdlen;
+    for (uint32_t counter = 0;;) {
+        for (int i = 0; i < BATCH_SIZE; ++i) {
+            iovs[i] = (struct iovec){bufs[i], PACKET_MAXSIZE};
+            msgs[i].msg_hdr = (struct msghdr){.msg_name = &addrs[i], .msg_namelen = sizeof(addrs[i]), .msg_iov = &iovs[i], .msg_iovlen = 1};
+        }
+        int count = recvmmsg(sockfd, msgs, BATCH_SIZE, MSG_WAITFORONE, NULL);
+        if (count <= 0) continue;
+        for (int i = 0; i < count; ++i) {
+            uint8_t *packet = (uint8_t *)bufs[i];
+            size_t len = msgs[i].msg_len;
+            if (len < 17) len = 0;
+            packet[2] |= 0x80; /* qr */
+            packet[3] = 0x80;  /* ra */
+            packet[7] = 1;     /* ancount */
+            if (!is_chinadns) {
+                memcpy(answer_rr + 12, answer_ips[0], rdlen);
+            } else if (g_answers) {
+                memcpy(answer_rr + 12, g_answers[counter++ % g_answer_count], rdlen);
+            } else {
+                memcpy(answer_rr + 12, answer_ips[counter++ & 1], rdlen);
+            }
+            memcpy(packet + len, answer_rr, answer_len);
+            iovs[i].iov_len = len ? len + answer_len : 0;
+        }
+        sendmmsg(sockfd, msgs, count, 0);
+    }
+}
+
+static int compare_int64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    const char *chnroute_fname = NULL;
+    for (int opt; (opt = getopt(argc, argv, "6r:")) != -1;) {
+        switch (opt) {
+            case '6':
+                g_ipv6 = true;
+                break;
+            case 'r':
+                chnroute_fname = optarg;
+                break;
+            default:
+                argc = 0;
+        }
+    }
+    argv += optind - 1;
+    argc -= optind - 1;
+    if (argc < 4) {
+        printf("usage: dnsbench [-6] [-r chnroute-file] <chinadns-port> <fake-chinadns-port> <fake-trustdns-port> [query-count] [concurrency] [client-count]\n");
+        return 1;
+    }
+    uint16_t target_port = strtol(argv[1], NULL, 10);
+    long total = argc > 4 ? strtol(argv[4], NULL, 10) : 100000;
+    int window = argc > 5 ? strtol(argv[5], NULL, 10) : 64;
+    int client_count = argc > 6 ? strtol(argv[6], NULL, 10) : 4;
+    if (total < 1 || window < 1 || client_count < 1 || client_count > CLIENT_MAXCOUNT || window / client_count > 65535) {
+        printf("[main] invalid query-count, concurrency or client-count\n");
+        return 1;
+    }
+
+    if (chnroute_fname) load_answers(chnroute_fname);
+    if (fork() == 0) run_upstream(strtol(argv[2], NULL, 10), true);
+    if (fork() == 0) run_upstream(strtol(argv[3], NULL, 10), false);
+    usleep(100000);
+
+    /* each client socket keeps window/client_count queries in flight, msgid = sequence */
+    int client_window = (window + client_count - 1) / client_count;
+    struct pollfd pfds[CLIENT_MAXCOUNT];
+    struct sockaddr_in target = {.sin_family = AF_INET, .sin_port = htons(target_port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    static int64_t sent_nsec[CLIENT_MAXCOUNT][65536];
+    uint16_t next_seq[CLIENT_MAXCOUNT] = {0}, oldest_seq[CLIENT_MAXCOUNT] = {0};
+    for (int c = 0; c < client_count; ++c) {
+        pfds[c] = (struct pollfd){.fd = new_loopback_socket(0), .events = POLLIN};
+        connect(pfds[c].fd, (void *)&target, sizeof(target));
+    }
+
+    int64_t *latencies = malloc(total * sizeof(int64_t));
+    long sent = 0, received = 0, lost = 0;
+    uint8_t query[] = {0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 3, 'w', 'w', 'w', 5, 'b', 'a', 'i', 'd', 'u', 3, 'c', 'o', 'm', 0, 0, DNS_TYPE_A, 0, 1};
+    if (g_ipv6) query[sizeof(query) - 3] = DNS_TYPE_AAAA;
+    char reply[PACKET_MAXSIZE];
+    int64_t start_nsec = now_nsec();
+
+    while (received + lost < total) {
+        int64_t curr_nsec = now_nsec();
+        for (int c = 0; c < client_count; ++c) {
+            /* retire lost queries, then fill the window */
+            for (; oldest_seq[c] != next_seq[c]; ++oldest_seq[c]) {
+                int64_t *stamp = &sent_nsec[c][oldest_seq[c]];
+                if (*stamp && curr_nsec - *stamp < LOST_TIMEOUT_NSEC) break;
+                if (*stamp) ++lost;
+                *stamp = 0;
+            }
+            while (sent < total && (uint16_t)(next_seq[c] - oldest_seq[c]) < client_window) {
+                query[0] = next_seq[c] >> 8;
+                query[1] = next_seq[c];
+                sent_nsec[c][next_seq[c]++] = now_nsec();
+                send(pfds[c].fd, query, sizeof(query), 0);
+                ++sent;
+            }
+        }
+        if (poll(pfds, client_count, 100) <= 0) continue;
+        for (int c = 0; c < client_count; ++c) {
+            if (!(pfds[c].revents & POLLIN)) continue;
+            ssize_t len;
+            while ((len = recv(pfds[c].fd, reply, sizeof(reply), MSG_DONTWAIT)) >= 2) {
+                uint16_t seq = ((uint8_t)reply[0] << 8) | (uint8_t)reply[1];
+                int64_t *stamp = &sent_nsec[c][seq];
+                if (!*stamp) continue; /* duplicate or already counted as lost */
+                latencies[received++] = now_nsec() - *stamp;
+                *stamp = 0;
+            }
+        }
+    }
+
+    double elapsed = (now_nsec() - start_nsec) / 1e9;
+    qsort(latencies, received, sizeof(int64_t), compare_int64);
+    printf("queries: %ld, replies: %ld, lost: %ld, elapsed: %.2fs, %.0f replies/s\n", sent, received, lost, elapsed, received / elapsed);
+    if (received) {
+        printf("latency: p50 %.1fus, p99 %.1fus, max %.1fus\n",
+               latencies[received / 2] / 1e3, latencies[received * 99 / 100] / 1e3, latencies[received - 1] / 1e3);
+    }
+    return 0;
+}
@@ -1,6 +1,7 @@
 #define _GNU_SOURCE
 #include "dnsutils.h"
 #include "netutils.h"
+#include "iplutils.h"
 #include "logutils.h"
 #include "chinadns.h"
 #include <string.h>
@@ -14,6 +15,7 @@
 #define DNS_CLASS_INTERNET 1
 #define DNS_RECORD_TYPE_A 1 /* ipv4 address */
 #define DNS_RECORD_TYPE_AAAA 28 /* ipv6 address */
+#define DNS_RECORD_TYPE_OPT 41 /* edns pseudo-record */
 #define DNS_DNAME_LABEL_MAXLEN 63 /* domain-name label maxlen */
 #define DNS_DNAME_COMPRESSION_MINVAL 192 /* domain-name compression minval */
 
@@ -196,13 +198,13 @@ static bool dns_ipset_check(const void *packet_ptr, const void *ans_ptr, ssize_t
                     LOGERR("[dns_ipset_check] the format of the dns packet is incorrect");
                     return false;
                 }
-                return ipset_addr4_is_exists((void *)record->rdataptr);
+                return g_chnroute_fname4 ? ipl_addr4_is_exists((void *)record->rdataptr) : ipset_addr4_is_exists((void *)record->rdataptr);
             case DNS_RECORD_TYPE_AAAA:
                 if (rdatalen != sizeof(inet6_ipaddr_t)) {
                     LOGERR("[dns_ipset_check] the format of the dns packet is incorrect");
                     return false;
                 }
-                return ipset_addr6_is_exists((void *)record->rdataptr);
+                return g_chnroute_fname6 ? ipl_addr6_is_exists((void *)record->rdataptr) : ipset_addr6_is_exists((void *)record->rdataptr);
             default:
                 ans_ptr += sizeof(dns_record_t) + rdatalen;
                 ans_len -= sizeof(dns_record_t) + rdatalen;
@@ -226,3 +228,71 @@ bool dns_reply_check(const void *packet_buf, ssize_t packet_len, char *name_buf)
     if (!dns_packet_check(packet_buf, packet_len, name_buf, false, &answer_ptr)) return false;
     return dns_ipset_check(packet_buf, answer_ptr, packet_len - (answer_ptr - packet_buf));
 }
+
+/* call func for every record (except OPT) of all sections, false if the packet is malformed */
+static bool dns_record_foreach(void *packet_buf, ssize_t packet_len, void (*func)(dns_record_t *record, void *arg), void *arg) {
+    const dns_header_t *header = packet_buf;
+    uint32_t record_count = ntohs(header->answer_count) + ntohs(header->authority_count) + ntohs(header->additional_count);
+
+    /* skip the header and the question section */
+    const void *dname_endptr = memchr(packet_buf + sizeof(dns_header_t), 0, packet_len - sizeof(dns_header_t));
+    if (!dname_endptr) return false;
+    void *record_ptr = (void *)dname_endptr + 1 + sizeof(dns_query_t);
+    ssize_t remain_len = packet_len - (record_ptr - packet_buf);
+
+    for (uint32_t i = 0; i < record_count; ++i) {
+        /* skip the record name */
+        while (true) {
+            if (remain_len < 1) return false;
+            uint8_t label_len = *(uint8_t *)record_ptr;
+            if (label_len >= DNS_DNAME_COMPRESSION_MINVAL) {
+                record_ptr += 2;
+                remain_len -= 2;
+                break;
+            }
+            if (label_len > DNS_DNAME_LABEL_MAXLEN) return false;
+            record_ptr += label_len + 1;
+            remain_len -= label_len + 1;
+            if (label_len == 0) break;
+        }
+        if (remain_len < (ssize_t)sizeof(dns_record_t)) return false;
+        dns_record_t *record = record_ptr;
+        ssize_t record_len = sizeof(dns_record_t) + ntohs(record->rdatalen);
+        if (remain_len < record_len) return false;
+        if (ntohs(record->rtype) != DNS_RECORD_TYPE_OPT) func(record, arg);
+        record_ptr += record_len;
+        remain_len -= record_len;
+    }
+    return true;
+}
+
+static void dns_record_minttl(dns_record_t *record, void *arg) {
+    uint32_t ttl = ntohl(record->rttl);
+    if (*(uint32_t *)arg > ttl) *(uint32_t *)arg = ttl;
+}
+
+static void dns_record_subttl(dns_record_t *record, void *arg) {
+    uint32_t ttl = ntohl(record->rttl);
+    record->rttl = htonl(ttl > *(uint32_t *)arg ? ttl - *(uint32_t *)arg : 0);
+}
+
+static void dns_record_setttl(dns_record_t *record, void *arg) {
+    record->rttl = htonl(*(uint32_t *)arg);
+}
+
+/* get the min ttl of the records (except OPT), 0 if there is no record or the packet is malformed */
+uint32_t dns_reply_get_ttl(const void *packet_buf, ssize_t packet_len) {
+    uint32_t min_ttl = UINT32_MAX;
+    if (!dns_record_foreach((void *)packet_buf, packet_len, dns_record_minttl, &min_ttl)) return 0;
+    return min_ttl == UINT32_MAX ? 0 : min_ttl;
+}
+
+/* subtract `elapsed` from the ttl of the records (except OPT), stop at 0 */
+void dns_reply_sub_ttl(void *packet_buf, ssize_t packet_len, uint32_t elapsed) {
+    dns_record_foreach(packet_buf, packet_len, dns_record_subttl, &elapsed);
+}
+
+/* set the ttl of the records (except OPT) */
+void dns_reply_set_ttl(void *packet_buf, ssize_t packet_len, uint32_t ttl) {
+    dns_record_foreach(packet_buf, packet_len, dns_record_setttl, &ttl);
+}
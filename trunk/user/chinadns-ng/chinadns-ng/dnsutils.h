@@ -72,4 +72,13 @@ bool dns_query_check(const void *packet_buf, ssize_t packet_len, char *name_buf)
 /* check a dns reply packet, `name_buf` used to get domain name */
 bool dns_reply_check(const void *packet_buf, ssize_t packet_len, char *name_buf);
 
+/* get the min ttl of the records (except OPT), 0 if there is no record or the packet is malformed */
+uint32_t dns_reply_get_ttl(const void *packet_buf, ssize_t packet_len);
+
+/* subtract `elapsed` from the ttl of the records (except OPT), stop at 0 */
+void dns_reply_sub_ttl(void *packet_buf, ssize_t packet_len, uint32_t elapsed);
+
+/* set the ttl of the records (except OPT) */
+void dns_reply_set_ttl(void *packet_buf, ssize_t packet_len, uint32_t ttl);
+
 #endif
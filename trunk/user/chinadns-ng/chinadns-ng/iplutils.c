@@ -0,0 +1,236 @@
+#define _GNU_SOURCE
+#include "iplutils.h"
+#include "logutils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#undef _GNU_SOURCE
+
+/*
+ * multibit trie: the root is indexed by the first 16 bits of the address,
+ * every level below it by the next 8 bits (ipv4: at most 3 memory loads).
+ * an entry is a leaf (hit/miss) or the index of a child chunk. identical
+ * chunks are shared and a chunk whose entries are all hits becomes a hit.
+ */
+#define IPL_ROOT_BITS 16
+#define IPL_ROOT_SIZE (1 << IPL_ROOT_BITS)
+#define IPL_CHUNK_BITS 8
+#define IPL_CHUNK_SIZE (1 << IPL_CHUNK_BITS)
+#define IPL_ENTRY_MISS 0
+#define IPL_ENTRY_HIT 1
+#define IPL_CHILD_FLAG 0x80000000u
+
+/* lookup structure typedef */
+typedef struct {
+    uint32_t   root[IPL_ROOT_SIZE];
+    uint32_t (*chunks)[IPL_CHUNK_SIZE];
+    uint32_t   chunk_count;
+} ipltrie_t;
+
+/* build-time structure typedef (chunks do not move while inserting) */
+typedef struct {
+    uint32_t   root[IPL_ROOT_SIZE];
+    uint32_t **chunks;
+    uint32_t   chunk_count;
+    uint32_t   chunk_alloc;
+} iplbuild_t;
+
+/* current lookup structure and its source file */
+static ipltrie_t  *g_ipl_trie4  = NULL;
+static ipltrie_t  *g_ipl_trie6  = NULL;
+static const char *g_ipl_fname4 = NULL;
+static const char *g_ipl_fname6 = NULL;
+
+/* allocate a zeroed build-time chunk, return its index */
+static uint32_t ipl_new_chunk(iplbuild_t *build) {
+    if (build->chunk_count == build->chunk_alloc) {
+        build->chunk_alloc = build->chunk_alloc ? build->chunk_alloc * 2 : 64;
+        build->chunks = realloc(build->chunks, build->chunk_alloc * sizeof(uint32_t *));
+    }
+    build->chunks[build->chunk_count] = calloc(IPL_CHUNK_SIZE, sizeof(uint32_t));
+    return build->chunk_count++;
+}
+
+/* mark all addresses covered by addr/prefixlen as hit */
+static void ipl_insert(iplbuild_t *build, const uint8_t *addr, int prefixlen) {
+    uint32_t *entries = build->root;
+    uint32_t index = (addr[0] << 8) | addr[1];
+    int remain = prefixlen - IPL_ROOT_BITS;
+    for (const uint8_t *byte = addr + 2; remain > 0; ++byte, remain -= IPL_CHUNK_BITS) {
+        uint32_t *entry = &entries[index];
+        if (*entry == IPL_ENTRY_HIT) return; /* covered by a shorter prefix */
+        if (*entry == IPL_ENTRY_MISS) *entry = IPL_CHILD_FLAG | ipl_new_chunk(build);
+        entries = build->chunks[*entry & ~IPL_CHILD_FLAG];
+        index = *byte;
+    }
+    uint32_t count = 1u << -remain;
+    index &= ~(count - 1);
+    for (uint32_t i = 0; i < count; ++i) entries[index + i] = IPL_ENTRY_HIT;
+}
+
+/* dedup table used by ipl_compact() */
+typedef struct {
+    uint32_t *slots; /* chunk index + 1, 0 means empty */
+    uint32_t  mask;
+} ipldedup_t;
+
+/* copy the subtree of entry into trie, return the entry to store */
+static uint32_t ipl_compact(const iplbuild_t *build, ipltrie_t *trie, ipldedup_t *dedup, uint32_t entry) {
+    if (!(entry & IPL_CHILD_FLAG)) return entry;
+
+    const uint32_t *source = build->chunks[entry & ~IPL_CHILD_FLAG];
+    uint32_t chunk[IPL_CHUNK_SIZE];
+    bool all_hit = true;
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < IPL_CHUNK_SIZE; ++i) {
+        chunk[i] = ipl_compact(build, trie, dedup, source[i]);
+        if (chunk[i] != IPL_ENTRY_HIT) all_hit = false;
+        hash = (hash ^ chunk[i]) * 16777619u;
+    }
+    if (all_hit) return IPL_ENTRY_HIT;
+
+    uint32_t slot = hash & dedup->mask;
+    for (; dedup->slots[slot]; slot = (slot + 1) & dedup->mask) {
+        uint32_t index = dedup->slots[slot] - 1;
+        if (memcmp(trie->chunks[index], chunk, sizeof(chunk)) == 0) return IPL_CHILD_FLAG | index;
+    }
+    memcpy(trie->chunks[trie->chunk_count], chunk, sizeof(chunk));
+    dedup->slots[slot] = ++trie->chunk_count;
+    return IPL_CHILD_FLAG | (trie->chunk_count - 1);
+}
+
+/* convert the build-time structure to the lookup structure */
+static ipltrie_t* ipl_finish(iplbuild_t *build) {
+    ipltrie_t *trie = malloc(sizeof(ipltrie_t));
+    trie->chunks = malloc((build->chunk_count ? build->chunk_count : 1) * sizeof(*trie->chunks));
+    trie->chunk_count = 0;
+
+    ipldedup_t dedup = {0};
+    dedup.mask = 63;
+    while (dedup.mask < build->chunk_count * 2) dedup.mask = (dedup.mask << 1) | 1;
+    dedup.slots = calloc(dedup.mask + 1, sizeof(uint32_t));
+
+    for (int i = 0; i < IPL_ROOT_SIZE; ++i) {
+        trie->root[i] = ipl_compact(build, trie, &dedup, build->root[i]);
+    }
+    free(dedup.slots);
+
+    if (trie->chunk_count) trie->chunks = realloc(trie->chunks, trie->chunk_count * sizeof(*trie->chunks));
+    return trie;
+}
+
+/* release the lookup structure */
+static void ipl_free(ipltrie_t *trie) {
+    if (!trie) return;
+    free(trie->chunks);
+    free(trie);
+}
+
+/* parse "addr[/prefixlen]", return prefixlen or -1 */
+static int ipl_parse_cidr(char *cidr, bool is_ipv4, uint8_t *addr) {
+    int maxlen = is_ipv4 ? 32 : 128;
+    int prefixlen = maxlen;
+    char *slash = strchr(cidr, '/');
+    if (slash) {
+        *slash = 0;
+        char *endptr = NULL;
+        prefixlen = strtol(slash + 1, &endptr, 10);
+        if (endptr == slash + 1 || *endptr || prefixlen < 0 || prefixlen > maxlen) return -1;
+    }
+    if (inet_pton(is_ipv4 ? AF_INET : AF_INET6, cidr, addr) != 1) return -1;
+    return prefixlen;
+}
+
+/* build the lookup structure from file, NULL if it cannot be opened */
+static ipltrie_t* ipl_load(const char *filename, bool is_ipv4, size_t *entry_count) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        LOGERR("[ipl_load] failed to open '%s': (%d) %s", filename, errno, strerror(errno));
+        return NULL;
+    }
+
+    iplbuild_t *build = calloc(1, sizeof(iplbuild_t));
+    char linebuf[256], token1[64], token2[64], token3[64];
+    size_t count = 0, lineno = 0;
+    while (fgets(linebuf, sizeof(linebuf), fp)) {
+        ++lineno;
+        /* ipset save format ("create ...", "add <setname> <cidr>") or plain "<cidr>" */
+        int token_count = sscanf(linebuf, "%63s %63s %63s", token1, token2, token3);
+        if (token_count < 1 || token1[0] == '#' || strcmp(token1, "create") == 0) continue;
+        char *cidr = token1;
+        if (strcmp(token1, "add") == 0) {
+            if (token_count < 3) continue;
+            cidr = token3;
+        }
+        uint8_t addr[16];
+        int prefixlen = ipl_parse_cidr(cidr, is_ipv4, addr);
+        if (prefixlen < 0) {
+            LOGERR("[ipl_load] invalid %s prefix at %s:%zu: %s", is_ipv4 ? "ipv4" : "ipv6", filename, lineno, cidr);
+            continue;
+        }
+        ipl_insert(build, addr, prefixlen);
+        ++count;
+    }
+    fclose(fp);
+
+    ipltrie_t *trie = ipl_finish(build);
+    for (uint32_t i = 0; i < build->chunk_count; ++i) free(build->chunks[i]);
+    free(build->chunks);
+    free(build);
+
+    *entry_count = count;
+    return trie;
+}
+
+/* initialize ip-prefix-list from file (exit on error) */
+size_t ipl_init(const char *filename, bool is_ipv4) {
+    size_t count = 0;
+    ipltrie_t *trie = ipl_load(filename, is_ipv4, &count);
+    if (!trie) exit(errno ? errno : 1);
+    if (is_ipv4) {
+        g_ipl_trie4 = trie;
+        g_ipl_fname4 = filename;
+    } else {
+        g_ipl_trie6 = trie;
+        g_ipl_fname6 = filename;
+    }
+    return count;
+}
+
+/* reload ip-prefix-list from the same file (keep the old one on error) */
+void ipl_reload(bool is_ipv4) {
+    const char *filename = is_ipv4 ? g_ipl_fname4 : g_ipl_fname6;
+    if (!filename) return;
+    size_t count = 0;
+    ipltrie_t *trie = ipl_load(filename, is_ipv4, &count);
+    if (!trie) {
+        LOGERR("[ipl_reload] keep using the previous %s prefix list", is_ipv4 ? "ipv4" : "ipv6");
+        return;
+    }
+    ipltrie_t **current = is_ipv4 ? &g_ipl_trie4 : &g_ipl_trie6;
+    ipl_free(*current);
+    *current = trie; /* lookups only ever see a complete structure */
+    LOGINF("[ipl_reload] reloaded '%s', entries count: %zu", filename, count);
+}
+
+/* walk down from the root */
+static inline bool ipl_lookup(const ipltrie_t *trie, const uint8_t *addr) {
+    uint32_t entry = trie->root[(addr[0] << 8) | addr[1]];
+    for (addr += 2; entry & IPL_CHILD_FLAG; ++addr) {
+        entry = trie->chunks[entry & ~IPL_CHILD_FLAG][*addr];
+    }
+    return entry == IPL_ENTRY_HIT;
+}
+
+/* check given ipaddr is covered by the ip-prefix-list */
+bool ipl_addr4_is_exists(const inet4_ipaddr_t *addr_ptr) {
+    return ipl_lookup(g_ipl_trie4, (const uint8_t *)addr_ptr);
+}
+
+/* check given ipaddr is covered by the ip-prefix-list */
+bool ipl_addr6_is_exists(const inet6_ipaddr_t *addr_ptr) {
+    return ipl_lookup(g_ipl_trie6, addr_ptr->addr);
+}
@@ -0,0 +1,20 @@
+#ifndef CHINADNS_NG_IPLUTILS_H
+#define CHINADNS_NG_IPLUTILS_H
+
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdbool.h>
+#include "netutils.h"
+#undef _GNU_SOURCE
+
+/* initialize ip-prefix-list from file (exit on error) */
+size_t ipl_init(const char *filename, bool is_ipv4);
+
+/* reload ip-prefix-list from the same file (keep the old one on error) */
+void ipl_reload(bool is_ipv4);
+
+/* check given ipaddr is covered by the ip-prefix-list */
+bool ipl_addr4_is_exists(const inet4_ipaddr_t *addr_ptr);
+bool ipl_addr6_is_exists(const inet6_ipaddr_t *addr_ptr);
+
+#endif
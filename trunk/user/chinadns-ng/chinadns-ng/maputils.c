@@ -1,20 +1,84 @@
 #define _GNU_SOURCE
 #include "maputils.h"
+#include "dnsutils.h"
+#include "cacheutils.h"
+#include "logutils.h"
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #undef _GNU_SOURCE
 
-/* put key and value to hashmap */
-hashentry_t* hashmap_put(hashmap_t **hashmap, uint16_t unique_msgid, uint16_t origin_msgid, int query_timerfd, uint8_t dnlmatch_ret, const inet6_skaddr_t *source_addr) {
-    hashentry_t *hashentry = malloc(sizeof(hashentry_t));
+/*
+ * fixed-size object allocator: objects are carved from malloc'd blocks of
+ * `batch` objects and recycled through a freelist, never given back to libc.
+ */
+typedef struct {
+    size_t objsize;  /* aligned object size (>= sizeof(void *)) */
+    size_t batch;    /* objects per malloc'd block */
+    void  *freelist; /* singly linked through the first word of the object */
+} slab_t;
+
+#define SLAB_ALIGN(size) (((size) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+static slab_t g_entry_slab = {SLAB_ALIGN(sizeof(hashentry_t)), 64, NULL};
+static slab_t g_reply_slab = {SLAB_ALIGN(sizeof(uint16_t) + DNS_PACKET_MAXSIZE), 8, NULL};
+static slab_t g_ckey_slab  = {SLAB_ALIGN(sizeof(uint16_t) + CACHE_KEY_MAXLEN), 16, NULL};
+
+/* timing wheel slots and the current tick */
+static hashentry_t *g_timewheel[TIMEWHEEL_SLOTS] = {NULL};
+static uint32_t     g_timewheel_tick             = 0;
+
+static void* slab_alloc(slab_t *slab) {
+    if (!slab->freelist) {
+        char *block = malloc(slab->objsize * slab->batch);
+        if (!block) {
+            LOGERR("[slab_alloc] failed to allocate %zu objects of %zu bytes: (%d) %s", slab->batch, slab->objsize, errno, strerror(errno));
+            exit(errno);
+        }
+        for (size_t i = 0; i < slab->batch; ++i) {
+            void *object = block + i * slab->objsize;
+            *(void **)object = slab->freelist;
+            slab->freelist = object;
+        }
+    }
+    void *object = slab->freelist;
+    slab->freelist = *(void **)object;
+    return object;
+}
+
+static void slab_free(slab_t *slab, void *object) {
+    if (!object) return;
+    *(void **)object = slab->freelist;
+    slab->freelist = object;
+}
+
+/* link entry into the slot of its expire_tick */
+static void timewheel_link(hashentry_t *hashentry) {
+    hashentry_t **slot = &g_timewheel[hashentry->expire_tick & (TIMEWHEEL_SLOTS - 1)];
+    hashentry->wheel_next = *slot;
+    if (*slot) (*slot)->wheel_pprev = &hashentry->wheel_next;
+    hashentry->wheel_pprev = slot;
+    *slot = hashentry;
+}
+
+static void timewheel_unlink(hashentry_t *hashentry) {
+    *hashentry->wheel_pprev = hashentry->wheel_next;
+    if (hashentry->wheel_next) hashentry->wheel_next->wheel_pprev = hashentry->wheel_pprev;
+}
+
+/* put key and value to hashmap, it times out after timeout_ticks */
+hashentry_t* hashmap_put(hashmap_t **hashmap, uint16_t unique_msgid, uint16_t origin_msgid, uint8_t dnlmatch_ret, const inet6_skaddr_t *source_addr, uint32_t timeout_ticks) {
+    hashentry_t *hashentry = slab_alloc(&g_entry_slab);
     hashentry->unique_msgid = unique_msgid;
     hashentry->origin_msgid = origin_msgid;
-    hashentry->query_timerfd = query_timerfd;
+    hashentry->expire_tick = g_timewheel_tick + timeout_ticks;
     hashentry->trustdns_buf = NULL;
+    hashentry->cachekey_buf = NULL;
     hashentry->chinadns_got = false;
     hashentry->dnlmatch_ret = dnlmatch_ret;
     memcpy(&hashentry->source_addr, source_addr, sizeof(inet6_skaddr_t));
     MYHASH_ADD(*hashmap, hashentry, &hashentry->unique_msgid, sizeof(hashentry->unique_msgid));
+    timewheel_link(hashentry);
     return hashentry;
 }
 
@@ -25,8 +89,46 @@ hashentry_t* hashmap_get(hashmap_t *hashmap, uint16_t unique_msgid) {
     return hashentry;
 }
 
+/* save a copy of the trust-dns reply (length-prefixed) */
+void hashmap_save_reply(hashentry_t *hashentry, const void *packet_buf, uint16_t packet_len) {
+    if (!hashentry->trustdns_buf) hashentry->trustdns_buf = slab_alloc(&g_reply_slab);
+    *(uint16_t *)hashentry->trustdns_buf = packet_len;
+    memcpy(hashentry->trustdns_buf + sizeof(uint16_t), packet_buf, packet_len);
+}
+
+/* save a copy of the cache key (length-prefixed), used to serve stale on timeout */
+void hashmap_save_cachekey(hashentry_t *hashentry, const void *key_buf, uint16_t key_len) {
+    if (!hashentry->cachekey_buf) hashentry->cachekey_buf = slab_alloc(&g_ckey_slab);
+    *(uint16_t *)hashentry->cachekey_buf = key_len;
+    memcpy(hashentry->cachekey_buf + sizeof(uint16_t), key_buf, key_len);
+}
+
 /* delete and free the entry from hashmap */
 void hashmap_del(hashmap_t **hashmap, hashentry_t *hashentry) {
     MYHASH_DEL(*hashmap, hashentry);
-    free(hashentry);
+    timewheel_unlink(hashentry);
+    slab_free(&g_reply_slab, hashentry->trustdns_buf);
+    slab_free(&g_ckey_slab, hashentry->cachekey_buf);
+    slab_free(&g_entry_slab, hashentry);
+}
+
+/* advance the timing wheel, delete the timed out entries (call timeout_cb before) */
+void hashmap_tick(hashmap_t **hashmap, uint64_t ticks, void (*timeout_cb)(hashentry_t *hashentry)) {
+    /* a full turn visits every slot, skip the turns before it */
+    if (ticks > TIMEWHEEL_SLOTS) {
+        g_timewheel_tick += ticks - TIMEWHEEL_SLOTS;
+        ticks = TIMEWHEEL_SLOTS;
+    }
+    while (ticks--) {
+        ++g_timewheel_tick;
+        hashentry_t *hashentry = g_timewheel[g_timewheel_tick & (TIMEWHEEL_SLOTS - 1)];
+        while (hashentry) {
+            hashentry_t *next_entry = hashentry->wheel_next;
+            if ((int32_t)(hashentry->expire_tick - g_timewheel_tick) <= 0) {
+                timeout_cb(hashentry);
+                hashmap_del(hashmap, hashentry);
+            }
+            hashentry = next_entry;
+        }
+    }
 }
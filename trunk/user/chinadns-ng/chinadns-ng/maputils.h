@@ -6,25 +6,41 @@
 #include "netutils.h"
 #undef _GNU_SOURCE
 
+/* timing wheel: slot count (power of 2) and tick interval */
+#define TIMEWHEEL_SLOTS 64
+#define TIMEWHEEL_TICK_MSEC 100
+
 /* hash table structure typedef */
-typedef struct {
-    uint16_t       unique_msgid;  /* [key]   globally unique msgid */
-    uint16_t       origin_msgid;  /* [value] associated original msgid */
-    int            query_timerfd; /* [value] dns query timeout timerfd */
-    void          *trustdns_buf;  /* [value] storage reply from trust-dns */
-    bool           chinadns_got;  /* [value] received reply from china-dns */
-    uint8_t        dnlmatch_ret;  /* [value] dnl_ismatch(dname) ret-value */
-    inet6_skaddr_t source_addr;   /* [value] associated client sockaddr */
-    UT_hash_handle hh;            /* metadata, used internally by uthash */
+typedef struct hashentry {
+    uint16_t           unique_msgid;  /* [key]   globally unique msgid */
+    uint16_t           origin_msgid;  /* [value] associated original msgid */
+    uint32_t           expire_tick;   /* [value] timing wheel tick of timeout */
+    void              *trustdns_buf;  /* [value] storage reply from trust-dns */
+    void              *cachekey_buf;  /* [value] storage key of a stale cache entry */
+    bool               chinadns_got;  /* [value] received reply from china-dns */
+    uint8_t            dnlmatch_ret;  /* [value] dnl_ismatch(dname) ret-value */
+    inet6_skaddr_t     source_addr;   /* [value] associated client sockaddr */
+    struct hashentry  *wheel_next;    /* metadata, timing wheel slot list */
+    struct hashentry **wheel_pprev;   /* metadata, timing wheel slot list */
+    UT_hash_handle     hh;            /* metadata, used internally by uthash */
 } hashmap_t, hashentry_t;
 
-/* put key and value to hashmap */
-hashentry_t* hashmap_put(hashmap_t **hashmap, uint16_t unique_msgid, uint16_t origin_msgid, int query_timerfd, uint8_t dnlmatch_ret, const inet6_skaddr_t *source_addr);
+/* put key and value to hashmap, it times out after timeout_ticks */
+hashentry_t* hashmap_put(hashmap_t **hashmap, uint16_t unique_msgid, uint16_t origin_msgid, uint8_t dnlmatch_ret, const inet6_skaddr_t *source_addr, uint32_t timeout_ticks);
 
 /* get entry_ptr by unique_msgid */
 hashentry_t* hashmap_get(hashmap_t *hashmap, uint16_t unique_msgid);
 
+/* save a copy of the trust-dns reply (length-prefixed) */
+void hashmap_save_reply(hashentry_t *hashentry, const void *packet_buf, uint16_t packet_len);
+
+/* save a copy of the cache key (length-prefixed), used to serve stale on timeout */
+void hashmap_save_cachekey(hashentry_t *hashentry, const void *key_buf, uint16_t key_len);
+
 /* delete and free the entry from hashmap */
 void hashmap_del(hashmap_t **hashmap, hashentry_t *hashentry);
 
+/* advance the timing wheel, delete the timed out entries (call timeout_cb before) */
+void hashmap_tick(hashmap_t **hashmap, uint64_t ticks, void (*timeout_cb)(hashentry_t *hashentry));
+
 #endif
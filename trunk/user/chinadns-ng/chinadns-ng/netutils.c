@@ -123,23 +123,26 @@ void set_reuse_port(int sockfd) {
     }
 }
 
-/* create a timer fd (in seconds) */
-int new_once_timerfd(time_t second) {
-    int timerfd = timerfd_create(CLOCK_MONOTONIC, 0);
+/* create a timer fd (disarmed) */
+int new_timerfd(void) {
+    int timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC|TFD_NONBLOCK);
     if (timerfd < 0) {
-        LOGERR("[new_once_timerfd] failed to create timer fd: (%d) %s", errno, strerror(errno));
+        LOGERR("[new_timerfd] failed to create timer fd: (%d) %s", errno, strerror(errno));
         exit(errno);
     }
+    return timerfd;
+}
+
+/* arm a periodic timer fd (in milliseconds), 0 means disarm */
+void set_timerfd_interval(int timerfd, long msec) {
     struct itimerspec time_value;
-    time_value.it_value.tv_sec = second;
-    time_value.it_value.tv_nsec = 0;
-    time_value.it_interval.tv_sec = 0;
-    time_value.it_interval.tv_nsec = 0;
+    time_value.it_value.tv_sec = msec / 1000;
+    time_value.it_value.tv_nsec = (msec % 1000) * 1000000;
+    time_value.it_interval = time_value.it_value;
     if (timerfd_settime(timerfd, 0, &time_value, NULL)) {
-        LOGERR("[new_once_timerfd] failed to settime for timer fd: (%d) %s", errno, strerror(errno));
+        LOGERR("[set_timerfd_interval] failed to settime for timer fd: (%d) %s", errno, strerror(errno));
         exit(errno);
     }
-    return timerfd;
 }
 
 /* AF_INET or AF_INET6 or -1(invalid) */
@@ -43,8 +43,11 @@ void set_reuse_addr(int sockfd);
 /* setsockopt(SO_REUSEPORT) */
 void set_reuse_port(int sockfd);
 
-/* create a timer fd (in seconds) */
-int new_once_timerfd(time_t second);
+/* create a timer fd (disarmed) */
+int new_timerfd(void);
+
+/* arm a periodic timer fd (in milliseconds), 0 means disarm */
+void set_timerfd_interval(int timerfd, long msec);
 
 /* AF_INET or AF_INET6 or -1(invalid) */
 int get_addrstr_family(const char *addrstr);
@@ -26,6 +26,7 @@
 #define MAXDNAME	1025		/* maximum presentation domain name */
 #define RRFIXEDSZ	10		/* #/bytes of fixed data in r record */
 #define MAXLABEL        63              /* maximum length of domain label */
+#define MAXNAMELABELS   128             /* maximum number of labels in a name */
 
 #define NOERROR		0		/* no error */
 #define FORMERR		1		/* format error */
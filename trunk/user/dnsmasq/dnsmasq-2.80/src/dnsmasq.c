@@ -299,7 +299,10 @@ int main (int argc, char **argv)
 
 #ifdef HAVE_IPSET
   if (daemon->ipsets)
-    ipset_init();
+    {
+      ipset_init();
+      build_ipset_trie();
+    }
 #endif
 
 #if  defined(HAVE_LINUX_NETWORK)
@@ -1450,6 +1453,10 @@ static void async_event(int pipe, time_t now)
 	  }
 #endif
 	
+#ifdef HAVE_DHCP
+	/* write out changes held back by LEASE_WRITE_DELAY */
+	lease_flush_file();
+#endif
 	if (daemon->lease_stream)
 	  fclose(daemon->lease_stream);
 
@@ -548,9 +548,16 @@ struct server {
 #ifdef HAVE_LOOP
   u32 uid;
 #endif
+  unsigned int seq; /* position in daemon->servers, see domain-trie.c */
+  struct server *domain_next; /* next server of the same type and domain */
   struct server *next; 
 };
 
+struct server_match {
+  int count, linear;
+  struct server *head[MAXNAMELABELS + 2];
+};
+
 struct ipsets {
   char **sets;
   char *domain;
@@ -734,6 +741,10 @@ struct dhcp_lease {
   } *slaac_address;
   int vendorclass_count;
 #endif
+  unsigned int seq;      /* allocation order, newest first in the list */
+  char *file_line;       /* leasefile record, NULL when it needs formatting */
+  unsigned int file_line_len;
+  struct dhcp_lease *addr_next, *clid_next, *hwaddr_next; /* hash chains */
   struct dhcp_lease *next;
 };
 
@@ -1187,6 +1198,17 @@ char *get_domain6(struct in6_addr *addr);
 int is_name_synthetic(int flags, char *name, union all_addr *addr);
 int is_rev_synth(int flag, union all_addr *addr, char *name);
 
+/* domain-trie.c */
+void build_server_trie(void);
+void match_servers(struct server_match *m, char *name);
+struct server *next_server_match(struct server_match *m);
+struct server *server_group(int type, char *domain);
+struct server *lookup_server_addr(union mysockaddr *addr);
+#ifdef HAVE_IPSET
+void build_ipset_trie(void);
+struct ipsets *match_ipsets(char *name);
+#endif
+
 /* rfc1035.c */
 int extract_name(struct dns_header *header, size_t plen, unsigned char **pp, 
                  char *name, int isExtract, int extrabytes);
@@ -1381,6 +1403,7 @@ char *host_from_dns(struct in_addr addr);
 /* lease.c */
 #ifdef HAVE_DHCP
 void lease_update_file(time_t now);
+void lease_flush_file(void);
 void lease_update_dns(int force);
 void lease_init(time_t now);
 struct dhcp_lease *lease4_allocate(struct in_addr addr);
@@ -1403,6 +1426,7 @@ void lease_set_hwaddr(struct dhcp_lease *lease, const unsigned char *hwaddr,
 void lease_set_hostname(struct dhcp_lease *lease, const char *name, int auth, char *domain, char *config_domain);
 void lease_set_expires(struct dhcp_lease *lease, unsigned int len, time_t now);
 void lease_set_interface(struct dhcp_lease *lease, int interface, time_t now);
+void lease_set_changed(struct dhcp_lease *lease);
 struct dhcp_lease *lease_find_by_client(unsigned char *hwaddr, int hw_len, int hw_type,  
 					unsigned char *clid, int clid_len);
 struct dhcp_lease *lease_find_by_addr(struct in_addr addr);
@@ -0,0 +1,528 @@
+/* dnsmasq is Copyright (c) 2000-2018 Simon Kelley
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 dated June, 1991, or
+   (at your option) version 3 dated 29 June, 2007.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Reversed-label tries for --server/--address and --ipset domains.
+
+   Every node is one label, reached from its parent (the label to its
+   right). Children are not stored in the node, instead all nodes of a
+   trie share one hash table keyed by (parent, label), so a node costs
+   the same whether it has no children or fifty thousand (as "com" does
+   with a gfwlist loaded). Labels are not copied, they point into the
+   domain string of the server or ipset which owns the node, and that
+   string lives as long as the trie does.
+
+   Matching a name walks its labels from the right, one hash probe per
+   label, and collects every node on the way which carries data: those
+   are exactly the configured domains which are a suffix of the name.
+
+   Servers without a domain are kept on two plain chains, one for
+   unqualified names and one for everything else, and a small hash table
+   maps each upstream address to its first server, so that neither sending
+   a query nor accepting its reply has to walk the whole server list. */
+
+#include "dnsmasq.h"
+
+struct dtrie_node {
+  const char *label;
+  void *data;
+  unsigned int parent, hash, next; /* next: hash chain, 0 terminates */
+  unsigned int len;
+};
+
+struct dtrie {
+  struct dtrie_node *nodes;  /* nodes[0] is the root */
+  unsigned int *buckets;
+  unsigned int count, size, mask;
+};
+
+static struct dtrie server_trie;
+static struct server *nodots_servers, *plain_servers;
+static struct server **addr_table;
+static unsigned int addr_mask, addr_count;
+static int server_trie_ok;
+
+#ifdef HAVE_IPSET
+static struct dtrie ipset_trie;
+static int ipset_trie_ok;
+#endif
+
+static unsigned int label_hash(unsigned int parent, const char *label, unsigned int len)
+{
+  unsigned int h = 2166136261u ^ parent;
+
+  while (len--)
+    {
+      unsigned int c = (unsigned char)*label++;
+
+      if (c >= 'A' && c <= 'Z')
+	c += 'a' - 'A';
+      h = (h ^ c) * 16777619u;
+    }
+
+  return h;
+}
+
+/* Same case folding as hostname_isequal() */
+static int label_isequal(const char *a, const char *b, unsigned int len)
+{
+  while (len--)
+    {
+      unsigned int c1 = (unsigned char)*a++;
+      unsigned int c2 = (unsigned char)*b++;
+
+      if (c1 >= 'A' && c1 <= 'Z')
+	c1 += 'a' - 'A';
+      if (c2 >= 'A' && c2 <= 'Z')
+	c2 += 'a' - 'A';
+
+      if (c1 != c2)
+	return 0;
+    }
+
+  return 1;
+}
+
+/* Empty the trie, keeping its memory for the next build. */
+static int dtrie_reset(struct dtrie *t)
+{
+  if (!t->nodes)
+    {
+      if (!(t->nodes = whine_malloc(64 * sizeof(struct dtrie_node))) ||
+	  !(t->buckets = whine_malloc(64 * sizeof(unsigned int))))
+	{
+	  free(t->nodes);
+	  t->nodes = NULL;
+	  return 0;
+	}
+      t->size = 64;
+      t->mask = 63;
+    }
+  else
+    memset(t->buckets, 0, (t->mask + 1) * sizeof(unsigned int));
+
+  memset(&t->nodes[0], 0, sizeof(struct dtrie_node));
+  t->count = 1;
+
+  return 1;
+}
+
+static unsigned int dtrie_child(struct dtrie *t, unsigned int parent, const char *label, unsigned int len)
+{
+  unsigned int hash = label_hash(parent, label, len);
+  unsigned int i;
+
+  for (i = t->buckets[hash & t->mask]; i != 0; i = t->nodes[i].next)
+    {
+      struct dtrie_node *node = &t->nodes[i];
+
+      if (node->hash == hash && node->parent == parent && node->len == len &&
+	  label_isequal(node->label, label, len))
+	return i;
+    }
+
+  return 0;
+}
+
+static int dtrie_grow(struct dtrie *t)
+{
+  if (t->count == t->size)
+    {
+      struct dtrie_node *new = whine_malloc(2 * t->size * sizeof(struct dtrie_node));
+
+      if (!new)
+	return 0;
+      memcpy(new, t->nodes, t->count * sizeof(struct dtrie_node));
+      free(t->nodes);
+      t->nodes = new;
+      t->size *= 2;
+    }
+
+  /* Keep the load factor at or below one. */
+  if (t->count > t->mask)
+    {
+      unsigned int mask = 2 * t->mask + 1, i;
+      unsigned int *new = whine_malloc((mask + 1) * sizeof(unsigned int));
+
+      if (!new)
+	return 0;
+
+      for (i = 1; i < t->count; i++)
+	{
+	  t->nodes[i].next = new[t->nodes[i].hash & mask];
+	  new[t->nodes[i].hash & mask] = i;
+	}
+
+      free(t->buckets);
+      t->buckets = new;
+      t->mask = mask;
+    }
+
+  return 1;
+}
+
+/* Return the node for domain, creating it and its parents as needed.
+   Returns -1 on allocation failure. */
+static int dtrie_insert(struct dtrie *t, const char *domain)
+{
+  const char *end = domain + strlen(domain);
+  unsigned int node = 0;
+
+  if (end == domain)
+    return 0;
+
+  while (1)
+    {
+      const char *p = end;
+      unsigned int child;
+
+      while (p > domain && *(p-1) != '.')
+	p--;
+
+      if (!(child = dtrie_child(t, node, p, end - p)))
+	{
+	  struct dtrie_node *new;
+
+	  if (!dtrie_grow(t))
+	    return -1;
+
+	  child = t->count++;
+	  new = &t->nodes[child];
+	  new->label = p;
+	  new->len = end - p;
+	  new->data = NULL;
+	  new->parent = node;
+	  new->hash = label_hash(node, p, new->len);
+	  new->next = t->buckets[new->hash & t->mask];
+	  t->buckets[new->hash & t->mask] = child;
+	}
+
+      node = child;
+
+      if (p == domain)
+	return node;
+
+      end = p - 1;
+    }
+}
+
+/* Fill path with the nodes carrying data whose domain is a suffix
+   of name, shortest first. Returns the number found. */
+static int dtrie_match(struct dtrie *t, const char *name, unsigned int *path)
+{
+  const char *end = name + strlen(name);
+  unsigned int node = 0;
+  int depth = 0, n = 0;
+
+  if (t->nodes[0].data)
+    path[n++] = 0;
+
+  if (end == name)
+    return n;
+
+  while (depth++ < MAXNAMELABELS)
+    {
+      const char *p = end;
+
+      while (p > name && *(p-1) != '.')
+	p--;
+
+      if (!(node = dtrie_child(t, node, p, end - p)))
+	break;
+
+      if (t->nodes[node].data)
+	path[n++] = node;
+
+      if (p == name)
+	break;
+
+      end = p - 1;
+    }
+
+  return n;
+}
+
+static unsigned int addr_hash(union mysockaddr *addr)
+{
+  unsigned int h;
+
+  if (addr->sa.sa_family == AF_INET6)
+    {
+      u32 *a = (u32 *)&addr->in6.sin6_addr;
+      h = a[0] ^ a[1] ^ a[2] ^ a[3] ^ addr->in6.sin6_port;
+    }
+  else
+    h = addr->in.sin_addr.s_addr ^ addr->in.sin_port;
+
+  return (h ^ (h >> 16)) * 0x45d9f3b;
+}
+
+/* Remember serv as the first server for its address, unless there is one. */
+static int addr_insert(struct server *serv)
+{
+  unsigned int i;
+
+  if (2 * (addr_count + 1) > addr_mask + 1)
+    {
+      unsigned int mask = addr_table ? 2 * addr_mask + 1 : 15, j;
+      struct server **new = whine_malloc((mask + 1) * sizeof(struct server *));
+
+      if (!new)
+	return 0;
+
+      if (addr_table)
+	for (j = 0; j <= addr_mask; j++)
+	  if (addr_table[j])
+	    {
+	      for (i = addr_hash(&addr_table[j]->addr) & mask; new[i]; i = (i + 1) & mask);
+	      new[i] = addr_table[j];
+	    }
+
+      free(addr_table);
+      addr_table = new;
+      addr_mask = mask;
+    }
+
+  for (i = addr_hash(&serv->addr) & addr_mask; addr_table[i]; i = (i + 1) & addr_mask)
+    if (sockaddr_isequal(&addr_table[i]->addr, &serv->addr))
+      return 1;
+
+  addr_table[i] = serv;
+  addr_count++;
+
+  return 1;
+}
+
+/* Index daemon->servers. Called whenever the server list has changed,
+   before any query can see it. Servers for one domain are chained through
+   domain_next in list order, and numbered so that candidates from several
+   domains can be merged back into list order when matching. If we run
+   out of memory, everything falls back to walking the whole list. */
+void build_server_trie(void)
+{
+  struct server *serv, **nodots = &nodots_servers, **plain = &plain_servers;
+  unsigned int seq = 0, i;
+
+  server_trie_ok = 0;
+  nodots_servers = plain_servers = NULL;
+  addr_count = 0;
+  if (addr_table)
+    memset(addr_table, 0, (addr_mask + 1) * sizeof(struct server *));
+
+  if (!dtrie_reset(&server_trie))
+    return;
+
+  /* Domain chains are built in reverse and turned around below. */
+  for (serv = daemon->servers; serv; serv = serv->next)
+    {
+      serv->seq = seq++;
+      serv->domain_next = NULL;
+
+      if (serv->flags & SERV_HAS_DOMAIN)
+	{
+	  int node = dtrie_insert(&server_trie, serv->domain);
+
+	  if (node == -1)
+	    return;
+
+	  serv->domain_next = server_trie.nodes[node].data;
+	  server_trie.nodes[node].data = serv;
+	}
+      else if (serv->flags & SERV_FOR_NODOTS)
+	{
+	  *nodots = serv;
+	  nodots = &serv->domain_next;
+	}
+      else
+	{
+	  *plain = serv;
+	  plain = &serv->domain_next;
+	}
+
+      if (!(serv->flags & (SERV_LITERAL_ADDRESS | SERV_NO_ADDR)) && !addr_insert(serv))
+	return;
+    }
+
+  for (i = 0; i < server_trie.count; i++)
+    {
+      struct server *rev = NULL, *tmp;
+
+      for (serv = server_trie.nodes[i].data; serv; serv = tmp)
+	{
+	  tmp = serv->domain_next;
+	  serv->domain_next = rev;
+	  rev = serv;
+	}
+
+      server_trie.nodes[i].data = rev;
+    }
+
+  server_trie_ok = 1;
+}
+
+/* Collect the servers which could apply to name: those for domains which
+   are a suffix of it and, if it has no dots, those for unqualified names. */
+void match_servers(struct server_match *m, char *name)
+{
+  unsigned int path[MAXNAMELABELS + 1];
+  int i;
+
+  m->count = 0;
+
+  if (!server_trie_ok)
+    {
+      m->linear = 1;
+      m->head[m->count++] = daemon->servers;
+      return;
+    }
+
+  m->linear = 0;
+
+  for (i = dtrie_match(&server_trie, name, path) - 1; i >= 0; i--)
+    m->head[m->count++] = server_trie.nodes[path[i]].data;
+
+  if (nodots_servers && !strchr(name, '.'))
+    m->head[m->count++] = nodots_servers;
+}
+
+/* Return the collected servers one at a time, in daemon->servers order. */
+struct server *next_server_match(struct server_match *m)
+{
+  struct server *serv;
+  int i, min = 0;
+
+  if (m->count == 0)
+    return NULL;
+
+  if (m->linear)
+    {
+      if ((serv = m->head[0]))
+	m->head[0] = serv->next;
+      return serv;
+    }
+
+  for (i = 1; i < m->count; i++)
+    if (m->head[i]->seq < m->head[min]->seq)
+      min = i;
+
+  serv = m->head[min];
+
+  if (!(m->head[min] = serv->domain_next))
+    m->head[min] = m->head[--m->count];
+
+  return serv;
+}
+
+/* First server, in list order, whose (flags & SERV_TYPE) is type and, for
+   SERV_HAS_DOMAIN, whose domain is domain. The others follow through
+   domain_next. NULL if there is none or the index is unavailable. */
+struct server *server_group(int type, char *domain)
+{
+  unsigned int path[MAXNAMELABELS + 1];
+  struct server *serv;
+  int n;
+
+  if (!server_trie_ok)
+    return NULL;
+
+  if (type == 0)
+    return plain_servers;
+
+  if (type == SERV_FOR_NODOTS)
+    return nodots_servers;
+
+  if ((n = dtrie_match(&server_trie, domain, path)) == 0)
+    return NULL;
+
+  /* The deepest match is exact only if it covers the whole of domain. */
+  serv = server_trie.nodes[path[n-1]].data;
+
+  return hostname_isequal(serv->domain, domain) ? serv : NULL;
+}
+
+/* First server in list order with this address, which isn't a local answer. */
+struct server *lookup_server_addr(union mysockaddr *addr)
+{
+  struct server *serv;
+  unsigned int i;
+
+  if (server_trie_ok)
+    {
+      for (i = addr_hash(addr) & addr_mask; (serv = addr_table[i]); i = (i + 1) & addr_mask)
+	if (sockaddr_isequal(&serv->addr, addr))
+	  return serv;
+
+      return NULL;
+    }
+
+  for (serv = daemon->servers; serv; serv = serv->next)
+    if (!(serv->flags & (SERV_LITERAL_ADDRESS | SERV_NO_ADDR)) &&
+	sockaddr_isequal(&serv->addr, addr))
+      break;
+
+  return serv;
+}
+
+#ifdef HAVE_IPSET
+/* The ipset list does not change after start-up. Of several entries
+   for the same domain, the last in daemon->ipsets wins. */
+void build_ipset_trie(void)
+{
+  struct ipsets *ipset_pos;
+
+  if (!dtrie_reset(&ipset_trie))
+    return;
+
+  for (ipset_pos = daemon->ipsets; ipset_pos; ipset_pos = ipset_pos->next)
+    {
+      int node = dtrie_insert(&ipset_trie, ipset_pos->domain);
+
+      if (node == -1)
+	return;
+
+      ipset_trie.nodes[node].data = ipset_pos;
+    }
+
+  ipset_trie_ok = 1;
+}
+
+/* Entry for the longest configured domain which is a suffix of name. */
+struct ipsets *match_ipsets(char *name)
+{
+  unsigned int path[MAXNAMELABELS + 1];
+  struct ipsets *ipset_pos, *ret = NULL;
+  unsigned int namelen, matchlen = 0;
+  int n;
+
+  if (ipset_trie_ok)
+    return (n = dtrie_match(&ipset_trie, name, path)) ? ipset_trie.nodes[path[n-1]].data : NULL;
+
+  namelen = strlen(name);
+  for (ipset_pos = daemon->ipsets; ipset_pos; ipset_pos = ipset_pos->next)
+    {
+      unsigned int domainlen = strlen(ipset_pos->domain);
+      char *matchstart = name + namelen - domainlen;
+      if (namelen >= domainlen && hostname_isequal(matchstart, ipset_pos->domain) &&
+	  (domainlen == 0 || namelen == domainlen || *(matchstart - 1) == '.' ) &&
+	  domainlen >= matchlen)
+	{
+	  matchlen = domainlen;
+	  ret = ipset_pos;
+	}
+    }
+
+  return ret;
+}
+#endif
@@ -108,15 +108,18 @@ static unsigned int search_servers(time_t now, union all_addr **addrpp, unsigned
 {
   /* If the query ends in the domain in one of our servers, set
      domain to point to that name. We find the largest match to allow both
-     domain.org and sub.domain.org to exist. */
+     domain.org and sub.domain.org to exist. Only servers which can
+     match are visited, in list order, see domain-trie.c */
   
   unsigned int namelen = strlen(qdomain);
   unsigned int matchlen = 0;
   struct server *serv;
+  struct server_match m;
   unsigned int flags = 0;
   static union all_addr zero;
   
-  for (serv = daemon->servers; serv; serv=serv->next)
+  match_servers(&m, qdomain);
+  while ((serv = next_server_match(&m)))
     if (qtype == F_DNSSECOK && !(serv->flags & SERV_DO_DNSSEC))
       continue;
     /* domain matches take priority over NODOTS matches */
@@ -250,7 +253,7 @@ static int forward_query(int udpfd, union mysockaddr *udpaddr,
   union all_addr *addrp = NULL;
   unsigned int flags = 0;
   unsigned int fwd_flags = 0;
-  struct server *start = NULL;
+  struct server *start = NULL, *group = NULL;
   void *hash = hash_questions(header, plen, daemon->namebuff);
 #ifdef HAVE_DNSSEC
   int do_dnssec = 0;
@@ -336,7 +339,10 @@ static int forward_query(int udpfd, union mysockaddr *udpaddr,
       do_dnssec = forward->sentto->flags & SERV_DO_DNSSEC;
 #endif
 
-      if (!(start = forward->sentto->next))
+      /* servers of one type and domain are chained, see domain-trie.c */
+      if ((group = server_group(type, domain)))
+	start = forward->sentto->domain_next ? forward->sentto->domain_next : group;
+      else if (!(start = forward->sentto->next))
 	start = daemon->servers; /* at end of list, recycle */
       header->id = htons(forward->new_id);
     }
@@ -439,6 +445,10 @@ static int forward_query(int udpfd, union mysockaddr *udpaddr,
 	      if (!option_bool(OPT_ORDER))
 		forward->forwardall = 1;
 	    }
+
+	  /* skip straight to the first server which can take the query */
+	  if ((group = server_group(type, domain)) && start == daemon->servers)
+	    start = group;
 	}
     }
 
@@ -587,7 +597,9 @@ static int forward_query(int udpfd, union mysockaddr *udpaddr,
 		}
 	    } 
 	  
-	  if (!(start = start->next))
+	  if (group)
+	    start = start->domain_next ? start->domain_next : group;
+	  else if (!(start = start->next))
  	    start = daemon->servers;
 	  
 	  if (start == firstsentto)
@@ -631,22 +643,9 @@ static size_t process_reply(struct dns_header *header, time_t now, struct server
 #ifdef HAVE_IPSET
   if (daemon->ipsets && extract_request(header, n, daemon->namebuff, NULL))
     {
-      /* Similar algorithm to search_servers. */
-      struct ipsets *ipset_pos;
-      unsigned int namelen = strlen(daemon->namebuff);
-      unsigned int matchlen = 0;
-      for (ipset_pos = daemon->ipsets; ipset_pos; ipset_pos = ipset_pos->next) 
-	{
-	  unsigned int domainlen = strlen(ipset_pos->domain);
-	  char *matchstart = daemon->namebuff + namelen - domainlen;
-	  if (namelen >= domainlen && hostname_isequal(matchstart, ipset_pos->domain) &&
-	      (domainlen == 0 || namelen == domainlen || *(matchstart - 1) == '.' ) &&
-	      domainlen >= matchlen) 
-	    {
-	      matchlen = domainlen;
-	      sets = ipset_pos->sets;
-	    }
-	}
+      struct ipsets *ipset_pos = match_ipsets(daemon->namebuff);
+      if (ipset_pos)
+	sets = ipset_pos->sets;
     }
 #endif
 
@@ -826,10 +825,7 @@ void reply_query(int fd, int family, time_t now)
     return;
   
   /* spoof check: answer must come from known server, */
-  for (server = daemon->servers; server; server = server->next)
-    if (!(server->flags & (SERV_LITERAL_ADDRESS | SERV_NO_ADDR)) &&
-	sockaddr_isequal(&server->addr, &serveraddr))
-      break;
+  server = lookup_server_addr(&serveraddr);
   
   if (!server)
     if (serveraddr.sa.sa_family == AF_INET ? (serveraddr.in.sin_addr.s_addr != INADDR_ANY && htonl(serveraddr.in.sin_addr.s_addr) != INADDR_LOOPBACK) : (memcmp(&serveraddr.in6.sin6_addr, &in6addr_any, sizeof(in6addr_any)) && memcmp(&serveraddr.in6.sin6_addr, &in6addr_loopback, sizeof(in6addr_loopback))))
@@ -972,10 +968,11 @@ void reply_query(int fd, int family, time_t now)
 	server = NULL;
       else
 	{
-	  struct server *last_server;
+	  struct server *last_server, *group = server_group(0, NULL);
 	  
 	  /* find good server by address if possible, otherwise assume the last one we sent to */ 
-	  for (last_server = daemon->servers; last_server; last_server = last_server->next)
+	  for (last_server = group ? group : daemon->servers; last_server;
+	       last_server = group ? last_server->domain_next : last_server->next)
 	    if (!(last_server->flags & (SERV_LITERAL_ADDRESS | SERV_HAS_DOMAIN | SERV_FOR_NODOTS | SERV_NO_ADDR)) &&
 		sockaddr_isequal(&last_server->addr, &serveraddr))
 	      {
@@ -1812,7 +1809,7 @@ unsigned char *tcp_request(int confd, time_t now,
   /* largest field in header is 16-bits, so this is still sufficiently aligned */
   struct dns_header *header = (struct dns_header *)payload;
   u16 *length = (u16 *)packet;
-  struct server *last_server;
+  struct server *last_server, *group;
   struct in_addr dst_addr_4;
   union mysockaddr peer_addr;
   socklen_t peer_len = sizeof(union mysockaddr);
@@ -2000,6 +1997,9 @@ unsigned char *tcp_request(int confd, time_t now,
 		last_server = daemon->servers;
 	      else
 		last_server = daemon->last_server;
+
+	      if ((group = server_group(type, domain)) && last_server == daemon->servers)
+		last_server = group;
 	      
 	      if (!flags && last_server)
 		{
@@ -2016,7 +2016,9 @@ unsigned char *tcp_request(int confd, time_t now,
 			firstsendto = last_server;
 		      else
 			{
-			  if (!(last_server = last_server->next))
+			  if (group)
+			    last_server = last_server->domain_next ? last_server->domain_next : group;
+			  else if (!(last_server = last_server->next))
 			    last_server = daemon->servers;
 			  
 			  if (last_server == firstsendto)
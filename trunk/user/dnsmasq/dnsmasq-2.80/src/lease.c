@@ -20,6 +20,153 @@
 
 static struct dhcp_lease *leases = NULL, *old_leases = NULL;
 static int dns_dirty, file_dirty, leases_left;
+static time_t file_written;
+static int file_write_held; /* file_written is less than LEASE_WRITE_DELAY ago */
+
+/* Leases in the list with an old_hostname or a change still to report,
+   do_script_run() resumes its scans for them here: no lease nearer the
+   head of the list has anything to report. */
+static int names_pending, changes_pending;
+static struct dhcp_lease *name_scan, *change_scan;
+
+/* No lease expires before this, zero if none expires. Renewals can leave
+   it early, the next full walk in lease_prune() makes it exact again. */
+static time_t expiry_floor;
+
+/* Hash indices over the leases list, by address, by client-id and by
+   hardware address. Several leases may share a key, in which case the
+   lookups return the one nearest the head of the list, as the list walks
+   they replace did. Leases are only ever added at the head, so that is
+   the one with the highest seq. */
+static struct dhcp_lease **addr_hash, **clid_hash, **hwaddr_hash;
+static unsigned int lease_hash_mask, lease_seq;
+
+#define CHAIN_NEXT(lease, off) (*(struct dhcp_lease **)((char *)(lease) + (off)))
+
+static unsigned int hash_bytes(const unsigned char *p, int len, unsigned int h)
+{
+  while (len-- > 0)
+    h = (h ^ *p++) * 16777619u;
+
+  return h;
+}
+
+static struct dhcp_lease **addr4_bucket(struct in_addr addr)
+{
+  return &addr_hash[hash_bytes((unsigned char *)&addr, sizeof(addr), 2166136261u) & lease_hash_mask];
+}
+
+#ifdef HAVE_DHCP6
+static struct dhcp_lease **addr6_bucket(struct in6_addr *addr)
+{
+  return &addr_hash[hash_bytes((unsigned char *)addr, IN6ADDRSZ, 2166136261u) & lease_hash_mask];
+}
+#endif
+
+static struct dhcp_lease **clid_bucket(unsigned char *clid, int clid_len)
+{
+  return &clid_hash[hash_bytes(clid, clid_len, 2166136261u) & lease_hash_mask];
+}
+
+static struct dhcp_lease **hwaddr_bucket(const unsigned char *hwaddr, int hw_len, int hw_type)
+{
+  return &hwaddr_hash[hash_bytes(hwaddr, hw_len, 2166136261u ^ hw_type) & lease_hash_mask];
+}
+
+static void chain_link(struct dhcp_lease **bucket, struct dhcp_lease *lease, size_t off)
+{
+  CHAIN_NEXT(lease, off) = *bucket;
+  *bucket = lease;
+}
+
+static void chain_unlink(struct dhcp_lease **up, struct dhcp_lease *lease, size_t off)
+{
+  for (; *up; up = &CHAIN_NEXT(*up, off))
+    if (*up == lease)
+      {
+	*up = CHAIN_NEXT(lease, off);
+	break;
+      }
+}
+
+static struct dhcp_lease **lease_addr_bucket(struct dhcp_lease *lease)
+{
+#ifdef HAVE_DHCP6
+  if (lease->flags & (LEASE_TA | LEASE_NA))
+    return addr6_bucket(&lease->addr6);
+#endif
+  return addr4_bucket(lease->addr);
+}
+
+/* Index by client-id and hardware address, which lease_set_hwaddr() changes. */
+static void lease_hash_client(struct dhcp_lease *lease)
+{
+  if (lease->clid && lease->clid_len > 0)
+    chain_link(clid_bucket(lease->clid, lease->clid_len), lease, offsetof(struct dhcp_lease, clid_next));
+
+  if (lease->hwaddr_len > 0 && lease->hwaddr_len <= DHCP_CHADDR_MAX)
+    chain_link(hwaddr_bucket(lease->hwaddr, lease->hwaddr_len, lease->hwaddr_type),
+	       lease, offsetof(struct dhcp_lease, hwaddr_next));
+}
+
+static void lease_unhash_client(struct dhcp_lease *lease)
+{
+  if (lease->clid && lease->clid_len > 0)
+    chain_unlink(clid_bucket(lease->clid, lease->clid_len), lease, offsetof(struct dhcp_lease, clid_next));
+
+  if (lease->hwaddr_len > 0 && lease->hwaddr_len <= DHCP_CHADDR_MAX)
+    chain_unlink(hwaddr_bucket(lease->hwaddr, lease->hwaddr_len, lease->hwaddr_type),
+		 lease, offsetof(struct dhcp_lease, hwaddr_next));
+}
+
+/* The lease has something for do_script_run(), move the scan back to
+   it if it is nearer the head of the list. */
+static void script_pending(struct dhcp_lease **scan, struct dhcp_lease *lease)
+{
+  if (!*scan || lease->seq > (*scan)->seq)
+    *scan = lease;
+}
+
+static int script_wanted(struct dhcp_lease *lease)
+{
+  return (lease->flags & (LEASE_NEW | LEASE_CHANGED)) || 
+    ((lease->flags & LEASE_AUX_CHANGED) && option_bool(OPT_LEASE_RO));
+}
+
+static void lease_script_flags(struct dhcp_lease *lease, int flags)
+{
+  if (!script_wanted(lease))
+    {
+      lease->flags |= flags;
+      if (script_wanted(lease))
+	{
+	  changes_pending++;
+	  script_pending(&change_scan, lease);
+	}
+    }
+  else
+    lease->flags |= flags;
+}
+
+static void lease_script_clear(struct dhcp_lease *lease, int flags)
+{
+  if (script_wanted(lease))
+    {
+      lease->flags &= ~flags;
+      if (!script_wanted(lease))
+	changes_pending--;
+    }
+  else
+    lease->flags &= ~flags;
+}
+
+/* Something which goes into the leasefile changed. */
+static void lease_file_changed(struct dhcp_lease *lease)
+{
+  file_dirty = 1;
+  free(lease->file_line);
+  lease->file_line = NULL;
+}
 
 static int read_leases(time_t now, FILE *leasestream)
 {
@@ -132,7 +279,7 @@ static int read_leases(time_t now, FILE *leasestream)
 	
 	/* set these correctly: the "old" events are generated later from
 	   the startup synthesised SIGHUP. */
-	lease->flags &= ~(LEASE_NEW | LEASE_CHANGED);
+	lease_script_clear(lease, LEASE_NEW | LEASE_CHANGED);
 	
 	*daemon->dhcp_buff3 = *daemon->dhcp_buff2 = '\0';
       }
@@ -146,6 +293,12 @@ void lease_init(time_t now)
 
   leases_left = daemon->dhcp_max;
 
+  for (lease_hash_mask = 15; lease_hash_mask < (unsigned int)daemon->dhcp_max && lease_hash_mask < 0xffff; )
+    lease_hash_mask = (lease_hash_mask << 1) | 1;
+  addr_hash = safe_malloc((lease_hash_mask + 1) * sizeof(struct dhcp_lease *));
+  clid_hash = safe_malloc((lease_hash_mask + 1) * sizeof(struct dhcp_lease *));
+  hwaddr_hash = safe_malloc((lease_hash_mask + 1) * sizeof(struct dhcp_lease *));
+
   if (option_bool(OPT_LEASE_RO))
     {
       /* run "<lease_change_script> init" once to get the
@@ -248,101 +401,152 @@ static void ourprintf(int *errp, char *format, ...)
   va_end(ap);
 }
 
-void lease_update_file(time_t now)
+static unsigned int lease_format(struct dhcp_lease *lease, char *buf)
 {
-  struct dhcp_lease *lease;
-  time_t next_event;
-  int i, err = 0;
+  char *p = buf;
+  int i;
 
-  if (file_dirty != 0 && daemon->lease_stream)
-    {
-      errno = 0;
-      rewind(daemon->lease_stream);
-      if (errno != 0 || ftruncate(fileno(daemon->lease_stream), 0) != 0)
-	err = errno;
-      
-      for (lease = leases; lease; lease = lease->next)
-	{
+#ifdef HAVE_BROKEN_RTC
+  p += sprintf(p, "%u ", lease->length);
+#else
+  p += sprintf(p, "%lu ", (unsigned long)lease->expires);
+#endif
 
 #ifdef HAVE_DHCP6
-	  if (lease->flags & (LEASE_TA | LEASE_NA))
-	    continue;
+  if (lease->flags & (LEASE_TA | LEASE_NA))
+    {
+      inet_ntop(AF_INET6, &lease->addr6, daemon->addrbuff, ADDRSTRLEN);
+      p += sprintf(p, "%s%u %s ", (lease->flags & LEASE_TA) ? "T" : "",
+		   lease->iaid, daemon->addrbuff);
+    }
+  else
 #endif
+    {
+      if (lease->hwaddr_type != ARPHRD_ETHER || lease->hwaddr_len == 0) 
+	p += sprintf(p, "%.2x-", lease->hwaddr_type);
+      for (i = 0; i < lease->hwaddr_len; i++)
+	{
+	  p += sprintf(p, "%.2x", lease->hwaddr[i]);
+	  if (i != lease->hwaddr_len - 1)
+	    *p++ = ':';
+	}
+      
+      inet_ntop(AF_INET, &lease->addr, daemon->addrbuff, ADDRSTRLEN); 
+      p += sprintf(p, " %s ", daemon->addrbuff);
+    }
 
-#ifdef HAVE_BROKEN_RTC
-	  ourprintf(&err, "%u ", lease->length);
-#else
-	  ourprintf(&err, "%lu ", (unsigned long)lease->expires);
-#endif
+  p += sprintf(p, "%s ", lease->hostname ? lease->hostname : "*");
+  
+  if (lease->clid && lease->clid_len != 0)
+    {
+      for (i = 0; i < lease->clid_len - 1; i++)
+	p += sprintf(p, "%.2x:", lease->clid[i]);
+      p += sprintf(p, "%.2x\n", lease->clid[i]);
+    }
+  else
+    p += sprintf(p, "*\n");
 
-	  if (lease->hwaddr_type != ARPHRD_ETHER || lease->hwaddr_len == 0) 
-	    ourprintf(&err, "%.2x-", lease->hwaddr_type);
-	  for (i = 0; i < lease->hwaddr_len; i++)
-	    {
-	      ourprintf(&err, "%.2x", lease->hwaddr[i]);
-	      if (i != lease->hwaddr_len - 1)
-		ourprintf(&err, ":");
-	    }
-	  
-	  inet_ntop(AF_INET, &lease->addr, daemon->addrbuff, ADDRSTRLEN); 
+  return p - buf;
+}
 
-	  ourprintf(&err, " %s ", daemon->addrbuff);
-	  ourprintf(&err, "%s ", lease->hostname ? lease->hostname : "*");
-	  	  
-	  if (lease->clid && lease->clid_len != 0)
-	    {
-	      for (i = 0; i < lease->clid_len - 1; i++)
-		ourprintf(&err, "%.2x:", lease->clid[i]);
-	      ourprintf(&err, "%.2x\n", lease->clid[i]);
-	    }
-	  else
-	    ourprintf(&err, "*\n");	  
-	}
+/* Records are formatted once and kept until the lease changes, so a
+   rewrite only formats the leases which changed since the last one. */
+static void lease_write(int *errp, struct dhcp_lease *lease)
+{
+  if (!lease->file_line)
+    {
+      /* expiry, hwaddr or iaid, address, hostname, client-id */
+      size_t max = 48 + 3 * lease->hwaddr_len + ADDRSTRLEN + 3 * lease->clid_len +
+	(lease->hostname ? strlen(lease->hostname) : 1);
       
-#ifdef HAVE_DHCP6  
-      if (daemon->duid)
+      if (!(lease->file_line = whine_malloc(max)))
 	{
-	  ourprintf(&err, "duid ");
-	  for (i = 0; i < daemon->duid_len - 1; i++)
-	    ourprintf(&err, "%.2x:", daemon->duid[i]);
-	  ourprintf(&err, "%.2x\n", daemon->duid[i]);
-	  
-	  for (lease = leases; lease; lease = lease->next)
-	    {
-	      
-	      if (!(lease->flags & (LEASE_TA | LEASE_NA)))
-		continue;
+	  if (!(*errp))
+	    *errp = ENOMEM;
+	  return;
+	}
+      lease->file_line_len = lease_format(lease, lease->file_line);
+    }
 
-#ifdef HAVE_BROKEN_RTC
-	      ourprintf(&err, "%u ", lease->length);
-#else
-	      ourprintf(&err, "%lu ", (unsigned long)lease->expires);
+  if (!(*errp) && 
+      fwrite(lease->file_line, 1, lease->file_line_len, daemon->lease_stream) != lease->file_line_len)
+    *errp = errno;
+}
+
+static int lease_write_file(void)
+{
+  struct dhcp_lease *lease;
+  int i, err = 0;
+
+  errno = 0;
+  rewind(daemon->lease_stream);
+  if (errno != 0 || ftruncate(fileno(daemon->lease_stream), 0) != 0)
+    err = errno;
+  
+  for (lease = leases; lease; lease = lease->next)
+    {
+#ifdef HAVE_DHCP6
+      if (lease->flags & (LEASE_TA | LEASE_NA))
+	continue;
 #endif
-    
-	      inet_ntop(AF_INET6, &lease->addr6, daemon->addrbuff, ADDRSTRLEN);
-	 
-	      ourprintf(&err, "%s%u %s ", (lease->flags & LEASE_TA) ? "T" : "",
-			lease->iaid, daemon->addrbuff);
-	      ourprintf(&err, "%s ", lease->hostname ? lease->hostname : "*");
-	      
-	      if (lease->clid && lease->clid_len != 0)
-		{
-		  for (i = 0; i < lease->clid_len - 1; i++)
-		    ourprintf(&err, "%.2x:", lease->clid[i]);
-		  ourprintf(&err, "%.2x\n", lease->clid[i]);
-		}
-	      else
-		ourprintf(&err, "*\n");	  
-	    }
-	}
+      lease_write(&err, lease);
+    }
+  
+#ifdef HAVE_DHCP6  
+  if (daemon->duid)
+    {
+      ourprintf(&err, "duid ");
+      for (i = 0; i < daemon->duid_len - 1; i++)
+	ourprintf(&err, "%.2x:", daemon->duid[i]);
+      ourprintf(&err, "%.2x\n", daemon->duid[i]);
+      
+      for (lease = leases; lease; lease = lease->next)
+	if (lease->flags & (LEASE_TA | LEASE_NA))
+	  lease_write(&err, lease);
+    }
+#else
+  (void)i;
 #endif      
-	  
-      if (fflush(daemon->lease_stream) != 0 ||
-	  fsync(fileno(daemon->lease_stream)) < 0)
-	err = errno;
+  
+  if (fflush(daemon->lease_stream) != 0 ||
+      fsync(fileno(daemon->lease_stream)) < 0)
+    err = errno;
+  
+  if (!err)
+    file_dirty = 0;
+
+  return err;
+}
+
+/* Write out pending changes now, ignoring LEASE_WRITE_DELAY. */
+void lease_flush_file(void)
+{
+  if (file_dirty != 0 && daemon->lease_stream)
+    lease_write_file();
+}
+
+void lease_update_file(time_t now)
+{
+  time_t next_event;
+  int err = 0;
+
+  /* A burst of DHCP traffic changes leases on every packet. Coalesce
+     the rewrites, the alarm below brings us back for deferred ones.
+     The clock may step back (NTP sync after boot, time set by hand),
+     then the last write time is in the future: don't wait for it. */
+  if (file_write_held)
+    {
+      double since = difftime(now, file_written);
       
-      if (!err)
-	file_dirty = 0;
+      if (since < 0.0 || since >= LEASE_WRITE_DELAY)
+	file_write_held = 0;
+    }
+
+  if (file_dirty != 0 && daemon->lease_stream && !file_write_held)
+    {
+      err = lease_write_file();
+      file_written = now;
+      file_write_held = 1;
     }
   
   /* Set alarm for when the first lease expires. */
@@ -368,10 +572,16 @@ void lease_update_file(time_t now)
     }
 #endif
 
-  for (lease = leases; lease; lease = lease->next)
-    if (lease->expires != 0 &&
-	(next_event == 0 || difftime(next_event, lease->expires) > 0.0))
-      next_event = lease->expires;
+  if (expiry_floor != 0 &&
+      (next_event == 0 || difftime(next_event, expiry_floor) > 0.0))
+    next_event = expiry_floor;
+
+  if (file_dirty != 0 && daemon->lease_stream && !err)
+    {
+      time_t deferred = file_written + LEASE_WRITE_DELAY;
+      if (next_event == 0 || difftime(next_event, deferred) > 0.0)
+	next_event = deferred;
+    }
    
   if (err)
     {
@@ -555,6 +765,11 @@ void lease_prune(struct dhcp_lease *target, time_t now)
 {
   struct dhcp_lease *lease, *tmp, **up;
 
+  if (!target && (expiry_floor == 0 || difftime(now, expiry_floor) <= 0))
+    return;
+
+  expiry_floor = 0;
+
   for (lease = leases, up = &leases; lease; lease = tmp)
     {
       tmp = lease->next;
@@ -567,6 +782,16 @@ void lease_prune(struct dhcp_lease *target, time_t now)
 	  daemon->metrics[lease->addr.s_addr ? METRIC_LEASES_PRUNED_4 : METRIC_LEASES_PRUNED_6]++;
 
  	  *up = lease->next; /* unlink */
+	  chain_unlink(lease_addr_bucket(lease), lease, offsetof(struct dhcp_lease, addr_next));
+	  lease_unhash_client(lease);
+	  if (lease->old_hostname)
+	    names_pending--;
+	  if (script_wanted(lease))
+	    changes_pending--;
+	  if (name_scan == lease)
+	    name_scan = tmp;
+	  if (change_scan == lease)
+	    change_scan = tmp;
 	  
 	  /* Put on old_leases list 'till we
 	     can run the script */
@@ -576,7 +801,12 @@ void lease_prune(struct dhcp_lease *target, time_t now)
 	  leases_left++;
 	}
       else
-	up = &lease->next;
+	{
+	  if (lease->expires != 0 &&
+	      (expiry_floor == 0 || difftime(expiry_floor, lease->expires) > 0.0))
+	    expiry_floor = lease->expires;
+	  up = &lease->next;
+	}
     }
 } 
 	
@@ -584,52 +814,64 @@ void lease_prune(struct dhcp_lease *target, time_t now)
 struct dhcp_lease *lease_find_by_client(unsigned char *hwaddr, int hw_len, int hw_type,
 					unsigned char *clid, int clid_len)
 {
-  struct dhcp_lease *lease;
+  struct dhcp_lease *lease, *found = NULL;
 
-  if (clid)
-    for (lease = leases; lease; lease = lease->next)
+  if (!clid_hash)
+    return NULL;
+
+  if (clid && clid_len > 0)
+    for (lease = *clid_bucket(clid, clid_len); lease; lease = lease->clid_next)
       {
 #ifdef HAVE_DHCP6
 	if (lease->flags & (LEASE_TA | LEASE_NA))
 	  continue;
 #endif
 	if (lease->clid && clid_len == lease->clid_len &&
-	    memcmp(clid, lease->clid, clid_len) == 0)
-	  return lease;
+	    memcmp(clid, lease->clid, clid_len) == 0 &&
+	    (!found || lease->seq > found->seq))
+	  found = lease;
       }
+
+  if (found)
+    return found;
   
-  for (lease = leases; lease; lease = lease->next)	
-    {
+  if (hw_len > 0 && hw_len <= DHCP_CHADDR_MAX)
+    for (lease = *hwaddr_bucket(hwaddr, hw_len, hw_type); lease; lease = lease->hwaddr_next)
+      {
 #ifdef HAVE_DHCP6
-      if (lease->flags & (LEASE_TA | LEASE_NA))
-	continue;
+	if (lease->flags & (LEASE_TA | LEASE_NA))
+	  continue;
 #endif   
-      if ((!lease->clid || !clid) && 
-	  hw_len != 0 && 
-	  lease->hwaddr_len == hw_len &&
-	  lease->hwaddr_type == hw_type &&
-	  memcmp(hwaddr, lease->hwaddr, hw_len) == 0)
-	return lease;
-    }
+	if ((!lease->clid || !clid) && 
+	    lease->hwaddr_len == hw_len &&
+	    lease->hwaddr_type == hw_type &&
+	    memcmp(hwaddr, lease->hwaddr, hw_len) == 0 &&
+	    (!found || lease->seq > found->seq))
+	  found = lease;
+      }
 
-  return NULL;
+  return found;
 }
 
 struct dhcp_lease *lease_find_by_addr(struct in_addr addr)
 {
-  struct dhcp_lease *lease;
+  struct dhcp_lease *lease, *found = NULL;
 
-  for (lease = leases; lease; lease = lease->next)
+  if (!addr_hash)
+    return NULL;
+
+  for (lease = *addr4_bucket(addr); lease; lease = lease->addr_next)
     {
 #ifdef HAVE_DHCP6
       if (lease->flags & (LEASE_TA | LEASE_NA))
 	continue;
 #endif  
-      if (lease->addr.s_addr == addr.s_addr)
-	return lease;
+      if (lease->addr.s_addr == addr.s_addr &&
+	  (!found || lease->seq > found->seq))
+	found = lease;
     }
 
-  return NULL;
+  return found;
 }
 
 #ifdef HAVE_DHCP6
@@ -637,9 +879,12 @@ struct dhcp_lease *lease_find_by_addr(struct in_addr addr)
 struct dhcp_lease *lease6_find(unsigned char *clid, int clid_len, 
 			       int lease_type, int iaid, struct in6_addr *addr)
 {
-  struct dhcp_lease *lease;
+  struct dhcp_lease *lease, *found = NULL;
   
-  for (lease = leases; lease; lease = lease->next)
+  if (!addr_hash)
+    return NULL;
+
+  for (lease = *addr6_bucket(addr); lease; lease = lease->addr_next)
     {
       if (!(lease->flags & lease_type) || lease->iaid != iaid)
 	continue;
@@ -651,10 +896,11 @@ struct dhcp_lease *lease6_find(unsigned char *clid, int clid_len,
 	   memcmp(clid, lease->clid, clid_len) != 0))
 	continue;
       
-      return lease;
+      if (!found || lease->seq > found->seq)
+	found = lease;
     }
   
-  return NULL;
+  return found;
 }
 
 /* reset "USED flags */
@@ -669,7 +915,30 @@ void lease6_reset(void)
 /* enumerate all leases belonging to {CLID, IAID} */
 struct dhcp_lease *lease6_find_by_client(struct dhcp_lease *first, int lease_type, unsigned char *clid, int clid_len, int iaid)
 {
-  struct dhcp_lease *lease;
+  struct dhcp_lease *lease, *found = NULL;
+
+  /* Enumerate in list order, that is descending seq, starting below first. */
+  if (clid_hash && clid && clid_len > 0)
+    {
+      for (lease = *clid_bucket(clid, clid_len); lease; lease = lease->clid_next)
+	{
+	  if (lease->flags & LEASE_USED)
+	    continue;
+	  
+	  if (!(lease->flags & lease_type) || lease->iaid != iaid)
+	    continue;
+	  
+	  if ((clid_len != lease->clid_len ||
+	       memcmp(clid, lease->clid, clid_len) != 0))
+	    continue;
+	  
+	  if ((!first || lease->seq < first->seq) &&
+	      (!found || lease->seq > found->seq))
+	    found = lease;
+	}
+      
+      return found;
+    }
 
   if (!first)
     first = leases;
@@ -696,7 +965,30 @@ struct dhcp_lease *lease6_find_by_client(struct dhcp_lease *first, int lease_typ
 
 struct dhcp_lease *lease6_find_by_addr(struct in6_addr *net, int prefix, u64 addr)
 {
-  struct dhcp_lease *lease;
+  struct dhcp_lease *lease, *found = NULL;
+  struct in6_addr key;
+
+  /* The address is fully determined for /128 and /64, other prefixes
+     still need the walk. */
+  if (addr_hash && (prefix == 128 || prefix == 64))
+    {
+      key = *net;
+      if (prefix == 64)
+	setaddr6part(&key, addr);
+      
+      for (lease = *addr6_bucket(&key); lease; lease = lease->addr_next)
+	{
+	  if (!(lease->flags & (LEASE_TA | LEASE_NA)))
+	    continue;
+	  
+	  if (is_same_net6(&lease->addr6, net, prefix) &&
+	      (prefix == 128 || addr6part(&lease->addr6) == addr) &&
+	      (!found || lease->seq > found->seq))
+	    found = lease;
+	}
+      
+      return found;
+    }
     
   for (lease = leases; lease; lease = lease->next)
     {
@@ -764,12 +1056,14 @@ static struct dhcp_lease *lease_allocate(void)
     return NULL;
 
   memset(lease, 0, sizeof(struct dhcp_lease));
-  lease->flags = LEASE_NEW;
   lease->expires = 1;
+  expiry_floor = 1;
 #ifdef HAVE_BROKEN_RTC
   lease->length = 0xffffffff; /* illegal value */
 #endif
   lease->hwaddr_len = 256; /* illegal value */
+  lease->seq = lease_seq++;
+  lease_script_flags(lease, LEASE_NEW);
   lease->next = leases;
   leases = lease;
   
@@ -785,6 +1079,7 @@ struct dhcp_lease *lease4_allocate(struct in_addr addr)
   if (lease)
     {
       lease->addr = addr;
+      chain_link(addr4_bucket(addr), lease, offsetof(struct dhcp_lease, addr_next));
       daemon->metrics[METRIC_LEASES_ALLOCATED_4]++;
     }
   
@@ -801,6 +1096,7 @@ struct dhcp_lease *lease6_allocate(struct in6_addr *addrp, int lease_type)
       lease->addr6 = *addrp;
       lease->flags |= lease_type;
       lease->iaid = 0;
+      chain_link(addr6_bucket(addrp), lease, offsetof(struct dhcp_lease, addr_next));
 
       daemon->metrics[METRIC_LEASES_ALLOCATED_6]++;
     }
@@ -832,9 +1128,11 @@ void lease_set_expires(struct dhcp_lease *lease, unsigned int len, time_t now)
     {
       dns_dirty = 1;
       lease->expires = exp;
+      if (exp != 0 && (expiry_floor == 0 || difftime(expiry_floor, exp) > 0.0))
+	expiry_floor = exp;
 #ifndef HAVE_BROKEN_RTC
-      lease->flags |= LEASE_AUX_CHANGED;
-      file_dirty = 1;
+      lease_script_flags(lease, LEASE_AUX_CHANGED);
+      lease_file_changed(lease);
 #endif
     }
   
@@ -842,8 +1140,8 @@ void lease_set_expires(struct dhcp_lease *lease, unsigned int len, time_t now)
   if (len != lease->length)
     {
       lease->length = len;
-      lease->flags |= LEASE_AUX_CHANGED;
-      file_dirty = 1; 
+      lease_script_flags(lease, LEASE_AUX_CHANGED);
+      lease_file_changed(lease);
     }
 #endif
 } 
@@ -854,7 +1152,8 @@ void lease_set_iaid(struct dhcp_lease *lease, int iaid)
   if (lease->iaid != iaid)
     {
       lease->iaid = iaid;
-      lease->flags |= LEASE_CHANGED;
+      lease_script_flags(lease, LEASE_CHANGED);
+      lease_file_changed(lease);
     }
 }
 #endif
@@ -871,6 +1170,8 @@ void lease_set_hwaddr(struct dhcp_lease *lease, const unsigned char *hwaddr,
   (void)force;
   (void)now;
 
+  lease_unhash_client(lease);
+
   if (hw_len != lease->hwaddr_len ||
       hw_type != lease->hwaddr_type || 
       (hw_len != 0 && memcmp(lease->hwaddr, hwaddr, hw_len) != 0))
@@ -879,8 +1180,8 @@ void lease_set_hwaddr(struct dhcp_lease *lease, const unsigned char *hwaddr,
 	memcpy(lease->hwaddr, hwaddr, hw_len);
       lease->hwaddr_len = hw_len;
       lease->hwaddr_type = hw_type;
-      lease->flags |= LEASE_CHANGED;
-      file_dirty = 1; /* run script on change */
+      lease_script_flags(lease, LEASE_CHANGED);
+      lease_file_changed(lease); /* run script on change */
     }
 
   /* only update clid when one is available, stops packets
@@ -893,19 +1194,22 @@ void lease_set_hwaddr(struct dhcp_lease *lease, const unsigned char *hwaddr,
 
       if (lease->clid_len != clid_len)
 	{
-	  lease->flags |= LEASE_AUX_CHANGED;
-	  file_dirty = 1;
+	  lease_script_flags(lease, LEASE_AUX_CHANGED);
+	  lease_file_changed(lease);
 	  free(lease->clid);
 	  if (!(lease->clid = whine_malloc(clid_len)))
-	    return;
+	    {
+	      lease_hash_client(lease);
+	      return;
+	    }
 #ifdef HAVE_DHCP6
 	  change = 1;
 #endif	   
 	}
       else if (memcmp(lease->clid, clid, clid_len) != 0)
 	{
-	  lease->flags |= LEASE_AUX_CHANGED;
-	  file_dirty = 1;
+	  lease_script_flags(lease, LEASE_AUX_CHANGED);
+	  lease_file_changed(lease);
 #ifdef HAVE_DHCP6
 	  change = 1;
 #endif	
@@ -914,6 +1218,8 @@ void lease_set_hwaddr(struct dhcp_lease *lease, const unsigned char *hwaddr,
       lease->clid_len = clid_len;
       memcpy(lease->clid, clid, clid_len);
     }
+
+  lease_hash_client(lease);
   
 #ifdef HAVE_DHCP6
   if (change)
@@ -941,6 +1247,24 @@ static void kill_name(struct dhcp_lease *lease)
     lease->old_hostname = lease->hostname;
 
   lease->hostname = lease->fqdn = NULL;
+  free(lease->file_line);
+  lease->file_line = NULL;
+}
+
+/* kill_name() for leases in the list, the old name gets reported. */
+static void lease_kill_name(struct dhcp_lease *lease)
+{
+  int had_old = lease->old_hostname != NULL;
+
+  kill_name(lease);
+
+  if (!had_old && lease->old_hostname)
+    {
+      names_pending++;
+      script_pending(&name_scan, lease);
+    }
+  else if (had_old && !lease->old_hostname)
+    names_pending--;
 }
 
 void lease_set_hostname(struct dhcp_lease *lease, const char *name, int auth, char *domain, char *config_domain)
@@ -1017,13 +1341,13 @@ void lease_set_hostname(struct dhcp_lease *lease, const char *name, int auth, ch
 	      return;
 	    }
 	
-	  kill_name(lease_tmp);
+	  lease_kill_name(lease_tmp);
 	  break;
 	}
     }
 
   if (lease->hostname)
-    kill_name(lease);
+    lease_kill_name(lease);
 
   lease->hostname = new_name;
   lease->fqdn = new_fqdn;
@@ -1031,9 +1355,9 @@ void lease_set_hostname(struct dhcp_lease *lease, const char *name, int auth, ch
   if (auth)
     lease->flags |= LEASE_AUTH_NAME;
   
-  file_dirty = 1;
+  lease_file_changed(lease);
   dns_dirty = 1; 
-  lease->flags |= LEASE_CHANGED; /* run script on change */
+  lease_script_flags(lease, LEASE_CHANGED); /* run script on change */
 }
 
 void lease_set_interface(struct dhcp_lease *lease, int interface, time_t now)
@@ -1044,7 +1368,7 @@ void lease_set_interface(struct dhcp_lease *lease, int interface, time_t now)
     return;
 
   lease->last_interface = interface;
-  lease->flags |= LEASE_CHANGED; 
+  lease_script_flags(lease, LEASE_CHANGED); 
 
 #ifdef HAVE_DHCP6
   slaac_add_addrs(lease, now, 0);
@@ -1056,7 +1380,12 @@ void rerun_scripts(void)
   struct dhcp_lease *lease;
   
   for (lease = leases; lease; lease = lease->next)
-    lease->flags |= LEASE_CHANGED; 
+    lease_script_flags(lease, LEASE_CHANGED); 
+}
+
+void lease_set_changed(struct dhcp_lease *lease)
+{
+  lease_script_flags(lease, LEASE_CHANGED);
 }
 
 /* deleted leases get transferred to the old_leases list.
@@ -1113,6 +1442,7 @@ int do_script_run(time_t now)
 	  free(lease->old_hostname); 
 	  free(lease->clid);
 	  free(lease->extradata);
+	  free(lease->file_line);
 	  free(lease);
 	    
 	  return 1; 
@@ -1120,7 +1450,7 @@ int do_script_run(time_t now)
     }
   
   /* make sure we announce the loss of a hostname before its new location. */
-  for (lease = leases; lease; lease = lease->next)
+  for (lease = names_pending ? name_scan : NULL; lease; lease = lease->next)
     if (lease->old_hostname)
       {	
 #ifdef HAVE_SCRIPT
@@ -1128,12 +1458,16 @@ int do_script_run(time_t now)
 #endif
 	free(lease->old_hostname);
 	lease->old_hostname = NULL;
+	names_pending--;
+	name_scan = lease->next;
 	return 1;
       }
   
-  for (lease = leases; lease; lease = lease->next)
-    if ((lease->flags & (LEASE_NEW | LEASE_CHANGED)) || 
-	((lease->flags & LEASE_AUX_CHANGED) && option_bool(OPT_LEASE_RO)))
+  names_pending = 0;
+  name_scan = NULL;
+
+  for (lease = changes_pending ? change_scan : NULL; lease; lease = lease->next)
+    if (script_wanted(lease))
       {
 #ifdef HAVE_SCRIPT
 	queue_script((lease->flags & LEASE_NEW) ? ACTION_ADD : ACTION_OLD, lease, 
@@ -1143,15 +1477,19 @@ int do_script_run(time_t now)
 	emit_dbus_signal((lease->flags & LEASE_NEW) ? ACTION_ADD : ACTION_OLD, lease,
 			 lease->fqdn ? lease->fqdn : lease->hostname);
 #endif
-	lease->flags &= ~(LEASE_NEW | LEASE_CHANGED | LEASE_AUX_CHANGED);
+	lease_script_clear(lease, LEASE_NEW | LEASE_CHANGED | LEASE_AUX_CHANGED);
 	
 	/* this is used for the "add" call, then junked, since they're not in the database */
 	free(lease->extradata);
 	lease->extradata = NULL;
 	
+	change_scan = lease->next;
 	return 1;
       }
 
+  changes_pending = 0;
+  change_scan = NULL;
+
   return 0; /* nothing to do */
 }
 
@@ -1340,6 +1340,8 @@ void cleanup_servers(void)
        up = &serv->next;
     }
 
+  build_server_trie();
+
 #ifdef HAVE_LOOP
   /* Now we have a new set of servers, test for loops. */
   loop_send_probes();
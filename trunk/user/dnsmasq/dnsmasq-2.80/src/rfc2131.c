@@ -1335,7 +1335,7 @@ size_t dhcp_reply(struct dhcp_context *context, char *iface_name, int int_index,
 	  if (do_classes)
 	    {
 	      /* pick up INIT-REBOOT events. */
-	      lease->flags |= LEASE_CHANGED;
+	      lease_set_changed(lease);
 
 #ifdef HAVE_SCRIPT
 	      if (daemon->lease_change_command)
@@ -1886,7 +1886,7 @@ static void update_leases(struct state *state, struct dhcp_context *context, str
       if (daemon->lease_change_command)
 	{
 	  void *class_opt;
-	  lease->flags |= LEASE_CHANGED;
+	  lease_set_changed(lease);
 	  free(lease->extradata);
 	  lease->extradata = NULL;
 	  lease->extradata_size = lease->extradata_len = 0;
@@ -0,0 +1,168 @@
+/* Replay a query log against server=/ipset= rules, list walk vs trie.
+
+   domain_trie_bench [rules.conf [queries.txt]]
+
+   rules.conf takes server=, local=, address=, rebind-domain-ok= and
+   ipset= lines (dnsmasq-china-list, gfwlist2dnsmasq output), queries.txt
+   one name per line. Without them, 70k server= plus 70k ipset= domains
+   and 20k queries, half under a listed domain, are generated. */
+
+#include "trie_ref.h"
+
+#define GEN_RULES 70000
+#define GEN_QUERIES 20000
+
+static unsigned int seed = 4711;
+
+static unsigned int rnd(unsigned int n)
+{
+  seed = seed * 1103515245u + 12345u;
+  return (seed >> 8) % n;
+}
+
+static void gen_label(char *buf, int len)
+{
+  int i;
+
+  for (i = 0; i < len; i++)
+    buf[i] = 'a' + rnd(26);
+  buf[len] = '\0';
+}
+
+static const char *tlds[] = { "com", "net", "org", "cn", "io", "jp", "tw", "hk" };
+
+static char **gen_rules(int n, int *lines)
+{
+  char **domains = calloc(n, sizeof(char *));
+  char line[256], label[16];
+  int i;
+
+  *lines = ref_conf_line(strcpy(line, "server=114.114.114.114"));
+  for (i = 0; i < n; i++)
+    {
+      gen_label(label, 3 + rnd(10));
+      snprintf(line, sizeof(line), "%s.%s", label, tlds[rnd(8)]);
+      domains[i] = strdup(line);
+      snprintf(line, sizeof(line), "server=/%s/127.0.0.1#5353", domains[i]);
+      *lines += ref_conf_line(line);
+      snprintf(line, sizeof(line), "ipset=/%s/gfwlist", domains[i]);
+      *lines += ref_conf_line(line);
+    }
+
+  return domains;
+}
+
+static char **gen_queries(char **domains, int rules, int n)
+{
+  char **names = calloc(n, sizeof(char *));
+  char name[256], l1[16], l2[16];
+  int i;
+
+  for (i = 0; i < n; i++)
+    {
+      gen_label(l1, 3 + rnd(6));
+      gen_label(l2, 3 + rnd(10));
+      if (i & 1)
+	snprintf(name, sizeof(name), "%s.%s", l1, domains[rnd(rules)]);
+      else
+	snprintf(name, sizeof(name), "%s.%s.%s", l1, l2, tlds[rnd(8)]);
+      names[i] = strdup(name);
+    }
+
+  return names;
+}
+
+static char **load_queries(const char *path, int *n)
+{
+  char **names = NULL, line[1024];
+  int size = 0, len;
+  FILE *f = fopen(path, "r");
+
+  *n = 0;
+  if (!f)
+    return NULL;
+  while (fgets(line, sizeof(line), f))
+    {
+      len = strcspn(line, " \t\r\n");
+      line[len] = '\0';
+      if (!len)
+	continue;
+      if (*n == size)
+	names = realloc(names, (size = size ? 2 * size : 1024) * sizeof(char *));
+      names[(*n)++] = strdup(line);
+    }
+  fclose(f);
+
+  return names;
+}
+
+int main(int argc, char **argv)
+{
+  struct ref_result r;
+  char **names, **domains = NULL;
+  int i, n, lines, rules = GEN_RULES, matched = 0;
+  double t, t_walk, t_trie, t_iwalk, t_itrie;
+
+  ref_init();
+
+  if (argc > 1)
+    {
+      if ((lines = ref_conf_file(argv[1])) < 0)
+	{
+	  perror(argv[1]);
+	  return 1;
+	}
+    }
+  else
+    domains = gen_rules(rules, &lines);
+
+  if (argc > 2)
+    {
+      if (!(names = load_queries(argv[2], &n)))
+	{
+	  perror(argv[2]);
+	  return 1;
+	}
+    }
+  else if (domains)
+    names = gen_queries(domains, rules, n = GEN_QUERIES);
+  else
+    {
+      fprintf(stderr, "usage: domain_trie_bench [rules.conf [queries.txt]]\n");
+      return 1;
+    }
+
+  t = ref_now_us();
+  ref_build();
+  t = ref_now_us() - t;
+
+  printf("domain_trie_bench: %d rule lines, %d queries, trie build %.1f ms\n", lines, n, t / 1000);
+
+  t = ref_now_us();
+  for (i = 0; i < n; i++)
+    ref_search(0, F_IPV4, names[i], &r, 1);
+  t_walk = ref_now_us() - t;
+
+  t = ref_now_us();
+  for (i = 0; i < n; i++)
+    if (ref_search(1, F_IPV4, names[i], &r, 1) || r.domain)
+      matched++;
+  t_trie = ref_now_us() - t;
+
+  t = ref_now_us();
+  for (i = 0; i < n; i++)
+    ref_ipsets(names[i]);
+  t_iwalk = ref_now_us() - t;
+
+  t = ref_now_us();
+  for (i = 0; i < n; i++)
+    match_ipsets(names[i]);
+  t_itrie = ref_now_us() - t;
+
+  printf("server match : list walk %9.2f us, trie %6.2f us per query (%.0fx), %d of %d under a rule\n",
+	 t_walk / n, t_trie / n, t_walk / t_trie, matched, n);
+  printf("ipset match  : list walk %9.2f us, trie %6.2f us per query (%.0fx)\n",
+	 t_iwalk / n, t_itrie / n, t_iwalk / t_itrie);
+
+  return 0;
+}
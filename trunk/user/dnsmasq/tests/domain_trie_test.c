@@ -0,0 +1,280 @@
+/* domain-trie.c must pick the same servers and ipsets as the list walks
+   it replaced. Fixed cases for most specific match, --address/--server
+   priority, # wildcards and local (/-terminated) domains, then a random
+   config with many overlapping domains, compared query by query. */
+
+#include "trie_ref.h"
+
+static int checks, failed;
+static unsigned int seed = 12345;
+
+static unsigned int rnd(unsigned int n)
+{
+  seed = seed * 1103515245u + 12345u;
+  return (seed >> 8) % n;
+}
+
+static void conf(const char *line)
+{
+  char buf[1024];
+
+  snprintf(buf, sizeof(buf), "%s", line);
+  if (!ref_conf_line(buf))
+    {
+      fprintf(stderr, "bad conf line: %s\n", line);
+      exit(1);
+    }
+}
+
+static void fail(const char *what, const char *name, unsigned int qtype)
+{
+  if (failed++ < 20)
+    fprintf(stderr, "FAIL %s: '%s' qtype 0x%x\n", what, name, qtype);
+}
+
+/* trie and list walk agree on everything search_servers() returns */
+static void compare(char *name, unsigned int qtype, int want_norebind)
+{
+  struct ref_result a, b;
+
+  ref_search(0, qtype, name, &a, want_norebind);
+  ref_search(1, qtype, name, &b, want_norebind);
+  checks++;
+
+  if (a.flags != b.flags || a.type != b.type || a.domain != b.domain ||
+      a.addrp != b.addrp || a.norebind != b.norebind)
+    fail("search", name, qtype);
+}
+
+static void compare_ipsets(char *name)
+{
+  checks++;
+  if (ref_ipsets(name) != match_ipsets(name))
+    fail("ipset", name, 0);
+}
+
+static void expect(char *name, unsigned int qtype, unsigned int flags, const char *domain)
+{
+  struct ref_result r;
+
+  compare(name, qtype, 0);
+  ref_search(1, qtype, name, &r, 0);
+  checks++;
+  if (r.flags != flags || (domain ? (!r.domain || strcmp(r.domain, domain)) : r.domain != NULL))
+    {
+      fail("expect", name, qtype);
+      fprintf(stderr, "  got flags 0x%x domain '%s'\n", r.flags, r.domain ? r.domain : "(none)");
+    }
+}
+
+static void expect_ipset(char *name, const char *set)
+{
+  struct ipsets *i = match_ipsets(name);
+
+  compare_ipsets(name);
+  checks++;
+  if (set ? (!i || strcmp(i->sets[0], set)) : i != NULL)
+    fail("expect ipset", name, 0);
+}
+
+static void compare_groups(void)
+{
+  struct server *serv;
+  union mysockaddr addr;
+
+  for (serv = daemon->servers; serv; serv = serv->next)
+    {
+      int type = serv->flags & SERV_TYPE;
+
+      checks += 2;
+      if (server_group(type, serv->domain) != ref_group(type, serv->domain))
+	fail("group", serv->domain ? serv->domain : "", type);
+      if (!(serv->flags & (SERV_LITERAL_ADDRESS | SERV_NO_ADDR)) &&
+	  lookup_server_addr(&serv->addr) != ref_server_addr(&serv->addr))
+	fail("server addr", serv->domain ? serv->domain : "", type);
+    }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.in.sin_family = AF_INET;
+  addr.in.sin_port = htons(NAMESERVER_PORT);
+  inet_pton(AF_INET, "203.0.113.77", &addr.in.sin_addr);
+  checks++;
+  if (lookup_server_addr(&addr) != ref_server_addr(&addr))
+    fail("unknown server addr", "203.0.113.77", 0);
+}
+
+static void fixed_cases(void)
+{
+  ref_init();
+  conf("server=8.8.8.8");
+  conf("server=1.1.1.1#5353");
+  conf("server=//192.168.1.1");
+  conf("server=/example.com/1.2.3.4");
+  conf("server=/sub.example.com/5.6.7.8");
+  conf("address=/ads.example.com/0.0.0.0");
+  conf("address=/both.example.org/9.9.9.9");
+  conf("server=/both.example.org/4.3.2.1");
+  conf("address=/v6only.example.org/::9");
+  conf("server=/v6only.example.org/4.3.2.1");
+  conf("local=/lan/");
+  conf("server=/corp.lan/10.0.0.1");
+  conf("server=/home/");
+  conf("server=/resolv.example.net/#");
+  conf("rebind-domain-ok=/example.com/rebind.test/");
+  conf("server=/Mixed.Case.ORG/4.4.4.4");
+  conf("address=/deep.a.b.c.d/1.1.1.1");
+  conf("server=/b.c.d/2.2.2.2");
+  conf("ipset=/example.com/gfw");
+  conf("ipset=/sub.example.com/other,gfw");
+  conf("ipset=/dup.example.net/first");
+  conf("ipset=/dup.example.net/second");
+  ref_build();
+
+  /* most specific domain wins */
+  expect("www.sub.example.com", F_IPV4, 0, "sub.example.com");
+  expect("www.example.com", F_IPV4, 0, "example.com");
+  expect("x.ads.example.com", F_IPV4, F_IPV4, "ads.example.com");
+  expect("x.deep.a.b.c.d", F_IPV4, F_IPV4, "deep.a.b.c.d");
+  expect("x.a.b.c.d", F_IPV4, 0, "b.c.d");
+  expect("notexample.com", F_IPV4, 0, NULL);
+  expect("WWW.MIXED.case.org", F_IPV4, 0, "mixed.case.org");
+  /* --address beats --server for the right family, not otherwise */
+  expect("both.example.org", F_IPV4, F_IPV4, "both.example.org");
+  expect("both.example.org", F_IPV6, 0, "both.example.org");
+  expect("v6only.example.org", F_IPV6, F_IPV6, "v6only.example.org");
+  expect("v6only.example.org", F_IPV4, 0, "v6only.example.org");
+  /* local domains, /-terminated */
+  expect("host.lan", F_IPV4, F_NXDOMAIN, "lan");
+  expect("pc.corp.lan", F_IPV4, 0, "corp.lan");
+  expect("box.home", F_IPV6, F_NXDOMAIN, "home");
+  expect("a.resolv.example.net", F_IPV4, 0, "resolv.example.net");
+  /* dotless names go to the // servers */
+  expect("router", F_IPV4, 0, NULL);
+  compare("router", F_IPV4, 1);
+  compare("x.rebind.test", F_IPV4, 1);
+  compare("www.example.com", F_IPV4, 1);
+  compare("", F_IPV4, 0);
+
+  expect_ipset("a.b.sub.example.com", "other");
+  expect_ipset("example.com", "gfw");
+  expect_ipset("xexample.com", NULL);
+  expect_ipset("dup.example.net", "first");
+
+  compare_groups();
+
+  /* # matches everything */
+  ref_init();
+  conf("server=8.8.8.8");
+  conf("server=/example.com/1.2.3.4");
+  conf("address=/#/127.0.0.2");
+  conf("address=/#/::2");
+  conf("server=/#/#");
+  conf("local=/lan/");
+  conf("ipset=/#/all");
+  conf("ipset=/example.com/gfw");
+  ref_build();
+
+  expect("anything.xyz", F_IPV4, F_IPV4, "");
+  expect("anything.xyz", F_IPV6, F_IPV6, "");
+  expect("www.example.com", F_IPV4, 0, "example.com");
+  expect("host.lan", F_IPV4, F_NXDOMAIN, "lan");
+  compare("nodots", F_IPV4, 0);
+  compare("", F_IPV4, 0);
+  expect_ipset("anything.xyz", "all");
+  expect_ipset("a.example.com", "gfw");
+
+  compare_groups();
+}
+
+static const char *labels[] = {
+  "a", "b", "c", "www", "mail", "cdn", "api", "x1", "google", "baidu",
+  "qq", "example", "lan", "home", "corp", "net", "com", "org", "cn", "io"
+};
+#define LABELS (sizeof(labels) / sizeof(labels[0]))
+
+static void random_domain(char *buf, size_t size, int depth)
+{
+  int i, len = 0;
+
+  buf[0] = '\0';
+  for (i = 0; i < depth; i++)
+    len += snprintf(buf + len, size - len, "%s%s", i ? "." : "", labels[rnd(LABELS)]);
+}
+
+static void random_cases(int rules, int queries)
+{
+  static const char *kinds[] = {
+    "server=/%s/10.0.%u.%u", "address=/%s/10.1.%u.%u", "address=/%s/fd00::%x:%x",
+    "local=/%s/", "server=/%s/", "server=/%s/#", "address=/%s/",
+    "rebind-domain-ok=/%s/", "server=/%s/%s/10.2.%u.%u"
+  };
+  static const unsigned int qtypes[] = { F_IPV4, F_IPV6, F_IPV4 | F_IPV6, F_QUERY, F_DNSSECOK };
+  char **domains = calloc(rules, sizeof(char *));
+  char line[1024], d1[256], d2[256], name[768];
+  int i, k;
+
+  ref_init();
+  conf("server=8.8.8.8");
+  conf("server=//192.168.1.1");
+  for (i = 0; i < rules; i++)
+    {
+      random_domain(d1, sizeof(d1), 1 + rnd(4));
+      random_domain(d2, sizeof(d2), 1 + rnd(3));
+      domains[i] = strdup(d1);
+      k = rnd(sizeof(kinds) / sizeof(kinds[0]));
+      if (k == 8)
+	snprintf(line, sizeof(line), kinds[k], d1, d2, rnd(256), rnd(256));
+      else
+	snprintf(line, sizeof(line), kinds[k], d1, rnd(256), rnd(256));
+      conf(line);
+      if (rnd(3) == 0)
+	{
+	  snprintf(line, sizeof(line), "ipset=/%s/set%d", d1, i);
+	  conf(line);
+	}
+    }
+  ref_build();
+
+  for (i = 0; i < queries; i++)
+    {
+      int len = 0, j, prefix = rnd(4);
+
+      for (j = 0; j < prefix; j++)
+	len += snprintf(name + len, sizeof(name) - len, "%s.", labels[rnd(LABELS)]);
+      switch (rnd(6))
+	{
+	case 0:
+	  random_domain(name + len, sizeof(name) - len, 1 + rnd(5));
+	  break;
+	case 1:
+	  snprintf(name, sizeof(name), "%s", labels[rnd(LABELS)]);
+	  break;
+	default:
+	  snprintf(name + len, sizeof(name) - len, "%s", domains[rnd(rules)]);
+	}
+      if (rnd(4) == 0)
+	for (j = 0; name[j]; j++)
+	  if (rnd(2) && name[j] >= 'a' && name[j] <= 'z')
+	    name[j] -= 'a' - 'A';
+
+      compare(name, qtypes[rnd(5)], rnd(2));
+      compare_ipsets(name);
+    }
+
+  compare_groups();
+}
+
+int main(void)
+{
+  fixed_cases();
+  random_cases(3000, 200000);
+
+  if (failed)
+    {
+      printf("domain_trie_test: %d of %d checks FAILED\n", failed, checks);
+      return 1;
+    }
+
+  printf("domain_trie_test: %d checks ok\n", checks);
+  return 0;
+}
@@ -0,0 +1,555 @@
+/* lease.c looks leases up through hash indices and coalesces leasefile
+   rewrites. The lookups must find what the list walks they replaced
+   found, after any mix of allocations, deletions and renames, and the
+   leasefile written after a burst of changes must be the same as a full
+   rewrite of all leases. The reference walks and the full rewrite run
+   over a copy of the leases list kept here, in list order. */
+
+#include "dnsmasq.h"
+
+#define MAX_LEASES 2000
+#define HW_KEYS 48
+#define CLID_KEYS 24
+#define NAME_KEYS 40
+
+struct daemon *dnsmasq_daemon;
+
+static struct dhcp_lease *list[MAX_LEASES]; /* oldest first, list walks go backwards */
+static int list_len;
+static time_t alarm_at;
+static int checks, failed;
+static unsigned int seed = 4242;
+static char lease_path[] = "/tmp/lease_test.XXXXXX";
+
+/* Stubs for what lease.c and util.c pull in from the rest of dnsmasq */
+void my_syslog(int priority, const char *format, ...)
+{
+  va_list ap;
+
+  (void)priority;
+  va_start(ap, format);
+  vfprintf(stderr, format, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+}
+
+void die(char *message, char *arg1, int exit_code)
+{
+  fprintf(stderr, message, arg1 ? arg1 : "");
+  fputc('\n', stderr);
+  exit(1);
+  (void)exit_code;
+}
+
+int fix_fd(int fd)
+{
+  (void)fd;
+  return 1;
+}
+
+void send_alarm(time_t event, time_t now)
+{
+  (void)now;
+  alarm_at = event;
+}
+
+void cache_add_dhcp_entry(char *host_name, int prot, union all_addr *host_address, time_t ttd)
+{
+  (void)host_name; (void)prot; (void)host_address; (void)ttd;
+}
+
+void cache_unhash_dhcp(void) {}
+char *get_domain(struct in_addr addr) { (void)addr; return NULL; }
+char *get_domain6(struct in6_addr *addr) { (void)addr; return NULL; }
+char *host_from_dns(struct in_addr addr) { (void)addr; return NULL; }
+int iface_enumerate(int family, void *parm, int (callback)()) { (void)family; (void)parm; (void)callback; return 1; }
+void make_duid(time_t now) { (void)now; }
+time_t periodic_ra(time_t now) { (void)now; return 0; }
+time_t periodic_slaac(time_t now, struct dhcp_lease *leases) { (void)now; (void)leases; return 0; }
+void slaac_add_addrs(struct dhcp_lease *lease, time_t now, int force) { (void)lease; (void)now; (void)force; }
+
+void slaac_ping_reply(struct in6_addr *sender, unsigned char *packet, char *interface, struct dhcp_lease *leases)
+{
+  (void)sender; (void)packet; (void)interface; (void)leases;
+}
+
+void queue_script(int action, struct dhcp_lease *lease, char *hostname, time_t now)
+{
+  (void)action; (void)lease; (void)hostname; (void)now;
+}
+
+struct dhcp_config *find_config(struct dhcp_config *configs, struct dhcp_context *context,
+				unsigned char *clid, int clid_len, unsigned char *hwaddr, int hw_len,
+				int hw_type, char *hostname)
+{
+  (void)configs; (void)context; (void)clid; (void)clid_len; (void)hwaddr; (void)hw_len;
+  (void)hw_type; (void)hostname;
+  return NULL;
+}
+
+static unsigned int rnd(unsigned int n)
+{
+  seed = seed * 1103515245u + 12345u;
+  return (seed >> 8) % n;
+}
+
+static void fail(const char *what, int key)
+{
+  if (failed++ < 20)
+    fprintf(stderr, "FAIL %s: key %d\n", what, key);
+}
+
+static void check(int ok, const char *what, int key)
+{
+  checks++;
+  if (!ok)
+    fail(what, key);
+}
+
+/* The list walks lease.c used before the hash indices */
+static struct dhcp_lease *ref_find_by_client(unsigned char *hwaddr, int hw_len, int hw_type,
+					     unsigned char *clid, int clid_len)
+{
+  struct dhcp_lease *lease;
+  int i;
+
+  if (clid)
+    for (i = list_len - 1; i >= 0; i--)
+      {
+	lease = list[i];
+	if (lease->flags & (LEASE_TA | LEASE_NA))
+	  continue;
+	if (lease->clid && clid_len == lease->clid_len &&
+	    memcmp(clid, lease->clid, clid_len) == 0)
+	  return lease;
+      }
+
+  for (i = list_len - 1; i >= 0; i--)
+    {
+      lease = list[i];
+      if (lease->flags & (LEASE_TA | LEASE_NA))
+	continue;
+      if ((!lease->clid || !clid) &&
+	  hw_len != 0 &&
+	  lease->hwaddr_len == hw_len &&
+	  lease->hwaddr_type == hw_type &&
+	  memcmp(hwaddr, lease->hwaddr, hw_len) == 0)
+	return lease;
+    }
+
+  return NULL;
+}
+
+static struct dhcp_lease *ref_find_by_addr(struct in_addr addr)
+{
+  int i;
+
+  for (i = list_len - 1; i >= 0; i--)
+    if (!(list[i]->flags & (LEASE_TA | LEASE_NA)) && list[i]->addr.s_addr == addr.s_addr)
+      return list[i];
+
+  return NULL;
+}
+
+static struct dhcp_lease *ref6_find(unsigned char *clid, int clid_len,
+				    int lease_type, int iaid, struct in6_addr *addr)
+{
+  struct dhcp_lease *lease;
+  int i;
+
+  for (i = list_len - 1; i >= 0; i--)
+    {
+      lease = list[i];
+      if (!(lease->flags & lease_type) || lease->iaid != iaid)
+	continue;
+      if (!IN6_ARE_ADDR_EQUAL(&lease->addr6, addr))
+	continue;
+      if (clid_len != lease->clid_len || memcmp(clid, lease->clid, clid_len) != 0)
+	continue;
+      return lease;
+    }
+
+  return NULL;
+}
+
+/* Enumeration of {CLID, IAID}, as a list walk starting below first */
+static struct dhcp_lease *ref6_find_by_client(struct dhcp_lease *first, int lease_type,
+					      unsigned char *clid, int clid_len, int iaid)
+{
+  struct dhcp_lease *lease;
+  int i = list_len - 1;
+
+  if (first)
+    while (i >= 0 && list[i--] != first);
+
+  for (; i >= 0; i--)
+    {
+      lease = list[i];
+      if (!(lease->flags & lease_type) || lease->iaid != iaid)
+	continue;
+      if (clid_len != lease->clid_len || memcmp(clid, lease->clid, clid_len) != 0)
+	continue;
+      return lease;
+    }
+
+  return NULL;
+}
+
+static struct dhcp_lease *ref6_find_by_addr(struct in6_addr *net, int prefix, u64 addr)
+{
+  struct dhcp_lease *lease;
+  int i;
+
+  for (i = list_len - 1; i >= 0; i--)
+    {
+      lease = list[i];
+      if (!(lease->flags & (LEASE_TA | LEASE_NA)))
+	continue;
+      if (is_same_net6(&lease->addr6, net, prefix) &&
+	  (prefix == 128 || addr6part(&lease->addr6) == addr))
+	return lease;
+    }
+
+  return NULL;
+}
+
+/* The leasefile as the whole-file rewrite before this change wrote it */
+static size_t ref_file(char *buf, size_t size)
+{
+  struct dhcp_lease *lease;
+  size_t len = 0;
+  int i, j, v6;
+
+#define OUT(...) len += snprintf(buf + len, size - len, __VA_ARGS__)
+  for (v6 = 0; v6 <= 1; v6++)
+    {
+      if (v6)
+	{
+	  OUT("duid ");
+	  for (j = 0; j < daemon->duid_len - 1; j++)
+	    OUT("%.2x:", daemon->duid[j]);
+	  OUT("%.2x\n", daemon->duid[j]);
+	}
+      for (i = list_len - 1; i >= 0; i--)
+	{
+	  lease = list[i];
+	  if (!(lease->flags & (LEASE_TA | LEASE_NA)) != !v6)
+	    continue;
+	  OUT("%lu ", (unsigned long)lease->expires);
+	  if (v6)
+	    {
+	      inet_ntop(AF_INET6, &lease->addr6, daemon->addrbuff, ADDRSTRLEN);
+	      OUT("%s%u %s ", (lease->flags & LEASE_TA) ? "T" : "", lease->iaid, daemon->addrbuff);
+	    }
+	  else
+	    {
+	      if (lease->hwaddr_type != ARPHRD_ETHER || lease->hwaddr_len == 0)
+		OUT("%.2x-", lease->hwaddr_type);
+	      for (j = 0; j < lease->hwaddr_len; j++)
+		OUT(j != lease->hwaddr_len - 1 ? "%.2x:" : "%.2x", lease->hwaddr[j]);
+	      inet_ntop(AF_INET, &lease->addr, daemon->addrbuff, ADDRSTRLEN);
+	      OUT(" %s ", daemon->addrbuff);
+	    }
+	  OUT("%s ", lease->hostname ? lease->hostname : "*");
+	  if (lease->clid && lease->clid_len != 0)
+	    {
+	      for (j = 0; j < lease->clid_len - 1; j++)
+		OUT("%.2x:", lease->clid[j]);
+	      OUT("%.2x\n", lease->clid[j]);
+	    }
+	  else
+	    OUT("*\n");
+	}
+    }
+#undef OUT
+
+  return len;
+}
+
+static size_t read_file(char *buf, size_t size)
+{
+  FILE *f = fopen(lease_path, "r");
+  size_t len;
+
+  if (!f)
+    die("cannot open %s", lease_path, 0);
+  len = fread(buf, 1, size, f);
+  fclose(f);
+
+  return len;
+}
+
+static int file_is(const char *want, size_t want_len)
+{
+  static char buf[1 << 20];
+  size_t len = read_file(buf, sizeof(buf));
+
+  return len == want_len && memcmp(buf, want, len) == 0;
+}
+
+static int file_is_full_rewrite(void)
+{
+  static char want[1 << 20];
+
+  return file_is(want, ref_file(want, sizeof(want)));
+}
+
+/* Keys are drawn from small sets, so that leases share them */
+static void hw_key(int k, unsigned char *hw)
+{
+  memcpy(hw, "\x02\x00\x5e\x10", 4);
+  hw[4] = k >> 8;
+  hw[5] = k;
+}
+
+static int clid_key(int k, unsigned char *clid)
+{
+  int i, len = 7 + k % 5;
+
+  clid[0] = 0xff;
+  for (i = 1; i < len; i++)
+    clid[i] = k * 31 + i;
+
+  return len;
+}
+
+static struct in_addr addr4_key(int k)
+{
+  struct in_addr addr;
+
+  addr.s_addr = htonl(0xc0a80000 | k);
+  return addr;
+}
+
+static struct in6_addr addr6_key(int k)
+{
+  struct in6_addr addr;
+
+  inet_pton(AF_INET6, (k & 1) ? "fd00:1::" : "fd00:2::", &addr);
+  setaddr6part(&addr, 0x100 + k / 2);
+  return addr;
+}
+
+static void list_remove(struct dhcp_lease *lease)
+{
+  int i;
+
+  for (i = 0; i < list_len; i++)
+    if (list[i] == lease)
+      {
+	memmove(&list[i], &list[i + 1], (list_len - i - 1) * sizeof(list[0]));
+	list_len--;
+	return;
+      }
+}
+
+static void set_client(struct dhcp_lease *lease, time_t now)
+{
+  unsigned char hw[6], clid[16];
+  int clid_len = clid_key(rnd(CLID_KEYS), clid);
+
+  hw_key(rnd(HW_KEYS), hw);
+  if (lease->flags & (LEASE_TA | LEASE_NA))
+    lease_set_hwaddr(lease, hw, clid, 6, ARPHRD_ETHER, clid_len, now, 0);
+  else if (rnd(3) == 0)
+    lease_set_hwaddr(lease, hw, NULL, 6, ARPHRD_ETHER, 0, now, 1);
+  else
+    lease_set_hwaddr(lease, hw, clid, 6, ARPHRD_ETHER, clid_len, now, 1);
+}
+
+static void set_name(struct dhcp_lease *lease)
+{
+  char name[32];
+
+  if (rnd(4) == 0)
+    lease_set_hostname(lease, NULL, 0, NULL, NULL);
+  else
+    {
+      snprintf(name, sizeof(name), "host%u", rnd(NAME_KEYS));
+      lease_set_hostname(lease, name, rnd(8) == 0, NULL, NULL);
+    }
+}
+
+/* One DHCP event, as rfc2131.c/rfc3315.c would apply it */
+static void random_change(time_t now)
+{
+  struct dhcp_lease *lease;
+  struct in6_addr addr6;
+
+  switch (rnd(list_len < 300 ? 2 : 9))
+    {
+    case 0:
+      if (!(lease = lease4_allocate(addr4_key(rnd(512)))))
+	return;
+      list[list_len++] = lease;
+      set_client(lease, now);
+      lease_set_expires(lease, 3600 + rnd(3600), now);
+      break;
+    case 1:
+      addr6 = addr6_key(rnd(256));
+      if (!(lease = lease6_allocate(&addr6, rnd(4) ? LEASE_NA : LEASE_TA)))
+	return;
+      list[list_len++] = lease;
+      lease_set_iaid(lease, rnd(3));
+      set_client(lease, now);
+      lease_set_expires(lease, 3600 + rnd(3600), now);
+      break;
+    case 2:
+    case 3:
+      lease = list[rnd(list_len)];
+      list_remove(lease);
+      lease_prune(lease, now);
+      break;
+    case 4:
+      set_client(list[rnd(list_len)], now);
+      break;
+    case 5:
+      set_name(list[rnd(list_len)]);
+      break;
+    default:
+      /* renewal */
+      lease_set_expires(list[rnd(list_len)], 3600 + rnd(3600), now);
+    }
+}
+
+/* A packet handled, then what dhcp_packet() does after it */
+static void dhcp_event(time_t now)
+{
+  random_change(now);
+  lease_prune(NULL, now);
+  lease_update_file(now);
+}
+
+static void compare_lookups(void)
+{
+  struct dhcp_lease *a, *b;
+  unsigned char hw[6], clid[16];
+  struct in6_addr addr6, net;
+  int k, clid_len, type, iaid, prefix;
+
+  for (k = 0; k < 512; k++)
+    check(lease_find_by_addr(addr4_key(k)) == ref_find_by_addr(addr4_key(k)), "lease_find_by_addr", k);
+
+  for (k = 0; k < HW_KEYS * CLID_KEYS; k += 7)
+    {
+      hw_key(k % HW_KEYS, hw);
+      clid_len = clid_key(k / HW_KEYS, clid);
+      check(lease_find_by_client(hw, 6, ARPHRD_ETHER, clid, clid_len) ==
+	    ref_find_by_client(hw, 6, ARPHRD_ETHER, clid, clid_len), "lease_find_by_client", k);
+      check(lease_find_by_client(hw, 6, ARPHRD_ETHER, NULL, 0) ==
+	    ref_find_by_client(hw, 6, ARPHRD_ETHER, NULL, 0), "lease_find_by_client w/o clid", k);
+    }
+
+  for (k = 0; k < 256; k++)
+    {
+      addr6 = addr6_key(k);
+      clid_len = clid_key(k % CLID_KEYS, clid);
+      type = (k & 2) ? LEASE_NA : LEASE_TA;
+      iaid = k % 3;
+      check(lease6_find(clid, clid_len, type, iaid, &addr6) ==
+	    ref6_find(clid, clid_len, type, iaid, &addr6), "lease6_find", k);
+
+      prefix = (k % 3 == 0) ? 128 : (k % 3 == 1) ? 64 : 48;
+      net = addr6;
+      check(lease6_find_by_addr(&net, prefix, addr6part(&addr6)) ==
+	    ref6_find_by_addr(&net, prefix, addr6part(&addr6)), "lease6_find_by_addr", k);
+    }
+
+  lease6_reset();
+  for (k = 0; k < CLID_KEYS * 3 * 2; k++)
+    {
+      clid_len = clid_key(k % CLID_KEYS, clid);
+      iaid = (k / CLID_KEYS) % 3;
+      type = (k < CLID_KEYS * 3) ? LEASE_NA : LEASE_TA;
+      a = b = NULL;
+      do
+	{
+	  a = lease6_find_by_client(a, type, clid, clid_len, iaid);
+	  b = ref6_find_by_client(b, type, clid, clid_len, iaid);
+	  check(a == b, "lease6_find_by_client", k);
+	}
+      while (a && a == b);
+    }
+}
+
+static void setup(void)
+{
+  int fd = mkstemp(lease_path);
+
+  if (fd < 0)
+    die("cannot create %s", lease_path, 0);
+  close(fd);
+
+  daemon = calloc(1, sizeof(struct daemon));
+  daemon->dhcp_max = MAX_LEASES;
+  daemon->lease_file = lease_path;
+  daemon->addrbuff = safe_malloc(ADDRSTRLEN);
+  daemon->dhcp_buff = safe_malloc(DHCP_BUFF_SZ);
+  daemon->dhcp_buff2 = safe_malloc(DHCP_BUFF_SZ);
+  daemon->dhcp_buff3 = safe_malloc(DHCP_BUFF_SZ);
+  daemon->namebuff = safe_malloc(MAXDNAME * 2);
+  daemon->packet = safe_malloc(PACKETSZ + MAXDNAME + RRFIXEDSZ);
+  daemon->duid = (unsigned char *)"\x00\x01\x00\x01\x2a\x2b\x2c\x2d\x02\x00\x5e\x00\x00\x01";
+  daemon->duid_len = 14;
+}
+
+int main(void)
+{
+  static char written[1 << 20];
+  size_t written_len;
+  time_t now = 1700000000, wrote_at;
+  int i, burst;
+
+  setup();
+  lease_init(now);
+
+  /* Lookups after add/delete/rename, the rewrite is checked each time
+     LEASE_WRITE_DELAY has passed. Within it, the file stays as written. */
+  dhcp_event(now);
+  check(file_is_full_rewrite(), "first write", 0);
+  wrote_at = now;
+  written_len = read_file(written, sizeof(written));
+
+  for (burst = 0; burst < 300; burst++)
+    {
+      for (i = 0; i < 100; i++)
+	{
+	  dhcp_event(now);
+	  if (rnd(10) == 0 && now < wrote_at + LEASE_WRITE_DELAY - 1)
+	    now++;
+	}
+      compare_lookups();
+
+      check(file_is(written, written_len), "held within LEASE_WRITE_DELAY", burst);
+      check(alarm_at == wrote_at + LEASE_WRITE_DELAY, "alarm for the deferred write", burst);
+
+      now = wrote_at + LEASE_WRITE_DELAY;
+      lease_update_file(now);
+      check(file_is_full_rewrite(), "coalesced write", burst);
+      wrote_at = now;
+      written_len = read_file(written, sizeof(written));
+    }
+
+  /* Clock steps back an hour: the next change is written right away */
+  now -= 3600;
+  lease_set_expires(list[0], 7200, now);
+  dhcp_event(now);
+  check(file_is_full_rewrite(), "write after clock step back", 0);
+
+  /* Pending changes are written on SIGTERM */
+  lease_set_expires(list[0], 3600, now);
+  dhcp_event(now);
+  lease_flush_file();
+  check(file_is_full_rewrite(), "lease_flush_file", 0);
+
+  unlink(lease_path);
+
+  if (failed)
+    {
+      printf("lease_test: %d of %d checks FAILED\n", failed, checks);
+      return 1;
+    }
+
+  printf("lease_test: %d checks ok, %d leases at the end\n", checks, list_len);
+  return 0;
+}
@@ -0,0 +1,417 @@
+/* Host harness for src/domain-trie.c, see trie_ref.h */
+
+#include "trie_ref.h"
+
+#include <sys/time.h>
+
+struct daemon *dnsmasq_daemon;
+
+/* Stubs for what util.c pulls in from the rest of dnsmasq */
+void my_syslog(int priority, const char *format, ...)
+{
+  va_list ap;
+
+  (void)priority;
+  va_start(ap, format);
+  vfprintf(stderr, format, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+}
+
+void die(char *message, char *arg1, int exit_code)
+{
+  fprintf(stderr, message, arg1 ? arg1 : "");
+  fputc('\n', stderr);
+  exit(1);
+  (void)exit_code;
+}
+
+int fix_fd(int fd)
+{
+  (void)fd;
+  return 1;
+}
+
+void ref_init(void)
+{
+  daemon = calloc(1, sizeof(struct daemon));
+}
+
+double ref_now_us(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+static char *ref_strdup(const char *s)
+{
+  char *ret = strdup(s);
+
+  if (!ret)
+    die("out of memory", NULL, 0);
+  return ret;
+}
+
+/* Lower case, no leading or trailing dots, like canonicalise_opt() */
+static char *ref_domain(char *arg)
+{
+  char *ret, *p;
+  size_t len;
+
+  while (*arg == '.')
+    arg++;
+  ret = ref_strdup(arg);
+  for (p = ret; *p; p++)
+    if (*p >= 'A' && *p <= 'Z')
+      *p += 'a' - 'A';
+  len = strlen(ret);
+  while (len > 0 && ret[len-1] == '.')
+    ret[--len] = '\0';
+  return ret;
+}
+
+/* addr[#port] */
+static int ref_addr(char *arg, union mysockaddr *addr)
+{
+  char *port = strchr(arg, '#');
+  int portno = NAMESERVER_PORT;
+
+  if (port)
+    {
+      *port++ = '\0';
+      portno = atoi(port);
+    }
+
+  memset(addr, 0, sizeof(*addr));
+  if (inet_pton(AF_INET, arg, &addr->in.sin_addr) > 0)
+    {
+      addr->in.sin_family = AF_INET;
+      addr->in.sin_port = htons(portno);
+      return 1;
+    }
+  if (inet_pton(AF_INET6, arg, &addr->in6.sin6_addr) > 0)
+    {
+      addr->in6.sin6_family = AF_INET6;
+      addr->in6.sin6_port = htons(portno);
+      return 1;
+    }
+  return 0;
+}
+
+/* server=, local=, address=, rebind-domain-ok= and ipset= lines, with the
+   list order option.c gives them. Returns 0 for lines it doesn't take. */
+int ref_conf_line(char *line)
+{
+  struct server *serv, *newlist = NULL;
+  char *arg, *end = NULL;
+  size_t len = strlen(line);
+  int option;
+
+  while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r' || line[len-1] == ' '))
+    line[--len] = '\0';
+
+  if (!(arg = strchr(line, '=')))
+    return 0;
+  *arg++ = '\0';
+
+  if (!strcmp(line, "server"))
+    option = 'S';
+  else if (!strcmp(line, "local"))
+    option = 'L';
+  else if (!strcmp(line, "address"))
+    option = 'A';
+  else if (!strcmp(line, "rebind-domain-ok"))
+    option = 'R';
+  else if (!strcmp(line, "ipset"))
+    {
+      struct ipsets head, *ipsets = &head;
+      char **sets;
+      int size;
+
+      memset(&head, 0, sizeof(head));
+      if (*arg != '/')
+	return 0;
+      arg++;
+      while ((end = strchr(arg, '/')))
+	{
+	  *end++ = '\0';
+	  if (!(ipsets->next = calloc(1, sizeof(struct ipsets))))
+	    die("out of memory", NULL, 0);
+	  ipsets = ipsets->next;
+	  ipsets->domain = (strcmp(arg, "#") == 0 || !*arg) ? "" : ref_domain(arg);
+	  arg = end;
+	}
+      if (!*arg || !head.next)
+	return 0;
+
+      for (size = 2, end = arg; *end; ++end)
+	if (*end == ',')
+	  ++size;
+      if (!(sets = calloc(size, sizeof(char *))))
+	die("out of memory", NULL, 0);
+      for (size = 0; arg; arg = end)
+	{
+	  if ((end = strchr(arg, ',')))
+	    *end++ = '\0';
+	  sets[size++] = ref_strdup(arg);
+	}
+
+      for (ipsets = &head; ipsets->next; ipsets = ipsets->next)
+	ipsets->next->sets = sets;
+      ipsets->next = daemon->ipsets;
+      daemon->ipsets = head.next;
+      return 1;
+    }
+  else
+    return 0;
+
+  if (*arg == '/' || option == 'R')
+    {
+      int rebind = !(*arg == '/');
+
+      if (!rebind)
+	arg++;
+      while (rebind || (end = strchr(arg, '/')))
+	{
+	  char *domain = NULL;
+
+	  if (!rebind)
+	    *end++ = '\0';
+	  if (strcmp(arg, "#") == 0)
+	    domain = "";
+	  else if (*arg)
+	    domain = ref_domain(arg);
+	  if (!(serv = calloc(1, sizeof(struct server))))
+	    die("out of memory", NULL, 0);
+	  serv->next = newlist;
+	  newlist = serv;
+	  serv->domain = domain;
+	  serv->flags = domain ? SERV_HAS_DOMAIN : SERV_FOR_NODOTS;
+	  if (rebind)
+	    {
+	      arg = NULL;
+	      break;
+	    }
+	  arg = end;
+	}
+      if (!newlist)
+	return 0;
+    }
+  else if (!(newlist = calloc(1, sizeof(struct server))))
+    die("out of memory", NULL, 0);
+
+  if (option == 'A')
+    {
+      newlist->flags |= SERV_LITERAL_ADDRESS;
+      if (!(newlist->flags & SERV_TYPE))
+	return 0;
+    }
+  else if (option == 'R')
+    newlist->flags |= SERV_NO_REBIND;
+
+  if (!arg || !*arg)
+    {
+      if (!(newlist->flags & SERV_NO_REBIND))
+	newlist->flags |= SERV_NO_ADDR;
+    }
+  else if (strcmp(arg, "#") == 0)
+    newlist->flags |= SERV_USE_RESOLV;
+  else if (!ref_addr(arg, &newlist->addr))
+    return 0;
+
+  for (serv = newlist; serv->next; serv = serv->next)
+    {
+      serv->next->flags = serv->flags;
+      serv->next->addr = serv->addr;
+    }
+  serv->next = daemon->servers;
+  daemon->servers = newlist;
+
+  return 1;
+}
+
+int ref_conf_file(const char *path)
+{
+  char line[4096];
+  FILE *f = fopen(path, "r");
+  int n = 0;
+
+  if (!f)
+    return -1;
+  while (fgets(line, sizeof(line), f))
+    n += ref_conf_line(line);
+  fclose(f);
+
+  return n;
+}
+
+void ref_build(void)
+{
+  build_server_trie();
+  build_ipset_trie();
+}
+
+/* The server selection of search_servers() in forward.c, without logging
+   and local domain checks. use_trie visits the candidates from
+   match_servers(), otherwise the whole list, as before domain-trie.c */
+unsigned int ref_search(int use_trie, unsigned int qtype, char *qdomain, struct ref_result *r, int want_norebind)
+{
+  unsigned int namelen = strlen(qdomain);
+  unsigned int matchlen = 0;
+  struct server *serv;
+  struct server_match m;
+  unsigned int flags = 0;
+  static union all_addr zero;
+  int *norebind = want_norebind ? &r->norebind : NULL;
+  int *type = &r->type;
+  char **domain = &r->domain;
+  union all_addr **addrpp = &r->addrp;
+
+  memset(r, 0, sizeof(*r));
+
+  if (use_trie)
+    match_servers(&m, qdomain);
+
+  for (serv = use_trie ? next_server_match(&m) : daemon->servers; serv;
+       serv = use_trie ? next_server_match(&m) : serv->next)
+    if (qtype == F_DNSSECOK && !(serv->flags & SERV_DO_DNSSEC))
+      continue;
+    /* domain matches take priority over NODOTS matches */
+    else if ((serv->flags & SERV_FOR_NODOTS) && *type != SERV_HAS_DOMAIN && !strchr(qdomain, '.') && namelen != 0)
+      {
+	unsigned int sflag = serv->addr.sa.sa_family == AF_INET ? F_IPV4 : F_IPV6;
+	*type = SERV_FOR_NODOTS;
+	if (serv->flags & SERV_NO_ADDR)
+	  flags = F_NXDOMAIN;
+	else if (serv->flags & SERV_LITERAL_ADDRESS)
+	  {
+	    if ((serv->flags & SERV_USE_RESOLV) && (qtype & (F_IPV6 | F_IPV4)))
+	      {
+		flags = qtype;
+		*addrpp = &zero;
+	      }
+	    else if (sflag & qtype)
+	      {
+		flags = sflag;
+		if (serv->addr.sa.sa_family == AF_INET)
+		  *addrpp = (union all_addr *)&serv->addr.in.sin_addr;
+		else
+		  *addrpp = (union all_addr *)&serv->addr.in6.sin6_addr;
+	      }
+	    else if (!flags || (flags & F_NXDOMAIN))
+	      flags = F_NOERR;
+	  }
+      }
+    else if (serv->flags & SERV_HAS_DOMAIN)
+      {
+	unsigned int domainlen = strlen(serv->domain);
+	char *matchstart = qdomain + namelen - domainlen;
+	if (namelen >= domainlen &&
+	    hostname_isequal(matchstart, serv->domain) &&
+	    (domainlen == 0 || namelen == domainlen || *(matchstart-1) == '.' ))
+	  {
+	    if ((serv->flags & SERV_NO_REBIND) && norebind)
+	      *norebind = 1;
+	    else
+	      {
+		unsigned int sflag = serv->addr.sa.sa_family == AF_INET ? F_IPV4 : F_IPV6;
+		if (domainlen != 0 && domainlen == matchlen)
+		  {
+		    if ((serv->flags & SERV_LITERAL_ADDRESS))
+		      {
+			if (!(sflag & qtype) && flags == 0)
+			  continue;
+		      }
+		    else
+		      {
+			if (flags & (F_IPV4 | F_IPV6))
+			  continue;
+		      }
+		  }
+
+		if (domainlen >= matchlen)
+		  {
+		    *type = serv->flags & (SERV_HAS_DOMAIN | SERV_USE_RESOLV | SERV_NO_REBIND | SERV_DO_DNSSEC);
+		    *domain = serv->domain;
+		    matchlen = domainlen;
+		    if (serv->flags & SERV_NO_ADDR)
+		      flags = F_NXDOMAIN;
+		    else if (serv->flags & SERV_LITERAL_ADDRESS)
+		      {
+			if ((serv->flags & SERV_USE_RESOLV) && (qtype & (F_IPV6 | F_IPV4)))
+			  {
+			    flags = qtype;
+			    *addrpp = &zero;
+			  }
+			else if (sflag & qtype)
+			  {
+			    flags = sflag;
+			    if (serv->addr.sa.sa_family == AF_INET)
+			      *addrpp = (union all_addr *)&serv->addr.in.sin_addr;
+			    else
+			      *addrpp = (union all_addr *)&serv->addr.in6.sin6_addr;
+			  }
+			else if (!flags || (flags & F_NXDOMAIN))
+			  flags = F_NOERR;
+		      }
+		    else
+		      flags = 0;
+		  }
+	      }
+	  }
+      }
+
+  r->flags = flags;
+  return flags;
+}
+
+/* The ipset match of process_reply() before domain-trie.c */
+struct ipsets *ref_ipsets(char *name)
+{
+  struct ipsets *ipset_pos, *ret = NULL;
+  unsigned int namelen = strlen(name);
+  unsigned int matchlen = 0;
+
+  for (ipset_pos = daemon->ipsets; ipset_pos; ipset_pos = ipset_pos->next)
+    {
+      unsigned int domainlen = strlen(ipset_pos->domain);
+      char *matchstart = name + namelen - domainlen;
+      if (namelen >= domainlen && hostname_isequal(matchstart, ipset_pos->domain) &&
+	  (domainlen == 0 || namelen == domainlen || *(matchstart - 1) == '.' ) &&
+	  domainlen >= matchlen)
+	{
+	  matchlen = domainlen;
+	  ret = ipset_pos;
+	}
+    }
+
+  return ret;
+}
+
+/* First server of the type and domain, as forward_query() found it */
+struct server *ref_group(int type, char *domain)
+{
+  struct server *serv;
+
+  for (serv = daemon->servers; serv; serv = serv->next)
+    if ((serv->flags & SERV_TYPE) == type &&
+	(type != SERV_HAS_DOMAIN || hostname_isequal(domain, serv->domain)))
+      return serv;
+
+  return NULL;
+}
+
+/* The spoof check of reply_query() before domain-trie.c */
+struct server *ref_server_addr(union mysockaddr *addr)
+{
+  struct server *serv;
+
+  for (serv = daemon->servers; serv; serv = serv->next)
+    if (!(serv->flags & (SERV_LITERAL_ADDRESS | SERV_NO_ADDR)) &&
+	sockaddr_isequal(&serv->addr, addr))
+      break;
+
+  return serv;
+}
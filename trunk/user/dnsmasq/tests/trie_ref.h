@@ -0,0 +1,28 @@
+/* Host harness for src/domain-trie.c: config loading, and the list walks
+   domain-trie.c replaced, kept here as the reference to compare with. */
+
+#ifndef TRIE_REF_H
+#define TRIE_REF_H
+
+#include "dnsmasq.h"
+
+struct ref_result {
+  unsigned int flags;
+  int type, norebind;
+  char *domain;
+  union all_addr *addrp;
+};
+
+void ref_init(void);
+int ref_conf_line(char *line);
+int ref_conf_file(const char *path);
+void ref_build(void);
+
+unsigned int ref_search(int use_trie, unsigned int qtype, char *qdomain, struct ref_result *r, int want_norebind);
+struct ipsets *ref_ipsets(char *name);
+struct server *ref_group(int type, char *domain);
+struct server *ref_server_addr(union mysockaddr *addr);
+
+double ref_now_us(void);
+
+#endif
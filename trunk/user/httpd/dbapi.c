@@ -26,16 +26,17 @@ typedef enum {
     S2IINCONVERTIBLE
 } STR2INT_ERROR;
 
-static int ignore_result(dbclient *client);
+static int ignore_result(dbclient *client, unsigned int delay);
+static int read_reply(dbclient *client, unsigned int delay);
 
-static int write_util(dbclient* client, int len, unsigned int delay) {
+static int write_util(dbclient* client, const char* buf, int len, unsigned int delay) {
     int n, writed_len = 0;
     unsigned int now, timeout;
     struct timeval tv, tv2;
 
     gettimeofday(&tv2, NULL); timeout = (tv2.tv_sec*1000) + (tv2.tv_usec/1000) + delay;
     while(writed_len < len) {
-        n = write(client->remote_fd, client->buf + writed_len, len - writed_len);
+        n = write(client->remote_fd, buf + writed_len, len - writed_len);
         if(n < 0) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
                 gettimeofday(&tv, NULL);
@@ -45,7 +46,9 @@ static int write_util(dbclient* client, int len, unsigned int delay) {
                 }
 
                 usleep(50);
+                continue;
             }
+            break;
         }
 
         writed_len += n;
@@ -163,14 +166,103 @@ int dbclient_bulk(dbclient* client, const char* command, const char* key, int nk
 
     client->buf[n2] = '\0';
 
-    if(0 == write_util(client, n1 + HEADER_PREFIX, 200)) {
-        ignore_result(client);
+    if(0 == write_util(client, client->buf, n1 + HEADER_PREFIX, 200)) {
+        ignore_result(client, 110);
         return 0;
     }
 
     return -1;
 }
 
+//"mset " header of batch
+#define MSET_PREFIX (HEADER_PREFIX + 5)
+
+//queue key for batched set, nv < 0 removes key
+int dbclient_mset(dbclient* client, const char* key, const char* value, int nv) {
+    int nk, n, need;
+    char* p;
+
+    nk = strlen(key);
+    if(nk <= 0) {
+        return -1;
+    }
+
+    need = nk + 14 + _max(nv, 0);// key len value\n
+    if((client->batch_len > MSET_PREFIX) && (client->batch_len - HEADER_PREFIX + need > READ_MAX)) {
+        dbclient_flush(client);
+    }
+
+    if(client->batch_len + need + 1 > client->batch_max) {
+        n = _max(client->batch_max * 2, _max(client->batch_len, MSET_PREFIX) + need + BUF_MAX);
+        p = (char*)realloc(client->batch, n);
+        if(NULL == p) {
+            return -1;
+        }
+        client->batch = p;
+        client->batch_max = n;
+    }
+
+    if(client->batch_len < MSET_PREFIX) {
+        client->batch_len = MSET_PREFIX;
+    }
+
+    p = client->batch + client->batch_len;
+    n = sprintf(p, "%s %d ", key, _max(nv, -1));
+    if(nv > 0) {
+        memcpy(p + n, value, nv);
+        n += nv;
+    }
+    p[n++] = '\n';
+    client->batch_len += n;
+
+    return 0;
+}
+
+//send queued keys in one mset, skipd writes them to disk in its next group commit
+int dbclient_flush(dbclient* client) {
+    int n1, ret = 0;
+
+    if(client->batch_len <= MSET_PREFIX) {
+        return 0;
+    }
+
+    n1 = client->batch_len - HEADER_PREFIX;
+    sprintf(client->batch, "%s%07d mset", MAGIC, n1);
+    client->batch[MSET_PREFIX - 1] = ' ';
+
+    if(0 == write_util(client, client->batch, client->batch_len, 200)) {
+        ret = ignore_result(client, 110);
+    } else {
+        ret = -1;
+    }
+
+    client->batch_len = 0;
+    return ret;
+}
+
+//flush queued keys and wait until skipd has committed all pending writes to disk
+int dbclient_commit(dbclient* client) {
+    int n1, n2;
+
+    if(0 != dbclient_flush(client)) {
+        return -1;
+    }
+
+    n1 = strlen("commit") + 3;//commit -\n
+    check_buf(client, n1 + HEADER_PREFIX);
+    n2 = sprintf(client->buf, "%s%07d commit -\n", MAGIC, n1);
+    if(0 != write_util(client, client->buf, n2, 200)) {
+        return -1;
+    }
+
+    n1 = read_reply(client, COMMIT_DELAY);
+    if(n1 < 0) {
+        return n1;
+    }
+
+    return (0 == strncmp(client->buf, "commit - ok", 11)) ? 0 : -5;
+}
+
 static int read_util(dbclient* client, int len, unsigned int delay) {
     int clen, n;
     unsigned int now, timeout;
@@ -213,12 +305,12 @@ static int read_util(dbclient* client, int len, unsigned int delay) {
     return -3;
 }
 
-static int ignore_result(dbclient *client) {
+static int ignore_result(dbclient *client, unsigned int delay) {
     int n1, n2;
     char* magic = MAGIC;
 
     do {
-        n1 = read_util(client, HEADER_PREFIX, 110);
+        n1 = read_util(client, HEADER_PREFIX, delay);
         if(n1 < 0) {
             return n1;
         }
@@ -234,7 +326,7 @@ static int ignore_result(dbclient *client) {
             return -4;
         }
 
-        n1 = read_util(client, n2, 110);
+        n1 = read_util(client, n2, delay);
         if(n1 < 0) {
             return n1;
         }
@@ -296,17 +388,118 @@ int dbclient_list(dbclient* client, char* prefix, webs_t wp, fn_db_parse fn) {
     n1 = strlen("list") + strlen(prefix) + 2;//list prefix\n
     check_buf(client, n1 + HEADER_PREFIX);
     n2 = sprintf(client->buf, "%s%07d list %s\n", MAGIC, n1, prefix);
-    if(0 != write_util(client, n1 + HEADER_PREFIX, 100)) {
+    if(0 != write_util(client, client->buf, n1 + HEADER_PREFIX, 100)) {
         return -1;
     }
 
     return parse_list_result(client, prefix, wp, fn);
 }
 
+static const char* scan_modes[] = { "all", "keys", "count" };
+
+//read header and body of one reply into client->buf, returns body length
+static int read_reply(dbclient *client, unsigned int delay) {
+    int n1, n2;
+
+    n1 = read_util(client, HEADER_PREFIX, delay);
+    if(n1 < 0) {
+        return n1;
+    }
+
+    if(0 != memcmp(client->buf, MAGIC, MAGIC_LEN)) {
+        //message error
+        return -3;
+    }
+
+    client->buf[HEADER_PREFIX-1] = '\0';
+    if(S2ISUCCESS != str2int(&n2, client->buf+MAGIC_LEN, 10)) {
+        //message error
+        return -4;
+    }
+
+    n1 = read_util(client, n2, _max(delay, 510));
+    if(n1 < 0) {
+        return n1;
+    }
+    client->buf[n2] = '\0';
+
+    return n2;
+}
+
+/* Paged prefix scan, records arrive in chunks of "key len value\n" (or "key\n"
+ * for DB_SCAN_KEYS) and fn is called for each of them, value is "" for keys.
+ * limit 0 for no limit. Returns the number of records, or of matches for
+ * DB_SCAN_COUNT, negative on error */
+int dbclient_scan(dbclient* client, char* prefix, int mode, int offset, int limit, webs_t wp, fn_db_parse fn) {
+    int n1, n2, np, stop = 0;
+    char pref_buf[HEADER_PREFIX+1];
+    char *p1, *p2, *p3, *end;
+
+    if(mode < DB_SCAN_ALL || mode > DB_SCAN_COUNT) {
+        return -1;
+    }
+
+    np = strlen(prefix);
+    check_buf(client, np + 32 + HEADER_PREFIX);
+    n1 = sprintf(client->buf + HEADER_PREFIX, "scan %s %d %d %s\n", scan_modes[mode], offset, limit, prefix);
+    sprintf(pref_buf, "%s%07d ", MAGIC, n1);
+    memcpy(client->buf, pref_buf, HEADER_PREFIX);
+    if(0 != write_util(client, client->buf, n1 + HEADER_PREFIX, 100)) {
+        return -1;
+    }
+
+    for(;;) {
+        n2 = read_reply(client, 110);
+        if(n2 < 0) {
+            return n2;
+        }
+
+        //"end prefix n\n"
+        if(0 == strncmp(client->buf, "end ", 4)) {
+            return atoi(client->buf + 4 + np + 1);
+        }
+        if(0 != strncmp(client->buf, "scan ", 5) || n2 < 5 + np + 1) {
+            return -5;
+        }
+
+        //keep draining the chunks once fn asked to stop
+        end = client->buf + n2;
+        for(p1 = client->buf + 5 + np + 1; p1 < end && !stop; p1 = p3 + 1) {
+            if(DB_SCAN_KEYS == mode) {
+                p3 = memchr(p1, '\n', end - p1);
+                if(NULL == p3) {
+                    return -5;
+                }
+                p2 = p3;
+            } else {
+                p2 = strchr(p1, ' ');
+                if(NULL == p2) {
+                    return -5;
+                }
+                *p2++ = '\0';
+                n1 = strtol(p2, &p3, 10);
+                if(' ' != *p3 || n1 < 0 || n1 + 2 > end - p3) {
+                    return -5;
+                }
+                p2 = p3 + 1;
+                p3 = p2 + n1;
+            }
+            *p3 = '\0';
+
+            if(NULL != fn && 0 != (*fn)(client, wp, prefix, p1, (DB_SCAN_KEYS == mode) ? "" : p2)) {
+                stop = 1;
+            }
+        }
+    }
+}
+
 int dbclient_end(dbclient* client) {
     if(NULL != client->buf) {
         free(client->buf);
     }
+    if(NULL != client->batch) {
+        free(client->batch);
+    }
     if((-1 != client->remote_fd) && (0 != client->remote_fd)) {
         close(client->remote_fd);
     }
@@ -13,6 +13,7 @@
 #define SK_PATH_MAX 128
 #define BUF_MAX 2048
 #define READ_MAX 65536
+#define COMMIT_DELAY 5000 //ms, commit writes db files on flash
 
 #define DELAY_PREFIX "__delay__"
 #define DELAY_PREFIX_LEN 9
@@ -37,13 +38,26 @@ typedef struct _dbclient {
     int buf_max;
     int buf_len;
     int buf_pos;
+
+    char* batch;
+    int batch_max;
+    int batch_len;
 } dbclient;
 
+//modes of dbclient_scan
+#define DB_SCAN_ALL 0
+#define DB_SCAN_KEYS 1
+#define DB_SCAN_COUNT 2
+
 typedef int (*fn_db_parse)(dbclient* client, webs_t wp, char* prefix, char* key, char* value);
 
 int dbclient_start(dbclient* client);
 int dbclient_bulk(dbclient* client, const char* command, const char* key, int nk, const char* value, int nv);
+int dbclient_mset(dbclient* client, const char* key, const char* value, int nv);
+int dbclient_flush(dbclient* client);
+int dbclient_commit(dbclient* client);
 int dbclient_end(dbclient* client);
 int dbclient_list(dbclient* client, char* prefix, webs_t wp, fn_db_parse fn);
+int dbclient_scan(dbclient* client, char* prefix, int mode, int offset, int limit, webs_t wp, fn_db_parse fn);
 #endif
 
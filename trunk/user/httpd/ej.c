@@ -21,10 +21,12 @@
 #include <string.h>
 #include <ctype.h>
 #include <assert.h>
+#include <sys/stat.h>
 
 #include <httpd.h>
 
-#define MAX_PATTERN_LENGTH	1024
+#define EJ_MAX_ARGS		16
+#define EJ_CACHE_SIZE		(1024 * 1024)
 
 static const char *asp_mark1 = "<%", *asp_mark2 = "%>";
 static const char *kw_mark1 = "<#", *kw_mark2 = "#>";
@@ -65,82 +67,58 @@ get_arg(char *args, char **next)
 	return arg;
 }
 
-static int
-call_asp(char *func, FILE *stream)
+/* FNV-1a of key, including trailing '=' */
+static unsigned int
+kw_hash(const char *name, int len)
 {
-	int argc;
-	char *args, *end, *next, *argv[16] = {NULL};
-	struct ej_handler *handler;
-	int success = 0;
-
-	/* Parse out ( args ) */
-	if (!(args = strchr(func, '(')))
-		return 0;
-	if (!(end = unqstrstr(func, ")")))
-		return 0;
-	*args++ = *end = '\0';
+	unsigned int h = 2166136261U;
 
-	/* Set up argv list */
-	for (argc = 0; argc < 16 && args && *args; argc++, args = next) {
-		if (!(argv[argc] = get_arg(args, &next)))
-			break;
-	}
+	while (len-- > 0)
+		h = (h ^ (unsigned char)*name++) * 16777619U;
 
-	/* Call handler */
-	for (handler = &ej_handlers[0]; handler->pattern; handler++) {
-		if (strcmp(handler->pattern, func) == 0){
-			handler->output(0, stream, argc, argv);
-			success = 1;
-			break;
-		}
-	}
-
-	return success;
+	return h;
 }
 
-// Call this function if and only if we can read whole <%....%> pattern.
-static char *
-process_asp(char *s, char *e, FILE *stream)
+/* Index dictionary entries by key, first entry wins on duplicates */
+static int
+build_dict_hash(pkw_t pkw)
 {
-	char *func, *end;
-	int asp_res = 0;
-
-	if (!s || !e || s >= e)
-		return NULL;
-
-	func = s;
+	int i, len;
+	unsigned int h;
+	char *p;
 
-	/* Skip initial whitespace */
-	while (func < e && isspace((int)*func))
-		func++;
+	pkw->hsize = 64;
+	while (pkw->hsize < pkw->len * 2)
+		pkw->hsize <<= 1;
 
-	/* find end of function '<% f(); %>' */
-	end = unqstrstr(func, ";");
-	if (end && end < e && (end-func) > 2) {
-		int asp_flen = end-func + 1;
-		char asp_func[asp_flen];
-		
-		/* copy func */
-		memcpy(asp_func, func, asp_flen-1);
-		asp_func[asp_flen-1] = '\0';
-		
-		/* Call function (1: success, 0: pattern not found) */
-		asp_res = call_asp(asp_func, stream);
+	pkw->hash = malloc(pkw->hsize * sizeof(int));
+	if (!pkw->hash) {
+		pkw->hsize = 0;
+		return 0;
 	}
-
-	if (!asp_res) {
-		/* write pattern unchanged */
-		fwrite(s - strlen(asp_mark1), 1, e - s + strlen(asp_mark1) + strlen(asp_mark2), stream);
+	memset(pkw->hash, 0xff, pkw->hsize * sizeof(int));
+
+	for (i = 0; i < pkw->len; i++) {
+		p = (char *)pkw->idx[i];
+		len = strchr(p, '=') - p + 1;
+		h = kw_hash(p, len) & (pkw->hsize - 1);
+		while (pkw->hash[h] >= 0) {
+			if (strncmp((char *)pkw->idx[pkw->hash[h]], p, len) == 0)
+				break;
+			h = (h + 1) & (pkw->hsize - 1);
+		}
+		if (pkw->hash[h] < 0)
+			pkw->hash[h] = i;
 	}
 
-	/* skip asp_mark2 */
-	return e + strlen(asp_mark2);
+	return 1;
 }
 
 static char*
 search_desc(pkw_t pkw, char *name)
 {
 	int i, len;
+	unsigned int h;
 	char *p, *ret = NULL;
 
 	if (!pkw)
@@ -148,8 +126,19 @@ search_desc(pkw_t pkw, char *name)
 
 	len = strlen(name);
 
+	if (pkw->hash) {
+		h = kw_hash(name, len) & (pkw->hsize - 1);
+		while ((i = pkw->hash[h]) >= 0) {
+			p = (char *)pkw->idx[i];
+			if (strncmp(name, p, len) == 0)
+				return p + len;
+			h = (h + 1) & (pkw->hsize - 1);
+		}
+		return NULL;
+	}
+
 	for (i = 0; i < pkw->len; ++i)  {
-		p = pkw->idx[i];
+		p = (char *)pkw->idx[i];
 		if (strncmp(name, p, len) == 0) {
 			ret = p + len;
 			break;
@@ -159,50 +148,6 @@ search_desc(pkw_t pkw, char *name)
 	return ret;
 }
 
-// Call this function if and only if we can read whole <#....#> pattern.
-static char *
-translate_lang(char *s, char *e, FILE *stream, kw_t *pkw)
-{
-	char *name, *end, *desc = NULL;
-
-	if (!s || !e || s >= e)
-		return NULL;
-
-	name = s;
-
-	/* Skip initial whitespace */
-	while (name < e && isspace((int)*name))
-		name++;
-
-	/* find end of name '<# NNN #>' */
-	end = strstr(name, kw_mark2);
-	if (end && end <= e && (end-name) > 0) {
-		*end++ = '=';	// '#' --> '=', search_desc() need '='
-		*end = '\0';	// '>' --> '\0'
-		
-		desc = search_desc(pkw, name);
-		if (!desc && pkw != &kw_EN)
-			desc = search_desc(&kw_EN, name);
-		
-		if (desc) {
-			/* write translation from dictionary */
-			fputs(desc, stream);
-		} else {
-			/* restore pattern body */
-			*end-- = '>';
-			*end = '#';
-		}
-	}
-
-	if (!desc) {
-		/* write pattern unchanged */
-		fwrite(s - strlen(kw_mark1), 1, e - s + strlen(kw_mark1) + strlen(kw_mark2), stream);
-	}
-
-	/* skip kw_mark2 */
-	return e + strlen(kw_mark2);
-}
-
 char *
 get_alert_msg_from_dict(const char *msg_id)
 {
@@ -231,6 +176,9 @@ release_dictionary(pkw_t pkw)
 	if (pkw->idx)
 		free(pkw->idx);
 
+	if (pkw->hash)
+		free(pkw->hash);
+
 	if (pkw->buf)
 		free(pkw->buf);
 
@@ -242,8 +190,8 @@ load_dictionary(char *lang, pkw_t pkw)
 {
 	FILE *dfp;
 	char dfn[16];
-	char *p, *q;
-	int res, dict_size = 0;
+	char *p, *q, *end;
+	long dict_size;
 
 	if (!pkw)
 		return 0;
@@ -256,62 +204,372 @@ load_dictionary(char *lang, pkw_t pkw)
 	memset(pkw, 0, sizeof(kw_t));
 
 	fseek(dfp, 0L, SEEK_END);
-	dict_size = ftell(dfp) + 128;
+	dict_size = ftell(dfp);
+	fseek(dfp, 0L, SEEK_SET);
 
-	pkw->buf = malloc(dict_size);
+	pkw->buf = malloc(dict_size + 1);
 	if (!pkw->buf) {
 		fclose(dfp);
 		return 0;
 	}
 
+	dict_size = fread(pkw->buf, 1, dict_size, dfp);
+	fclose(dfp);
+
 	snprintf(pkw->dict, sizeof(pkw->dict), "%s", lang);
 	REALLOC_VECTOR (pkw->idx, pkw->len, pkw->tlen, sizeof (unsigned char*));
 
-	fseek(dfp, 0L, SEEK_SET);
-
-	q = pkw->buf;
-
-	while ((res = fscanf(dfp, "%[^\n]", q)) != EOF) {
-		fgetc(dfp);
-		
-		if (res < 1)
-			continue;
-		
-		p = strchr(q, '=');
+	/* split lines in place, keep 'KEY=text' lines */
+	q = (char *)pkw->buf;
+	end = q + dict_size;
+	*end = '\0';
+	for (; q < end; q = p + 1) {
+		p = memchr(q, '\n', end - q);
 		if (!p)
+			p = end;
+		*p = '\0';
+		
+		if (!strchr(q, '='))
 			continue;
 		
 		REALLOC_VECTOR (pkw->idx, pkw->len, pkw->tlen, sizeof (unsigned char*));
-		pkw->idx[pkw->len] = q;
+		pkw->idx[pkw->len] = (unsigned char *)q;
 		pkw->len++;
-		q = p + strlen(p);
-		*q = '\0';
-		q++;
 	}
 
-	fclose(dfp);
+	build_dict_hash(pkw);
+
+	return 1;
+}
+
+/* Compiled template: literal spans, <% hook(args); %> calls and <# key #> names */
+enum {
+	EJ_NODE_TEXT = 0,
+	EJ_NODE_ASP,
+	EJ_NODE_KEY
+};
+
+typedef struct ej_node {
+	int type;
+	const char *text;		/* span in page buffer (raw pattern for ASP/KEY) */
+	int len;
+	struct ej_handler *handler;	/* ASP: resolved hook */
+	char *args;			/* ASP: parsed args, '\0' separated / KEY: "NAME=" */
+	int args_len;
+	int argc;
+	int argv_off[EJ_MAX_ARGS];
+} ej_node_t;
+
+typedef struct ej_page {
+	struct ej_page *next;
+	char *url;
+	time_t mtime;
+	off_t size;
+	char *buf;
+	int len, tlen;
+	ej_node_t *node;
+	int flags;			/* EJ_FLAG_* of all hooks in page */
+	size_t mem;
+} ej_page_t;
+
+static ej_page_t *ej_cache = NULL;
+static size_t ej_cache_mem = 0;
+
+/* Parse '<% f(args); %>' body, returns 0 if it is not a valid hook call */
+static int
+compile_asp(ej_node_t *n, const char *s, const char *e)
+{
+	char *func, *end, *args, *next, *argv[EJ_MAX_ARGS];
+	struct ej_handler *handler;
+	int i, argc;
+
+	/* Skip initial whitespace */
+	while (s < e && isspace((int)*s))
+		s++;
+
+	func = strndup(s, e - s);
+	if (!func)
+		return 0;
+
+	/* find end of function '<% f(); %>' */
+	end = unqstrstr(func, ";");
+	if (!end || (end - func) <= 2)
+		goto fail;
+	*end = '\0';
+
+	/* Parse out ( args ) */
+	if (!(args = strchr(func, '(')))
+		goto fail;
+	if (!(end = unqstrstr(func, ")")))
+		goto fail;
+	*args++ = *end = '\0';
+
+	for (handler = &ej_handlers[0]; handler->pattern; handler++) {
+		if (strcmp(handler->pattern, func) == 0)
+			break;
+	}
+	if (!handler->pattern)
+		goto fail;
+
+	/* Set up argv list */
+	for (argc = 0; argc < EJ_MAX_ARGS && args && *args; argc++, args = next) {
+		if (!(argv[argc] = get_arg(args, &next)))
+			break;
+	}
+
+	n->type = EJ_NODE_ASP;
+	n->handler = handler;
+	n->args = func;
+	n->args_len = (e - s) + 1;
+	n->argc = argc;
+	for (i = 0; i < argc; i++)
+		n->argv_off[i] = argv[i] - func;
+
+	return 1;
+
+fail:
+	free(func);
+	return 0;
+}
+
+/* Parse '<# NAME #>' body, key is stored as 'NAME=' for search_desc() */
+static int
+compile_key(ej_node_t *n, const char *s, const char *e)
+{
+	/* Skip initial whitespace */
+	while (s < e && isspace((int)*s))
+		s++;
+
+	if (e <= s)
+		return 0;
+
+	n->args = malloc((e - s) + 2);
+	if (!n->args)
+		return 0;
+
+	memcpy(n->args, s, e - s);
+	n->args[e - s] = '=';
+	n->args[e - s + 1] = '\0';
+	n->args_len = (e - s) + 2;
+	n->type = EJ_NODE_KEY;
 
 	return 1;
 }
 
+static ej_node_t *
+page_add_node(ej_page_t *page, int type, const char *text, int len)
+{
+	ej_node_t *n;
+
+	if (len <= 0)
+		return NULL;
+
+	/* merge adjacent literal spans */
+	if (type == EJ_NODE_TEXT && page->len > 0) {
+		n = &page->node[page->len - 1];
+		if (n->type == EJ_NODE_TEXT && n->text + n->len == text) {
+			n->len += len;
+			return n;
+		}
+	}
+
+	REALLOC_VECTOR(page->node, page->len, page->tlen, sizeof(ej_node_t));
+	n = &page->node[page->len++];
+	n->type = type;
+	n->text = text;
+	n->len = len;
+
+	return n;
+}
+
+static void
+page_free(ej_page_t *page)
+{
+	int i;
+
+	for (i = 0; i < page->len; i++) {
+		if (page->node[i].args)
+			free(page->node[i].args);
+	}
+	free(page->node);
+	free(page->buf);
+	free(page->url);
+	free(page);
+}
+
+static ej_page_t *
+page_compile(const char *url, const struct stat *st)
+{
+	FILE *fp;
+	ej_page_t *page;
+	ej_node_t *n;
+	char *p, *end, *asp, *key, *mark_end;
+	int i;
+
+	if (!(fp = fopen(url, "r")))
+		return NULL;
+
+	page = calloc(1, sizeof(*page));
+	if (!page)
+		goto fail;
+
+	page->url = strdup(url);
+	page->buf = malloc(st->st_size + 1);
+	if (!page->url || !page->buf)
+		goto fail;
+
+	page->size = fread(page->buf, 1, st->st_size, fp);
+	page->buf[page->size] = '\0';
+	page->mtime = st->st_mtime;
+
+	fclose(fp);
+	fp = NULL;
+
+	p = page->buf;
+	end = page->buf + page->size;
+	while (p < end) {
+		asp = strstr(p, asp_mark1);
+		key = strstr(p, kw_mark1);
+		if (!asp && !key) {
+			page_add_node(page, EJ_NODE_TEXT, p, end - p);
+			break;
+		}
+		
+		if (asp && (!key || asp < key)) {
+			mark_end = strstr(asp + 2, asp_mark2);
+			if (!mark_end) {
+				page_add_node(page, EJ_NODE_TEXT, p, end - p);
+				break;
+			}
+			page_add_node(page, EJ_NODE_TEXT, p, asp - p);
+			n = page_add_node(page, EJ_NODE_ASP, asp, mark_end + 2 - asp);
+			if (!compile_asp(n, asp + 2, mark_end))
+				n->type = EJ_NODE_TEXT;
+		} else {
+			mark_end = strstr(key + 2, kw_mark2);
+			if (!mark_end) {
+				page_add_node(page, EJ_NODE_TEXT, p, end - p);
+				break;
+			}
+			page_add_node(page, EJ_NODE_TEXT, p, key - p);
+			n = page_add_node(page, EJ_NODE_KEY, key, mark_end + 2 - key);
+			if (!compile_key(n, key + 2, mark_end))
+				n->type = EJ_NODE_TEXT;
+		}
+		p = mark_end + 2;
+	}
+
+	page->mem = sizeof(*page) + page->size + page->tlen * sizeof(ej_node_t);
+	for (i = 0; i < page->len; i++) {
+		page->mem += page->node[i].args_len;
+		if (page->node[i].type == EJ_NODE_ASP)
+			page->flags |= page->node[i].handler->flags;
+	}
+
+	return page;
+
+fail:
+	if (fp)
+		fclose(fp);
+	if (page) {
+		free(page->buf);
+		free(page->url);
+		free(page);
+	}
+	return NULL;
+}
+
+/* Find or (re)compile page, most recently used page is on list head */
+static ej_page_t *
+page_lookup(const char *url)
+{
+	struct stat st;
+	ej_page_t *page, **pp, **tail;
+
+	if (stat(url, &st) != 0 || !S_ISREG(st.st_mode))
+		return NULL;
+
+	for (pp = &ej_cache; (page = *pp) != NULL; pp = &page->next) {
+		if (strcmp(page->url, url) == 0) {
+			*pp = page->next;
+			if (page->mtime == st.st_mtime && page->size == st.st_size)
+				break;
+			ej_cache_mem -= page->mem;
+			page_free(page);
+			page = NULL;
+			break;
+		}
+	}
+
+	if (!page) {
+		page = page_compile(url, &st);
+		if (!page)
+			return NULL;
+		ej_cache_mem += page->mem;
+	}
+
+	page->next = ej_cache;
+	ej_cache = page;
+
+	/* drop least recently used pages over limit */
+	while (ej_cache_mem > EJ_CACHE_SIZE && ej_cache->next) {
+		for (tail = &ej_cache->next; (*tail)->next; tail = &(*tail)->next);
+		ej_cache_mem -= (*tail)->mem;
+		page_free(*tail);
+		*tail = NULL;
+	}
+
+	return page;
+}
+
+int
+ej_hook_flags(const char *name)
+{
+	struct ej_handler *handler;
+
+	for (handler = &ej_handlers[0]; handler->pattern; handler++) {
+		if (strcmp(handler->pattern, name) == 0)
+			return handler->flags;
+	}
+
+	return 0;
+}
+
+/* Compile page in advance and tell what its hooks need */
+int
+ej_page_flags(const char *url)
+{
+	ej_page_t *page = page_lookup(url);
+
+	return (page) ? page->flags : 0;
+}
+
+static void
+render_asp(const ej_node_t *n, FILE *stream)
+{
+	char args[n->args_len];
+	char *argv[EJ_MAX_ARGS + 1] = {NULL};
+	int i;
+
+	/* hooks may modify args, pass private copy */
+	memcpy(args, n->args, n->args_len);
+	for (i = 0; i < n->argc; i++)
+		argv[i] = args + n->argv_off[i];
+
+	n->handler->output(0, stream, n->argc, argv);
+}
+
 // This translation engine can not process <%...%> interlace with <#...#>
 void
 do_ej(const char *url, FILE *stream)
 {
-#define FRAG_SIZE	128
-#define RESERVE_SIZE	4
-	FILE *fp;
-	int frag_size = FRAG_SIZE;
-	int pattern_size = MAX_PATTERN_LENGTH - RESERVE_SIZE;
-	char pat_buf[MAX_PATTERN_LENGTH];
-	char *pattern = pat_buf, *asp = NULL, *asp_end = NULL, *key = NULL, *key_end = NULL;
-	char *start_pat, *end_pat, *lang;
+	ej_page_t *page;
+	const ej_node_t *n;
+	char *lang, *desc;
 	pkw_t pkw = &kw_EN;
-	int conn_break = 0;
-	size_t ret, read_len, len;
-	int no_translate = 1;
+	int i;
 
-	if (!(fp = fopen(url, "r")))
+	if (!(page = page_lookup(url)))
 		return;
 
 	// Load dictionary file
@@ -328,143 +586,28 @@ do_ej(const char *url, FILE *stream)
 			release_dictionary(&kw_XX);
 	}
 
-	if (pkw->buf)
-		no_translate = 0;
-
-	start_pat = end_pat = pattern;
-	memset (pattern + pattern_size, 0, 4);
-	while (conn_break == 0)
-	{
-		int special;
-
-		// Arrange pattern[] if available buffer length (end_pat~pattern[pattern_size]) is smaller than frag_size
-		if (((pattern + pattern_size) - end_pat) < frag_size)
-		{
-			len = end_pat - start_pat;
-			memcpy (pattern, start_pat, len);
-			start_pat = pattern;
-			end_pat = start_pat + len;
-			*end_pat = '\0';
+	for (i = 0; i < page->len; i++) {
+		n = &page->node[i];
+		if (n->type == EJ_NODE_ASP) {
+			render_asp(n, stream);
+			continue;
 		}
-
-		read_len = (pattern + pattern_size) - end_pat;
-		len = fread (end_pat, 1, read_len, fp);
-		if (len == 0)   {
-			if (start_pat < end_pat){
-				fwrite (start_pat, 1, (size_t) (end_pat - start_pat), stream);
+		
+		if (n->type == EJ_NODE_KEY && pkw->buf) {
+			desc = search_desc(pkw, n->args);
+			if (!desc && pkw != &kw_EN)
+				desc = search_desc(&kw_EN, n->args);
+			if (desc) {
+				fputs(desc, stream);
+				continue;
 			}
-			break;
 		}
-		end_pat += len;
-		*end_pat = '\0';
-
-		asp = strstr (start_pat, asp_mark1);
-		key = NULL;
-		if (no_translate == 0)  {
-			key = strstr (start_pat, kw_mark1);
+		
+		if (fwrite(n->text, 1, n->len, stream) < n->len) {
+			/* the connection had been damaged. DO NOT process another data. */
+			break;
 		}
-		special = 0;
-		while ((start_pat < end_pat) && special == 0)
-		{
-			int postproc = 0;       /* 0: need more data; 1: translate; 2: execute asp; 3: write only; */
-			char *s, *e, *p;
-
-			/*				 asp      asp_end
-			 *				 ^	^
-			 *      +------------------------------<%.......%>-------------------------------+
-			 *  |	 XXXXXXXXXXXXXXXXXXXXX<#.......#>YYYYYYYYYYYYYYYYYY0	    |0000
-			 *  +------------------------------------------------------------------------+
-			 *  ^	 ^		    ^	^ ^		 ^	     ^
-			 *  |	 |		    |	| p		 |	     |
-			 *  pattern   start_pat,s	  key,e(2) key_end	     end_pat,e(1)  pattern + pattern_size
-			 *				     ^				|
-			 *				     +--------------------------------+
-			 *
-			 */
-
-			// If <%...%> and <#...#> do not exist in pattern[], write whole pattern[].
-			s = start_pat;
-			e = end_pat;
-
-			if (key != NULL && asp == NULL) {
-				e = key;						// Write start_pat ~ (key - 1)
-				key_end = strstr (key, kw_mark2);
-				if (key_end != NULL)    {	       // We do have <#...#> in pattern[].
-					postproc = 1;
-				}
-			} else if (key != NULL && asp != NULL)  {
-				// We have <%...%> and <#...#> in pattern[], process first occurrence
-				if (asp < key)  {
-					e = asp;					// Write start_pat ~ (asp - 1)
-					asp_end = strstr (asp, asp_mark2);
-					if (asp_end != NULL)    {       // We do have whole <%...%>.
-						postproc = 2;
-					}
-				} else {
-					e = key;					// Write start_pat ~ (key - 1)
-					key_end = strstr (key, kw_mark2);
-					if (key_end != NULL)    {       // We do have whole <#...#>.
-						postproc = 1;
-					}
-				}
-			} else if (key == NULL && asp != NULL)  {
-				e = asp;						// Write start_pat ~ (asp - 1)
-				asp_end = strstr (asp, asp_mark2);
-				if (asp_end != NULL)    {	       // We do have whole <%...%>.
-					postproc = 2;
-				}
-			} else {
-				// Special case. If last character is '<'
-				// DO NOT write this character due to next one may be % or #.
-				if (*(e-1) == *asp_mark1 || *(e-1) == *kw_mark1)	{
-					special = 1;
-					e--;
-				}
-				postproc = 3;
-			}
-
-			// process text preceeding <# or <%
-			if (e > s)      {
-				ret = fwrite (s, 1, (size_t) (e - s), stream);
-				if (ret == 0 || ret < (e - s))  {
-					/* the connection had been damaged. DO NOT process another data. */
-					/* (reduce response time of httpd) */
-//					cprintf ("fwrite() ret %d, s %p e %p len %d, break do_ej()'s while loop\n", ret, s, e, e-s);
-					conn_break = 1;
-					break;
-				} else {
-					start_pat = e;
-				}
-			}
-			// post process
-			p = NULL;
-			if (postproc == 1) {			    // translate
-				p = translate_lang (key + strlen (kw_mark1), key_end, stream, pkw);
-				if (no_translate == 0 && p != NULL)     {
-					key = strstr (p, kw_mark1);
-				}
-			} else if (postproc == 2)       {	       // execute asp
-				p = process_asp (asp + strlen (asp_mark1), asp_end, stream);
-				if (p != NULL)  {
-					asp = strstr (p, asp_mark1);
-				}
-			} else if (postproc == 3)       {	       // no <%...%> or <#...#>
-				p = e;
-			} else if (postproc == 0)       {	       // read more data
-				break;
-			}
-
-			if (p != NULL)  {
-				start_pat = p;
-			}
-
-		}       /* while ((start_pat < end_pat) && special == 0) */
-	}	       /* while (conn_break == 0) */
-
-	fclose(fp);
-
-	if (pattern != pat_buf)
-		free (pattern);
+	}
 
 	fflush(stream);
 }
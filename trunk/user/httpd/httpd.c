@@ -32,8 +32,12 @@
 #include <netinet/tcp.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <poll.h>
 #include <assert.h>
 #include <sys/ioctl.h>
 #include <arpa/inet.h>
@@ -41,6 +45,7 @@
 #include <ifaddrs.h>
 
 #include <bsd_queue.h>
+#include <zlib.h>
 
 #include "httpd.h"
 #include "common.h"
@@ -50,11 +55,22 @@
 #define SERVER_PORT		80
 #define SERVER_PORT_SSL		443
 #define PROTOCOL		"HTTP/1.0"
+#define PROTOCOL_11		"HTTP/1.1"
 #define CACHE_AGE_VAL		(30 * (24*60*60))
 #define RFC1123FMT		"%a, %d %b %Y %H:%M:%S GMT"
 #define MAX_LISTEN_BACKLOG	511
 #define MAX_CONN_ACCEPT		50
 #define MAX_CONN_TIMEOUT	30
+#define MAX_CONN_REQUESTS	100
+#define MAX_CONN_WORKERS	2
+#define MAX_CONN_EVENTS		16
+#define MAX_CONN_HELD		16	/* long-poll requests parked at once */
+#define CONN_HOLD_TIMEOUT	25	/* sec, long-poll is answered w/o news after it */
+#define KEEPALIVE_TIMEOUT	15
+#define CONN_BUF_SIZE		4096
+#define CONN_BUF_MAX		65536		/* request is buffered whole up to this size */
+#define CONN_WBUF_MAX		(256*1024)	/* response buffered by main process, more waits for client */
+#define CONN_WBUF_WAIT		5		/* sec, main process waits for client to take over CONN_WBUF_MAX */
 #define MAX_AUTH_LEN		128
 
 /* A multi-family in_addr. */
@@ -83,8 +99,37 @@ typedef struct conn_item {
 	int fd;
 #if defined (SUPPORT_HTTPS)
 	int ssl;
+	int ssl_ready;
+	void *ssl_conn;
 #endif
 	usockaddr usa;
+	FILE *fp;
+	long atime;
+	int requests;
+	int http11;
+	int keep_alive;		/* connection stays open after response */
+	int chunked;		/* response body in chunked encoding */
+	int nowait;		/* read only what is already received */
+	int broken;
+	int detached;		/* handed over to worker process */
+	int gzip;		/* response body is precompressed file */
+	int vary;		/* response depends on Accept-Encoding */
+	int direct;		/* worker process, I/O waits for socket */
+	int closing;		/* close after pending output is sent */
+	int held;		/* long-poll request parked in rbuf */
+	long hold_until;	/* long-poll deadline, 0 if not holding */
+	uint32_t events;	/* epoll events armed */
+	int rpos;
+	int rlen;
+	int rsize;
+	char *rbuf;
+	size_t wpos;
+	size_t wlen;
+	size_t wsize;
+	char *wbuf;		/* response not yet sent by main process */
+	int file_fd;		/* file body queued after wbuf */
+	off_t file_pos;
+	off_t file_end;
 } conn_item_t;
 
 typedef struct conn_list {
@@ -107,6 +152,11 @@ int http_is_ssl = 0;
 #endif
 
 static int daemon_exit = 0;
+static int epoll_fd = -1;
+static int http_worker = 0;
+static pid_t http_workers[MAX_CONN_WORKERS];
+static int http_held = 0;
+static conn_item_t *http_conn = NULL;		// connection of current request
 static int http_has_lang = 0;
 static int http_acl_mode = 0;
 static int login_safe = 0;		// the login from LAN/VPN
@@ -122,8 +172,8 @@ static const struct in6_addr in6in4addr_loopback = {{{0x00, 0x00, 0x00, 0x00,
                                                       0x7f, 0x00, 0x00, 0x01}}};
 #endif
 
-kw_t kw_EN = {0, 0, {0, 0, 0, 0}, NULL, NULL};
-kw_t kw_XX = {0, 0, {0, 0, 0, 0}, NULL, NULL};
+kw_t kw_EN = {0, 0, {0, 0, 0, 0}, NULL, NULL, 0, NULL};
+kw_t kw_XX = {0, 0, {0, 0, 0, 0}, NULL, NULL, 0, NULL};
 
 const int int_1 = 1;
 
@@ -595,16 +645,361 @@ initialize_listen_socket(usockaddr* usaP, int http_port)
 	return listen_fd;
 }
 
+static ssize_t
+conn_recv(conn_item_t *item, char *buf, size_t len)
+{
+#if defined (SUPPORT_HTTPS)
+	if (item->ssl)
+		return ssl_server_read(item->ssl_conn, buf, len);
+#endif
+	return recv(item->fd, buf, len, 0);
+}
+
+static ssize_t
+conn_send(conn_item_t *item, const char *buf, size_t len, int more)
+{
+#if defined (SUPPORT_HTTPS)
+	if (item->ssl)
+		return ssl_server_write(item->ssl_conn, buf, len);
+#endif
+	return send(item->fd, buf, len, MSG_NOSIGNAL | ((more) ? MSG_MORE : 0));
+}
+
+/* Wait socket is ready for I/O in worker process, socket is non-blocking */
+static int
+conn_poll(conn_item_t *item, short events, int timeout)
+{
+	struct pollfd pfd;
+	int ret;
+
+#if defined (SUPPORT_HTTPS)
+	if (item->ssl && ssl_server_want_write(item->ssl_conn))
+		events = POLLOUT;
+#endif
+	pfd.fd = item->fd;
+	pfd.events = events;
+
+	do {
+		ret = poll(&pfd, 1, timeout);
+	} while (ret < 0 && errno == EINTR);
+
+	return (ret > 0) ? 0 : -1;
+}
+
+static ssize_t
+conn_read(conn_item_t *item, char *buf, size_t len)
+{
+	ssize_t nr;
+
+	for (;;) {
+		nr = conn_recv(item, buf, len);
+		if (nr >= 0)
+			return nr;
+		if (errno == EINTR)
+			continue;
+		/* main process reads only buffered request */
+		if (errno != EAGAIN || item->nowait || !item->direct)
+			return -1;
+		if (conn_poll(item, POLLIN, MAX_CONN_TIMEOUT * 1000) < 0)
+			return -1;
+	}
+}
+
+/* Backpressure for response over CONN_WBUF_MAX, main process sends
+ * what the client takes until len fits, waits at most CONN_WBUF_WAIT */
+static int
+conn_wbuf_push(conn_item_t *item, size_t len)
+{
+	long now, until = uptime() + CONN_WBUF_WAIT;
+	ssize_t ns;
+
+	while (item->wpos < item->wlen && (item->wlen - item->wpos) + len > CONN_WBUF_MAX) {
+		ns = conn_send(item, item->wbuf + item->wpos, item->wlen - item->wpos, 1);
+		if (ns > 0) {
+			item->wpos += ns;
+			continue;
+		}
+		if (ns < 0 && errno == EINTR)
+			continue;
+		if (ns == 0 || errno != EAGAIN)
+			return -1;
+		now = uptime();
+		if (now >= until || conn_poll(item, POLLOUT, (until - now) * 1000) < 0)
+			return -1;
+	}
+
+	if (item->wpos > 0) {
+		memmove(item->wbuf, item->wbuf + item->wpos, item->wlen - item->wpos);
+		item->wlen -= item->wpos;
+		item->wpos = 0;
+	}
+
+	return 0;
+}
+
+static int
+conn_wbuf_reserve(conn_item_t *item, size_t len)
+{
+	size_t size;
+	char *wbuf;
+
+	if (item->wlen + len <= item->wsize)
+		return 0;
+
+	if (item->wlen + len > CONN_WBUF_MAX && !item->direct) {
+		if (conn_wbuf_push(item, len) < 0) {
+			httpd_log("Client does not take response, drop.");
+			return -1;
+		}
+		if (item->wlen + len <= item->wsize)
+			return 0;
+	}
+
+	for (size = (item->wsize) ? item->wsize : CONN_BUF_SIZE; size < item->wlen + len; size <<= 1);
+	if (size > CONN_WBUF_MAX) {
+		httpd_log("Response is too large (%u bytes), drop.", (unsigned int)(item->wlen + len));
+		return -1;
+	}
+
+	wbuf = realloc(item->wbuf, size);
+	if (!wbuf)
+		return -1;
+
+	item->wbuf = wbuf;
+	item->wsize = size;
+
+	return 0;
+}
+
+/* Append part of queued file to wbuf */
+static ssize_t
+conn_file_load(conn_item_t *item, off_t max)
+{
+	off_t len = item->file_end - item->file_pos;
+	ssize_t nr;
+
+	if (len > max)
+		len = max;
+	if (conn_wbuf_reserve(item, len) < 0)
+		return -1;
+
+	nr = pread(item->file_fd, item->wbuf + item->wlen, len, item->file_pos);
+	if (nr <= 0)
+		return -1;
+
+	item->wlen += nr;
+	item->file_pos += nr;
+
+	return nr;
+}
+
+static void
+conn_file_close(conn_item_t *item)
+{
+	if (item->file_fd >= 0) {
+		close(item->file_fd);
+		item->file_fd = -1;
+	}
+}
+
+/* More output after queued file, keep order */
+static int
+conn_file_drain(conn_item_t *item)
+{
+	int ret = 0;
+
+	while (item->file_fd >= 0 && item->file_pos < item->file_end) {
+		if (conn_file_load(item, CONN_BUF_MAX) < 0) {
+			ret = -1;
+			break;
+		}
+	}
+	conn_file_close(item);
+
+	return ret;
+}
+
+/* Body of regular file is sent by event loop, fd is kept open */
+static int
+conn_file_queue(conn_item_t *item, int fd, off_t offset, off_t len)
+{
+	if (conn_file_drain(item) < 0)
+		return -1;
+
+	item->file_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if (item->file_fd < 0)
+		return -1;
+
+	item->file_pos = offset;
+	item->file_end = offset + len;
+
+	return 0;
+}
+
+static int
+conn_write(conn_item_t *item, const char *buf, size_t len, int more)
+{
+	ssize_t nw;
+
+	/* main process waits for socket only past CONN_WBUF_MAX, see conn_flush() */
+	if (!item->direct) {
+		if (conn_file_drain(item) < 0)
+			return -1;
+		while (len > 0) {
+			nw = (len > CONN_BUF_MAX) ? CONN_BUF_MAX : len;
+			if (conn_wbuf_reserve(item, nw) < 0)
+				return -1;
+			memcpy(item->wbuf + item->wlen, buf, nw);
+			item->wlen += nw;
+			buf += nw;
+			len -= nw;
+		}
+		return 0;
+	}
+
+	while (len > 0) {
+		nw = conn_send(item, buf, len, more);
+		if (nw > 0) {
+			buf += nw;
+			len -= nw;
+			continue;
+		}
+		if (nw < 0 && errno == EINTR)
+			continue;
+		if (nw == 0 || errno != EAGAIN || conn_poll(item, POLLOUT, MAX_CONN_TIMEOUT * 1000) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* stdio stream over connection, read is never ahead of current line */
+static ssize_t
+http_conn_read(void *cookie, char *buf, size_t len)
+{
+	conn_item_t *item = (conn_item_t *)cookie;
+	ssize_t nr;
+	char *nl;
+
+	if (item->rpos >= item->rlen) {
+		item->rpos = 0;
+		item->rlen = 0;
+		nr = conn_read(item, item->rbuf, item->rsize);
+		if (nr <= 0) {
+			if (nr < 0 && !item->nowait)
+				item->broken = 1;
+			return (nr < 0 && item->nowait) ? 0 : nr;
+		}
+		item->rlen = nr;
+	}
+
+	nr = item->rlen - item->rpos;
+	nl = memchr(item->rbuf + item->rpos, '\n', nr);
+	if (nl)
+		nr = nl - (item->rbuf + item->rpos) + 1;
+	if (nr > len)
+		nr = len;
+
+	memcpy(buf, item->rbuf + item->rpos, nr);
+	item->rpos += nr;
+
+	return nr;
+}
+
+static ssize_t
+http_conn_write(void *cookie, const char *buf, size_t len)
+{
+	conn_item_t *item = (conn_item_t *)cookie;
+	char chunk[16];
+	int ret;
+
+	if (item->broken)
+		return -1;
+
+	if (len < 1)
+		return 0;
+
+	if (item->chunked) {
+		sprintf(chunk, "%x\r\n", (unsigned int)len);
+		ret = conn_write(item, chunk, strlen(chunk), 1);
+		if (ret == 0)
+			ret = conn_write(item, buf, len, 1);
+		if (ret == 0)
+			ret = conn_write(item, "\r\n", 2, 0);
+	} else {
+		ret = conn_write(item, buf, len, 0);
+	}
+
+	if (ret < 0) {
+		item->broken = 1;
+		item->keep_alive = 0;
+		return -1;
+	}
+
+	return len;
+}
+
+static int
+http_conn_close(void *cookie)
+{
+	conn_item_t *item = (conn_item_t *)cookie;
+
+#if defined (SUPPORT_HTTPS)
+	if (item->ssl_conn) {
+		ssl_server_close(item->ssl_conn, item->ssl_ready && !item->broken && !item->detached);
+		item->ssl_conn = NULL;
+	}
+#endif
+	/* worker still owns socket */
+	if (!item->detached)
+		shutdown(item->fd, SHUT_RDWR);
+
+	close(item->fd);
+	item->fd = -1;
+
+	return 0;
+}
+
+static const cookie_io_functions_t http_conn_io = {
+	.read  = http_conn_read,
+	.write = http_conn_write,
+	.seek  = NULL,
+	.close = http_conn_close
+};
+
+/* Complete response of current request */
+static void
+http_conn_finish(conn_item_t *item)
+{
+	fflush(item->fp);
+
+	if (item->chunked) {
+		item->chunked = 0;
+		if (!item->broken && conn_write(item, "0\r\n\r\n", 5, 0) < 0) {
+			item->broken = 1;
+			item->keep_alive = 0;
+		}
+	}
+}
+
+static void
+make_etag(const struct stat *st, char *buf, size_t len)
+{
+	snprintf(buf, len, "\"%lx-%lx\"", (unsigned long)st->st_mtime, (unsigned long)st->st_size);
+}
+
 static void
 send_headers( int status, const char *title, const char *extra_header, const char *mime_type, const struct stat *st, FILE *conn_fp )
 {
 	time_t now;
 	char timebuf[64];
+	int has_length = 0, chunked = 0;
+	conn_item_t *item = http_conn;
 
 	now = time(NULL);
 	strftime( timebuf, sizeof(timebuf), RFC1123FMT, gmtime( &now ) );
 
-	fprintf( conn_fp, "%s %d %s\r\n", PROTOCOL, status, title );
+	fprintf( conn_fp, "%s %d %s\r\n", (item && item->http11) ? PROTOCOL_11 : PROTOCOL, status, title );
 	fprintf( conn_fp, "Server: %s\r\n", SERVER_NAME );
 	fprintf( conn_fp, "Date: %s\r\n", timebuf );
 	if (extra_header) {
@@ -618,19 +1013,47 @@ send_headers( int status, const char *title, const char *extra_header, const cha
 			now = st->st_mtime;
 			strftime( timebuf, sizeof(timebuf), RFC1123FMT, gmtime( &now ) );
 			fprintf( conn_fp, "Last-Modified: %s\r\n", timebuf );
+			make_etag(st, timebuf, sizeof(timebuf));
+			fprintf( conn_fp, "ETag: %s\r\n", timebuf );
 		}
-		if (st->st_size > 0)
+		if (item && item->gzip)
+			fprintf( conn_fp, "Content-Encoding: gzip\r\n" );
+		if (item && item->vary)
+			fprintf( conn_fp, "Vary: Accept-Encoding\r\n" );
+		if (st->st_size > 0 && status != 304) {
 			fprintf( conn_fp, "Content-Length: %lu\r\n", st->st_size );
+			has_length = 1;
+		}
 	}
 	if (mime_type)
 		fprintf( conn_fp, "Content-Type: %s\r\n", mime_type );
-	fprintf( conn_fp, "Connection: close\r\n" );
+	if (item && item->keep_alive) {
+		/* Persistent connection needs known body end */
+		if (!has_length && status != 304) {
+			if (item->http11)
+				chunked = 1;
+			else
+				item->keep_alive = 0;
+		}
+	}
+	if (chunked)
+		fprintf( conn_fp, "Transfer-Encoding: chunked\r\n" );
+	fprintf( conn_fp, "Connection: %s\r\n", (item && item->keep_alive) ? "keep-alive" : "close" );
 	fprintf( conn_fp, "\r\n" );
+
+	if (chunked) {
+		fflush( conn_fp );
+		item->chunked = 1;
+	}
 }
 
 static void
 send_error( int status, const char *title, const char *extra_header, const char *text, FILE *conn_fp )
 {
+	/* rest of request may be unread, don't reuse connection */
+	if (http_conn)
+		http_conn->keep_alive = 0;
+
 	send_headers( status, title, extra_header, "text/html", NULL, conn_fp );
 	fprintf( conn_fp, "<HTML><HEAD><TITLE>%d %s</TITLE></HEAD>\n<BODY BGCOLOR=\"#cc9999\"><H4>%d %s</H4>\n", status, title, status, title );
 	fprintf( conn_fp, "%s\n", text );
@@ -766,17 +1189,15 @@ eat_post_data(FILE *conn_fp, int clen)
 }
 
 static void
-try_pull_data(FILE *conn_fp, int conn_fd)
+try_pull_data(FILE *conn_fp, conn_item_t *item)
 {
-	int flags = fcntl(conn_fd, F_GETFL);
-
 	/* Read up to two more characters */
-	if (flags != -1 && fcntl(conn_fd, F_SETFL, flags | O_NONBLOCK) != -1) {
-		if (fgetc(conn_fp) != EOF)
-			fgetc(conn_fp);
-		
-		fcntl(conn_fd, F_SETFL, flags);
-	}
+	item->nowait = 1;
+	if (fgetc(conn_fp) != EOF)
+		fgetc(conn_fp);
+	item->nowait = 0;
+
+	clearerr(conn_fp);
 }
 
 int
@@ -796,18 +1217,103 @@ do_fwrite(const char *buffer, int len, FILE *stream)
 	return r;
 }
 
+/* Zero-copy file body in worker, only for plain HTTP w/o chunked encoding */
+static int
+conn_sendfile(conn_item_t *item, int fd, off_t offset, off_t size)
+{
+	ssize_t ns;
+
+	size += offset;
+	while (offset < size) {
+		ns = sendfile(item->fd, fd, &offset, size - offset);
+		if (ns > 0)
+			continue;
+		if (ns < 0 && errno == EINTR)
+			continue;
+		if (ns == 0 || errno != EAGAIN || conn_poll(item, POLLOUT, MAX_CONN_TIMEOUT * 1000) < 0) {
+			item->broken = 1;
+			item->keep_alive = 0;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Send part of regular file */
+void
+do_file_range(int fd, off_t offset, off_t len, FILE *stream)
+{
+	char buf[4096];
+	ssize_t nr;
+	conn_item_t *item = http_conn;
+
+	if (item && item->fp == stream && !item->chunked && !item->broken) {
+		fflush(stream);
+		if (!item->direct) {
+			if (conn_file_queue(item, fd, offset, len) == 0)
+				return;
+		}
+#if defined (SUPPORT_HTTPS)
+		else if (!item->ssl)
+#else
+		else
+#endif
+		{
+			conn_sendfile(item, fd, offset, len);
+			return;
+		}
+	}
+
+	while (len > 0) {
+		nr = pread(fd, buf, (len < sizeof(buf)) ? len : sizeof(buf), offset);
+		if (nr <= 0)
+			break;
+		if (fwrite(buf, 1, nr, stream) < nr)
+			break;
+		offset += nr;
+		len -= nr;
+	}
+}
+
 void
 do_file(const char *url, FILE *stream)
 {
-	FILE *fp;
+	struct stat st;
 	char buf[1024];
+	ssize_t nr;
+	int fd;
+
+	fd = open(url, O_RDONLY);
+	if (fd >= 0) {
+		if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+			do_file_range(fd, 0, st.st_size, stream);
+		} else {
+			while ((nr = read(fd, buf, sizeof(buf))) > 0)
+				do_fwrite(buf, nr, stream);
+		}
+		close(fd);
+	}
+}
+
+/* www file stored as .gz only, for clients w/o gzip support */
+static void
+do_file_gunzip(const char *url, FILE *stream)
+{
+	char buf[4096];
+	gzFile gz;
 	int nr;
 
-	if ((fp = fopen(url, "r")) != NULL) {
-		while ((nr = fread(buf, 1, sizeof(buf), fp)) > 0)
-			do_fwrite(buf, nr, stream);
-		fclose(fp);
+	gz = gzopen(url, "rb");
+	if (!gz)
+		return;
+
+	while ((nr = gzread(gz, buf, sizeof(buf))) > 0) {
+		if (fwrite(buf, 1, nr, stream) < nr)
+			break;
 	}
+
+	gzclose(gz);
 }
 
 static int
@@ -903,15 +1409,90 @@ void send_file_download(const char *file, FILE *conn_fp) {
     fclose(fp);
 }
 
+/* Hand connection over to forked worker, returns 0 in worker */
+static pid_t
+conn_worker(conn_item_t *item)
+{
+	pid_t pid;
+	int i;
+
+	for (i = 0; i < MAX_CONN_WORKERS; i++) {
+		if (!http_workers[i])
+			break;
+	}
+	if (i >= MAX_CONN_WORKERS)
+		return -1;
+
+	fflush(item->fp);
+	pid = fork();
+	if (pid == 0) {
+		http_worker = 1;
+		item->direct = 1;
+		item->keep_alive = 0;
+	} else if (pid > 0) {
+		http_workers[i] = pid;
+		item->detached = 1;
+		item->keep_alive = 0;
+	}
+
+	return pid;
+}
+
+/* Park long-poll request, it is parsed again on next tick by
+ * conn_resume(). Returns 0 when request must be answered now. */
+static int
+conn_hold(conn_item_t *item)
+{
+	long now = uptime();
+
+	if (!item->hold_until) {
+		if (http_held >= MAX_CONN_HELD)
+			return 0;
+		item->hold_until = now + CONN_HOLD_TIMEOUT;
+		http_held++;
+	} else if (now >= item->hold_until) {
+		return 0;
+	}
+
+	item->held = 1;
+
+	return 1;
+}
+
+/* Output may wait for slow hooks */
+static int
+is_worker_output(const struct mime_handler *handler, const char *file)
+{
+	const char *output;
+
+	if (handler->flags & MIME_FLAG_WORKER)
+		return 1;
+
+	if (handler->flags & MIME_FLAG_EJ_OUTPUT) {
+		output = get_cgi("output");
+		return (output && (ej_hook_flags(output) & EJ_FLAG_WORKER)) ? 1 : 0;
+	}
+
+	if (handler->output == do_ej)
+		return (ej_page_flags(file) & EJ_FLAG_WORKER) ? 1 : 0;
+
+	return 0;
+}
+
 static void
-handle_request(FILE *conn_fp, const conn_item_t *item)
+handle_request(FILE *conn_fp, conn_item_t *item)
 {
-	char line[4096];
+	char line[4096], skip[256];
 	char *method, *path, *protocol, *authorization, *boundary;
 	char *cur, *end, *cp, *file, *query;
 	int len, login_state, method_id, do_logout, do_wxsend, clen = 0;
+	int hdr_done = 0, line_done = 1;
 	time_t if_modified_since = (time_t)-1;
+	char *if_none_match = NULL;
+	int accept_gzip = 0;
+	char file_gz[256], etag[64];
 	struct mime_handler *handler;
+	void (*output)(const char *url, FILE *stream);
 	struct stat st, *p_st = NULL;
 	uaddr conn_ip;
 
@@ -940,11 +1521,21 @@ handle_request(FILE *conn_fp, const conn_item_t *item)
 		return;
 	}
 
+	/* HTTP/1.1 connections are persistent by default */
+	item->http11 = (strncasecmp(protocol, PROTOCOL_11, 8) == 0) ? 1 : 0;
+	item->keep_alive = (item->http11 && item->requests < MAX_CONN_REQUESTS) ? 1 : 0;
+
 	cur = protocol + strlen(protocol) + 1;
 	end = line + sizeof(line) - 1;
 
 	while ( (cur < end) && (fgets(cur, line + sizeof(line) - cur, conn_fp)) ) {
+		int partial = !line_done;
+
+		line_done = (strchr(cur, '\n') != NULL);
+		if (partial)
+			continue;
 		if ( strcmp( cur, "\n" ) == 0 || strcmp( cur, "\r\n" ) == 0 ) {
+			hdr_done = 1;
 			break;
 		}
 		
@@ -952,6 +1543,13 @@ handle_request(FILE *conn_fp, const conn_item_t *item)
 			if (!http_has_lang)
 				http_has_lang = set_preferred_lang(cur + 16);
 		}
+		else if (strncasecmp( cur, "Connection:", 11) == 0) {
+			cp = cur + 11;
+			if (strcasestr(cp, "close"))
+				item->keep_alive = 0;
+			else if (strcasestr(cp, "keep-alive") && item->requests < MAX_CONN_REQUESTS)
+				item->keep_alive = 1;
+		}
 		else if (strncasecmp( cur, "Authorization:", 14) == 0) {
 			cp = cur + 14;
 			cp += strspn( cp, " \t" );
@@ -963,6 +1561,7 @@ handle_request(FILE *conn_fp, const conn_item_t *item)
 			cp += strspn( cp, " \t" );
 			clen = strtoul( cp, NULL, 0 );
 			if ((clen < 0) || (clen > 50000000)) {
+				item->keep_alive = 0;
 				send_error( 400, "Bad Request", NULL, "Content length invalid.", conn_fp);
 				return;
 			}
@@ -972,6 +1571,18 @@ handle_request(FILE *conn_fp, const conn_item_t *item)
 			cp += strspn( cp, " \t" );
 			if_modified_since = tdate_parse(cp);
 		}
+		else if (strncasecmp( cur, "If-None-Match:", 14) == 0) {
+			cp = cur + 14;
+			cp += strspn( cp, " \t" );
+			if_none_match = cp;
+			cp += strcspn( cp, "\r\n" );
+			*cp = '\0';
+			cur = cp + 1;
+		}
+		else if (strncasecmp( cur, "Accept-Encoding:", 16) == 0) {
+			if (strcasestr(cur + 16, "gzip"))
+				accept_gzip = 1;
+		}
 		else if ((cp = strstr( cur, "boundary=" ))) {
 			boundary = cp + 9;
 			for ( cp = cp + 9; *cp && *cp != '\r' && *cp != '\n'; cp++ );
@@ -980,6 +1591,18 @@ handle_request(FILE *conn_fp, const conn_item_t *item)
 		}
 	}
 
+	/* header block not fully read, the rest would be taken as the next request;
+	 * skip it, the stream must not hold unread input when response is written */
+	if (!hdr_done) {
+		item->keep_alive = 0;
+		while (fgets(skip, sizeof(skip), conn_fp)) {
+			if (line_done && (strcmp(skip, "\n") == 0 || strcmp(skip, "\r\n") == 0))
+				break;
+			line_done = (strchr(skip, '\n') != NULL);
+		}
+		clearerr(conn_fp);
+	}
+
 	if (strcasecmp(method, "get") == 0)
 		method_id = HTTP_METHOD_GET;
 	else if (strcasecmp(method, "head") == 0)
@@ -987,10 +1610,15 @@ handle_request(FILE *conn_fp, const conn_item_t *item)
 	else if (strcasecmp(method, "post") == 0)
 		method_id = HTTP_METHOD_POST;
 	else {
+		item->keep_alive = 0;
 		send_error( 501, "Not Implemented", NULL, "Unsupported method.", conn_fp );
 		return;
 	}
 
+	/* POST body may be left unread by handler, HEAD has no body to frame */
+	if (method_id != HTTP_METHOD_GET)
+		item->keep_alive = 0;
+
 	if ( path[0] != '/' ) {
 		send_error( 400, "Bad Request", NULL, "Bad URL.", conn_fp );
 		return;
@@ -1023,6 +1651,7 @@ handle_request(FILE *conn_fp, const conn_item_t *item)
 	usockaddr_to_uaddr(&item->usa, &conn_ip);
 	/* 处理特殊路径: 以 "etc/" 或 "tmp/" 开头 */
 	if (strncmp(file, "etc/", 4) == 0 || strncmp(file, "tmp/", 4) == 0) {
+		item->keep_alive = 0;
     		char *ext = strrchr(file, '.'); // 获取文件后缀
     		if (ext) {
         		if (strcasecmp(ext, ".html") == 0 || strcasecmp(ext, ".asp") == 0) {
@@ -1109,7 +1738,7 @@ handle_request(FILE *conn_fp, const conn_item_t *item)
 			handler->input(file, conn_fp, clen, boundary);
 		else
 			eat_post_data(conn_fp, clen);
-		try_pull_data(conn_fp, item->fd);
+		try_pull_data(conn_fp, item);
 	} else {
 		if (query)
 			do_uncgi_query(query);
@@ -1117,22 +1746,71 @@ handle_request(FILE *conn_fp, const conn_item_t *item)
 			do_cgi_clear();
 	}
 
-	if (handler->output == do_file) {
-		if (stat(file, &st) == 0 && !S_ISDIR(st.st_mode)) {
+	output = handler->output;
+	if (output == do_file) {
+		int has_file, has_gz = 0;
+		struct stat st_gz;
+
+		has_file = (stat(file, &st) == 0 && !S_ISDIR(st.st_mode)) ? 1 : 0;
+		if (!handler->extra_header && strlen(file) + 4 <= sizeof(file_gz)) {
+			sprintf(file_gz, "%s.gz", file);
+			has_gz = (stat(file_gz, &st_gz) == 0 && S_ISREG(st_gz.st_mode)) ? 1 : 0;
+			/* use precompressed copy when it is not outdated */
+			if (has_gz && has_file && st_gz.st_mtime < st.st_mtime)
+				has_gz = 0;
+		}
+		if (has_gz) {
+			item->vary = 1;
+			if (accept_gzip) {
+				st = st_gz;
+				file = file_gz;
+				item->gzip = 1;
+				has_file = 1;
+			} else if (!has_file) {
+				/* www ships compressed copy only, body length is unknown */
+				st = st_gz;
+				st.st_size = 0;
+				file = file_gz;
+				output = do_file_gunzip;
+				has_file = 1;
+			}
+		}
+		if (has_file) {
 			p_st = &st;
-			if (!handler->extra_header && if_modified_since != (time_t)-1 && if_modified_since == st.st_mtime) {
-				st.st_size = 0; /* not send Content-Length */
-				send_headers( 304, "Not Modified", NULL, handler->mime_type, p_st, conn_fp );
-				return;
+			if (!handler->extra_header) {
+				int not_modified;
+				if (if_none_match) {
+					make_etag(&st, etag, sizeof(etag));
+					not_modified = (strcmp(if_none_match, "*") == 0 || strstr(if_none_match, etag)) ? 1 : 0;
+				} else {
+					not_modified = (if_modified_since != (time_t)-1 && if_modified_since == st.st_mtime) ? 1 : 0;
+				}
+				if (not_modified) {
+					send_headers( 304, "Not Modified", NULL, handler->mime_type, p_st, conn_fp );
+					return;
+				}
 			}
 		}
 	}
 
+	/* Long-poll waits in main loop, not in handler */
+	if (method_id == HTTP_METHOD_GET && !http_worker && handler->ready && !handler->ready(file)) {
+		if (conn_hold(item))
+			return;
+	}
+
+	/* Slow output goes to worker, connection is closed after it. Main
+	 * process renders it itself when all workers are busy. */
+	if (method_id != HTTP_METHOD_HEAD && !http_worker && is_worker_output(handler, file)) {
+		if (conn_worker(item) > 0)
+			return;
+	}
+
 	send_headers( 200, "OK", handler->extra_header, handler->mime_type, p_st, conn_fp );
 
 	if (method_id != HTTP_METHOD_HEAD) {
-		if (handler->output)
-			handler->output(file, conn_fp);
+		if (output)
+			output(file, conn_fp);
 	}
 
 	if (do_logout)
@@ -1168,17 +1846,430 @@ catch_sig(int sig)
 	}
 }
 
+static void
+conn_close(conn_list_t *pool, conn_item_t *item)
+{
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, item->fd, NULL);
+
+	TAILQ_REMOVE(&pool->head, item, entry);
+	pool->count--;
+
+	if (item->hold_until)
+		http_held--;
+
+	fclose(item->fp);
+	conn_file_close(item);
+	free(item->wbuf);
+	free(item->rbuf);
+	free(item);
+}
+
+/* Arm epoll for next step of connection */
+static void
+conn_wait(conn_item_t *item, uint32_t events)
+{
+	struct epoll_event ev;
+
+#if defined (SUPPORT_HTTPS)
+	if (item->ssl && ssl_server_want_write(item->ssl_conn))
+		events = EPOLLOUT;
+#endif
+	if (item->events == events)
+		return;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.ptr = item;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, item->fd, &ev) == 0)
+		item->events = events;
+}
+
+static void
+conn_accept(conn_list_t *pool, int listen_fd, int is_ssl)
+{
+	struct epoll_event ev;
+	conn_item_t *item;
+	socklen_t sz;
+
+	while (pool->count < MAX_CONN_ACCEPT) {
+		item = calloc(1, sizeof(*item));
+		if (!item)
+			break;
+		
+		item->rsize = CONN_BUF_SIZE;
+		item->rbuf = malloc(item->rsize);
+		if (!item->rbuf) {
+			free(item);
+			break;
+		}
+		item->file_fd = -1;
+		
+		sz = sizeof(item->usa);
+		item->fd = accept4(listen_fd, &item->usa.sa, &sz, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (item->fd < 0) {
+			if (errno != EINTR && errno != EAGAIN) {
+				if (debug_mode)
+					perror("accept");
+			}
+			free(item->rbuf);
+			free(item);
+			break;
+		}
+		
+		if (!is_http_client_allowed(&item->usa))
+			goto drop;
+		
+		setsockopt(item->fd, SOL_SOCKET, SO_KEEPALIVE, &int_1, sizeof(int_1));
+		/* responses are coalesced by MSG_MORE, last part goes w/o delay */
+		setsockopt(item->fd, IPPROTO_TCP, TCP_NODELAY, &int_1, sizeof(int_1));
+		
+#if defined (SUPPORT_HTTPS)
+		item->ssl = is_ssl;
+		if (is_ssl && !(item->ssl_conn = ssl_server_open(item->fd)))
+			goto drop;
+#endif
+		item->fp = fopencookie(item, "r+", http_conn_io);
+		if (!item->fp) {
+#if defined (SUPPORT_HTTPS)
+			if (item->ssl_conn)
+				ssl_server_close(item->ssl_conn, 0);
+#endif
+			goto drop;
+		}
+		
+		item->atime = uptime();
+		
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.ptr = item;
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, item->fd, &ev) < 0) {
+			fclose(item->fp);
+			free(item->rbuf);
+			free(item);
+			continue;
+		}
+		item->events = EPOLLIN;
+		
+		TAILQ_INSERT_TAIL(&pool->head, item, entry);
+		pool->count++;
+		continue;
+drop:
+		shutdown(item->fd, SHUT_RDWR);
+		close(item->fd);
+		free(item->rbuf);
+		free(item);
+	}
+}
+
+/* Pull received data w/o blocking, returns -1 on closed connection */
+static int
+conn_fill(conn_item_t *item)
+{
+	ssize_t nr;
+	char *rbuf;
+
+	if (item->rpos > 0) {
+		item->rlen -= item->rpos;
+		memmove(item->rbuf, item->rbuf + item->rpos, item->rlen);
+		item->rpos = 0;
+	}
+
+	/* give back space of large request */
+	if (item->rlen <= CONN_BUF_SIZE && item->rsize > CONN_BUF_SIZE) {
+		rbuf = realloc(item->rbuf, CONN_BUF_SIZE);
+		if (rbuf) {
+			item->rbuf = rbuf;
+			item->rsize = CONN_BUF_SIZE;
+		}
+	}
+
+	for (;;) {
+		if (item->rlen == item->rsize) {
+			if (item->rsize >= CONN_BUF_MAX)
+				break;
+			rbuf = realloc(item->rbuf, item->rsize * 2);
+			if (!rbuf)
+				break;
+			item->rbuf = rbuf;
+			item->rsize *= 2;
+		}
+		nr = conn_recv(item, item->rbuf + item->rlen, item->rsize - item->rlen);
+		if (nr > 0) {
+			item->rlen += nr;
+			continue;
+		}
+		if (nr < 0 && errno == EINTR)
+			continue;
+		if (nr < 0 && errno == EAGAIN)
+			break;
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Request is complete in rbuf: header (or what can be buffered of it)
+ * and body. Returns 2 if body is too large to be buffered. */
+static int
+conn_has_request(conn_item_t *item)
+{
+	char *p, *begin, *end, *body = NULL;
+	unsigned long clen = 0;
+
+	begin = item->rbuf + item->rpos;
+	end = item->rbuf + item->rlen;
+	for (p = begin; p < end; p++) {
+		p = memchr(p, '\n', end - p);
+		if (!p)
+			break;
+		if (p + 1 < end && p[1] == '\n') {
+			body = p + 2;
+			break;
+		}
+		if (p + 2 < end && p[1] == '\r' && p[2] == '\n') {
+			body = p + 3;
+			break;
+		}
+		if (p + 16 < end && strncasecmp(p + 1, "Content-Length:", 15) == 0)
+			clen = strtoul(p + 16, NULL, 10);
+	}
+
+	if (!body)
+		return (item->rpos == 0 && item->rlen == CONN_BUF_MAX) ? 1 : 0;
+
+	/* invalid length is rejected by handle_request() */
+	if (clen > 50000000)
+		return 1;
+
+	if (clen <= (unsigned long)(end - body))
+		return 1;
+
+	return ((body - begin) + clen > CONN_BUF_MAX) ? 2 : 0;
+}
+
+/* Send pending output w/o blocking, returns 1 when all is sent */
+static int
+conn_flush(conn_item_t *item)
+{
+	ssize_t ns = 0;
+
+	for (;;) {
+		if (item->wpos < item->wlen) {
+			ns = conn_send(item, item->wbuf + item->wpos, item->wlen - item->wpos, (item->file_fd >= 0));
+			if (ns > 0) {
+				item->wpos += ns;
+				continue;
+			}
+		} else {
+			item->wpos = 0;
+			item->wlen = 0;
+			/* don't keep space of large response */
+			if (item->wsize > CONN_BUF_MAX) {
+				free(item->wbuf);
+				item->wbuf = NULL;
+				item->wsize = 0;
+			}
+			if (item->file_fd < 0)
+				return 1;
+			if (item->file_pos >= item->file_end) {
+				conn_file_close(item);
+				continue;
+			}
+#if defined (SUPPORT_HTTPS)
+			if (item->ssl) {
+				if (conn_file_load(item, CONN_BUF_MAX) < 0)
+					return -1;
+				continue;
+			}
+#endif
+			ns = sendfile(item->fd, item->file_fd, &item->file_pos, item->file_end - item->file_pos);
+			if (ns > 0)
+				continue;
+		}
+		if (ns < 0 && errno == EINTR)
+			continue;
+		if (ns < 0 && errno == EAGAIN)
+			return 0;
+		return -1;
+	}
+}
+
+static void
+conn_handle(conn_item_t *item)
+{
+	int rpos = item->rpos;
+
+	http_conn = item;
+
+	item->held = 0;
+	item->http11 = 0;
+	item->keep_alive = 0;
+	item->chunked = 0;
+	item->gzip = 0;
+	item->vary = 0;
+	clearerr(item->fp);
+
+	handle_request(item->fp, item);
+
+	if (item->held) {
+		/* nothing is sent, request is parsed again on next try */
+		item->rpos = rpos;
+	} else {
+		if (item->hold_until) {
+			item->hold_until = 0;
+			http_held--;
+		}
+		if (!item->detached)
+			http_conn_finish(item);
+		item->requests++;
+	}
+
+	http_conn = NULL;
+#if defined (SUPPORT_HTTPS)
+	http_is_ssl = 0;
+#endif
+
+	if (http_worker) {
+		fclose(item->fp);
+		_exit(0);
+	}
+}
+
+/* Upload is read by worker, main process doesn't wait for it */
+static void
+conn_handle_large(conn_item_t *item)
+{
+	if (conn_worker(item) == 0) {
+		conn_handle(item);
+		return;
+	}
+
+	if (item->detached)
+		return;
+
+	http_conn = item;
+	send_error( 503, "Service Unavailable", "Retry-After: 5", "Server is busy.", item->fp );
+	http_conn_finish(item);
+	http_conn = NULL;
+}
+
+static void
+conn_on_event(conn_list_t *pool, conn_item_t *item)
+{
+	int ret, closed = 0;
+
+#if defined (SUPPORT_HTTPS)
+	if (item->ssl && !item->ssl_ready) {
+		ret = ssl_server_accept(item->ssl_conn);
+		if (ret < 0)
+			goto close;
+		conn_wait(item, EPOLLIN);
+		if (ret == 0)
+			return;
+		item->ssl_ready = 1;
+	}
+#endif
+
+	for (;;) {
+		/* previous response goes first */
+		ret = conn_flush(item);
+		if (ret < 0)
+			goto close;
+		if (ret == 0) {
+			conn_wait(item, EPOLLOUT);
+			goto done;
+		}
+		if (item->closing || item->broken)
+			goto close;
+		
+		if (!closed)
+			closed = conn_fill(item);
+		
+		ret = conn_has_request(item);
+		if (!ret)
+			break;
+		
+		if (ret > 1)
+			conn_handle_large(item);
+		else
+			conn_handle(item);
+		
+		if (item->held)
+			break;
+		if (item->detached)
+			goto close;
+		if (!item->keep_alive)
+			item->closing = 1;
+	}
+
+	if (closed)
+		goto close;
+
+	conn_wait(item, EPOLLIN);
+
+done:
+	/* parked request keeps its place, see conn_resume() */
+	if (item->held)
+		return;
+
+	/* Most recently used at tail */
+	item->atime = uptime();
+	TAILQ_REMOVE(&pool->head, item, entry);
+	TAILQ_INSERT_TAIL(&pool->head, item, entry);
+	return;
+
+close:
+	conn_close(pool, item);
+}
+
+static void
+conn_expire(conn_list_t *pool, long now)
+{
+	conn_item_t *item, *next;
+	long timeout;
+
+	TAILQ_FOREACH_SAFE(item, &pool->head, entry, next) {
+		if (item->held)
+			continue;
+		timeout = (item->requests > 0) ? KEEPALIVE_TIMEOUT : MAX_CONN_TIMEOUT;
+		if ((now - item->atime) > timeout)
+			conn_close(pool, item);
+	}
+}
+
+/* Retry parked long-poll requests, answered ones move to tail */
+static void
+conn_resume(conn_list_t *pool)
+{
+	conn_item_t *item, *next;
+
+	TAILQ_FOREACH_SAFE(item, &pool->head, entry, next) {
+		if (item->held)
+			conn_on_event(pool, item);
+	}
+}
+
+static void
+reap_workers(void)
+{
+	int i;
+
+	for (i = 0; i < MAX_CONN_WORKERS; i++) {
+		if (http_workers[i] && waitpid(http_workers[i], NULL, WNOHANG) != 0)
+			http_workers[i] = 0;
+	}
+}
+
 int
 main(int argc, char **argv)
 {
 	FILE *pid_fp;
-	struct timeval tv;
-	fd_set active_rfds;
+	struct epoll_event ev, events[MAX_CONN_EVENTS];
 	usockaddr usa[2];
 	int listen_fd[2], http_port[2];
-	int i, c, tmp, max_fd, cnt_fd, selected;
+	int i, c, tmp, cnt_fd, selected, listening;
+	long now, resume_time = 0;
 	pid_t pid;
-	socklen_t sz;
 	conn_list_t pool;
 	conn_item_t *item, *next;
 
@@ -1309,10 +2400,8 @@ main(int argc, char **argv)
 
 	chdir("/www");
 
-	FD_ZERO(&active_rfds);
 	TAILQ_INIT(&pool.head);
 	pool.count = 0;
-	sz = sizeof(usa);
 
 	load_dictionary("EN", &kw_EN);
 
@@ -1323,129 +2412,86 @@ main(int argc, char **argv)
 		httpd_log("Server listening port %d (%s). %s.", http_port[1], "HTTPS", ssl_server_get_ssl_ver());
 #endif
 
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0) {
+		httpd_log("Failed to create epoll instance (errno: %d). EXITING", errno);
+		daemon_exit = 1;
+	}
+
+	for (i=0; i<cnt_fd && !daemon_exit; i++) {
+		if (listen_fd[i] >= 0) {
+			fcntl(listen_fd[i], F_SETFL, fcntl(listen_fd[i], F_GETFL) | O_NONBLOCK);
+			memset(&ev, 0, sizeof(ev));
+			ev.events = EPOLLIN;
+			ev.data.ptr = &listen_fd[i];
+			epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd[i], &ev);
+		}
+	}
+
+	listening = 1;
+
 	while (!daemon_exit) {
-		fd_set rfds;
-		
-		rfds = active_rfds;
-		max_fd = -1;
-		if (pool.count < MAX_CONN_ACCEPT) {
+		/* stop accept while pool is full */
+		if (listening != (pool.count < MAX_CONN_ACCEPT)) {
+			listening = !listening;
 			for (i=0; i<cnt_fd; i++) {
 				if (listen_fd[i] >= 0) {
-					FD_SET(listen_fd[i], &rfds);
-					max_fd = (listen_fd[i] > max_fd) ? listen_fd[i] : max_fd;
+					memset(&ev, 0, sizeof(ev));
+					ev.events = (listening) ? EPOLLIN : 0;
+					ev.data.ptr = &listen_fd[i];
+					epoll_ctl(epoll_fd, EPOLL_CTL_MOD, listen_fd[i], &ev);
 				}
 			}
 		}
 		
-		TAILQ_FOREACH(item, &pool.head, entry)
-			max_fd = (item->fd > max_fd) ? item->fd : max_fd;
-		
 		/* wait for new connection or incoming request */
-		tv.tv_sec = MAX_CONN_TIMEOUT;
-		tv.tv_usec = 0;
-		selected = select(max_fd + 1, &rfds, NULL, NULL, &tv);
+		selected = epoll_wait(epoll_fd, events, MAX_CONN_EVENTS, 1000);
 		if (selected < 0) {
-			if (errno == EINTR || errno == EAGAIN)
+			if (errno == EINTR)
 				continue;
 			if (debug_mode)
-				perror("select");
+				perror("epoll_wait");
 			else
-				httpd_log("Failed to select open sockets (errno: %d). EXITING", errno);
+				httpd_log("Failed to wait open sockets (errno: %d). EXITING", errno);
 			break;
 		}
 		
-		/* check and accept new connection */
-		if (selected) {
-			int is_accept = 0;
-			for (i=0; i<cnt_fd; i++) {
-				if (listen_fd[i] >= 0 && FD_ISSET(listen_fd[i], &rfds)) {
-					item = malloc(sizeof(*item));
-					if (!item)
-						continue;
-					
-					item->fd = accept(listen_fd[i], &item->usa.sa, &sz);
-					if (item->fd >= 0) {
-#if defined (SUPPORT_HTTPS)
-						item->ssl = (i > 0) ? 1 : 0;
-#endif
-						if (is_http_client_allowed(&item->usa)) {
-							setsockopt(item->fd, SOL_SOCKET, SO_KEEPALIVE, &int_1, sizeof(int_1));
-							FD_SET(item->fd, &active_rfds);
-							TAILQ_INSERT_TAIL(&pool.head, item, entry);
-							pool.count++;
-							is_accept++;
-						} else {
-							shutdown(item->fd, SHUT_RDWR);
-							close(item->fd);
-							free(item);
-						}
-					} else {
-						if (errno != EINTR && errno != EAGAIN) {
-							if (debug_mode)
-								perror("accept");
-						}
-						free(item);
-					}
-				}
-			}
-			
-			/* Continue waiting */
-			if (is_accept)
+		for (c=0; c<selected; c++) {
+			if (events[c].data.ptr == &listen_fd[0]) {
+				conn_accept(&pool, listen_fd[0], 0);
 				continue;
-		}
-		
-		/* Check and process pending or expired requests */
-		TAILQ_FOREACH_SAFE(item, &pool.head, entry, next) {
-			if (selected && !FD_ISSET(item->fd, &rfds))
-				continue;
-			
-			FD_CLR(item->fd, &active_rfds);
-			TAILQ_REMOVE(&pool.head, item, entry);
-			pool.count--;
-			
-			if (selected) {
-				FILE *conn_fp;
-#if defined (SUPPORT_HTTPS)
-				if (item->ssl)
-					conn_fp = ssl_server_fopen(item->fd);
-				else
-#endif
-				conn_fp = fdopen(item->fd, "r+");
-				if (conn_fp) {
-					handle_request(conn_fp, item);
-					fflush(conn_fp);
-#if defined (SUPPORT_HTTPS)
-					http_is_ssl = 0;
-					if (!item->ssl)
-#endif
-					shutdown(item->fd, SHUT_RDWR);
-					fclose(conn_fp);
-					conn_fp = NULL;
-					item->fd = -1;
-				}
-				if (--selected == 0)
-					next = NULL;
 			}
-			
-			if (item->fd >= 0) {
-				shutdown(item->fd, SHUT_RDWR);
-				close(item->fd);
+			if (events[c].data.ptr == &listen_fd[1]) {
+				conn_accept(&pool, listen_fd[1], 1);
+				continue;
 			}
 			
-			free(item);
+			item = (conn_item_t *)events[c].data.ptr;
+			if (events[c].events & (EPOLLIN | EPOLLOUT | EPOLLHUP | EPOLLERR))
+				conn_on_event(&pool, item);
 		}
-	}
-
-	/* free all pending requests */
-	TAILQ_FOREACH_SAFE(item, &pool.head, entry, next) {
-		if (item->fd >= 0) {
-			shutdown(item->fd, SHUT_RDWR);
-			close(item->fd);
+		
+		reap_workers();
+		
+		now = uptime();
+		
+		/* answer long-poll requests once per second */
+		if (http_held > 0 && now != resume_time) {
+			resume_time = now;
+			conn_resume(&pool);
 		}
 		
-		free(item);
+		/* close idle connections */
+		conn_expire(&pool, now);
 	}
 
+	/* free all pending requests */
+	TAILQ_FOREACH_SAFE(item, &pool.head, entry, next)
+		conn_close(&pool, item);
+
+	if (epoll_fd >= 0)
+		close(epoll_fd);
+
 	for (i=0; i<cnt_fd; i++) {
 		if (listen_fd[i] >= 0) {
 			shutdown(listen_fd[i], SHUT_RDWR);
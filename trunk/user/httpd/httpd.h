@@ -46,8 +46,13 @@ struct mime_handler {
 	void (*input)(const char *url, FILE *stream, int clen, char *boundary);
 	void (*output)(const char *url, FILE *stream);
 	int need_auth;
+	int flags;
+	int (*ready)(const char *url);	/* long-poll: GET is held until ready or timeout */
 };
 
+#define MIME_FLAG_WORKER	0x01	/* slow GET output, run in forked worker */
+#define MIME_FLAG_EJ_OUTPUT	0x02	/* 'output' var names ej hook, see EJ_FLAG_WORKER */
+
 extern struct mime_handler mime_handlers[];
 
 /* CGI helper functions */
@@ -66,6 +71,8 @@ typedef struct kw_s     {
 	char dict[4];
 	unsigned char **idx;
 	unsigned char *buf;
+	int hsize;						// hash index size (power of 2)
+	int *hash;						// key hash -> idx, -1 empty
 } kw_t, *pkw_t;
 
 extern kw_t kw_EN;
@@ -93,13 +100,14 @@ typedef FILE * webs_t;
 #define __TMPVAR(x) tmpvar ## x
 #define _TMPVAR(x) __TMPVAR(x)
 #define TMPVAR _TMPVAR(__LINE__)
-#define websWrite(wp, fmt, args...) ({ int TMPVAR = fprintf(wp, fmt, ## args); fflush(wp); TMPVAR; })
+#define websWrite(wp, fmt, args...) fprintf(wp, fmt, ## args)
 #define websError(wp, code, msg, args...) fprintf(wp, msg, ## args)
 #define websDone(wp, code) fflush(wp)
 #define websGetVar(wp, var, default) (get_cgi(var) ? : default)
 
 /* Regular file handler */
 extern void do_file(const char *url, FILE *stream);
+extern void do_file_range(int fd, off_t offset, off_t len, FILE *stream);
 extern void do_ej(const char *url, FILE *stream);
 
 extern int ejArgs(int argc, char **argv, char *fmt, ...);
@@ -107,9 +115,14 @@ extern int ejArgs(int argc, char **argv, char *fmt, ...);
 struct ej_handler {
 	char *pattern;
 	int (*output)(int eid, webs_t wp, int argc, char **argv);
+	int flags;
 };
 
+#define EJ_FLAG_WORKER		0x01	/* slow hook, page is rendered in forked worker */
+
 extern struct ej_handler ej_handlers[];
+extern int ej_hook_flags(const char *name);
+extern int ej_page_flags(const char *url);
 
 // aidisk.c
 #if defined (USE_USB_SUPPORT)
@@ -211,7 +224,12 @@ extern void do_cgi_clear(void);
 #if defined (SUPPORT_HTTPS)
 extern int ssl_server_init(char* ca_file, char *crt_file, char *key_file, char *dhp_file, char *ssl_cipher_list);
 extern void ssl_server_uninit(void);
-extern FILE *ssl_server_fopen(int sd);
+extern void *ssl_server_open(int fd);
+extern int ssl_server_accept(void *ssl);
+extern ssize_t ssl_server_read(void *ssl, char *buf, size_t len);
+extern ssize_t ssl_server_write(void *ssl, const char *buf, size_t len);
+extern int ssl_server_want_write(void *ssl);
+extern void ssl_server_close(void *ssl, int do_shutdown);
 extern const char* ssl_server_get_ssl_ver(void);
 #endif
 
@@ -40,12 +40,6 @@
 
 #define SYSLOG_ID_SSL	"SSL/TLS"
 
-typedef struct {
-	SSL* ssl;
-	int fd;
-} http_ssl_cookie_t;
-
-
 extern int debug_mode;
 static SSL_CTX *ssl_ctx = NULL;
 
@@ -88,103 +82,6 @@ static const unsigned char dh1024_g[]={
 	0x85,0x5E,0x6E,0xEB,0x22,0xB3,0xB2,0xE5,
 };
 
-static ssize_t
-http_ssl_read(void *cookie, char *buf, size_t len)
-{
-	int nr, err;
-	http_ssl_cookie_t *hsc = (http_ssl_cookie_t *)cookie;
-	size_t total = 0;
-
-	do {
-		nr = SSL_read(hsc->ssl, buf + total, len - total);
-		if (nr > 0) {
-			total += (size_t)nr;
-		} else {
-			err = SSL_get_error(hsc->ssl, nr);
-			switch (err) {
-			case SSL_ERROR_ZERO_RETURN:
-				goto read_out;
-				break;
-			case SSL_ERROR_WANT_WRITE:
-			case SSL_ERROR_WANT_READ:
-				break;
-			default:
-				if (debug_mode)
-					ERR_print_errors_fp(stderr);
-				if (total == 0)
-					total = (ssize_t)-1;
-				goto read_out;
-			}
-		}
-	} while ((total < len) && SSL_pending(hsc->ssl));
-
-read_out:
-
-	return (ssize_t)total;
-}
-
-static ssize_t
-http_ssl_write(void *cookie, const char *buf, size_t len)
-{
-	int nw, err;
-	http_ssl_cookie_t *hsc = (http_ssl_cookie_t *)cookie;
-	size_t total = 0;
-
-	while (total < len) {
-		nw = SSL_write(hsc->ssl, buf + total, len - total);
-		if (nw > 0) {
-			total += (size_t)nw;
-		} else {
-			err = SSL_get_error(hsc->ssl, nw);
-			switch (err) {
-			case SSL_ERROR_ZERO_RETURN:
-				goto write_out;
-				break;
-			case SSL_ERROR_WANT_WRITE:
-			case SSL_ERROR_WANT_READ:
-				break;
-			default:
-				if (debug_mode)
-					ERR_print_errors_fp(stderr);
-				if (total == 0)
-					total = (ssize_t)-1;
-				goto write_out;
-			}
-		}
-	}
-
-write_out:
-
-	return (ssize_t)total;
-}
-
-static int
-http_ssl_close(void *cookie)
-{
-	http_ssl_cookie_t *hsc = (http_ssl_cookie_t *)cookie;
-	if (!hsc)
-		return 0;
-
-	if (hsc->ssl) {
-		SSL_shutdown(hsc->ssl);
-		shutdown(hsc->fd, SHUT_WR);
-		SSL_free(hsc->ssl);
-	}
-
-	close(hsc->fd);
-
-	free(hsc);
-
-	return 0;
-}
-
-static const cookie_io_functions_t http_ssl_io = {
-	.read  = http_ssl_read,
-	.write = http_ssl_write,
-	.seek  = NULL,
-	.close = http_ssl_close
-};
-
 static void
 http_ssl_info_cb(const SSL *ssl, int where, int ret)
 {
@@ -319,50 +216,99 @@ int ssl_server_init(char* ca_file, char *crt_file, char *key_file, char *dhp_fil
 	return 0;
 }
 
-FILE *ssl_server_fopen(int fd)
+static ssize_t
+ssl_server_error(SSL *ssl, int ret)
 {
-	FILE *fp;
-	http_ssl_cookie_t *hsc;
+	switch (SSL_get_error(ssl, ret)) {
+	case SSL_ERROR_ZERO_RETURN:
+		return 0;
+	case SSL_ERROR_WANT_READ:
+	case SSL_ERROR_WANT_WRITE:
+		errno = EAGAIN;
+		break;
+	default:
+		if (debug_mode)
+			ERR_print_errors_fp(stderr);
+		errno = EIO;
+		break;
+	}
 
-	hsc = (http_ssl_cookie_t *)malloc(sizeof(http_ssl_cookie_t));
-	if (!hsc)
-		return NULL;
+	return -1;
+}
 
-	hsc->fd = fd;
-	hsc->ssl = SSL_new(ssl_ctx);
-	if (!hsc->ssl)
-		goto ERROR;
+/* Connection on non-blocking socket, I/O returns -1 with EAGAIN if SSL wants more data */
+void *
+ssl_server_open(int fd)
+{
+	SSL *ssl;
 
-	SSL_set_mode(hsc->ssl, SSL_MODE_AUTO_RETRY);
+	ssl = SSL_new(ssl_ctx);
+	if (!ssl)
+		return NULL;
 
-	if (SSL_set_fd(hsc->ssl, fd) != 1)
-		goto ERROR;
+	SSL_set_mode(ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
 
-	for (;;) {
-		int ret = SSL_accept(hsc->ssl);
-		if (ret <= 0) {
-			int err = SSL_get_error(hsc->ssl, ret);
-			if (ret < 0 && (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE))
-				continue;
-			goto ERROR;
-		}
-		break;
+	if (SSL_set_fd(ssl, fd) != 1) {
+		SSL_free(ssl);
+		return NULL;
 	}
 
-	fp = fopencookie((void*)hsc, "r+", http_ssl_io);
-	if (!fp)
-		goto ERROR;
+	return ssl;
+}
 
-	return fp;
+/* Returns 1 if handshake is done, 0 if wants more I/O, -1 on error */
+int
+ssl_server_accept(void *ssl)
+{
+	int ret = SSL_accept((SSL *)ssl);
 
-ERROR:
+	if (ret > 0)
+		return 1;
 
-	if (hsc->ssl)
-		SSL_free(hsc->ssl);
+	if (ssl_server_error((SSL *)ssl, ret) < 0 && errno == EAGAIN)
+		return 0;
 
-	free(hsc);
+	return -1;
+}
+
+ssize_t
+ssl_server_read(void *ssl, char *buf, size_t len)
+{
+	int nr = SSL_read((SSL *)ssl, buf, len);
+
+	if (nr > 0)
+		return nr;
+
+	return ssl_server_error((SSL *)ssl, nr);
+}
+
+ssize_t
+ssl_server_write(void *ssl, const char *buf, size_t len)
+{
+	int nw = SSL_write((SSL *)ssl, buf, len);
+
+	if (nw > 0)
+		return nw;
+
+	if (ssl_server_error((SSL *)ssl, nw) == 0)
+		errno = EPIPE;
+
+	return -1;
+}
+
+int
+ssl_server_want_write(void *ssl)
+{
+	return SSL_want_write((SSL *)ssl);
+}
+
+void
+ssl_server_close(void *ssl, int do_shutdown)
+{
+	if (do_shutdown)
+		SSL_shutdown((SSL *)ssl);
 
-	return NULL;
+	SSL_free((SSL *)ssl);
 }
 
 const char*
@@ -0,0 +1,251 @@
+/*
+ * Render time of ASP pages: compiled templates (ej.c) against the
+ * fragment scanner they replaced (ej_legacy.c). Output of both engines
+ * is compared before timing.
+ *
+ * Without pages given, a page shaped like the heaviest web UI pages
+ * (Advanced_Wireless_Content.asp: ~60 KB, ~300 <#KEY#>, ~160 hooks) and
+ * EN and CN dictionaries of 1500 keys are generated, CN missing every
+ * tenth key so those fall back to EN. Pages are rendered in EN and CN,
+ * dictionary load time is measured on CN.dict. With -w, pages and
+ * dictionaries are read from a www directory.
+ *
+ * Usage: ej_bench [-n renders] [-w wwwdir page.asp ...]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <httpd.h>
+
+#define DICT_KEYS	1500
+
+kw_t kw_EN, kw_XX;
+
+extern kw_t legacy_kw_EN, legacy_kw_XX;
+extern int legacy_load_dictionary(char *lang, pkw_t pkw);
+extern void legacy_release_dictionary(pkw_t pkw);
+extern void legacy_do_ej(const char *url, FILE *stream);
+
+static double
+now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void
+make_dict(const char *name, const char *text, int keys, int skip)
+{
+	FILE *fp;
+	int i;
+
+	fp = fopen(name, "w");
+	if (!fp) {
+		perror(name);
+		exit(1);
+	}
+	for (i = 0; i < keys; i++)
+		if (!skip || (i % skip) != 0)
+			fprintf(fp, "WLANConfig%04d_Desc=%s %d, some words of description\n", i, text, i);
+	fclose(fp);
+}
+
+static void
+make_page(const char *name, int size, int keys, int hooks)
+{
+	FILE *fp;
+	int i, k = 0, h = 0, step;
+
+	fp = fopen(name, "w");
+	if (!fp) {
+		perror(name);
+		exit(1);
+	}
+	step = size / (keys + hooks);
+	for (i = 0; k < keys || h < hooks; i++) {
+		fprintf(fp, "%.*s\n", step - 40,
+			"<tr><th width=\"50%\"><a class=\"help_tooltip\" href=\"javascript:void(0);\" "
+			"onmouseover=\"openTooltip(this, 0, 1);\"></a></th><td><input type=\"text\" "
+			"maxlength=\"32\" class=\"input\" size=\"32\" name=\"wl_ssid\" value=\"\"/></td></tr>");
+		if ((i & 1) && h < hooks) {
+			fprintf(fp, "<%% nvram_get_x(\"\", \"wl_var%d\"); %%>", h % 40);
+			h++;
+		} else if (k < keys) {
+			fprintf(fp, "<#WLANConfig%04d_Desc#>", (k * 7) % (DICT_KEYS + 100));
+			k++;
+		}
+	}
+	fclose(fp);
+}
+
+static char *
+render(void (*engine)(const char *, FILE *), const char *page, size_t *len)
+{
+	char *out = NULL;
+	FILE *fp;
+
+	fp = open_memstream(&out, len);
+	if (!fp)
+		exit(1);
+	engine(page, fp);
+	fclose(fp);
+
+	return out;
+}
+
+static double
+time_render(void (*engine)(const char *, FILE *), const char *page, FILE *null, int n)
+{
+	double start;
+	int i;
+
+	engine(page, null);
+
+	start = now_usec();
+	for (i = 0; i < n; i++)
+		engine(page, null);
+
+	return (now_usec() - start) / n;
+}
+
+static int
+bench_page(const char *page, const char *lang, FILE *null, int n)
+{
+	char *out_old, *out_new;
+	size_t len_old, len_new;
+	double t_old, t_new;
+	int same;
+
+	out_old = render(legacy_do_ej, page, &len_old);
+	out_new = render(do_ej, page, &len_new);
+	same = (len_old == len_new && memcmp(out_old, out_new, len_old) == 0);
+	free(out_old);
+	free(out_new);
+
+	t_old = time_render(legacy_do_ej, page, null, n);
+	t_new = time_render(do_ej, page, null, n);
+
+	printf("%-32s %s: %6zu bytes, legacy %7.1f us, compiled %6.1f us per render (%.1fx), output %s\n",
+		page, lang, len_new, t_old, t_new, t_old / t_new, (same) ? "identical" : "DIFFERS");
+
+	return (same) ? 0 : 1;
+}
+
+static void
+bench_dict(char *lang, int n)
+{
+	double start, t_old, t_new;
+	kw_t kw;
+	int i;
+
+	start = now_usec();
+	for (i = 0; i < n; i++) {
+		if (!legacy_load_dictionary(lang, &kw))
+			return;
+		legacy_release_dictionary(&kw);
+	}
+	t_old = (now_usec() - start) / n;
+
+	start = now_usec();
+	for (i = 0; i < n; i++) {
+		if (!load_dictionary(lang, &kw))
+			return;
+		release_dictionary(&kw);
+	}
+	t_new = (now_usec() - start) / n;
+
+	printf("%s.dict load%*s: legacy %7.1f us, hashed %8.1f us per load (%.1fx)\n",
+		lang, 25 - (int)strlen(lang), "", t_old, t_new, t_old / t_new);
+}
+
+static int
+bench_pages(char **pages, int count, const char *lang, FILE *null, int n)
+{
+	int i, failed = 0;
+
+	setenv("preferred_lang", lang, 1);
+	for (i = 0; i < count; i++)
+		failed += bench_page(pages[i], lang, null, n);
+
+	return failed;
+}
+
+int
+main(int argc, char **argv)
+{
+	char dir[] = "/tmp/ej_bench.XXXXXX", cmd[64];
+	const char *www = NULL;
+	char *page_gen[] = { "Advanced_Wireless_Content.asp" };
+	char **pages = page_gen;
+	FILE *null;
+	int c, i, n = 2000, count = 1, failed = 0;
+
+	while ((c = getopt(argc, argv, "n:w:")) != -1) {
+		switch (c) {
+		case 'n':
+			n = atoi(optarg);
+			break;
+		case 'w':
+			www = optarg;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-n renders] [-w wwwdir page.asp ...]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (www) {
+		if (chdir(www) < 0) {
+			perror(www);
+			return 1;
+		}
+	} else {
+		if (!mkdtemp(dir) || chdir(dir) < 0) {
+			perror(dir);
+			return 1;
+		}
+		make_dict("EN.dict", "English text", DICT_KEYS, 0);
+		make_dict("CN.dict", "Chinese text", DICT_KEYS, 10);
+		make_page("Advanced_Wireless_Content.asp", 60000, 300, 160);
+	}
+
+	for (i = 0; i < 40; i++) {
+		char name[16], value[32];
+		sprintf(name, "wl_var%d", i);
+		sprintf(value, "value_of_wl_var%d", i);
+		setenv(name, value, 1);
+	}
+
+	load_dictionary("EN", &kw_EN);
+	legacy_load_dictionary("EN", &legacy_kw_EN);
+
+	null = fopen("/dev/null", "w");
+	if (!null)
+		return 1;
+
+	if (www) {
+		pages = &argv[optind];
+		count = argc - optind;
+	}
+
+	failed += bench_pages(pages, count, "EN", null, n);
+	failed += bench_pages(pages, count, "CN", null, n);
+
+	bench_dict("CN", (n / 10) ? : 1);
+
+	fclose(null);
+
+	if (!www) {
+		snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+		if (system(cmd) != 0)
+			return 1;
+	}
+
+	return (failed) ? 1 : 0;
+}
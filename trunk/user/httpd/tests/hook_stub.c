@@ -0,0 +1,47 @@
+/*
+ * Host stand-in for ej_handlers[] of web_ex.c.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <httpd.h>
+
+/* <% fast(); %>: inline output of main process */
+static int
+fast_hook(int eid, webs_t wp, int argc, char **argv)
+{
+	return websWrite(wp, "var fast_hook = %d;\n", (int)getpid());
+}
+
+/* <% slow(); %>: stands for wanlink_hook() and co, waits on system */
+static int
+slow_hook(int eid, webs_t wp, int argc, char **argv)
+{
+	usleep(((argc > 0) ? atoi(argv[0]) : 300) * 1000);
+	return websWrite(wp, "var slow_hook = %d;\n", (int)getpid());
+}
+
+/* <% nvram_get_x("", "name"); %> and <% nvram_match_x("", "name", "value", "out"); %> */
+static int
+nvram_get_x_hook(int eid, webs_t wp, int argc, char **argv)
+{
+	return (argc > 1) ? websWrite(wp, "%s", nvram_safe_get(argv[1])) : 0;
+}
+
+static int
+nvram_match_x_hook(int eid, webs_t wp, int argc, char **argv)
+{
+	if (argc > 3 && strcmp(nvram_safe_get(argv[1]), argv[2]) == 0)
+		return websWrite(wp, "%s", argv[3]);
+	return 0;
+}
+
+struct ej_handler ej_handlers[] = {
+	{ "nvram_get_x", nvram_get_x_hook },
+	{ "nvram_match_x", nvram_match_x_hook },
+	{ "fast", fast_hook },
+	{ "slow", slow_hook, EJ_FLAG_WORKER },
+	{ NULL, NULL }
+};
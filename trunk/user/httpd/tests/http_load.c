@@ -0,0 +1,692 @@
+/*
+ * Page load test of httpd: a browser fetches the page, then its assets
+ * over up to 6 keep-alive connections. Time of a whole load is reported
+ * as p50/p99 of all loads of all browsers.
+ *
+ * Without -t, httpd_host is started on a generated www root (page with
+ * 30 assets) and loads are repeated by a client w/o gzip support (www
+ * stores large css as .gz only), with a slow hook page being polled
+ * (like status pages poll wanlink), with a client which stalls on a
+ * large download and with status tabs waiting in long-poll. Framing of
+ * a request with a header block larger than httpd's line buffer is
+ * checked first.
+ *
+ * Usage: http_load [-t host:port] [-b browsers] [-l loads] [page asset ...]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define BROWSER_CONNS	6
+#define ASSETS		30
+#define MAX_URLS	256
+#define SLOW_HOOK_MS	300
+#define LONG_POLLS	16
+
+struct load {
+	double msec;			/* < 0: failed */
+	long bytes;
+};
+
+struct conn {
+	int fd;
+	int busy;
+	int close;			/* server closes after response */
+	char *buf;
+	size_t len, size;
+	size_t body;			/* offset of body, 0 until header is complete */
+	long clen;			/* -1: chunked, -2: until close */
+	size_t chunk;			/* offset of next chunk size line */
+};
+
+static struct sockaddr_in server;
+static const char *urls[MAX_URLS];
+static int url_count;
+static int accept_gzip = 1;
+static long load_bytes;
+static int load_errors;
+
+static double
+now_msec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int
+conn_open(struct conn *c)
+{
+	int one = 1;
+
+	c->fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (c->fd < 0)
+		return -1;
+	setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	if (connect(c->fd, (struct sockaddr *)&server, sizeof(server)) < 0) {
+		close(c->fd);
+		c->fd = -1;
+		return -1;
+	}
+	c->close = 0;
+
+	return 0;
+}
+
+static void
+conn_drop(struct conn *c)
+{
+	if (c->fd >= 0)
+		close(c->fd);
+	c->fd = -1;
+	c->busy = 0;
+}
+
+static int
+conn_request(struct conn *c, const char *url)
+{
+	char req[512];
+	int len;
+
+	if (c->fd < 0 && conn_open(c) < 0)
+		return -1;
+
+	len = snprintf(req, sizeof(req),
+		"GET /%s HTTP/1.1\r\nHost: router\r\n%s"
+		"Connection: keep-alive\r\n\r\n", url, (accept_gzip) ? "Accept-Encoding: gzip\r\n" : "");
+	if (write(c->fd, req, len) != len)
+		return -1;
+
+	c->busy = 1;
+	c->len = 0;
+	c->body = 0;
+	c->chunk = 0;
+
+	return 0;
+}
+
+/* Response is complete in buffer: 1 yes, 0 no, -1 bad response */
+static int
+conn_complete(struct conn *c, int eof)
+{
+	char *p, *end;
+	long size;
+
+	if (!c->body) {
+		p = memmem(c->buf, c->len, "\r\n\r\n", 4);
+		if (!p)
+			return (eof) ? -1 : 0;
+		*p = '\0';
+		c->body = p + 4 - c->buf;
+		if (strncmp(c->buf, "HTTP/1.", 7) || atoi(c->buf + 9) != 200)
+			return -1;
+		c->close = (strcasestr(c->buf, "\nConnection: close")) ? 1 : 0;
+		c->clen = -2;
+		if ((p = strcasestr(c->buf, "\nContent-Length:")))
+			c->clen = atol(p + 16);
+		else if (strcasestr(c->buf, "\nTransfer-Encoding: chunked"))
+			c->clen = -1;
+		c->chunk = c->body;
+	}
+
+	if (c->clen >= 0)
+		return (c->len - c->body >= (size_t)c->clen) ? 1 : ((eof) ? -1 : 0);
+
+	if (c->clen == -2)
+		return eof;
+
+	for (;;) {
+		end = c->buf + c->len;
+		p = memmem(c->buf + c->chunk, end - (c->buf + c->chunk), "\r\n", 2);
+		if (!p)
+			break;
+		size = strtol(c->buf + c->chunk, NULL, 16);
+		if (size == 0)
+			return (p + 4 <= end) ? 1 : ((eof) ? -1 : 0);
+		if (p + 2 + size + 2 > end)
+			break;
+		c->chunk = (p + 2 + size + 2) - c->buf;
+	}
+
+	return (eof) ? -1 : 0;
+}
+
+/* Read what is available, returns 1 when response is complete */
+static int
+conn_input(struct conn *c)
+{
+	ssize_t nr;
+	int ret;
+
+	if (c->size - c->len < 16384) {
+		c->size = (c->size) ? c->size * 2 : 65536;
+		c->buf = realloc(c->buf, c->size);
+		if (!c->buf)
+			return -1;
+	}
+
+	nr = read(c->fd, c->buf + c->len, c->size - c->len - 1);
+	if (nr < 0)
+		return (errno == EINTR || errno == EAGAIN) ? 0 : -1;
+	c->len += nr;
+
+	ret = conn_complete(c, (nr == 0));
+	if (ret > 0) {
+		load_bytes += c->len;
+		c->busy = 0;
+		if (c->close || nr == 0)
+			conn_drop(c);
+	} else if (ret == 0 && nr == 0) {
+		ret = -1;
+	}
+
+	return ret;
+}
+
+/* One page load, returns time in ms or -1 */
+static double
+page_load(struct conn *conns)
+{
+	struct pollfd pfd[BROWSER_CONNS];
+	int i, n, next, done, ret;
+	double start = now_msec();
+
+	/* page first, its assets are known after it */
+	if (conn_request(&conns[0], urls[0]) < 0)
+		goto fail;
+	for (;;) {
+		pfd[0].fd = conns[0].fd;
+		pfd[0].events = POLLIN;
+		if (poll(pfd, 1, 60000) <= 0)
+			goto fail;
+		ret = conn_input(&conns[0]);
+		if (ret < 0)
+			goto fail;
+		if (ret > 0)
+			break;
+	}
+
+	next = 1;
+	done = 1;
+	while (done < url_count) {
+		for (i = 0; i < BROWSER_CONNS && next < url_count; i++) {
+			if (!conns[i].busy) {
+				if (conn_request(&conns[i], urls[next++]) < 0)
+					goto fail;
+			}
+		}
+		for (i = 0, n = 0; i < BROWSER_CONNS; i++) {
+			pfd[i].fd = (conns[i].busy) ? conns[i].fd : -1;
+			pfd[i].events = POLLIN;
+			n += conns[i].busy;
+		}
+		if (poll(pfd, BROWSER_CONNS, 60000) <= 0)
+			goto fail;
+		for (i = 0; i < BROWSER_CONNS; i++) {
+			if (!(pfd[i].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+			ret = conn_input(&conns[i]);
+			if (ret < 0)
+				goto fail;
+			done += ret;
+		}
+	}
+
+	for (i = 0; i < BROWSER_CONNS; i++)
+		conn_drop(&conns[i]);
+
+	return now_msec() - start;
+
+fail:
+	for (i = 0; i < BROWSER_CONNS; i++)
+		conn_drop(&conns[i]);
+	return -1;
+}
+
+static void
+browser(int loads, int out_fd)
+{
+	struct conn conns[BROWSER_CONNS];
+	struct load l;
+	int i;
+
+	memset(conns, 0, sizeof(conns));
+	for (i = 0; i < BROWSER_CONNS; i++)
+		conns[i].fd = -1;
+
+	for (i = 0; i < loads; i++) {
+		load_bytes = 0;
+		l.msec = page_load(conns);
+		l.bytes = load_bytes;
+		if (write(out_fd, &l, sizeof(l)) != sizeof(l))
+			break;
+	}
+
+	_exit(0);
+}
+
+static void
+run(const char *name, int browsers, int loads)
+{
+	struct load l;
+	double *t;
+	long total_bytes = 0;
+	int i, n = 0, fds[2], ok;
+	pid_t *pids;
+
+	t = calloc(browsers * loads, sizeof(double));
+	pids = calloc(browsers, sizeof(pid_t));
+	if (!t || !pids || pipe(fds) < 0)
+		exit(1);
+
+	for (i = 0; i < browsers; i++) {
+		pids[i] = fork();
+		if (pids[i] == 0) {
+			close(fds[0]);
+			browser(loads, fds[1]);
+		}
+	}
+	close(fds[1]);
+
+	/* loads are written whole, pipe writes of this size are atomic */
+	load_errors = 0;
+	for (i = 0; i < browsers * loads; i++) {
+		if (read(fds[0], &l, sizeof(l)) != sizeof(l))
+			break;
+		if (l.msec < 0) {
+			load_errors++;
+		} else {
+			t[n++] = l.msec;
+			total_bytes += l.bytes;
+		}
+	}
+	close(fds[0]);
+	for (i = 0; i < browsers; i++)
+		waitpid(pids[i], NULL, 0);
+
+	qsort(t, n, sizeof(double), cmp_double);
+	ok = (n > 0);
+	printf("%-22s: %d x %d loads of %d urls, %ld KB/load, p50 %.1f ms, p99 %.1f ms, max %.1f ms, %d failed\n",
+		name, browsers, loads, url_count, (ok) ? total_bytes / n / 1024 : 0,
+		(ok) ? t[n / 2] : 0, (ok) ? t[(n * 99) / 100] : 0, (ok) ? t[n - 1] : 0, load_errors);
+
+	free(pids);
+	free(t);
+}
+
+/* Background client polling the slow hook page */
+static pid_t
+poller(void)
+{
+	struct conn c;
+	pid_t pid;
+
+	pid = fork();
+	if (pid != 0)
+		return pid;
+
+	memset(&c, 0, sizeof(c));
+	c.fd = -1;
+	for (;;) {
+		if (conn_request(&c, "slow.asp") < 0) {
+			conn_drop(&c);
+			usleep(10000);
+			continue;
+		}
+		while (c.busy) {
+			if (conn_input(&c) < 0) {
+				conn_drop(&c);
+				break;
+			}
+		}
+	}
+}
+
+/* Background client waiting in long-poll, like status tab on status_poll.cgi */
+static pid_t
+long_poller(void)
+{
+	struct conn c;
+	char url[64];
+	long seq = 0;
+	pid_t pid;
+	char *p;
+
+	pid = fork();
+	if (pid != 0)
+		return pid;
+
+	memset(&c, 0, sizeof(c));
+	c.fd = -1;
+	for (;;) {
+		snprintf(url, sizeof(url), "poll.cgi?seq=%ld", seq);
+		if (conn_request(&c, url) < 0) {
+			conn_drop(&c);
+			usleep(10000);
+			continue;
+		}
+		while (c.busy) {
+			if (conn_input(&c) < 0) {
+				conn_drop(&c);
+				break;
+			}
+		}
+		if (c.body && c.body < c.len) {
+			c.buf[c.len] = '\0';
+			p = strstr(c.buf + c.body, "seq: ");
+			if (p)
+				seq = atol(p + 5);
+		}
+	}
+}
+
+/* Background client which requests large file and never reads it */
+static pid_t
+staller(void)
+{
+	struct conn c;
+	pid_t pid;
+	int rcvbuf = 4096;
+
+	pid = fork();
+	if (pid != 0)
+		return pid;
+
+	memset(&c, 0, sizeof(c));
+	for (;;) {
+		c.fd = socket(AF_INET, SOCK_STREAM, 0);
+		setsockopt(c.fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+		if (connect(c.fd, (struct sockaddr *)&server, sizeof(server)) == 0 &&
+		    conn_request(&c, "big.png") == 0)
+			pause();
+		close(c.fd);
+		usleep(10000);
+	}
+}
+
+static void
+write_file(const char *dir, const char *name, const char *head, size_t size)
+{
+	char path[256];
+	FILE *fp;
+	size_t i;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	fp = fopen(path, "w");
+	if (!fp) {
+		perror(path);
+		exit(1);
+	}
+	fputs(head, fp);
+	i = strlen(head);
+	if (strstr(name, ".png")) {
+		/* image data does not compress */
+		for (; i < size; i++)
+			fputc(rand() & 0xff, fp);
+	} else {
+		static const char *words[] = {
+			".btn", " {\n", "}\n", "\tcolor: ", "#fff;\n", "#3a87ad;\n", "\tmargin: ",
+			"0 auto;\n", "\tpadding: ", "4px 8px;\n", "\tdisplay: ", "block;\n",
+			"\tfont-size: ", "12px;\n", "\tbackground: ", "url(bg.png);\n", ".nav-tabs",
+			" > li", ".table", " td", ".span", "6", "12", ":hover"
+		};
+		const char *w;
+		for (; i < size; i += strlen(w)) {
+			w = words[rand() % (sizeof(words) / sizeof(words[0]))];
+			fputs(w, fp);
+		}
+	}
+	fclose(fp);
+}
+
+/* www root: page of 30 assets (css/png of 1..64 KB), slow page, big file.
+ * css over 2 KB is stored as .gz only, like www romfs does. */
+static void
+make_root(const char *dir)
+{
+	static char names[ASSETS][32];
+	char page[4096], slow[128], cmd[1024];
+	int i, len;
+
+	len = snprintf(page, sizeof(page), "<html><head><script><%% fast(); %%></script>\n");
+	for (i = 0; i < ASSETS; i++) {
+		sprintf(names[i], (i % 3) ? "asset%02d.png" : "asset%02d.css", i);
+		write_file(dir, names[i], "", 1024 << (i % 7));
+		if (!(i % 3) && (1024 << (i % 7)) > 2048) {
+			snprintf(cmd, sizeof(cmd), "gzip -9 -n -f %s/%s", dir, names[i]);
+			if (system(cmd) != 0)
+				exit(1);
+		}
+		urls[++url_count] = names[i];
+		len += snprintf(page + len, sizeof(page) - len, "<img src=\"%s\">\n", names[i]);
+	}
+	snprintf(page + len, sizeof(page) - len, "</head>\n");
+	write_file(dir, "index.asp", page, 24 * 1024);
+	urls[0] = "index.asp";
+	url_count++;
+
+	snprintf(slow, sizeof(slow), "<script><%% slow(%d); %%></script>\n", SLOW_HOOK_MS);
+	write_file(dir, "slow.asp", slow, 1024);
+	write_file(dir, "big.png", "", 8 * 1024 * 1024);
+}
+
+/*
+ * Header block larger than the request line buffer, followed by a
+ * pipelined request: httpd must answer once and close, not take the
+ * unread header lines for the next request.
+ */
+static int
+framing_check(void)
+{
+	struct conn c;
+	char req[16384], buf[256 * 1024];
+	int i, len = 0, responses = 0;
+	struct pollfd pfd;
+	ssize_t n;
+	char *p;
+
+	memset(&c, 0, sizeof(c));
+	if (conn_open(&c) < 0)
+		return -1;
+
+	len += snprintf(req + len, sizeof(req) - len, "GET /index.asp HTTP/1.1\r\nHost: router\r\n");
+	for (i = 0; i < 4; i++) {
+		len += snprintf(req + len, sizeof(req) - len, "Authorization: Basic ");
+		memset(req + len, 'A', 1500);
+		len += 1500;
+		len += snprintf(req + len, sizeof(req) - len, "\r\n");
+	}
+	len += snprintf(req + len, sizeof(req) - len,
+		"X-Left-Over: GET /index.asp HTTP/1.1\r\nConnection: keep-alive\r\n\r\n"
+		"GET /index.asp HTTP/1.1\r\nHost: router\r\n\r\n");
+	if (write(c.fd, req, len) != len) {
+		close(c.fd);
+		return -1;
+	}
+
+	/* count responses until close, a kept connection times out as failure */
+	len = 0;
+	pfd.fd = c.fd;
+	pfd.events = POLLIN;
+	while (len < (int)sizeof(buf) - 1) {
+		if (poll(&pfd, 1, 2000) <= 0) {
+			len = -1;
+			break;
+		}
+		n = read(c.fd, buf + len, sizeof(buf) - 1 - len);
+		if (n <= 0)
+			break;
+		len += n;
+	}
+	close(c.fd);
+	if (len < 0)
+		return -1;
+
+	buf[len] = '\0';
+	for (p = buf; (p = strstr(p, "HTTP/1.")); p += 7)
+		responses++;
+
+	return responses;
+}
+
+static pid_t
+start_httpd(const char *dir, int port)
+{
+	char sport[16];
+	pid_t pid;
+	int i, fd;
+
+	snprintf(sport, sizeof(sport), "%d", port);
+	pid = fork();
+	if (pid == 0) {
+		setenv("HTTPD_ROOT", dir, 1);
+		fd = open("/dev/null", O_WRONLY);
+		dup2(fd, 1);
+		execl("./httpd_host", "httpd_host", "-d", "-p", sport, NULL);
+		_exit(127);
+	}
+
+	/* wait until it listens */
+	for (i = 0; i < 500; i++) {
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (connect(fd, (struct sockaddr *)&server, sizeof(server)) == 0) {
+			close(fd);
+			return pid;
+		}
+		close(fd);
+		usleep(10000);
+	}
+
+	fprintf(stderr, "http_load: httpd_host does not listen on port %d\n", port);
+	kill(pid, SIGKILL);
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	char dir[] = "/tmp/http_load.XXXXXX", cmd[64];
+	const char *target = NULL;
+	int c, port, browsers = 4, loads = 50;
+	pid_t httpd = 0, bg[LONG_POLLS];
+	struct hostent *he;
+	char *p;
+
+	while ((c = getopt(argc, argv, "t:b:l:")) != -1) {
+		switch (c) {
+		case 't':
+			target = optarg;
+			break;
+		case 'b':
+			browsers = atoi(optarg);
+			break;
+		case 'l':
+			loads = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-t host:port] [-b browsers] [-l loads] [page asset ...]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	server.sin_family = AF_INET;
+
+	if (target) {
+		char host[128];
+
+		snprintf(host, sizeof(host), "%s", target);
+		p = strchr(host, ':');
+		port = (p) ? atoi(p + 1) : 80;
+		if (p)
+			*p = '\0';
+		he = gethostbyname(host);
+		if (!he || optind >= argc) {
+			fprintf(stderr, "http_load: need resolvable host and page [asset ...]\n");
+			return 1;
+		}
+		memcpy(&server.sin_addr, he->h_addr, sizeof(server.sin_addr));
+		server.sin_port = htons(port);
+		for (; optind < argc && url_count < MAX_URLS; optind++)
+			urls[url_count++] = (argv[optind][0] == '/') ? argv[optind] + 1 : argv[optind];
+		run("page load", browsers, loads);
+		return 0;
+	}
+
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	make_root(dir);
+
+	port = 20000 + getpid() % 20000;
+	server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	server.sin_port = htons(port);
+	httpd = start_httpd(dir, port);
+
+	c = framing_check();
+	printf("header framing        : %d response(s) to oversized header block + pipelined request, %s\n",
+		c, (c == 1) ? "ok" : "FAILED");
+	if (c != 1) {
+		kill(httpd, SIGKILL);
+		return 1;
+	}
+
+	run("page load", browsers, loads);
+	accept_gzip = 0;
+	run("page load w/o gzip", browsers, loads);
+	accept_gzip = 1;
+
+	bg[0] = poller();
+	bg[1] = poller();
+	run("+ slow hook polled", browsers, loads);
+	kill(bg[0], SIGKILL);
+	kill(bg[1], SIGKILL);
+	waitpid(bg[0], NULL, 0);
+	waitpid(bg[1], NULL, 0);
+
+	bg[0] = staller();
+	usleep(200000);
+	run("+ stalled download", browsers, loads);
+	kill(bg[0], SIGKILL);
+	waitpid(bg[0], NULL, 0);
+
+	for (c = 0; c < LONG_POLLS; c++)
+		bg[c] = long_poller();
+	usleep(200000);
+	run("+ long-polls held", browsers, loads);
+	for (c = 0; c < LONG_POLLS; c++) {
+		kill(bg[c], SIGKILL);
+		waitpid(bg[c], NULL, 0);
+	}
+
+	kill(httpd, SIGTERM);
+	waitpid(httpd, NULL, 0);
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+	return system(cmd);
+}
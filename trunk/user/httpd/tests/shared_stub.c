@@ -0,0 +1,86 @@
+/*
+ * Host stand-in for libshared calls of httpd.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#include <httpd.h>
+
+/* libshared, nvram variables are taken from environment */
+char *
+nvram_get(const char *name)
+{
+	return getenv(name);
+}
+
+char *
+nvram_safe_get(const char *name)
+{
+	char *value = getenv(name);
+
+	return (value) ? value : "";
+}
+
+int
+nvram_get_int(const char *name)
+{
+	return atoi(nvram_safe_get(name));
+}
+
+int
+nvram_set(const char *name, const char *value)
+{
+	return 0;
+}
+
+int
+nvram_set_temp(const char *name, const char *value)
+{
+	return 0;
+}
+
+void
+logmessage(char *logheader, char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	fprintf(stderr, "%s: ", logheader);
+	vfprintf(stderr, fmt, args);
+	fputc('\n', stderr);
+	va_end(args);
+}
+
+int
+f_exists(const char *path)
+{
+	return access(path, F_OK) == 0;
+}
+
+int
+get_ap_mode(void)
+{
+	return 0;
+}
+
+int
+is_mac_in_sta_list(const unsigned char *p_mac)
+{
+	return 1;
+}
+
+int
+ether_atoe(const char *a, unsigned char *e)
+{
+	return 0;
+}
+
+char *
+ether_etoa(const unsigned char *e, char *a)
+{
+	a[0] = 0;
+	return a;
+}
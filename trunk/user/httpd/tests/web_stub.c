@@ -0,0 +1,127 @@
+/*
+ * Host stand-in for web_ex.c handlers used by httpd.c: static files,
+ * pages, update.cgi, a long-poll and an upload, enough to serve a page
+ * load.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <httpd.h>
+
+static char post_buf[65535];
+
+void
+do_cgi_clear(void)
+{
+	init_cgi(NULL);
+	post_buf[0] = 0;
+}
+
+void
+do_uncgi_query(const char *query)
+{
+	init_cgi(NULL);
+	snprintf(post_buf, sizeof(post_buf), "%s", query);
+	if (post_buf[0])
+		init_cgi(post_buf);
+}
+
+static void
+do_html_post(const char *url, FILE *stream, int len, char *boundary)
+{
+	if (len >= sizeof(post_buf))
+		len = sizeof(post_buf) - 1;
+	if (!fgets(post_buf, len + 1, stream))
+		post_buf[0] = 0;
+	init_cgi(post_buf);
+}
+
+/* upload.cgi: count body bytes, answer with the count */
+static void
+do_upload_post(const char *url, FILE *stream, int len, char *boundary)
+{
+	char buf[4096];
+	size_t nr;
+
+	post_buf[0] = 0;
+	while (len > 0) {
+		nr = fread(buf, 1, (len < sizeof(buf)) ? len : sizeof(buf), stream);
+		if (nr < 1)
+			break;
+		len -= nr;
+	}
+	snprintf(post_buf, sizeof(post_buf), "left=%d", len);
+}
+
+static void
+do_upload_cgi(const char *url, FILE *stream)
+{
+	fprintf(stream, "%s pid=%d\n", post_buf, (int)getpid());
+}
+
+/* update.cgi?output=hook */
+static void
+do_update_cgi(const char *url, FILE *stream)
+{
+	struct ej_handler *handler;
+	const char *pattern = get_cgi("output");
+
+	for (handler = &ej_handlers[0]; pattern && handler->pattern; handler++) {
+		if (strcmp(handler->pattern, pattern) == 0) {
+			handler->output(0, stream, 0, NULL);
+			break;
+		}
+	}
+}
+
+/* poll.cgi?seq=N: long-poll, news every 2 seconds */
+static long
+poll_seq(void)
+{
+	return time(NULL) / 2;
+}
+
+static int
+poll_ready(const char *url)
+{
+	const char *seq = get_cgi("seq");
+
+	return (!seq || poll_seq() > atol(seq)) ? 1 : 0;
+}
+
+static void
+do_poll_cgi(const char *url, FILE *stream)
+{
+	fprintf(stream, "{ seq: %ld }", poll_seq());
+}
+
+static char no_cache_IE[] =
+"X-UA-Compatible: IE=edge\r\n"
+"Cache-Control: no-cache, no-store, must-revalidate\r\n"
+"Pragma: no-cache\r\n"
+"Expires: 0";
+
+struct mime_handler mime_handlers[] = {
+	{ "**.css", "text/css", NULL, NULL, do_file, 0 },
+	{ "**.png", "image/png", NULL, NULL, do_file, 0 },
+	{ "**.asp*", "text/html", no_cache_IE, do_html_post, do_ej, 1 },
+	{ "**.js",  "text/javascript", no_cache_IE, NULL, do_ej, 1 },
+	{ "update.cgi*", "text/javascript", no_cache_IE, do_html_post, do_update_cgi, 1, MIME_FLAG_EJ_OUTPUT },
+	{ "poll.cgi*", "text/javascript", no_cache_IE, NULL, do_poll_cgi, 1, 0, poll_ready },
+	{ "upload.cgi*", "text/plain", no_cache_IE, do_upload_post, do_upload_cgi, 1 },
+	{ NULL, NULL, NULL, NULL, NULL, 0 }
+};
+
+/* httpd.c serves /www, serve HTTPD_ROOT instead */
+int __real_chdir(const char *path);
+
+int
+__wrap_chdir(const char *path)
+{
+	const char *root = getenv("HTTPD_ROOT");
+
+	return __real_chdir((root) ? root : path);
+}
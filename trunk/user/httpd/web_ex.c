@@ -867,6 +867,136 @@ validate_nvram_lan_subnet(void)
 	validate_nvram_lan_param("dmz_ip", lan_addr, lan_mask);
 }
 
+/* Pending nvram changes, applied by one nvram_set_multi() */
+struct nvram_batch {
+	struct nvram_pair *pairs;
+	int count;
+	int size;
+};
+
+static void
+nvram_batch_set(struct nvram_batch *nb, const char *name, const char *value)
+{
+	struct nvram_pair *pairs;
+	char *name_copy, *val_copy = NULL;
+	int i;
+
+	if (!(name_copy = strdup(name)))
+		goto direct;
+
+	if (value && !(val_copy = strdup(value)))
+		goto direct_free;
+
+	/* later set of the same name replaces the pending value */
+	for (i = 0; i < nb->count; i++) {
+		if (!strcmp(nb->pairs[i].name, name)) {
+			free(name_copy);
+			free(nb->pairs[i].value);
+			nb->pairs[i].value = val_copy;
+			return;
+		}
+	}
+
+	if (nb->count >= nb->size) {
+		pairs = realloc(nb->pairs, (nb->size + 64) * sizeof(struct nvram_pair));
+		if (!pairs)
+			goto direct_free;
+		nb->pairs = pairs;
+		nb->size += 64;
+	}
+
+	nb->pairs[nb->count].name = name_copy;
+	nb->pairs[nb->count].value = val_copy;
+	nb->count++;
+	return;
+
+direct_free:
+	free(name_copy);
+	free(val_copy);
+direct:
+	if (value)
+		nvram_set(name, value);
+	else
+		nvram_unset(name);
+}
+
+static void
+nvram_batch_set_int(struct nvram_batch *nb, const char *name, int value)
+{
+	char int_str[16];
+
+	snprintf(int_str, sizeof(int_str), "%d", value);
+	nvram_batch_set(nb, name, int_str);
+}
+
+/* Read through the batch, so checks in the same apply see pending values */
+static char *
+nvram_batch_safe_get(struct nvram_batch *nb, const char *name)
+{
+	int i;
+
+	for (i = nb->count - 1; i >= 0; i--) {
+		if (!strcmp(nb->pairs[i].name, name))
+			return (nb->pairs[i].value) ? nb->pairs[i].value : "";
+	}
+
+	return nvram_safe_get(name);
+}
+
+static int
+nvram_batch_get_int(struct nvram_batch *nb, const char *name)
+{
+	return atoi(nvram_batch_safe_get(nb, name));
+}
+
+static void
+nvram_batch_apply(struct nvram_batch *nb)
+{
+	int i;
+
+	if (nb->count > 0)
+		nvram_set_multi(nb->pairs, nb->count);
+
+	for (i = 0; i < nb->count; i++) {
+		free(nb->pairs[i].name);
+		free(nb->pairs[i].value);
+	}
+
+	free(nb->pairs);
+	nb->pairs = NULL;
+	nb->count = 0;
+	nb->size = 0;
+}
+
+/* Fetch current values of all posted variables at once */
+static void
+validate_asp_prefetch(webs_t wp, int sid)
+{
+	struct nvram_pair *pairs;
+	struct variable *v;
+	int count = 0;
+
+	for (v = GetVariables(sid); v->name != NULL; ++v)
+		count++;
+
+	if (count < 1 || !(pairs = malloc(count * sizeof(struct nvram_pair))))
+		return;
+
+	count = 0;
+	for (v = GetVariables(sid); v->name != NULL; ++v) {
+		if (!strcmp(v->longname, "Group") || !strcmp(v->longname, "File"))
+			continue;
+		if (!websGetVar(wp, v->name, NULL))
+			continue;
+		pairs[count].name = (char *)v->name;
+		pairs[count].value = NULL;
+		count++;
+	}
+
+	nvram_get_multi(pairs, count);
+	free(pairs);
+}
+
 static int
 validate_asp_apply(webs_t wp, int sid)
 {
@@ -875,10 +1005,13 @@ validate_asp_apply(webs_t wp, int sid)
 	int pass_changed = 0;
 	int lanip_changed = 0;
 	struct variable *v;
+	struct nvram_batch nb = { NULL, 0, 0 };
 	char *value;
 	char name[64];
 	char buff[160];
 
+	validate_asp_prefetch(wp, sid);
+
 	/* Validate and set variables in table order */
 	for (v = GetVariables(sid); v->name != NULL; ++v) {
 		snprintf(name, sizeof(name), "%s", v->name);
@@ -906,10 +1039,12 @@ validate_asp_apply(webs_t wp, int sid)
 					restart_needed_bits |= event_mask;
 					if (!strcmp(file_name, "ap_script.sh"))
 					{
+					/* script reads nvram, apply what is pending */
+					nvram_batch_apply(&nb);
 					doSystem("/etc/storage/ap_script.sh");
 					}
 			} else if (!strncmp(v->name, "crontab.", 8)) {
-				if (write_textarea_to_file(value, STORAGE_CRONTAB_DIR, nvram_safe_get("http_username")))
+				if (write_textarea_to_file(value, STORAGE_CRONTAB_DIR, nvram_batch_safe_get(&nb, "http_username")))
 					restart_needed_bits |= event_mask;
 			}
 #if defined (SUPPORT_HTTPS)
@@ -931,7 +1066,7 @@ validate_asp_apply(webs_t wp, int sid)
 		}
 		
 		/* check NVRAM value is changed */
-		if (!strcmp(nvram_safe_get(name), value))
+		if (!strcmp(nvram_batch_safe_get(&nb, name), value))
 			continue;
 		
 		if (!strcmp(v->name, "http_username") || !strcmp(v->name, "http_passwd")) {
@@ -941,12 +1076,12 @@ validate_asp_apply(webs_t wp, int sid)
 		
 		if (!strcmp(v->name, "http_username")) {
 			size_t buf_div = sizeof(buff)/2;
-			snprintf(buff, buf_div, "%s/%s", STORAGE_CRONTAB_DIR, nvram_safe_get(v->name));
+			snprintf(buff, buf_div, "%s/%s", STORAGE_CRONTAB_DIR, nvram_batch_safe_get(&nb, v->name));
 			snprintf(buff+buf_div, buf_div, "%s/%s", STORAGE_CRONTAB_DIR, value);
 			rename(buff, buff+buf_div);
 		}
 		
-		nvram_set(v->name, value);
+		nvram_batch_set(&nb, v->name, value);
 		nvram_modified = 1;
 		
 		if (!strcmp(v->name, "http_username"))
@@ -961,8 +1096,8 @@ validate_asp_apply(webs_t wp, int sid)
 		/* update sw_mode before nvram_commit */
 		if (!strcmp(v->name, "wan_nat_x")) {
 			int wan_nat_x = atoi(value);
-			if (nvram_get_int("sw_mode") != 3)
-				nvram_set_int("sw_mode", (wan_nat_x) ? 1 : 4);
+			if (nvram_batch_get_int(&nb, "sw_mode") != 3)
+				nvram_batch_set_int(&nb, "sw_mode", (wan_nat_x) ? 1 : 4);
 		}
 		
 #if BOARD_HAS_5G_RADIO
@@ -972,7 +1107,7 @@ validate_asp_apply(webs_t wp, int sid)
 			{
 				memset(buff, 0, sizeof(buff));
 				char_to_ascii(buff, value);
-				nvram_set("wl_ssid2", buff);
+				nvram_batch_set(&nb, "wl_ssid2", buff);
 			}
 			
 			if (!strcmp(v->name, "wl_TxPower"))
@@ -1045,7 +1180,7 @@ validate_asp_apply(webs_t wp, int sid)
 			{
 				memset(buff, 0, sizeof(buff));
 				char_to_ascii(buff, value);
-				nvram_set("rt_ssid2", buff);
+				nvram_batch_set(&nb, "rt_ssid2", buff);
 			}
 			
 			if (!strcmp(v->name, "rt_TxPower"))
@@ -1124,6 +1259,8 @@ validate_asp_apply(webs_t wp, int sid)
 		}
 	}
 
+	nvram_batch_apply(&nb);
+
 	if (user_changed || pass_changed)
 		auth_nvram_changed = 1;
 
@@ -2022,114 +2159,55 @@ static int
 applydb_cgi(webs_t wp, char *urlPrefix, char *webDir, int arg,
 		char *url, char *path, char *query)
 {
-	char *action_mode;
-	char *action_script;
-	char dbjson[100][9999];
-	char dbvar[2048];
-	char dbval[9999];
-	char notify_cmd[128];
-	char db_cmd[128];
-	int i, j;
-	char *result = NULL;
-	char *temp = NULL;
+	char *var, *val, *next;
 	char *name = websGetVar(wp, "p","");
-	char scPath[128];
-	char *post_db_buf = post_json_buf;
-
-	action_mode = websGetVar(wp, "action_mode", "");
-	action_script = websGetVar(wp, "action_script", "");
-	char userm[] = "deleting";
-	char useping[] = "ping";
-	char useaping[] = "allping";
-	char usedlink[] = "dlink";
-	char useddlink[] = "ddlink";
-	
+	int name_len = strlen(name);
 	dbclient client;
-	dbclient_start(&client);
-	if (strlen(name) <= 0) {
+
+	if (name_len <= 0) {
 		printf("No \"name\"!\n");
 	}
-	if ( !strcmp("", post_db_buf)){
+
+	if (!strcmp("", post_json_buf)) {
 		//get
-		sprintf(post_db_buf, "%s", post_buf_backup+1);
-		unescape(post_db_buf);
-		//logmessage("HTTPD", "url: %s,%s", post_db_buf, name);
-		strcpy(post_json_buf, post_db_buf);
-		result = strtok( post_json_buf, "&" );
-		i =0;
-	while( result != NULL )
-	{
-		if (result!=NULL)
-		{
-		strcpy(dbjson[i], result);
-		i++;
-			result = strtok( NULL, "&" );
-		}
-	}
-	for (j =0; j < i; j++)
-	{
-		if(!strncasecmp(dbjson[j], name, strlen(name))){
-				memset(dbvar,'\0',sizeof(dbvar));
-				memset(dbval,'\0',sizeof(dbval));
-				temp=strstr(dbjson[j], "=");
-				strcpy(dbval, temp+1);
-				strncpy(dbvar, dbjson[j], strlen(dbjson[j])-strlen(temp));
-			logmessage("httpd", "name: %s post: %s", dbvar, userm);
-			if(strcmp(dbval,userm) == 0)
-				doSystem("dbus remove %s", dbvar);
-			else if(strcmp(dbval,useping) == 0)
-				doSystem("/etc_ro/ss/ping.sh %s", dbvar);
-			else if(strcmp(dbval,useaping) == 0)
-				doSystem("/etc_ro/ss/allping.sh");
-			else if(strcmp(dbval,usedlink) == 0)
-				doSystem("/usr/bin/update_dlink.sh %s", "start");
-			else if(strcmp(dbval,useddlink) == 0)
-				doSystem("/usr/bin/update_dlink.sh %s", "reset");
-			else
-				doSystem("dbus set %s='%s'", dbvar, dbval);
-		}
+		snprintf(post_json_buf, sizeof(post_json_buf), "%s", post_buf_backup+1);
 	}
-	} else {
-	//post
-	unescape(post_db_buf);
-	//logmessage("HTTPD", "name: %s post: %s", name, post_json_buf);
-	//logmessage("HTTPD", "name: %s post: %s", name, post_db_buf);
-	strcpy(post_json_buf, post_db_buf);
-	result = strtok( post_json_buf, "&" );
-	i =0;
-	while( result != NULL )
-	{
-		if (result!=NULL)
-		{
-		strcpy(dbjson[i], result);
-		i++;
-			result = strtok( NULL, "&" );
+	unescape(post_json_buf);
+
+	dbclient_start(&client);
+
+	/* all plain set/remove go to skipd in one batch */
+	for (next = post_json_buf; (var = strsep(&next, "&")) != NULL; ) {
+		if (strncasecmp(var, name, name_len) != 0)
+			continue;
+		if (!(val = strchr(var, '=')))
+			continue;
+		*val++ = '\0';
+		
+		if (strcmp(val, "deleting") == 0) {
+			logmessage("httpd", "name: %s post: %s", var, val);
+			dbclient_mset(&client, var, NULL, -1);
+			continue;
 		}
-	}
-	for (j =0; j < i; j++)
-	{
-		if(!strncasecmp(dbjson[j], name, strlen(name))){
-				memset(dbvar,'\0',sizeof(dbvar));
-				memset(dbval,'\0',sizeof(dbval));
-				temp=strstr(dbjson[j], "=");
-				strcpy(dbval, temp+1);
-				strncpy(dbvar, dbjson[j], strlen(dbjson[j])-strlen(temp));
-			//logmessage("HTTPD", "name: %s post: %s", dbvar, dbval);
-			if(strcmp(dbval,userm) == 0)
-				doSystem("dbus remove %s", dbvar);
-			else if(strcmp(dbval,useping) == 0)
-				doSystem("/etc_ro/ss/ping.sh %s", dbvar);
-			else if(strcmp(dbval,useaping) == 0)
-				doSystem("/etc_ro/ss/allping.sh");
-			else if(strcmp(dbval,usedlink) == 0)
-				doSystem("/usr/bin/update_dlink.sh %s", "start");
-			else if(strcmp(dbval,useddlink) == 0)
-				doSystem("/usr/bin/update_dlink.sh %s", "reset");
-			else
-				doSystem("dbus set %s='%s'", dbvar, dbval);
+		if (strcmp(val, "ping") && strcmp(val, "allping") && strcmp(val, "dlink") && strcmp(val, "ddlink")) {
+			dbclient_mset(&client, var, val, strlen(val));
+			continue;
 		}
+		
+		/* scripts may read db, keep order */
+		dbclient_flush(&client);
+		if (strcmp(val, "ping") == 0)
+			doSystem("/etc_ro/ss/ping.sh %s", var);
+		else if (strcmp(val, "allping") == 0)
+			doSystem("/etc_ro/ss/allping.sh");
+		else if (strcmp(val, "dlink") == 0)
+			doSystem("/usr/bin/update_dlink.sh %s", "start");
+		else
+			doSystem("/usr/bin/update_dlink.sh %s", "reset");
 	}
-	}
+
+	/* db files are saved with storage, wait for skipd to write them */
+	dbclient_commit(&client);
 	dbclient_end(&client);
 	doSystem("/sbin/mtd_storage.sh %s", "save");
 	return 0;
@@ -2147,27 +2225,33 @@ static int db_print(dbclient* client, webs_t wp, char* prefix, char* key, char*
 	return 0;
 }
 
+/* p=prefix[,prefix...], optional o=offset, l=limit for paging,
+ * m=keys for names only, m=count for the number of matches */
 static void
 do_dbconf(char *url, FILE *stream)
 {
-	char *name = NULL;
-	char * delim = ",";
+	char *name;
 	char *pattern = websGetVar(wp, "p","");
+	char *mode = websGetVar(wp, "m","");
+	int offset = atoi(websGetVar(wp, "o","0"));
+	int limit = atoi(websGetVar(wp, "l","0"));
 	char *dup_pattern = strdup(pattern);
 	char *sepstr = dup_pattern;
 	dbclient client;
-	dbclient_start(&client);
-	if(strstr(sepstr,delim)) {
-		for(name = strsep(&sepstr, delim); name != NULL; name = strsep(&sepstr, delim)) {
-			websWrite(stream,"var db_%s=(function() {\nvar o={};\n", name);
 
-			dbclient_list(&client, name, stream, db_print);
-			websWrite(stream,"return o;\n})();\n" );
+	if (!dup_pattern)
+		return;
+
+	dbclient_start(&client);
+	for (name = strsep(&sepstr, ","); name != NULL; name = strsep(&sepstr, ",")) {
+		if (strcmp(mode, "count") == 0) {
+			websWrite(stream, "var db_%s_count=%d;\n", name,
+				_max(dbclient_scan(&client, name, DB_SCAN_COUNT, 0, 0, stream, NULL), 0));
+			continue;
 		}
-	} else {
-		name= strdup(pattern);
 		websWrite(stream,"var db_%s=(function() {\nvar o={};\n", name);
-		dbclient_list(&client, name, stream, db_print);
+		dbclient_scan(&client, name, (strcmp(mode, "keys") == 0) ? DB_SCAN_KEYS : DB_SCAN_ALL,
+			offset, limit, stream, db_print);
 		websWrite(stream,"return o;\n})();\n" );
 	}
 	free(dup_pattern);
@@ -3718,7 +3802,29 @@ void get_wifidata(struct wifi_stats *st, int is_5ghz)
 #define LOAD_INT(x)	(unsigned)((x) >> 16)
 #define LOAD_FRAC(x)	LOAD_INT(((x) & ((1 << 16) - 1)) * 100)
 
-static int ej_system_status_hook(int eid, webs_t wp, int argc, char **argv)
+#define SYSTEM_STATUS_TTL	2	/* sec, snapshot is shared by all status pollers */
+
+enum {
+	STATUS_LAVG = 0,
+	STATUS_UPTIME,
+	STATUS_RAM,
+	STATUS_SWAP,
+	STATUS_CPU,
+	STATUS_WIFI2,
+	STATUS_WIFI5,
+	STATUS_LOGMT,
+	STATUS_FIELDS
+};
+
+#define STATUS_FIELD_LEN	320
+
+/* Snapshot as 'name: value' fields, previous one is kept for deltas */
+static char system_status[2][STATUS_FIELDS][STATUS_FIELD_LEN];
+static unsigned long system_status_seq = 0;
+static long system_status_time = -1;
+
+static void
+system_status_sample(char field[STATUS_FIELDS][STATUS_FIELD_LEN])
 {
 	struct sysinfo info;
 	struct cpu_stats cpu;
@@ -3745,75 +3851,227 @@ static int ej_system_status_hook(int eid, webs_t wp, int argc, char **argv)
 	if (stat("/tmp/syslog.log", &log) != 0)
 		log.st_mtime = 0;
 
-	websWrite(wp, "{ lavg: \"%u.%02u %u.%02u %u.%02u\", "
-			"uptime: {days: %lu, hours: %lu, minutes: %lu}, "
-			"ram: {total: %lu, used: %lu, free: %lu, buffers: %lu, cached: %lu}, "
-			"swap: {total: %lu, used: %lu, free: %lu}, "
-			"cpu: {busy: 0x%llx, user: 0x%llx, nice: 0x%llx, system: 0x%llx, "
-			      "idle: 0x%llx, iowait: 0x%llx, irq: 0x%llx, sirq: 0x%llx, total: 0x%llx}, "
-			"wifi2: {state: %d, guest: %d}, "
-			"wifi5: {state: %d, guest: %d}, "
-			"logmt: %ld }",
+	snprintf(field[STATUS_LAVG], sizeof(field[0]), "lavg: \"%u.%02u %u.%02u %u.%02u\"",
 			LOAD_INT(info.loads[0]), LOAD_FRAC(info.loads[0]),
 			LOAD_INT(info.loads[1]), LOAD_FRAC(info.loads[1]),
-			LOAD_INT(info.loads[2]), LOAD_FRAC(info.loads[2]),
-			updays, uphours, upminutes,
-			mem.total, (mem.total - mem.free), mem.free, mem.buffers, mem.cached,
-			mem.sw_total, (mem.sw_total - mem.sw_free), mem.sw_free,
-			cpu.busy, cpu.user, cpu.nice, cpu.system, cpu.idle, cpu.iowait, cpu.irq, cpu.sirq, cpu.total,
-			wifi2.radio, wifi2.ap_guest,
-			wifi5.radio, wifi5.ap_guest,
-			log.st_mtime
-		);
+			LOAD_INT(info.loads[2]), LOAD_FRAC(info.loads[2]));
+	snprintf(field[STATUS_UPTIME], sizeof(field[0]), "uptime: {days: %lu, hours: %lu, minutes: %lu}",
+			updays, uphours, upminutes);
+	snprintf(field[STATUS_RAM], sizeof(field[0]), "ram: {total: %lu, used: %lu, free: %lu, buffers: %lu, cached: %lu}",
+			mem.total, (mem.total - mem.free), mem.free, mem.buffers, mem.cached);
+	snprintf(field[STATUS_SWAP], sizeof(field[0]), "swap: {total: %lu, used: %lu, free: %lu}",
+			mem.sw_total, (mem.sw_total - mem.sw_free), mem.sw_free);
+	snprintf(field[STATUS_CPU], sizeof(field[0]), "cpu: {busy: 0x%llx, user: 0x%llx, nice: 0x%llx, system: 0x%llx, "
+			"idle: 0x%llx, iowait: 0x%llx, irq: 0x%llx, sirq: 0x%llx, total: 0x%llx}",
+			cpu.busy, cpu.user, cpu.nice, cpu.system, cpu.idle, cpu.iowait, cpu.irq, cpu.sirq, cpu.total);
+	snprintf(field[STATUS_WIFI2], sizeof(field[0]), "wifi2: {state: %d, guest: %d}",
+			wifi2.radio, wifi2.ap_guest);
+	snprintf(field[STATUS_WIFI5], sizeof(field[0]), "wifi5: {state: %d, guest: %d}",
+			wifi5.radio, wifi5.ap_guest);
+	snprintf(field[STATUS_LOGMT], sizeof(field[0]), "logmt: %ld",
+			log.st_mtime);
+}
+
+/* Take new sample when snapshot is older than TTL, seq counts changes */
+static void
+system_status_update(void)
+{
+	char field[STATUS_FIELDS][STATUS_FIELD_LEN];
+	long now = uptime();
+
+	if (system_status_time >= 0 && (now - system_status_time) < SYSTEM_STATUS_TTL)
+		return;
+
+	system_status_time = now;
+	memset(field, 0, sizeof(field));
+	system_status_sample(field);
+	if (system_status_seq > 0 && memcmp(field, system_status[0], sizeof(field)) == 0)
+		return;
+
+	memcpy(system_status[1], system_status[0], sizeof(field));
+	memcpy(system_status[0], field, sizeof(field));
+	system_status_seq++;
+}
+
+static int ej_system_status_hook(int eid, webs_t wp, int argc, char **argv)
+{
+	int i;
+
+	system_status_update();
+
+	fputs("{ ", wp);
+	for (i = 0; i < STATUS_FIELDS; i++)
+		fprintf(wp, "%s%s", (i) ? ", " : "", system_status[0][i]);
+	fputs(" }", wp);
+
+	return 0;
+}
+
+static unsigned long
+status_poll_seq(void)
+{
+	const char *seq = get_cgi("seq");
+
+	return (seq) ? strtoul(seq, NULL, 10) : 0;
+}
+
+static int
+status_poll_ready(const char *url)
+{
+	system_status_update();
+
+	return (status_poll_seq() != system_status_seq) ? 1 : 0;
+}
+
+/*
+ * status_poll.cgi?seq=N
+ * Long-poll for json_system_status: held until snapshot differs from
+ * client's seq N. Reply is '{ seq: S, delta: 1, ... }' with fields
+ * changed since seq N when client has previous snapshot, or complete
+ * snapshot w/o 'delta' otherwise.
+ */
+static void
+do_status_poll_cgi(const char *url, FILE *stream)
+{
+	unsigned long seq;
+	int i, delta;
+
+	system_status_update();
+
+	seq = status_poll_seq();
+	delta = (seq > 0 && (seq == system_status_seq || seq + 1 == system_status_seq)) ? 1 : 0;
+
+	fprintf(stream, "{ seq: %lu", system_status_seq);
+	if (delta)
+		fputs(", delta: 1", stream);
+	for (i = 0; i < STATUS_FIELDS; i++) {
+		if (delta && (seq == system_status_seq ||
+		    strcmp(system_status[0][i], system_status[1][i]) == 0))
+			continue;
+		fprintf(stream, ", %s", system_status[0][i]);
+	}
+	fputs(" }", stream);
+}
+
+#define SYSLOG_FILE		"/tmp/syslog.log"
+#define SYSLOG_TAIL_LINES	100
+
+/* Find offset of last N lines, scan backwards from end of file */
+static off_t
+syslog_tail_offset(int fd, off_t size, int lines)
+{
+	char buf[2048];
+	off_t pos, end;
+	ssize_t nr;
+	int i;
+
+	if (lines < 1)
+		return size;
+
+	/* newline of last line is not a separator */
+	end = size - 1;
+	if (end < 0 || pread(fd, buf, 1, end) != 1 || buf[0] != '\n')
+		end = size;
+
+	for (pos = end; pos > 0; ) {
+		nr = (pos < sizeof(buf)) ? pos : sizeof(buf);
+		pos -= nr;
+		if (pread(fd, buf, nr, pos) != nr)
+			return 0;
+		for (i = nr - 1; i >= 0; i--) {
+			if (buf[i] == '\n' && --lines == 0)
+				return pos + i + 1;
+		}
+	}
 
 	return 0;
 }
 
 static int ej_dump_syslog_hook(int eid, webs_t wp, int argc, char **argv)
 {
-	int log_lines = 0;
+	int fd;
+	off_t start;
+	struct stat st;
 	int log_float = nvram_get_int("log_float_ui");
 
 	if (log_float > 0) {
-		FILE *fp;
-		int lskip = 0;
-		char buf[MAX_FILE_LINE_SIZE];
-		
-		fp = fopen("/tmp/syslog.log", "r");
-		if (fp) {
-			if (log_float > 1){
-				int ltotal = 0;
-				
-				while (fgets(buf, sizeof(buf), fp)!=NULL)
-					ltotal++;
-				fseek(fp, 0L, SEEK_SET);
-				
-				lskip = ltotal - 100;
-				if (lskip < 0)
-					lskip = 0;
+		fd = open(SYSLOG_FILE, O_RDONLY);
+		if (fd >= 0) {
+			if (fstat(fd, &st) == 0) {
+				start = (log_float > 1) ? syslog_tail_offset(fd, st.st_size, SYSLOG_TAIL_LINES) : 0;
+				do_file_range(fd, start, st.st_size - start, wp);
 			}
-			
-			while (fgets(buf, sizeof(buf), fp)!=NULL){
-				if (lskip > 0) {
-					lskip--;
-					continue;
-				}
-				fputs(buf, wp);
-				log_lines++;
-			}
-			
-			fclose(fp);
+			close(fd);
 		}
 	}
 
-	if (!log_lines)
-		fputs("", wp);
-
 	fflush(wp);
 
 	return 0;
 }
 
+/* syslog_tail.txt long-poll, held while log has nothing after offset */
+static int
+syslog_tail_ready(const char *url)
+{
+	struct stat st;
+	const char *wait, *inode, *offset;
+
+	wait = get_cgi("wait");
+	inode = get_cgi("inode");
+	offset = get_cgi("offset");
+	if (!wait || atoi(wait) == 0 || !inode || !offset)
+		return 1;
+
+	if (stat(SYSLOG_FILE, &st) != 0)
+		return 0;
+
+	return (strtoul(inode, NULL, 10) != (unsigned long)st.st_ino ||
+		strtoll(offset, NULL, 10) != (long long)st.st_size) ? 1 : 0;
+}
+
+/*
+ * syslog_tail.txt?inode=I&offset=N[&lines=L][&wait=1]
+ * First line is "<inode> <offset>" to pass in next request, followed by
+ * log data added since offset. Last L lines are sent if log was rotated
+ * or no offset given. With wait=1 reply is held until log changes.
+ */
+static void
+do_syslog_tail(const char *url, FILE *stream)
+{
+	int fd, lines;
+	off_t start;
+	struct stat st;
+	const char *inode, *offset, *nlines;
+
+	fd = open(SYSLOG_FILE, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		fprintf(stream, "0 0\n");
+		if (fd >= 0)
+			close(fd);
+		return;
+	}
+
+	inode = get_cgi("inode");
+	offset = get_cgi("offset");
+	nlines = get_cgi("lines");
+
+	lines = (nlines) ? atoi(nlines) : SYSLOG_TAIL_LINES;
+	if (lines < 1 || lines > 1000)
+		lines = SYSLOG_TAIL_LINES;
+
+	start = -1;
+	if (inode && offset && strtoul(inode, NULL, 10) == (unsigned long)st.st_ino)
+		start = strtoll(offset, NULL, 10);
+	if (start < 0 || start > st.st_size)
+		start = syslog_tail_offset(fd, st.st_size, lines);
+
+	fprintf(stream, "%lu %lld\n", (unsigned long)st.st_ino, (long long)st.st_size);
+	do_file_range(fd, start, st.st_size - start, stream);
+
+	close(fd);
+}
+
 static int ej_dump_eth_mib_hook(int eid, webs_t wp, int argc, char **argv)
 {
 	int eth_port_id = 0;
@@ -4560,6 +4818,7 @@ nvram_add_group_item(webs_t wp, struct variable *v)
 {
 	char name[64], *value;
 	struct variable *gv;
+	struct nvram_batch nb = { NULL, 0, 0 };
 	int gcount;
 
 	if (v->argv[0]==NULL)
@@ -4573,15 +4832,16 @@ nvram_add_group_item(webs_t wp, struct variable *v)
 		snprintf(name, sizeof(name), "%s_0", gv->name);
 		
 		/* clear last deleted value */
-		nvram_unset(name);
+		nvram_batch_set(&nb, name, NULL);
 		
 		value = websGetVar(wp, name, "");
 		snprintf(name, sizeof(name), "%s%d", gv->name, gcount);
-		nvram_set(name, value);
+		nvram_batch_set(&nb, name, value);
 	}
 
 	gcount++;
-	nvram_set_int(v->argv[3], gcount);
+	nvram_batch_set_int(&nb, v->argv[3], gcount);
+	nvram_batch_apply(&nb);
 }
 
 static void
@@ -4975,7 +5235,7 @@ do_storage_file(const char *url, FILE *stream)
 static void
 do_syslog_file(const char *url, FILE *stream)
 {
-	dump_file(stream, "/tmp/syslog.log");
+	dump_file(stream, SYSLOG_FILE);
 	fputs("\r\n", stream); /* terminator */
 }
 
@@ -5132,33 +5392,35 @@ struct mime_handler mime_handlers[] = {
 
 	/* downloads objects */
 	{ "Settings_**.CFG", "application/force-download", NULL, NULL, do_nvram_file, 1 },
-	{ "Storage_**.TBZ", "application/force-download", NULL, NULL, do_storage_file, 1 },
-	{ "syslog.txt", "application/force-download", syslog_txt, NULL, do_syslog_file, 1 },
+	{ "Storage_**.TBZ", "application/force-download", NULL, NULL, do_storage_file, 1, MIME_FLAG_WORKER },
+	{ "syslog.txt", "application/force-download", syslog_txt, NULL, do_syslog_file, 1, MIME_FLAG_WORKER },
+	{ "syslog_tail.txt", "text/plain", no_cache_IE, NULL, do_syslog_tail, 1, 0, syslog_tail_ready },
 #if defined(APP_KOOLPROXY)
 	{ "kp_ca.crt", "application/force-download", NULL, NULL, do_kp_crt_file, 1 },
 #endif
 #if defined(APP_SCUT)
-	{ "scutclient.log", "application/force-download", scutclient_log_txt, NULL, do_scutclient_log_file, 1 },
+	{ "scutclient.log", "application/force-download", scutclient_log_txt, NULL, do_scutclient_log_file, 1, MIME_FLAG_WORKER },
 #endif
 #if defined(APP_MENTOHUST)
-	{ "mentohust.log", "application/force-download", mentohust_log_txt, NULL, do_mentohust_log_file, 1 },
+	{ "mentohust.log", "application/force-download", mentohust_log_txt, NULL, do_mentohust_log_file, 1, MIME_FLAG_WORKER },
 #endif
 #if defined(APP_VNTCLI)
-	{ "vnt-cli.log", "application/force-download", vntcli_log_txt, NULL, do_vntcli_log_file, 1 },
+	{ "vnt-cli.log", "application/force-download", vntcli_log_txt, NULL, do_vntcli_log_file, 1, MIME_FLAG_WORKER },
 #endif
 #if defined(APP_VNTS)
-	{ "vnts.log", "application/force-download", vnts_log_txt, NULL, do_vnts_log_file, 1 },
+	{ "vnts.log", "application/force-download", vnts_log_txt, NULL, do_vnts_log_file, 1, MIME_FLAG_WORKER },
 #endif
 #if defined(APP_EASYTIER)
-	{ "easytier.log", "application/force-download", et_log_txt, NULL, do_et_log_file, 1 },
+	{ "easytier.log", "application/force-download", et_log_txt, NULL, do_et_log_file, 1, MIME_FLAG_WORKER },
 #endif
 #if defined(APP_OPENVPN)
-	{ "client.ovpn", "application/force-download", NULL, NULL, do_export_ovpn_client, 1 },
+	{ "client.ovpn", "application/force-download", NULL, NULL, do_export_ovpn_client, 1, MIME_FLAG_WORKER },
 #endif
 
 
 	/* no-cached POST objects */
-	{ "update.cgi*", "text/javascript", no_cache_IE, do_html_apply_post, do_update_cgi, 1 },
+	{ "update.cgi*", "text/javascript", no_cache_IE, do_html_apply_post, do_update_cgi, 1, MIME_FLAG_EJ_OUTPUT },
+	{ "status_poll.cgi*", "text/javascript", no_cache_IE, NULL, do_status_poll_cgi, 1, 0, status_poll_ready },
 	{ "apply.cgi*", "text/html", no_cache_IE, do_html_apply_post, do_apply_cgi, 1 },
 #if defined(APP_SHADOWSOCKS)
 	{ "applydb.cgi*", "text/html", no_cache_IE7, do_html_post_and_get, do_applydb_cgi, 1 },
@@ -5399,8 +5661,8 @@ struct ej_handler ej_handlers[] =
 	{ "asus_nvram_commit", asus_nvram_commit},
 	{ "notify_services", ej_notify_services},
 	{ "login_state_hook", login_state_hook},
-	{ "wanlink", wanlink_hook},
-	{ "lanlink", lanlink_hook},
+	{ "wanlink", wanlink_hook, EJ_FLAG_WORKER },
+	{ "lanlink", lanlink_hook, EJ_FLAG_WORKER },
 	{ "wan_action", wan_action_hook},
 	{ "wol_action", wol_action_hook},
 	{ "nf_values", nf_values_hook},
@@ -5415,19 +5677,19 @@ struct ej_handler ej_handlers[] =
 #endif
 	{ "wl_auth_list", ej_wl_auth_list},
 #if BOARD_HAS_5G_RADIO
-	{ "wl_scan_5g", ej_wl_scan_5g},
+	{ "wl_scan_5g", ej_wl_scan_5g, EJ_FLAG_WORKER },
 	{ "wl_bssid_5g", ej_wl_bssid_5g},
 #endif
 	{ "wl_bssid_2g", ej_wl_bssid_2g},
-	{ "wl_scan_2g", ej_wl_scan_2g},
+	{ "wl_scan_2g", ej_wl_scan_2g, EJ_FLAG_WORKER },
 	{ "shown_language_option", ej_shown_language_option},
 	{ "hardware_pins", ej_hardware_pins_hook},
 	{ "detect_internet", ej_detect_internet_hook},
 	{ "dump_syslog", ej_dump_syslog_hook},
-	{ "dump_eth_mib", ej_dump_eth_mib_hook},
+	{ "dump_eth_mib", ej_dump_eth_mib_hook, EJ_FLAG_WORKER },
 	{ "get_usb_ports_info", ej_get_usb_ports_info},
 	{ "get_ext_ports_info", ej_get_ext_ports_info},
-	{ "disk_pool_mapping_info", ej_disk_pool_mapping_info},
+	{ "disk_pool_mapping_info", ej_disk_pool_mapping_info, EJ_FLAG_WORKER },
 	{ "available_disk_names_and_sizes", ej_available_disk_names_and_sizes},
 #if defined (USE_STORAGE)
 	{ "get_usb_share_list", ej_get_storage_share_list},
@@ -5451,7 +5713,7 @@ struct ej_handler ej_handlers[] =
 #if defined (APP_SCUT)
 	{ "scutclient_action", scutclient_action_hook},
 	{ "scutclient_status", scutclient_status_hook},
-	{ "scutclient_version", scutclient_version_hook},
+	{ "scutclient_version", scutclient_version_hook, EJ_FLAG_WORKER },
 #endif
 #if defined (APP_MENTOHUST)
 	{ "mentohust_action", mentohust_action_hook},
@@ -5460,7 +5722,7 @@ struct ej_handler ej_handlers[] =
 #if defined (APP_SHADOWSOCKS)
 	{ "shadowsocks_action", shadowsocks_action_hook},
 	{ "shadowsocks_status", shadowsocks_status_hook},
-	{ "rules_count", rules_count_hook},
+	{ "rules_count", rules_count_hook, EJ_FLAG_WORKER },
 	{ "pdnsd_status", pdnsd_status_hook},
 	{ "dns2tcp_status", dns2tcp_status_hook},
 #endif
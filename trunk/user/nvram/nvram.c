@@ -44,7 +44,8 @@
 static void usage(void)
 {
 	printf("Usage: nvram [get name] [set name=value] [settmp name=value] [unset name]\n"
-	       "             [show] [showall] [clear] [save fn] [restore fn] [commit]\n");
+	       "             [show] [showall] [clear] [save fn] [restore fn] [commit]\n"
+	       "             [getfile fn] [setfile fn] [settmpfile fn]\n");
 	exit(1);
 }
 
@@ -214,6 +215,120 @@ static int nvram_restore(char *file)
 	return 0;
 }
 
+/* Read "name" or "name=value" lines of file into pairs */
+static int nvram_read_pairs(char *file, char **pbuf, struct nvram_pair **ppairs)
+{
+	FILE *fp;
+	long fsize;
+	int count, size;
+	char *buf, *line, *next;
+	struct nvram_pair *pairs;
+
+	if (strcmp(file, "-") == 0)
+		fp = stdin;
+	else if ((fp = fopen(file, "r")) == NULL)
+		return -1;
+
+	size = 0;
+	buf = NULL;
+	do {
+		fsize = size;
+		size += NVRAM_SPACE;
+		next = realloc(buf, size + 1);
+		if (!next)
+			break;
+		buf = next;
+		fsize += fread(buf + fsize, 1, NVRAM_SPACE, fp);
+	} while (fsize == size);
+
+	if (fp != stdin)
+		fclose(fp);
+
+	if (!next) {
+		free(buf);
+		perror ("Out of memory!\n");
+		return -1;
+	}
+
+	buf[fsize] = 0;
+
+	count = 0;
+	for (line = buf; *line; line++) {
+		if (*line == '\n')
+			count++;
+	}
+
+	pairs = malloc((count + 1) * sizeof(struct nvram_pair));
+	if (!pairs) {
+		free(buf);
+		perror ("Out of memory!\n");
+		return -1;
+	}
+
+	count = 0;
+	for (line = buf; line && *line; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = 0;
+		if (next && next > line + 1 && next[-2] == '\r')
+			next[-2] = 0;
+		if (!*line || *line == '#')
+			continue;
+		pairs[count].name = strsep(&line, "=");
+		pairs[count].value = line;
+		count++;
+	}
+
+	*pbuf = buf;
+	*ppairs = pairs;
+
+	return count;
+}
+
+static int nvram_getfile(char *file)
+{
+	struct nvram_pair *pairs;
+	char *buf;
+	int i, count;
+
+	count = nvram_read_pairs(file, &buf, &pairs);
+	if (count < 0)
+		return -1;
+
+	nvram_get_multi(pairs, count);
+
+	for (i = 0; i < count; i++) {
+		if (pairs[i].value)
+			printf("%s=%s\n", pairs[i].name, pairs[i].value);
+	}
+
+	free(pairs);
+	free(buf);
+
+	return 0;
+}
+
+static int nvram_setfile(char *file, int is_temp)
+{
+	struct nvram_pair *pairs;
+	char *buf;
+	int ret, count;
+
+	count = nvram_read_pairs(file, &buf, &pairs);
+	if (count < 0)
+		return -1;
+
+	if (is_temp)
+		ret = nvram_set_multi_temp(pairs, count);
+	else
+		ret = nvram_set_multi(pairs, count);
+
+	free(pairs);
+	free(buf);
+
+	return (ret < 0) ? -1 : 0;
+}
+
 static int nvram_show(int show_all)
 {
 	char *name, *buf;
@@ -304,6 +419,21 @@ main(int argc, char **argv)
 				ret |= nvram_restore(*argv);
 			break;
 		}
+		else if (!strcmp(*argv, "getfile")) {
+			if (*++argv)
+				ret |= nvram_getfile(*argv);
+			break;
+		}
+		else if (!strcmp(*argv, "setfile")) {
+			if (*++argv)
+				ret |= nvram_setfile(*argv, 0);
+			break;
+		}
+		else if (!strcmp(*argv, "settmpfile")) {
+			if (*++argv)
+				ret |= nvram_setfile(*argv, 1);
+			break;
+		}
 		else if (!strcmp(*argv, "show")) {
 			ret |= nvram_show(0);
 			break;
@@ -0,0 +1,236 @@
+/*
+ * Minimal kernel API for building drivers/nvram in userspace.
+ * Locks are counters, user copies are memcpy, MTD goes to mtdsim.c.
+ */
+#ifndef _KSHIM_H_
+#define _KSHIM_H_
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define __init
+#define __user
+#define KERN_ERR		""
+#define GFP_KERNEL		0
+#define GFP_ATOMIC		0
+#define ERESTARTSYS		512
+
+#define LINUX_VERSION_CODE	KERNEL_VERSION(3,4,0)
+#define KERNEL_VERSION(a,b,c)	(((a) << 16) + ((b) << 8) + (c))
+
+#define THIS_MODULE		NULL
+#define try_module_get(m)	kshim_module_get(m)
+#define module_put(m)		((void)(m))
+#define EXPORT_SYMBOL(sym)	extern int kshim_export_
+#define MODULE_LICENSE(s)	extern int kshim_export_
+#define MODULE_VERSION(s)	extern int kshim_export_
+#define late_initcall(fn)	int (*kshim_initcall)(void) = fn
+#define module_exit(fn)		void (*kshim_exitcall)(void) = fn
+
+static inline int
+kshim_module_get(void *m)
+{
+	return 1;
+}
+
+extern int kshim_quiet;
+#define printk(...)		do { if (!kshim_quiet) fprintf(stderr, __VA_ARGS__); } while (0)
+
+#define min_t(type, a, b)	((type)(a) < (type)(b) ? (type)(a) : (type)(b))
+#define smp_wmb()		__sync_synchronize()
+
+/* Memory */
+#define kmalloc(size, flags)	malloc(size)
+#define kzalloc(size, flags)	calloc(1, size)
+#define kfree(p)		free(p)
+
+struct kmem_cache {
+	size_t size;
+};
+
+#define kmem_cache_create(name, size, align, flags, ctor) kshim_cache_create(size)
+#define kmem_cache_alloc(c, flags)	malloc((c)->size)
+#define kmem_cache_free(c, p)		free(p)
+#define kmem_cache_destroy(c)		free(c)
+
+static inline struct kmem_cache *
+kshim_cache_create(size_t size)
+{
+	struct kmem_cache *c = malloc(sizeof(*c));
+
+	if (c)
+		c->size = size;
+	return c;
+}
+
+#define PAGE_SIZE		4096
+#define PAGE_SHIFT		12
+#define get_zeroed_page(flags)	kshim_zeroed_page()
+#define free_page(p)		free((void *)(p))
+#define virt_to_page(p)		(p)
+#define virt_to_phys(p)		((unsigned long)(p))
+#define SetPageReserved(p)	((void)(p))
+#define ClearPageReserved(p)	((void)(p))
+
+/* Page aligned, remap_pfn_range() goes by page frame */
+static inline unsigned long
+kshim_zeroed_page(void)
+{
+	void *p = aligned_alloc(PAGE_SIZE, PAGE_SIZE);
+
+	if (p)
+		memset(p, 0, PAGE_SIZE);
+	return (unsigned long)p;
+}
+
+#define copy_from_user(to, from, n)	(memcpy(to, from, n), 0)
+#define copy_to_user(to, from, n)	(memcpy(to, from, n), 0)
+
+/* Same result as lib/crc32.c crc32_le() */
+static inline uint32_t
+crc32_le(uint32_t crc, const unsigned char *p, size_t len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+	}
+
+	return crc;
+}
+
+/* Locks, acquisitions are counted for tests */
+extern unsigned long kshim_lock_count;
+#define DEFINE_SPINLOCK(x)	int x
+#define DEFINE_MUTEX(x)		int x
+#define spin_lock_init(l)	((void)(l))
+#define spin_lock_irqsave(l, f)	((void)(l), (f) = 0, kshim_lock_count++)
+#define spin_unlock_irqrestore(l, f)	((void)(l), (void)(f))
+#define mutex_lock(m)		((void)(m))
+#define mutex_unlock(m)		((void)(m))
+
+/* Lists */
+struct list_head {
+	struct list_head *next, *prev;
+};
+
+#define LIST_HEAD(name)		struct list_head name = { &(name), &(name) }
+#define container_of(ptr, type, member)	((type *)((char *)(ptr) - offsetof(type, member)))
+#define list_for_each_entry(pos, head, member) \
+	for (pos = container_of((head)->next, typeof(*pos), member); \
+	     &pos->member != (head); \
+	     pos = container_of(pos->member.next, typeof(*pos), member))
+
+static inline void
+list_add(struct list_head *n, struct list_head *head)
+{
+	n->next = head->next;
+	n->prev = head;
+	head->next->prev = n;
+	head->next = n;
+}
+
+static inline void
+list_del(struct list_head *e)
+{
+	e->prev->next = e->next;
+	e->next->prev = e->prev;
+}
+
+/* Wait queues, a reader never sleeps here */
+typedef int wait_queue_head_t;
+typedef int poll_table;
+#define init_waitqueue_head(wq)		((void)(wq))
+#define wake_up_interruptible(wq)	((void)(wq))
+#define wait_event_interruptible(wq, cond)	((cond) ? 0 : -ERESTARTSYS)
+#define poll_wait(file, wq, wait)	((void)(wq))
+
+/* Files and char devices */
+struct inode;
+
+struct file {
+	void *private_data;
+	unsigned int f_flags;
+};
+
+struct vm_area_struct {
+	unsigned long vm_start, vm_end, vm_pgoff, vm_flags;
+	int vm_page_prot;
+};
+
+#define VM_WRITE		0x2
+#define VM_MAYWRITE		0x20
+
+struct file_operations {
+	const void *owner, *open, *release, *read, *poll, *unlocked_ioctl, *mmap, *llseek;
+};
+
+extern const struct file_operations *kshim_chrdev_fops;
+extern void *kshim_mmap_addr;
+#define register_chrdev(major, name, fops)	(kshim_chrdev_fops = (fops), 0)
+#define unregister_chrdev(major, name)		((void)0)
+#define remap_pfn_range(vma, addr, pfn, size, prot) \
+	(kshim_mmap_addr = (void *)((pfn) << PAGE_SHIFT), 0)
+
+/* procfs */
+struct seq_file {
+	FILE *fp;
+};
+
+struct proc_dir_entry {
+	const void *proc_fops;
+};
+
+#define S_IRUGO			(S_IRUSR|S_IRGRP|S_IROTH)
+#define seq_printf(m, ...)	fprintf((m)->fp, __VA_ARGS__)
+#define single_open(file, show, data)	0
+#define seq_read		NULL
+#define seq_lseek		NULL
+#define single_release		NULL
+#define remove_proc_entry(name, parent)	((void)0)
+
+static inline struct proc_dir_entry *
+create_proc_entry(const char *name, int mode, void *parent)
+{
+	static struct proc_dir_entry entry;
+
+	return &entry;
+}
+
+/* MTD, backed by mtdsim.c */
+#define MTD_NORFLASH		3
+#define MTD_NANDFLASH		4
+#define MTD_MLCNANDFLASH	8
+#define MTD_UBIVOLUME		7
+
+struct mtd_info {
+	int type;
+	int index;
+	const char *name;
+	uint32_t flags;
+	unsigned long long size;
+	uint32_t erasesize;
+	uint32_t writesize;
+};
+
+#define IS_ERR(p)		((unsigned long)(p) >= (unsigned long)-4095)
+#define PTR_ERR(p)		((long)(p))
+
+struct mtd_info *get_mtd_device_nm(const char *name);
+void put_mtd_device(struct mtd_info *mtd);
+int mtd_write(struct mtd_info *mtd, loff_t to, size_t len, size_t *retlen, const u_char *buf);
+int ra_mtd_read_nm(char *name, loff_t from, size_t len, u_char *buf);
+int ra_mtd_write_nm(char *name, loff_t to, size_t len, const u_char *buf);
+
+#endif /* _KSHIM_H_ */
@@ -0,0 +1,222 @@
+/*
+ * NOR flash simulator, see mtdsim.h. Provides the MTD calls used by
+ * drivers/nvram/nvram_linux.c.
+ */
+#include "kernel/kshim.h"
+
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "mtdsim.h"
+
+/* Typical SPI NOR timings (64K block erase, 256 byte page program) */
+#define SIM_ERASE_USEC_PER_KB	2.3
+#define SIM_PROGRAM_USEC_PER_B	2.7
+
+static struct mtd_info sim_mtd;
+static uint8_t *sim_data;
+static size_t sim_size;
+static int sim_fd = -1;
+static long sim_cut = -1;
+static struct mtdsim_stats sim_stats;
+
+int
+mtdsim_init(const char *path, size_t size, uint32_t erasesize, int type)
+{
+	mtdsim_close();
+
+	if (path) {
+		sim_fd = open(path, O_RDWR | O_CREAT, 0644);
+		if (sim_fd < 0)
+			return -1;
+		if (lseek(sim_fd, 0, SEEK_END) != (off_t)size) {
+			/* New flash is erased */
+			uint8_t *ff = malloc(size);
+			if (!ff)
+				return -1;
+			memset(ff, 0xFF, size);
+			if (ftruncate(sim_fd, 0) || pwrite(sim_fd, ff, size, 0) != (ssize_t)size) {
+				free(ff);
+				return -1;
+			}
+			free(ff);
+		}
+		sim_data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, sim_fd, 0);
+		if (sim_data == MAP_FAILED) {
+			sim_data = NULL;
+			return -1;
+		}
+	} else {
+		sim_data = malloc(size);
+		if (!sim_data)
+			return -1;
+		memset(sim_data, 0xFF, size);
+	}
+
+	sim_size = size;
+	sim_cut = -1;
+	memset(&sim_mtd, 0, sizeof(sim_mtd));
+	sim_mtd.type = type;
+	sim_mtd.name = "Config";
+	sim_mtd.size = size;
+	sim_mtd.erasesize = erasesize;
+	sim_mtd.writesize = (type == MTD_NORFLASH) ? 1 : 2048;
+	mtdsim_stats_reset();
+
+	return 0;
+}
+
+void
+mtdsim_close(void)
+{
+	if (!sim_data)
+		return;
+
+	if (sim_fd >= 0) {
+		munmap(sim_data, sim_size);
+		close(sim_fd);
+		sim_fd = -1;
+	} else {
+		free(sim_data);
+	}
+	sim_data = NULL;
+}
+
+uint8_t *
+mtdsim_data(void)
+{
+	return sim_data;
+}
+
+size_t
+mtdsim_size(void)
+{
+	return sim_size;
+}
+
+void
+mtdsim_cut_after(long bytes)
+{
+	sim_cut = bytes;
+}
+
+void
+mtdsim_stats_get(struct mtdsim_stats *st)
+{
+	*st = sim_stats;
+}
+
+void
+mtdsim_stats_reset(void)
+{
+	memset(&sim_stats, 0, sizeof(sim_stats));
+}
+
+double
+mtdsim_flash_usec(const struct mtdsim_stats *st)
+{
+	return st->erased_bytes / 1024.0 * SIM_ERASE_USEC_PER_KB +
+	       st->programmed_bytes * SIM_PROGRAM_USEC_PER_B;
+}
+
+/* Program bytes (AND into flash), honour the power cut */
+static int
+sim_program(size_t to, size_t len, const uint8_t *buf)
+{
+	size_t i;
+
+	sim_stats.programs++;
+	for (i = 0; i < len; i++) {
+		if (sim_cut == 0)
+			return -EIO;
+		if (sim_cut > 0)
+			sim_cut--;
+		if ((sim_data[to + i] & buf[i]) != buf[i])
+			sim_stats.violations++;
+		sim_data[to + i] &= buf[i];
+		sim_stats.programmed_bytes++;
+	}
+
+	return 0;
+}
+
+struct mtd_info *
+get_mtd_device_nm(const char *name)
+{
+	if (!sim_data || strcmp(name, sim_mtd.name))
+		return (struct mtd_info *)(long)-ENODEV;
+
+	return &sim_mtd;
+}
+
+void
+put_mtd_device(struct mtd_info *mtd)
+{
+}
+
+int
+mtd_write(struct mtd_info *mtd, loff_t to, size_t len, size_t *retlen, const u_char *buf)
+{
+	int ret;
+
+	*retlen = 0;
+	if (to < 0 || to + len > sim_size)
+		return -EINVAL;
+
+	ret = sim_program(to, len, buf);
+	if (ret == 0)
+		*retlen = len;
+
+	return ret;
+}
+
+int
+ra_mtd_read_nm(char *name, loff_t from, size_t len, u_char *buf)
+{
+	if (!sim_data || from < 0 || from + len > sim_size)
+		return -EINVAL;
+
+	memcpy(buf, sim_data + from, len);
+
+	return 0;
+}
+
+/* Erase covered sectors (keeping bytes outside the range) and program */
+int
+ra_mtd_write_nm(char *name, loff_t to, size_t len, const u_char *buf)
+{
+	size_t es = sim_mtd.erasesize, start, end, s;
+	uint8_t *sector;
+	int ret = 0;
+
+	if (!sim_data || to < 0 || to + len > sim_size)
+		return -EINVAL;
+
+	/* Power is off after a cut */
+	if (sim_cut == 0)
+		return -EIO;
+
+	sector = malloc(es);
+	if (!sector)
+		return -ENOMEM;
+
+	start = (to / es) * es;
+	end = ((to + len + es - 1) / es) * es;
+	for (s = start; s < end && ret == 0; s += es) {
+		size_t lo = (s > (size_t)to) ? s : (size_t)to;
+		size_t hi = (s + es < to + len) ? s + es : to + len;
+
+		memcpy(sector, sim_data + s, es);
+		memcpy(sector + (lo - s), buf + (lo - to), hi - lo);
+
+		memset(sim_data + s, 0xFF, es);
+		sim_stats.erases++;
+		sim_stats.erased_bytes += es;
+
+		ret = sim_program(s, es, sector);
+	}
+
+	free(sector);
+
+	return ret;
+}
@@ -0,0 +1,41 @@
+/*
+ * NOR flash simulator for the "Config" MTD partition. Erase sets a whole
+ * sector to 0xFF, programming can only clear bits, and the next program
+ * can be cut short to emulate a power loss.
+ */
+#ifndef _MTDSIM_H_
+#define _MTDSIM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef MTD_NORFLASH
+#define MTD_NORFLASH		3
+#define MTD_NANDFLASH		4
+#endif
+
+struct mtdsim_stats {
+	unsigned long erases;		/* sectors erased */
+	unsigned long erased_bytes;
+	unsigned long programs;		/* write calls */
+	unsigned long programmed_bytes;
+	unsigned long violations;	/* 0 -> 1 bit flips asked w/o erase */
+};
+
+/* Backing store is a file when path is not NULL (kept between runs) */
+int mtdsim_init(const char *path, size_t size, uint32_t erasesize, int type);
+void mtdsim_close(void);
+uint8_t *mtdsim_data(void);
+size_t mtdsim_size(void);
+
+/* Power is cut after given bytes programmed: that write fails and all
+ * later ones do nothing. -1 restores power */
+void mtdsim_cut_after(long bytes);
+
+void mtdsim_stats_get(struct mtdsim_stats *st);
+void mtdsim_stats_reset(void);
+
+/* Modeled flash time of the counted operations, microseconds */
+double mtdsim_flash_usec(const struct mtdsim_stats *st);
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * Fake /dev/nvram, see nvdev.h. Definitions here take place of the libc
+ * ones for the whole test program, other files go to the real syscalls.
+ */
+#undef _FORTIFY_SOURCE
+#define _GNU_SOURCE
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <bcmnvram.h>
+
+#include "nvdrv.h"
+#include "nvdev.h"
+
+#define NVDEV_FILES	16
+
+static struct {
+	int fd;
+	void *file;
+} nvdev_files[NVDEV_FILES];
+
+static nvdev_hook_t nvdev_hook;
+static struct nvdev_stats nvdev_stats;
+
+void
+nvdev_set_hook(nvdev_hook_t hook)
+{
+	nvdev_hook = hook;
+}
+
+void
+nvdev_stats_get(struct nvdev_stats *st)
+{
+	*st = nvdev_stats;
+}
+
+void
+nvdev_stats_reset(void)
+{
+	memset(&nvdev_stats, 0, sizeof(nvdev_stats));
+}
+
+static int
+nvdev_find(int fd)
+{
+	int i;
+
+	for (i = 0; i < NVDEV_FILES && fd >= 0; i++) {
+		if (nvdev_files[i].file && nvdev_files[i].fd == fd)
+			return i;
+	}
+
+	return -1;
+}
+
+int
+open(const char *path, int flags, ...)
+{
+	mode_t mode = 0;
+	va_list ap;
+	int fd, i;
+
+	if (flags & O_CREAT) {
+		va_start(ap, flags);
+		mode = va_arg(ap, int);
+		va_end(ap);
+	}
+
+	if (strcmp(path, "/dev/nvram"))
+		return syscall(SYS_openat, AT_FDCWD, path, flags, mode);
+
+	for (i = 0; i < NVDEV_FILES && nvdev_files[i].file; i++)
+		;
+	if (i == NVDEV_FILES) {
+		errno = EMFILE;
+		return -1;
+	}
+
+	fd = syscall(SYS_openat, AT_FDCWD, "/dev/null", flags & ~O_NONBLOCK, 0);
+	if (fd < 0)
+		return -1;
+
+	nvdev_files[i].fd = fd;
+	nvdev_files[i].file = nvdrv_open();
+	nvdev_stats.opens++;
+
+	return fd;
+}
+
+int
+open64(const char *path, int flags, ...)
+{
+	mode_t mode = 0;
+	va_list ap;
+
+	if (flags & O_CREAT) {
+		va_start(ap, flags);
+		mode = va_arg(ap, int);
+		va_end(ap);
+	}
+
+	return open(path, flags, mode);
+}
+
+int
+close(int fd)
+{
+	int i = nvdev_find(fd);
+
+	if (i >= 0) {
+		nvdrv_release(nvdev_files[i].file);
+		nvdev_files[i].file = NULL;
+		nvdev_stats.closes++;
+	}
+
+	return syscall(SYS_close, fd);
+}
+
+int
+ioctl(int fd, unsigned long req, ...)
+{
+	va_list ap;
+	void *arg;
+	long ret;
+	int i;
+
+	va_start(ap, req);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+
+	/* Pay for a syscall in any case */
+	ret = syscall(SYS_ioctl, fd, req, arg);
+	if ((i = nvdev_find(fd)) < 0)
+		return ret;
+
+	nvdev_stats.ioctls++;
+	if (req == NVRAM_IOCTL_GET_MULTI)
+		nvdev_stats.get_multi++;
+	if (nvdev_hook)
+		nvdev_hook(req);
+
+	ret = nvdrv_ioctl(nvdev_files[i].file, req, arg);
+	if (ret < 0) {
+		errno = -ret;
+		return -1;
+	}
+
+	return ret;
+}
+
+void *
+mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off)
+{
+	const volatile void *shm;
+
+	if (nvdev_find(fd) < 0)
+		return (void *)syscall(SYS_mmap, addr, len, prot, flags, fd, off);
+
+	nvdev_stats.mmaps++;
+	if ((prot & PROT_WRITE) || off != 0 || !(shm = nvdrv_shm())) {
+		errno = EINVAL;
+		return MAP_FAILED;
+	}
+
+	return (void *)shm;
+}
+
+void *
+mmap64(void *addr, size_t len, int prot, int flags, int fd, off_t off)
+{
+	return mmap(addr, len, prot, flags, fd, off);
+}
@@ -0,0 +1,25 @@
+/*
+ * Fake /dev/nvram for libshared nvram_linux.c: open, ioctl, mmap and close
+ * of the device go to the driver built in userspace (nvdrv.c). Real
+ * syscalls are still made on /dev/null, so their cost is kept.
+ */
+#ifndef _NVDEV_H_
+#define _NVDEV_H_
+
+/* Called before each ioctl on the device, NULL to remove */
+typedef void (*nvdev_hook_t)(unsigned int req);
+void nvdev_set_hook(nvdev_hook_t hook);
+
+/* Device calls so far */
+struct nvdev_stats {
+	unsigned long opens;
+	unsigned long closes;
+	unsigned long ioctls;
+	unsigned long get_multi;	/* NVRAM_IOCTL_GET_MULTI ioctls */
+	unsigned long mmaps;
+};
+
+void nvdev_stats_get(struct nvdev_stats *st);
+void nvdev_stats_reset(void);
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * drivers/nvram/nvram_linux.c (with nvram.c) built against kernel/kshim.h.
+ */
+#include "kernel/kshim.h"
+
+#include "../../../linux-3.4.x/drivers/nvram/nvram_linux.c"
+
+#include "nvdrv.h"
+
+int kshim_quiet = 0;
+unsigned long kshim_lock_count = 0;
+const struct file_operations *kshim_chrdev_fops = NULL;
+void *kshim_mmap_addr = NULL;
+
+int
+nvdrv_load(void)
+{
+	return kshim_initcall();
+}
+
+void
+nvdrv_unload(void)
+{
+	kshim_exitcall();
+}
+
+char *
+nvdrv_get(const char *name)
+{
+	return nvram_get(name);
+}
+
+int
+nvdrv_set(const char *name, const char *value)
+{
+	return nvram_set(name, value);
+}
+
+int
+nvdrv_set_temp(const char *name, const char *value)
+{
+	return nvram_set_temp(name, value, 1);
+}
+
+int
+nvdrv_unset(const char *name)
+{
+	return nvram_unset(name);
+}
+
+int
+nvdrv_getall(char *buf, int count)
+{
+	return nvram_getall(buf, count, 0);
+}
+
+int
+nvdrv_commit(void)
+{
+	return nvram_commit();
+}
+
+void *
+nvdrv_open(void)
+{
+	struct file *file = calloc(1, sizeof(struct file));
+
+	if (file)
+		dev_nvram_open(NULL, file);
+
+	return file;
+}
+
+void
+nvdrv_release(void *file)
+{
+	dev_nvram_release(NULL, file);
+	free(file);
+}
+
+long
+nvdrv_ioctl(void *file, unsigned int req, void *arg)
+{
+	return dev_nvram_ioctl(file, req, (unsigned long)arg);
+}
+
+const volatile void *
+nvdrv_shm(void)
+{
+	struct vm_area_struct vma;
+
+	memset(&vma, 0, sizeof(vma));
+	vma.vm_end = sizeof(anvram_shm_t);
+	kshim_mmap_addr = NULL;
+	if (dev_nvram_mmap(NULL, &vma))
+		return NULL;
+
+	return kshim_mmap_addr;
+}
+
+void
+nvdrv_proc_show(FILE *fp)
+{
+	struct seq_file m = { fp };
+
+	nvram_ver_seq_show(&m, NULL);
+}
+
+uint32_t
+nvdrv_hash_size(void)
+{
+	return nvram_hash_size;
+}
+
+uint32_t
+nvdrv_hash_count(void)
+{
+	return nvram_hash_count;
+}
+
+uint32_t
+nvdrv_hash_of(const char *name)
+{
+	return hash(name);
+}
+
+int
+nvdrv_check_table(void)
+{
+	uint32_t i, j, used = 0, mask = nvram_hash_size - 1;
+	int problems = 0;
+
+	for (i = 0; i < nvram_hash_size; i++) {
+		if (!nvram_hash[i].t)
+			continue;
+		used++;
+		if (nvram_hash[i].hash != hash(nvram_hash[i].t->name))
+			problems++;
+		/* No hole between home slot and entry, or lookup misses it */
+		for (j = nvram_hash[i].hash & mask; j != i; j = (j + 1) & mask) {
+			if (!nvram_hash[j].t) {
+				problems++;
+				break;
+			}
+		}
+		if (nvram_slot_find(nvram_hash[i].t->name, nvram_hash[i].hash) != &nvram_hash[i])
+			problems++;
+	}
+
+	if (used != nvram_hash_count)
+		problems++;
+	if (nvram_hash_size && nvram_hash_count * 4 > nvram_hash_size * 3)
+		problems++;
+
+	return problems;
+}
+
+void
+nvdrv_probe_stats(double *avg, uint32_t *max)
+{
+	uint32_t i, len, mask = nvram_hash_size - 1;
+	unsigned long total = 0;
+
+	*max = 0;
+	for (i = 0; i < nvram_hash_size; i++) {
+		if (!nvram_hash[i].t)
+			continue;
+		len = ((i - nvram_hash[i].hash) & mask) + 1;
+		total += len;
+		if (len > *max)
+			*max = len;
+	}
+
+	*avg = (nvram_hash_count) ? (double)total / nvram_hash_count : 0;
+}
+
+uint32_t
+nvdrv_journal_offset(void)
+{
+	return nvram_journal_offset;
+}
+
+void
+nvdrv_journal_enable(int on)
+{
+	nvram_journal_mtd = on;
+}
+
+unsigned long
+nvdrv_lock_count(void)
+{
+	return kshim_lock_count;
+}
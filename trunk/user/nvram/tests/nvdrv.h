@@ -0,0 +1,49 @@
+/*
+ * drivers/nvram built in userspace (nvdrv.c), entry points for tests.
+ */
+#ifndef _NVDRV_H_
+#define _NVDRV_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Load driver from simulated flash (module init), unload frees all */
+int nvdrv_load(void);
+void nvdrv_unload(void);
+
+/* Kernel API */
+char *nvdrv_get(const char *name);
+int nvdrv_set(const char *name, const char *value);
+int nvdrv_set_temp(const char *name, const char *value);
+int nvdrv_unset(const char *name);
+int nvdrv_getall(char *buf, int count);
+int nvdrv_commit(void);
+
+/* Character device, file is an opaque open descriptor */
+void *nvdrv_open(void);
+void nvdrv_release(void *file);
+long nvdrv_ioctl(void *file, unsigned int req, void *arg);
+const volatile void *nvdrv_shm(void);
+
+/* Print /proc/nvram */
+void nvdrv_proc_show(FILE *fp);
+
+/* Hash table state */
+uint32_t nvdrv_hash_size(void);
+uint32_t nvdrv_hash_count(void);
+uint32_t nvdrv_hash_of(const char *name);
+/* Check probe invariants, returns number of problems (0 is good) */
+int nvdrv_check_table(void);
+/* Probe length (slots visited) statistics of all stored names */
+void nvdrv_probe_stats(double *avg, uint32_t *max);
+
+/* Journal state, journal off means full image on every commit */
+uint32_t nvdrv_journal_offset(void);
+void nvdrv_journal_enable(int on);
+
+/* Spinlock acquisitions so far */
+unsigned long nvdrv_lock_count(void);
+
+extern int kshim_quiet;
+
+#endif
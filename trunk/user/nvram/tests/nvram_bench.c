@@ -0,0 +1,110 @@
+/*
+ * Benchmark of the drivers/nvram hash table: set, get and getall on a
+ * synthetic config with many list entries (like the *_x0..N variables).
+ *
+ * Usage: nvram_bench [keys] [rounds]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <bcmnvram.h>
+
+#include "mtdsim.h"
+#include "nvdrv.h"
+
+static const char *prefixes[] = {
+	"wl_maclist_x", "vts_port_x", "dhcp_staticmac_x", "sr_ipaddr_x",
+	"filter_lw_", "url_keyword_x", "rt_", "wan_",
+};
+
+static double
+now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int keys = (argc > 1) ? atoi(argv[1]) : 5000;
+	int rounds = (argc > 2) ? atoi(argv[2]) : 20;
+	int i, r, np = sizeof(prefixes) / sizeof(prefixes[0]);
+	char (*names)[32], value[32], *buf;
+	unsigned long sum = 0;
+	uint32_t max_probe;
+	double t, avg_probe;
+
+	kshim_quiet = 1;
+	mtdsim_init(NULL, NVRAM_MTD_SIZE, NVRAM_MTD_SIZE, MTD_NORFLASH);
+	if (nvdrv_load() != 0)
+		return 1;
+
+	names = malloc(keys * sizeof(*names));
+	buf = malloc(NVRAM_SPACE);
+	for (i = 0; i < keys; i++)
+		sprintf(names[i], "%s%d", prefixes[i % np], i / np);
+
+	/* Values are short, a 5000 key config has to fit NVRAM_SPACE */
+	t = now_usec();
+	for (i = 0; i < keys; i++) {
+		sprintf(value, "%d", i);
+		nvdrv_set(names[i], value);
+	}
+	t = now_usec() - t;
+	printf("set (insert) : %8.1f ns/op, %u keys, table %u slots\n",
+		t * 1e3 / keys, nvdrv_hash_count(), nvdrv_hash_size());
+
+	t = now_usec();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < keys; i++) {
+			sprintf(value, "%d", i + r);
+			nvdrv_set(names[i], value);
+		}
+	}
+	t = now_usec() - t;
+	printf("set (update) : %8.1f ns/op, %u keys\n", t * 1e3 / ((double)keys * rounds), nvdrv_hash_count());
+
+	t = now_usec();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < keys; i++) {
+			char *v = nvdrv_get(names[i]);
+			sum += (v) ? v[0] : 0;
+		}
+	}
+	t = now_usec() - t;
+	printf("get (hit)    : %8.1f ns/op\n", t * 1e3 / ((double)keys * rounds));
+
+	t = now_usec();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < keys; i++) {
+			sprintf(value, "missing_%d", i);
+			sum += (nvdrv_get(value) != NULL);
+		}
+	}
+	t = now_usec() - t;
+	printf("get (miss)   : %8.1f ns/op (incl. name format)\n", t * 1e3 / ((double)keys * rounds));
+
+	t = now_usec();
+	for (r = 0; r < rounds; r++) {
+		nvdrv_getall(buf, NVRAM_SPACE);
+		sum += buf[0];
+	}
+	t = now_usec() - t;
+	printf("getall       : %8.1f us/op, %d bytes\n", t / rounds, NVRAM_SPACE);
+
+	nvdrv_probe_stats(&avg_probe, &max_probe);
+	printf("probe length : %.2f avg, %u max\n", avg_probe, max_probe);
+
+	nvdrv_unload();
+	mtdsim_close();
+	free(names);
+	free(buf);
+
+	return (sum == 0);
+}
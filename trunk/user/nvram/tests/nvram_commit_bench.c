@@ -0,0 +1,94 @@
+/*
+ * Benchmark of nvram commit on simulated NOR flash: journal records vs
+ * full image (as without CONFIG_ASUS_NVRAM_JOURNAL). A typical config is
+ * committed once, then every commit changes a few variables like a web
+ * UI apply does. Flash time is modeled from the erased and programmed
+ * bytes (see mtdsim.c), CPU time is measured on the host.
+ *
+ * Usage: nvram_commit_bench [commits] [vars per commit]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <bcmnvram.h>
+
+#include "mtdsim.h"
+#include "nvdrv.h"
+
+static double
+now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int
+run(int journal, int commits, int changes)
+{
+	struct mtdsim_stats st;
+	char name[32], value[64];
+	double cpu = 0, t;
+	int i, c;
+
+	mtdsim_init(NULL, NVRAM_MTD_SIZE, NVRAM_MTD_SIZE, MTD_NORFLASH);
+	if (nvdrv_load() != 0)
+		return -1;
+	nvdrv_journal_enable(journal);
+
+	/* About 30K of image, like a router with some lists configured */
+	for (i = 0; i < 1200; i++) {
+		sprintf(name, "cfg_%d", i);
+		sprintf(value, "value_%d_%08x", i, i * 2654435761U);
+		nvdrv_set(name, value);
+	}
+	if (nvdrv_commit() != 0)
+		return -1;
+
+	mtdsim_stats_reset();
+	for (c = 0; c < commits; c++) {
+		for (i = 0; i < changes; i++) {
+			sprintf(name, "cfg_%d", (c * 7 + i * 131) % 1200);
+			sprintf(value, "changed_%d_%d", c, i);
+			nvdrv_set(name, value);
+		}
+		t = now_usec();
+		if (nvdrv_commit() != 0)
+			return -1;
+		cpu += now_usec() - t;
+	}
+	mtdsim_stats_get(&st);
+
+	printf("%-10s: %7.1f us cpu, %7.1f us flash (modeled), "
+		"%6.0f B erased, %5.0f B programmed per commit, %d full images\n",
+		(journal) ? "journal" : "full image", cpu / commits,
+		mtdsim_flash_usec(&st) / commits,
+		(double)st.erased_bytes / commits, (double)st.programmed_bytes / commits,
+		(journal) ? (int)st.erases : commits);
+	if (st.violations)
+		printf("%lu NOR program violations\n", st.violations);
+
+	nvdrv_unload();
+	mtdsim_close();
+
+	return (st.violations) ? -1 : 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int commits = (argc > 1) ? atoi(argv[1]) : 1000;
+	int changes = (argc > 2) ? atoi(argv[2]) : 3;
+
+	kshim_quiet = 1;
+	printf("%d commits, %d variables changed per commit\n", commits, changes);
+
+	if (run(0, commits, changes) || run(1, commits, changes))
+		return 1;
+
+	return 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * Benchmark of libshared nvram_get() over the fake /dev/nvram: the cached
+ * lookup vs one open+ioctl+close per call as done before the cache. The
+ * fake device makes the same number of real syscalls (on /dev/null).
+ *
+ * Usage: nvram_lib_bench [gets]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+#include <bcmnvram.h>
+#include <nvram_linux.h>
+
+#include "mtdsim.h"
+#include "nvdrv.h"
+
+#define NAMES		64
+
+static double
+now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* nvram_get() without cache, as it was */
+static char *
+legacy_get(const char *name)
+{
+	static char value[NVRAM_MAX_VALUE_LEN];
+	anvram_ioctl_t nvr;
+	int fd, ret;
+
+	fd = open("/dev/nvram", O_RDWR);
+	if (fd < 0)
+		return NULL;
+
+	nvr.size = sizeof(nvr);
+	nvr.len_param = strlen(name);
+	nvr.len_value = sizeof(value);
+	nvr.param = (char *)name;
+	nvr.value = value;
+	ret = ioctl(fd, NVRAM_IOCTL_GET, &nvr);
+	close(fd);
+
+	return (ret < 0 || nvr.len_value < 1) ? NULL : nvr.value;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int gets = (argc > 1) ? atoi(argv[1]) : 200000;
+	char names[NAMES][32], value[32];
+	unsigned long sum = 0;
+	double t;
+	int i;
+
+	kshim_quiet = 1;
+	mtdsim_init(NULL, NVRAM_MTD_SIZE, NVRAM_MTD_SIZE, MTD_NORFLASH);
+	if (nvdrv_load() != 0)
+		return 1;
+
+	for (i = 0; i < NAMES; i++) {
+		sprintf(names[i], "wan0_option_%d", i);
+		sprintf(value, "%d", i * 1000);
+		nvram_set(names[i], value);
+	}
+
+	t = now_usec();
+	for (i = 0; i < gets; i++)
+		sum += legacy_get(names[i % NAMES])[0];
+	t = now_usec() - t;
+	printf("open+ioctl+close : %8.1f ns/get\n", t * 1e3 / gets);
+
+	t = now_usec();
+	for (i = 0; i < gets; i++)
+		sum += nvram_get(names[i % NAMES])[0];
+	t = now_usec() - t;
+	printf("cached           : %8.1f ns/get\n", t * 1e3 / gets);
+
+	/* Some variable changes between gets, cache revalidates by ioctl */
+	t = now_usec();
+	for (i = 0; i < gets; i++) {
+		if ((i % NAMES) == 0)
+			nvdrv_set_temp("bench_tick", (i & NAMES) ? "1" : "0");
+		sum += nvram_get(names[i % NAMES])[0];
+	}
+	t = now_usec() - t;
+	printf("cached, 1 change per %d gets : %8.1f ns/get\n", NAMES, t * 1e3 / gets);
+
+	nvdrv_unload();
+	mtdsim_close();
+
+	return (sum == 0);
+}
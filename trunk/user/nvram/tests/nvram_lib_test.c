@@ -0,0 +1,264 @@
+/*
+ * Tests of libshared nvram_linux.c over the fake /dev/nvram (nvdev.c)
+ * backed by drivers/nvram built in userspace.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <malloc.h>
+
+#include <bcmnvram.h>
+#include <nvram_linux.h>
+
+#include "mtdsim.h"
+#include "nvdrv.h"
+#include "nvdev.h"
+
+static int checks, failures;
+
+#define CHECK(cond) do { \
+	checks++; \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+static int
+str_eq(const char *a, const char *b)
+{
+	return (a && b) ? !strcmp(a, b) : (a == b);
+}
+
+static void
+boot_empty(void)
+{
+	mtdsim_init(NULL, NVRAM_MTD_SIZE, NVRAM_MTD_SIZE, MTD_NORFLASH);
+	CHECK(nvdrv_load() == 0);
+	nvdev_stats_reset();
+}
+
+/* Value of len bytes, filled by letter of seed */
+static void
+big_value(char *buf, int len, int seed)
+{
+	memset(buf, 'a' + seed % 26, len);
+	buf[len] = '\0';
+}
+
+/* Returned pointers keep their content when the value changes */
+static void
+test_get_stable(void)
+{
+	struct nvdev_stats st;
+	char *p, *q, *r, value[32];
+	int i;
+
+	nvram_set("st_a", "first");
+	p = nvram_get("st_a");
+	CHECK(str_eq(p, "first"));
+
+	/* Hit w/o any change, no ioctl */
+	nvdev_stats_reset();
+	CHECK(nvram_get("st_a") == p);
+	nvdev_stats_get(&st);
+	CHECK(st.ioctls == 0);
+
+	/* Other variable changed, same value keeps the same buffer */
+	nvram_set("st_b", "x");
+	CHECK(nvram_get("st_a") == p);
+
+	/* Shorter and longer values, old pointers untouched */
+	nvram_set("st_a", "2nd");
+	q = nvram_get("st_a");
+	CHECK(str_eq(q, "2nd") && q != p);
+	nvram_set("st_a", "a much longer third value");
+	r = nvram_get("st_a");
+	CHECK(str_eq(r, "a much longer third value"));
+	CHECK(str_eq(p, "first") && str_eq(q, "2nd"));
+
+	/* Still intact after many more changes of the name */
+	for (i = 0; i < 200; i++) {
+		sprintf(value, "value %d", i);
+		nvram_set("st_a", value);
+		CHECK(str_eq(nvram_get("st_a"), value));
+	}
+	CHECK(str_eq(p, "first") && str_eq(q, "2nd"));
+	CHECK(str_eq(r, "a much longer third value"));
+
+	/* Unset and set again */
+	nvram_unset("st_a");
+	CHECK(nvram_get("st_a") == NULL);
+	nvram_set("st_a", "back");
+	CHECK(str_eq(nvram_get("st_a"), "back"));
+	CHECK(str_eq(nvram_safe_get("st_none"), ""));
+}
+
+/* One ioctl for many names, unset names come back as NULL */
+static void
+test_get_multi(void)
+{
+	struct nvram_pair pairs[101];
+	struct nvdev_stats st;
+	char names[101][16], value[16];
+	int i;
+
+	for (i = 0; i < 100; i++) {
+		sprintf(names[i], "gm_%d", i);
+		sprintf(value, "%d", i * 3);
+		nvram_set(names[i], value);
+		pairs[i].name = names[i];
+	}
+	strcpy(names[100], "gm_unset");
+	pairs[100].name = names[100];
+
+	nvdev_stats_reset();
+	CHECK(nvram_get_multi(pairs, 101) == 0);
+	nvdev_stats_get(&st);
+	CHECK(st.get_multi == 1 && st.ioctls == 1);
+	for (i = 0; i < 100; i++) {
+		sprintf(value, "%d", i * 3);
+		CHECK(str_eq(pairs[i].value, value));
+	}
+	CHECK(pairs[100].value == NULL);
+
+	/* All cached now, no ioctl at all */
+	nvdev_stats_reset();
+	CHECK(nvram_get_multi(pairs, 101) == 0);
+	nvdev_stats_get(&st);
+	CHECK(st.ioctls == 0);
+	CHECK(str_eq(pairs[99].value, "297"));
+}
+
+/* Probing many unset names must not grow the cache without bound */
+static void
+test_get_unset_bounded(void)
+{
+	struct nvram_pair pairs[64];
+	struct nvdev_stats st;
+	char names[64][32], name[32];
+	size_t heap;
+	int i, j;
+
+	nvram_set("ub_kept", "kept");
+	CHECK(str_eq(nvram_get("ub_kept"), "kept"));
+
+	heap = mallinfo2().uordblks;
+	for (i = 0; i < 100000; i++) {
+		sprintf(name, "ub_probe_%d", i);
+		CHECK(nvram_get(name) == NULL);
+	}
+	for (i = 0; i < 1000; i++) {
+		for (j = 0; j < 64; j++) {
+			sprintf(names[j], "ub_multi_%d_%d", i, j);
+			pairs[j].name = names[j];
+		}
+		CHECK(nvram_get_multi(pairs, 64) == 0);
+		for (j = 0; j < 64; j++)
+			CHECK(pairs[j].value == NULL);
+	}
+	CHECK(mallinfo2().uordblks - heap < 256 * 1024);
+
+	/* Set values stay cached, a recent unset name is still a hit */
+	nvdev_stats_reset();
+	CHECK(str_eq(nvram_get("ub_kept"), "kept"));
+	CHECK(nvram_get("ub_multi_999_63") == NULL);
+	nvdev_stats_get(&st);
+	CHECK(st.ioctls == 0);
+
+	/* Name set after it was cached as unset */
+	nvram_set("ub_multi_999_63", "now");
+	CHECK(str_eq(nvram_get("ub_multi_999_63"), "now"));
+}
+
+/* Reply larger than NVRAM_SPACE, old code asked for it forever */
+static void
+test_get_multi_too_large(void)
+{
+	struct nvram_pair pairs[20];
+	struct nvdev_stats st;
+	char names[20][16], *value;
+	int i;
+
+	value = malloc(NVRAM_MAX_VALUE_LEN);
+	for (i = 0; i < 20; i++) {
+		sprintf(names[i], "huge_%d", i);
+		big_value(value, NVRAM_MAX_VALUE_LEN - 1, i);
+		CHECK(nvram_set_temp(names[i], value) == 0);
+		pairs[i].name = names[i];
+	}
+
+	nvdev_stats_reset();
+	CHECK(nvram_get_multi(pairs, 20) == 0);
+	nvdev_stats_get(&st);
+	CHECK(st.get_multi >= 1 && st.get_multi <= 3);
+	for (i = 0; i < 20; i++) {
+		big_value(value, NVRAM_MAX_VALUE_LEN - 1, i);
+		CHECK(str_eq(pairs[i].value, value));
+	}
+
+	free(value);
+}
+
+/* Reply grows before every retry, still bounded */
+static int grow_count;
+
+static void
+grow_hook(unsigned int req)
+{
+	char value[64];
+
+	if (req != NVRAM_IOCTL_GET_MULTI)
+		return;
+
+	grow_count++;
+	memset(value, 'g', sizeof(value) - 1);
+	value[grow_count % (sizeof(value) - 1)] = '\0';
+	nvdrv_set("grow_1", value);
+}
+
+static void
+test_get_multi_growing(void)
+{
+	struct nvram_pair pairs[2];
+	struct nvdev_stats st;
+	char value[NVRAM_MAX_VALUE_LEN];
+
+	big_value(value, NVRAM_MAX_VALUE_LEN - 1, 7);
+	nvram_set_temp("grow_0", value);
+	nvram_set("grow_1", "");
+	pairs[0].name = "grow_0";
+	pairs[1].name = "grow_1";
+
+	/* Every GET_MULTI sees a longer grow_1 than the size asked */
+	grow_count = 0;
+	nvdev_set_hook(grow_hook);
+	nvdev_stats_reset();
+	CHECK(nvram_get_multi(pairs, 2) == 0);
+	nvdev_set_hook(NULL);
+	nvdev_stats_get(&st);
+	CHECK(st.get_multi <= 3);
+
+	CHECK(str_eq(pairs[0].value, value));
+	CHECK(pairs[1].value && str_eq(pairs[1].value, nvdrv_get("grow_1")));
+}
+
+int
+main(int argc, char *argv[])
+{
+	kshim_quiet = 1;
+
+	/* Driver stays loaded, libshared keeps its descriptor and cache */
+	boot_empty();
+
+	test_get_stable();
+	test_get_multi();
+	test_get_unset_bounded();
+	test_get_multi_too_large();
+	test_get_multi_growing();
+
+	printf("nvram_lib_test: %d checks, %d failed\n", checks, failures);
+
+	return (failures) ? 1 : 0;
+}
@@ -0,0 +1,576 @@
+/*
+ * Tests of drivers/nvram built in userspace (nvdrv.c) on simulated flash:
+ * hash table, journaled commit and *_MULTI ioctls.
+ *
+ * Usage: nvram_test [seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include <bcmnvram.h>
+
+#include "mtdsim.h"
+#include "nvdrv.h"
+
+static int checks, failures;
+
+#define CHECK(cond) do { \
+	checks++; \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+#define CHECK_VAL(name, expect)	check_val(name, expect, __LINE__)
+
+/* Value of name is expect, NULL for unset */
+static void
+check_val(const char *name, const char *expect, int line)
+{
+	const char *value = nvdrv_get(name);
+
+	checks++;
+	if ((expect) ? (value && !strcmp(value, expect)) : !value)
+		return;
+
+	fprintf(stderr, "%s:%d: %s is '%s', expected '%s'\n", __FILE__, line, name,
+		(value) ? value : "(unset)", (expect) ? expect : "(unset)");
+	failures++;
+}
+
+static void
+boot_empty(void)
+{
+	mtdsim_init(NULL, NVRAM_MTD_SIZE, NVRAM_MTD_SIZE, MTD_NORFLASH);
+	CHECK(nvdrv_load() == 0);
+}
+
+static void
+shutdown(void)
+{
+	nvdrv_unload();
+	mtdsim_close();
+}
+
+/* Power cycle, flash content is kept and nothing is committed */
+static void
+reboot(void)
+{
+	nvdrv_unload();
+	mtdsim_cut_after(-1);
+	CHECK(nvdrv_load() == 0);
+}
+
+/* Journal record at offset in NVRAM image */
+static uint8_t *
+journal_at(uint32_t offset)
+{
+	return mtdsim_data() + NVRAM_MTD_OFFSET + offset;
+}
+
+/* Insert, lookup, overwrite and getall */
+static void
+test_insert_lookup(void)
+{
+	char name[32], value[32], *buf, *p;
+	int i, found;
+
+	boot_empty();
+
+	CHECK_VAL("lan_ipaddr", NULL);
+	CHECK(nvdrv_set("lan_ipaddr", "192.168.1.1") == 0);
+	CHECK_VAL("lan_ipaddr", "192.168.1.1");
+	CHECK(nvdrv_set("lan_ipaddr", "10.0.0.1") == 0);
+	CHECK_VAL("lan_ipaddr", "10.0.0.1");
+	CHECK(nvdrv_hash_count() == 1);
+
+	/* Value grows past its old space */
+	CHECK(nvdrv_set("lan_ipaddr", "192.168.100.100/24 and some more") == 0);
+	CHECK_VAL("lan_ipaddr", "192.168.100.100/24 and some more");
+	CHECK(nvdrv_set("empty", "") == 0);
+	CHECK_VAL("empty", "");
+
+	for (i = 0; i < 500; i++) {
+		sprintf(name, "key_x%d", i);
+		sprintf(value, "value%d", i * 7);
+		CHECK(nvdrv_set(name, value) == 0);
+	}
+	for (i = 0; i < 500; i++) {
+		sprintf(name, "key_x%d", i);
+		sprintf(value, "value%d", i * 7);
+		CHECK_VAL(name, value);
+	}
+	CHECK_VAL("key_x500", NULL);
+	CHECK_VAL("key_x", NULL);
+	CHECK(nvdrv_hash_count() == 502);
+	CHECK(nvdrv_check_table() == 0);
+
+	/* getall returns every persistent variable once */
+	nvdrv_set_temp("temp_var", "1");
+	buf = malloc(NVRAM_SPACE);
+	CHECK(nvdrv_getall(buf, NVRAM_SPACE) == 0);
+	found = 0;
+	for (p = buf; *p; p += strlen(p) + 1) {
+		CHECK(strncmp(p, "temp_var=", 9) != 0);
+		found++;
+	}
+	CHECK(found == 502);
+	free(buf);
+
+	shutdown();
+}
+
+/* Unset with backward shift keeps all other names reachable */
+static void
+test_delete(void)
+{
+	char name[32];
+	int i;
+
+	boot_empty();
+
+	for (i = 0; i < 600; i++) {
+		sprintf(name, "del_%d", i);
+		nvdrv_set(name, name);
+	}
+	for (i = 0; i < 600; i += 3) {
+		sprintf(name, "del_%d", i);
+		CHECK(nvdrv_unset(name) == 0);
+	}
+	CHECK(nvdrv_unset("never_set") == 0);
+	CHECK(nvdrv_check_table() == 0);
+	CHECK(nvdrv_hash_count() == 400);
+	for (i = 0; i < 600; i++) {
+		sprintf(name, "del_%d", i);
+		CHECK_VAL(name, (i % 3) ? name : NULL);
+	}
+
+	/* Reinsert after delete */
+	for (i = 0; i < 600; i += 3) {
+		sprintf(name, "del_%d", i);
+		nvdrv_set(name, "again");
+	}
+	for (i = 0; i < 600; i += 3) {
+		sprintf(name, "del_%d", i);
+		CHECK_VAL(name, "again");
+	}
+	CHECK(nvdrv_check_table() == 0);
+
+	shutdown();
+}
+
+/* Table doubles under load and every name survives the rehash */
+static void
+test_rehash(void)
+{
+	char name[32];
+	uint32_t size0, size;
+	int i, grows = 0;
+
+	boot_empty();
+
+	nvdrv_set("first", "1");
+	size0 = size = nvdrv_hash_size();
+	CHECK(size0 >= 1024 && (size0 & (size0 - 1)) == 0);
+
+	for (i = 0; i < 3000; i++) {
+		sprintf(name, "r%d", i);
+		nvdrv_set(name, "v");
+		if (nvdrv_hash_size() != size) {
+			CHECK(nvdrv_hash_size() == size * 2);
+			CHECK(nvdrv_hash_count() * 4 > size * 3);
+			size = nvdrv_hash_size();
+			grows++;
+			CHECK(nvdrv_check_table() == 0);
+		}
+	}
+	CHECK(grows >= 2);
+	CHECK(nvdrv_check_table() == 0);
+	for (i = 0; i < 3000; i++) {
+		sprintf(name, "r%d", i);
+		CHECK_VAL(name, "v");
+	}
+	CHECK_VAL("first", "1");
+
+	shutdown();
+}
+
+/* Names sharing one home slot, also wrapping around the table end */
+static void
+test_collisions(void)
+{
+	char names[24][32];
+	uint32_t mask, home;
+	int n, i, k;
+
+	for (k = 0; k < 2; k++) {
+		boot_empty();
+
+		nvdrv_set("seed", "1");
+		mask = nvdrv_hash_size() - 1;
+		home = (k == 0) ? 100 : mask - 2;
+
+		for (n = 0, i = 0; n < 24; i++) {
+			sprintf(names[n], "coll_%d", i);
+			if ((nvdrv_hash_of(names[n]) & mask) == home)
+				n++;
+		}
+
+		for (i = 0; i < 24; i++)
+			nvdrv_set(names[i], names[i]);
+		CHECK(nvdrv_hash_size() == mask + 1);
+		CHECK(nvdrv_check_table() == 0);
+
+		/* Remove from the middle and the head of the cluster */
+		nvdrv_unset(names[10]);
+		nvdrv_unset(names[0]);
+		nvdrv_unset(names[23]);
+		CHECK(nvdrv_check_table() == 0);
+		for (i = 0; i < 24; i++)
+			CHECK_VAL(names[i], (i == 0 || i == 10 || i == 23) ? NULL : names[i]);
+
+		nvdrv_set(names[10], "back");
+		CHECK_VAL(names[10], "back");
+		CHECK(nvdrv_check_table() == 0);
+
+		shutdown();
+	}
+}
+
+/* Commit appends records w/o erase, reboot replays them */
+static void
+test_journal_replay(void)
+{
+	struct mtdsim_stats st;
+	char name[32];
+	uint32_t offset;
+	int i;
+
+	boot_empty();
+
+	for (i = 0; i < 50; i++) {
+		sprintf(name, "jr_%d", i);
+		nvdrv_set(name, name);
+	}
+	CHECK(nvdrv_commit() == 0);
+	mtdsim_stats_get(&st);
+	CHECK(st.erases > 0);
+	offset = nvdrv_journal_offset();
+	CHECK(offset > 0 && (offset & 3) == 0);
+
+	/* Set, change, unset and temp in one record */
+	mtdsim_stats_reset();
+	nvdrv_set("jr_new", "new");
+	nvdrv_set("jr_1", "changed");
+	nvdrv_unset("jr_2");
+	nvdrv_set_temp("jr_3", "temp");
+	CHECK(nvdrv_commit() == 0);
+	mtdsim_stats_get(&st);
+	CHECK(st.erases == 0 && st.programs == 1);
+	CHECK(nvdrv_journal_offset() > offset);
+	offset = nvdrv_journal_offset();
+
+	/* Nothing changed, nothing written */
+	mtdsim_stats_reset();
+	CHECK(nvdrv_commit() == 0);
+	mtdsim_stats_get(&st);
+	CHECK(st.programs == 0 && nvdrv_journal_offset() == offset);
+
+	/* Set again after unset in the next record */
+	nvdrv_set("jr_2", "back");
+	nvdrv_unset("jr_new");
+	CHECK(nvdrv_commit() == 0);
+
+	reboot();
+	CHECK_VAL("jr_0", "jr_0");
+	CHECK_VAL("jr_1", "changed");
+	CHECK_VAL("jr_2", "back");
+	CHECK_VAL("jr_3", NULL);
+	CHECK_VAL("jr_new", NULL);
+	CHECK_VAL("jr_49", "jr_49");
+	CHECK(nvdrv_journal_offset() > offset);
+	CHECK(nvdrv_check_table() == 0);
+
+	mtdsim_stats_get(&st);
+	CHECK(st.violations == 0);
+
+	shutdown();
+}
+
+/* Power cut at every byte of a record keeps the old value */
+static void
+test_journal_torn(void)
+{
+	struct mtdsim_stats st;
+	uint32_t offset, len;
+	long cut;
+
+	boot_empty();
+	nvdrv_set("torn", "old");
+	nvdrv_set("other", "1");
+	CHECK(nvdrv_commit() == 0);
+
+	/* Record length of the change */
+	offset = nvdrv_journal_offset();
+	nvdrv_set("torn", "new value");
+	CHECK(nvdrv_commit() == 0);
+	len = nvdrv_journal_offset() - offset;
+	CHECK(len > 12);
+
+	for (cut = 0; cut < (long)len; cut++) {
+		/* Image with "old" and clean journal space */
+		mtdsim_init(NULL, NVRAM_MTD_SIZE, NVRAM_MTD_SIZE, MTD_NORFLASH);
+		nvdrv_unload();
+		CHECK(nvdrv_load() == 0);
+		nvdrv_set("torn", "old");
+		nvdrv_set("other", "1");
+		nvdrv_commit();
+
+		nvdrv_set("torn", "new value");
+		mtdsim_cut_after(cut);
+		CHECK(nvdrv_commit() != 0);
+		reboot();
+		CHECK_VAL("torn", "old");
+		CHECK_VAL("other", "1");
+
+		/* Dirty tail forces a full image, then journal resumes */
+		CHECK(nvdrv_journal_offset() == ((cut) ? 0 : offset));
+		nvdrv_set("torn", "after");
+		mtdsim_stats_reset();
+		CHECK(nvdrv_commit() == 0);
+		mtdsim_stats_get(&st);
+		CHECK(((cut) ? st.erases > 0 : st.erases == 0) && st.violations == 0);
+		nvdrv_set("torn", "after2");
+		CHECK(nvdrv_commit() == 0);
+		reboot();
+		CHECK_VAL("torn", "after2");
+	}
+
+	shutdown();
+}
+
+/* Any single bit cleared in a record (header or payload) rejects it */
+static void
+test_journal_corrupt(void)
+{
+	uint32_t offset, len, i;
+	uint8_t *rec, saved;
+	int bit;
+
+	boot_empty();
+	nvdrv_set("crc", "old");
+	CHECK(nvdrv_commit() == 0);
+	offset = nvdrv_journal_offset();
+	nvdrv_set("crc", "new");
+	CHECK(nvdrv_commit() == 0);
+	len = nvdrv_journal_offset() - offset;
+	rec = journal_at(offset);
+
+	for (i = 4; i < len; i++) {
+		for (bit = 0; bit < 8; bit++) {
+			if (!(rec[i] & (1 << bit)))
+				continue;
+			saved = rec[i];
+			rec[i] &= ~(1 << bit);
+			reboot();
+			CHECK_VAL("crc", "old");
+			rec[i] = saved;
+		}
+	}
+
+	reboot();
+	CHECK_VAL("crc", "new");
+
+	shutdown();
+}
+
+/* Journal space runs out, commit falls back to one full image */
+static void
+test_journal_full(void)
+{
+	struct mtdsim_stats st;
+	char value[512];
+	uint32_t offset;
+	int i, compactions = 0, records = 0;
+
+	boot_empty();
+	nvdrv_set("base", "1");
+	CHECK(nvdrv_commit() == 0);
+
+	memset(value, 'v', sizeof(value) - 1);
+	value[sizeof(value) - 1] = '\0';
+	for (i = 0; i < 400; i++) {
+		offset = nvdrv_journal_offset();
+		value[0] = 'a' + i % 26;
+		nvdrv_set("big", value);
+		mtdsim_stats_reset();
+		CHECK(nvdrv_commit() == 0);
+		mtdsim_stats_get(&st);
+		CHECK(st.violations == 0);
+		if (st.erases) {
+			/* Compaction only when the record did not fit */
+			CHECK(offset + 12 + sizeof(value) + 8 > NVRAM_SPACE - 4);
+			CHECK(nvdrv_journal_offset() < offset);
+			compactions++;
+		} else {
+			CHECK(nvdrv_journal_offset() > offset);
+			records++;
+		}
+	}
+	CHECK(compactions >= 2);
+	CHECK(records > compactions * 50);
+
+	reboot();
+	CHECK_VAL("base", "1");
+	CHECK_VAL("big", value);
+
+	shutdown();
+}
+
+/* Pack n pairs "name=value\0" (or names only) for *_MULTI ioctls */
+static int
+multi_pack(char *buf, int first, int n, int with_value)
+{
+	int i, len = 0;
+
+	for (i = first; i < first + n; i++) {
+		if (with_value)
+			len += sprintf(buf + len, "m_%d=v%d", i, i) + 1;
+		else
+			len += sprintf(buf + len, "m_%d", i) + 1;
+	}
+
+	return len;
+}
+
+/* Batches are applied with nvram_lock dropped every 32 names */
+static void
+test_multi_chunks(void)
+{
+	anvram_ioctl_t nvr;
+	char *param, *value, *p;
+	unsigned long locks1, locks100;
+	void *file;
+	int i;
+
+	boot_empty();
+	file = nvdrv_open();
+	param = malloc(NVRAM_SPACE);
+	value = malloc(NVRAM_SPACE);
+
+	memset(&nvr, 0, sizeof(nvr));
+	nvr.size = sizeof(nvr);
+	nvr.param = param;
+
+	nvr.len_param = multi_pack(param, 1000, 1, 1);
+	locks1 = nvdrv_lock_count();
+	CHECK(nvdrv_ioctl(file, NVRAM_IOCTL_SET_MULTI, &nvr) == 0);
+	locks1 = nvdrv_lock_count() - locks1;
+
+	nvr.len_param = multi_pack(param, 0, 100, 1);
+	locks100 = nvdrv_lock_count();
+	CHECK(nvdrv_ioctl(file, NVRAM_IOCTL_SET_MULTI, &nvr) == 0);
+	locks100 = nvdrv_lock_count() - locks100;
+	CHECK(locks100 == locks1 + 3);
+
+	for (i = 0; i < 100; i += 33) {
+		char name[16], val[16];
+
+		sprintf(name, "m_%d", i);
+		sprintf(val, "v%d", i);
+		CHECK_VAL(name, val);
+	}
+
+	/* Whole reply is built over all chunks */
+	nvr.len_param = multi_pack(param, 0, 100, 0);
+	nvr.value = value;
+	nvr.len_value = NVRAM_SPACE;
+	locks100 = nvdrv_lock_count();
+	CHECK(nvdrv_ioctl(file, NVRAM_IOCTL_GET_MULTI, &nvr) == 0);
+	locks100 = nvdrv_lock_count() - locks100;
+	CHECK(locks100 == locks1 + 3);
+	for (i = 0, p = value; *p; p += strlen(p) + 1, i++) {
+		char pair[32];
+
+		sprintf(pair, "m_%d=v%d", i, i);
+		CHECK(!strcmp(p, pair));
+	}
+	CHECK(i == 100);
+
+	/* Too small buffer reports the size needed for all chunks */
+	nvr.len_value = 64;
+	CHECK(nvdrv_ioctl(file, NVRAM_IOCTL_GET_MULTI, &nvr) == -EOVERFLOW);
+	CHECK(nvr.len_value == (p - value) + 1);
+
+	nvdrv_release(file);
+	free(param);
+	free(value);
+	shutdown();
+}
+
+/* Random set/unset against a reference array */
+static void
+test_random(unsigned int seed)
+{
+	enum { KEYS = 2000, OPS = 100000 };
+	static char ref[KEYS][16];
+	static int ref_set[KEYS];
+	char name[32];
+	int i, k, live = 0;
+
+	srand(seed);
+	memset(ref_set, 0, sizeof(ref_set));
+	boot_empty();
+
+	for (i = 0; i < OPS; i++) {
+		k = rand() % KEYS;
+		sprintf(name, "rnd_%d", k);
+		if (rand() % 4 == 0) {
+			nvdrv_unset(name);
+			live -= ref_set[k];
+			ref_set[k] = 0;
+		} else {
+			sprintf(ref[k], "%x", rand() % 0xFFFFF);
+			nvdrv_set(name, ref[k]);
+			live += !ref_set[k];
+			ref_set[k] = 1;
+		}
+		if (i % 10000 == 0)
+			CHECK(nvdrv_check_table() == 0);
+	}
+
+	CHECK(nvdrv_hash_count() == (uint32_t)live);
+	for (k = 0; k < KEYS; k++) {
+		sprintf(name, "rnd_%d", k);
+		CHECK_VAL(name, ref_set[k] ? ref[k] : NULL);
+	}
+
+	shutdown();
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned int seed = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1;
+
+	kshim_quiet = 1;
+
+	test_insert_lookup();
+	test_delete();
+	test_rehash();
+	test_collisions();
+	test_random(seed);
+	test_journal_replay();
+	test_journal_torn();
+	test_journal_corrupt();
+	test_journal_full();
+	test_multi_chunks();
+
+	printf("nvram_test: %d checks, %d failed\n", checks, failures);
+
+	return (failures) ? 1 : 0;
+}
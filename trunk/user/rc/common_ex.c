@@ -904,3 +904,35 @@ get_hotplug_action(const char *action)
 
 	return 1;
 }
+
+/* collect "ip" commands and run them through one "ip -batch" process,
+ * batch lines cannot carry options, so the family is set for the whole file */
+FILE *
+ip_batch_open(void)
+{
+	char path[32];
+
+	snprintf(path, sizeof(path), "/tmp/.ip_batch.%d", getpid());
+	return fopen(path, "w");
+}
+
+int
+ip_batch_run(FILE *fp, int ipv6)
+{
+	char path[32];
+	long size;
+	int ret = 0;
+
+	if (!fp)
+		return -1;
+
+	size = ftell(fp);
+	fclose(fp);
+
+	snprintf(path, sizeof(path), "/tmp/.ip_batch.%d", getpid());
+	if (size > 0)
+		ret = doSystem("ip %s-force -batch %s", (ipv6) ? "-6 " : "", path);
+	unlink(path);
+
+	return ret;
+}
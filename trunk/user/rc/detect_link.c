@@ -22,6 +22,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <syslog.h>
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/time.h>
 #include <time.h>
@@ -434,6 +435,9 @@ detect_link_main(int argc, char *argv[])
 {
 	FILE *fp;
 	pid_t pid;
+	int watch_fd;
+	struct pollfd pfd;
+	sigset_t sigs;
 	struct sigaction sa;
 
 	memset(&sa, 0, sizeof(sa));
@@ -469,11 +473,36 @@ detect_link_main(int argc, char *argv[])
 		fclose(fp);
 	}
 
+	/* follow LED settings w/o waiting for SIGHUP */
+	watch_fd = nvram_watch_open();
+	if (watch_fd >= 0 &&
+	   (nvram_watch_add(watch_fd, "front_led_") < 0 ||
+	    nvram_watch_add(watch_fd, "led_front_t") < 0)) {
+		close(watch_fd);
+		watch_fd = -1;
+	}
+
 	dl_reset_state();
 	dl_alarmtimer(DL_POLL_INTERVAL);
 
+	sigemptyset(&sigs);
+	sigaddset(&sigs, SIGHUP);
+	sigaddset(&sigs, SIGUSR1);
+	sigaddset(&sigs, SIGALRM);
+
 	while (1) {
-		pause();
+		if (watch_fd < 0) {
+			pause();
+			continue;
+		}
+		
+		pfd.fd = watch_fd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, -1) > 0 && nvram_watch_drain(watch_fd)) {
+			sigprocmask(SIG_BLOCK, &sigs, NULL);
+			dl_update_leds();
+			sigprocmask(SIG_UNBLOCK, &sigs, NULL);
+		}
 	}
 
 	return 0;
@@ -24,6 +24,8 @@
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <dirent.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "rc.h"
 
@@ -40,6 +42,49 @@
 /* state match - use xt_state (xt_conntrack more slower than xt_state) */
 #define CT_STATE		"state --state"
 
+/* exists while the tables hold exactly the last applied rules (*.rules.last) */
+#define FW_DIFF_STAMP		"/tmp/.firewall_diff"
+#define FW_MAX_TABLES		4
+#define FW_MAX_CHAINS		64
+#define FW_FNV_INIT		14695981039346656037ULL
+#define FW_FNV_PRIME		1099511628211ULL
+
+typedef struct fw_chain_s
+{
+	char name[32];
+	int builtin;
+	int changed;
+	unsigned long long hash;
+} fw_chain_t;
+
+typedef struct fw_chains_s
+{
+	int count;
+	int overflow;
+	fw_chain_t chain[FW_MAX_CHAINS];
+} fw_chains_t;
+
+/* tables of one family, restored by a single iptables-restore */
+typedef struct fw_family_s
+{
+	const char *restore;
+	const char *file;
+	int tables;
+	const char *rules[FW_MAX_TABLES];
+
+	/* stats of last apply */
+	int full;
+	int changed;
+	int total;
+	unsigned long ms_diff;
+	unsigned long ms_restore;
+} fw_family_t;
+
+static fw_family_t fw_ipv4 = { "iptables-restore", "/tmp/ipt.restore" };
+#if defined (USE_IPV6)
+static fw_family_t fw_ipv6 = { "ip6tables-restore", "/tmp/ip6t.restore" };
+#endif
+
 static char *g_buf;
 static char g_buf_pool[1024];
 
@@ -733,6 +778,293 @@ get_tcp_mss_ifname_vpnc(int vpnc_type)
 		return IFNAME_CLIENT_PPP;
 }
 
+static unsigned long
+fw_msec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static fw_chain_t *
+fw_chain_get(fw_chains_t *c, const char *name, int add)
+{
+	fw_chain_t *ch;
+	char buf[sizeof(ch->name)];
+	size_t len;
+	int i;
+
+	len = strcspn(name, " \n");
+	if (len >= sizeof(buf))
+		len = sizeof(buf) - 1;
+	memcpy(buf, name, len);
+	buf[len] = 0;
+
+	for (i = 0; i < c->count; i++) {
+		if (strcmp(c->chain[i].name, buf) == 0)
+			return &c->chain[i];
+	}
+
+	if (!add)
+		return NULL;
+
+	if (c->count >= FW_MAX_CHAINS) {
+		c->overflow = 1;
+		return NULL;
+	}
+
+	ch = &c->chain[c->count++];
+	memset(ch, 0, sizeof(fw_chain_t));
+	strcpy(ch->name, buf);
+	ch->hash = FW_FNV_INIT;
+
+	return ch;
+}
+
+/* hash chain declarations and rules of a rules file per chain */
+static int
+fw_chains_load(const char *file, fw_chains_t *c)
+{
+	FILE *fp;
+	fw_chain_t *ch = NULL;
+	char line[1024], *p;
+	int cont = 0;
+
+	c->count = 0;
+	c->overflow = 0;
+
+	if (!(fp = fopen(file, "r")))
+		return -1;
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (!cont) {
+			ch = NULL;
+			if (line[0] == ':') {
+				ch = fw_chain_get(c, line + 1, 1);
+				if (ch)
+					ch->builtin = (strncmp(line + 1 + strlen(ch->name), " - ", 3) != 0);
+			} else if (strncmp(line, "-A ", 3) == 0)
+				ch = fw_chain_get(c, line + 3, 1);
+		}
+		if (ch) {
+			for (p = line; *p; p++)
+				ch->hash = (ch->hash ^ (unsigned char)*p) * FW_FNV_PRIME;
+		}
+		cont = (strchr(line, '\n') == NULL);
+	}
+	fclose(fp);
+
+	return (c->overflow) ? -1 : 0;
+}
+
+/* write only the changed chains of a table for iptables-restore --noflush,
+ * returns number of changed and removed chains or -1 without usable last rules */
+static int
+fw_table_diff(FILE *out, const char *rules, int *total)
+{
+	FILE *fp;
+	fw_chain_t *ch, *och;
+	char line[1024], last[64];
+	int i, changed, cont, emit, flushed;
+	static fw_chains_t cur, old;
+
+	snprintf(last, sizeof(last), "%s.last", rules);
+	if (fw_chains_load(rules, &cur) < 0 || fw_chains_load(last, &old) < 0)
+		return -1;
+
+	changed = 0;
+	for (i = 0; i < cur.count; i++) {
+		ch = &cur.chain[i];
+		och = fw_chain_get(&old, ch->name, 0);
+		ch->changed = (!och || och->hash != ch->hash);
+		if (och)
+			och->changed = -1;
+		changed += ch->changed;
+	}
+	for (i = 0; i < old.count; i++) {
+		if (old.chain[i].changed != -1)
+			changed++;
+	}
+	*total += cur.count;
+
+	if (!changed)
+		return 0;
+
+	if (!(fp = fopen(rules, "r")))
+		return -1;
+
+	ch = NULL;
+	emit = 1;
+	cont = 0;
+	flushed = 0;
+	while (fgets(line, sizeof(line), fp)) {
+		if (!cont) {
+			if (line[0] == ':') {
+				ch = fw_chain_get(&cur, line + 1, 0);
+				emit = (ch && ch->changed);
+			} else if (line[0] == '*') {
+				emit = 1;
+			} else {
+				/* builtin chains are not flushed by --noflush */
+				if (!flushed) {
+					for (i = 0; i < cur.count; i++) {
+						if (cur.chain[i].builtin && cur.chain[i].changed)
+							fprintf(out, "-F %s\n", cur.chain[i].name);
+					}
+					flushed = 1;
+				}
+				if (strncmp(line, "-A ", 3) == 0) {
+					ch = fw_chain_get(&cur, line + 3, 0);
+					emit = (ch && ch->changed);
+				} else {
+					if (strncmp(line, "COMMIT", 6) == 0) {
+						for (i = 0; i < old.count; i++) {
+							if (old.chain[i].changed != -1 && !old.chain[i].builtin)
+								fprintf(out, "-F %s\n-X %s\n", old.chain[i].name, old.chain[i].name);
+						}
+					}
+					emit = 1;
+				}
+			}
+		}
+		if (emit)
+			fputs(line, out);
+		cont = (strchr(line, '\n') == NULL);
+	}
+	fclose(fp);
+
+	return changed;
+}
+
+static void
+fw_table_add(fw_family_t *f, const char *rules)
+{
+	if (f->tables < FW_MAX_TABLES)
+		f->rules[f->tables++] = rules;
+}
+
+/* table is left as is, its last rules are unknown from now */
+static void
+fw_table_drop(const char *rules)
+{
+	char last[64];
+
+	snprintf(last, sizeof(last), "%s.last", rules);
+	unlink(last);
+}
+
+static int
+fw_family_write(fw_family_t *f, int diff)
+{
+	FILE *out, *fp;
+	char buf[1024];
+	size_t n;
+	int i, ret;
+
+	if (!(out = fopen(f->file, "w")))
+		return -1;
+
+	f->changed = 0;
+	f->total = 0;
+	for (i = 0; i < f->tables; i++) {
+		if (diff) {
+			ret = fw_table_diff(out, f->rules[i], &f->total);
+			if (ret < 0)
+				break;
+			f->changed += ret;
+		} else if ((fp = fopen(f->rules[i], "r"))) {
+			while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+				fwrite(buf, 1, n, out);
+			fclose(fp);
+		}
+	}
+	fclose(out);
+
+	return (i < f->tables) ? -1 : 0;
+}
+
+/* apply all collected tables, only changed chains if diff is allowed */
+static int
+fw_family_apply(fw_family_t *f, int diff)
+{
+	char last[64];
+	unsigned long t;
+	int i, ret;
+
+	f->full = 0;
+	f->changed = 0;
+	f->total = 0;
+	f->ms_diff = 0;
+	f->ms_restore = 0;
+
+	if (!f->tables)
+		return 0;
+
+	t = fw_msec();
+	if (!diff || fw_family_write(f, 1) < 0) {
+		diff = 0;
+		f->full = 1;
+		fw_family_write(f, 0);
+	}
+	f->ms_diff = fw_msec() - t;
+
+	t = fw_msec();
+	ret = 0;
+	if (!diff || f->changed > 0) {
+		ret = doSystem("%s %s%s", f->restore, (diff) ? "--noflush " : "", f->file);
+		if (ret != 0 && diff) {
+			/* retry with whole tables */
+			f->full = 1;
+			fw_family_write(f, 0);
+			ret = doSystem("%s %s", f->restore, f->file);
+		}
+	}
+	f->ms_restore = fw_msec() - t;
+
+	for (i = 0; i < f->tables; i++) {
+		snprintf(last, sizeof(last), "%s.last", f->rules[i]);
+		if (ret == 0)
+			rename(f->rules[i], last);
+		else
+			unlink(last);
+	}
+
+	return (ret == 0) ? 0 : -1;
+}
+
+static void
+fw_family_stat(fw_family_t *f, char *buf, size_t len)
+{
+	if (!f->tables)
+		snprintf(buf, len, "-");
+	else if (f->full)
+		snprintf(buf, len, "full");
+	else
+		snprintf(buf, len, "%d/%d chains", f->changed, f->total);
+}
+
+/* script is not only comments */
+static int
+fw_script_has_commands(const char *script)
+{
+	FILE *fp;
+	char line[256], *p;
+	int ret = 0;
+
+	if (!(fp = fopen(script, "r")))
+		return 0;
+
+	while (!ret && fgets(line, sizeof(line), fp)) {
+		p = line + strspn(line, " \t\r\n");
+		if (*p && *p != '#')
+			ret = 1;
+	}
+	fclose(fp);
+
+	return ret;
+}
+
 static int
 get_sshd_bfp_time(int bfp_mode)
 {
@@ -1227,7 +1559,7 @@ ipt_filter_rules(char *man_if, char *wan_if, char *lan_if, char *lan_ip,
 	if (ret & MODULE_WEBSTR_MASK)
 		module_smart_load("xt_webstr", NULL);
 
-	doSystem("iptables-restore %s", ipt_file);
+	fw_table_add(&fw_ipv4, ipt_file);
 
 	return ret;
 }
@@ -1274,6 +1606,7 @@ ipt_filter_default(void)
 	fprintf(fp, "COMMIT\n\n");
 	fclose(fp);
 
+	unlink(FW_DIFF_STAMP);
 	doSystem("iptables-restore %s", ipt_file);
 }
 
@@ -1333,7 +1666,9 @@ ipt_mangle_rules(const char *man_if, const char *wan_if, int use_man)
 	fclose(fp);
 
 	if (i_wan_ttl_fix || is_module_loaded("iptable_mangle"))
-		doSystem("iptables-restore %s", ipt_file);
+		fw_table_add(&fw_ipv4, ipt_file);
+	else
+		fw_table_drop(ipt_file);
 }
 
 static void
@@ -1353,7 +1688,9 @@ ipt_raw_rules(void)
 	fclose(fp);
 
 	if (is_module_loaded("iptable_raw"))
-		doSystem("iptables-restore %s", ipt_file);
+		fw_table_add(&fw_ipv4, ipt_file);
+	else
+		fw_table_drop(ipt_file);
 }
 
 #if defined (USE_IPV6)
@@ -1635,7 +1972,7 @@ ip6t_filter_rules(char *man_if, char *wan_if, char *lan_if,
 	if (ret & MODULE_WEBSTR_MASK)
 		module_smart_load("xt_webstr", NULL);
 
-	doSystem("ip6tables-restore %s", ipt_file);
+	fw_table_add(&fw_ipv6, ipt_file);
 
 	return ret;
 }
@@ -1683,6 +2020,7 @@ ip6t_filter_default(void)
 	fprintf(fp, "COMMIT\n\n");
 	fclose(fp);
 
+	unlink(FW_DIFF_STAMP);
 	doSystem("ip6tables-restore %s", ipt_file);
 }
 
@@ -1706,7 +2044,9 @@ ip6t_mangle_rules(char *man_if)
 	fclose(fp);
 
 	if (is_module_loaded("ip6table_mangle"))
-		doSystem("ip6tables-restore %s", ipt_file);
+		fw_table_add(&fw_ipv6, ipt_file);
+	else
+		fw_table_drop(ipt_file);
 }
 
 #if defined (APP_NAPT66)
@@ -2065,7 +2405,7 @@ ipt_nat_rules(char *man_if, char *man_ip,
 	fprintf(fp, "COMMIT\n\n");
 	fclose(fp);
 
-	doSystem("iptables-restore %s", ipt_file);
+	fw_table_add(&fw_ipv4, ipt_file);
 
 	return 0;
 }
@@ -2108,13 +2448,16 @@ ipt_nat_default(void)
 	fprintf(fp, "COMMIT\n\n");
 	fclose(fp);
 
+	unlink(FW_DIFF_STAMP);
 	doSystem("iptables-restore %s", ipt_file);
 }
 
 void
 start_firewall_ex(void)
 {
-	int unit, wan_proto, i_tcp_mss, i_use_man, i_rp;
+	int unit, wan_proto, i_tcp_mss, i_use_man, i_rp, i_diff, i_hooks, ret;
+	unsigned long t_start, t_rules, t_apply;
+	char stat4[32], stat6[32] = "-";
 	char logaccept[16], logdrop[16];
 	char wan_if[16], man_if[16], lan_if[16];
 	char wan_ip[16], man_ip[16], lan_ip[16], lan_net[24] = {0};
@@ -2126,6 +2469,16 @@ start_firewall_ex(void)
 
 	unit = 0;
 
+	t_start = fw_msec();
+
+	/* only changed chains are restored while nobody else touched the tables */
+	i_diff = check_if_file_exist(FW_DIFF_STAMP);
+	unlink(FW_DIFF_STAMP);
+	fw_ipv4.tables = 0;
+#if defined (USE_IPV6)
+	fw_ipv6.tables = 0;
+#endif
+
 	snprintf(lan_if, sizeof(lan_if), "%s", IFNAME_BR);
 	snprintf(man_if, sizeof(man_if), "%s", get_man_ifname(unit));
 	snprintf(wan_if, sizeof(wan_if), "%s", get_wan_unit_value(unit, "ifname_t"));
@@ -2187,21 +2540,53 @@ start_firewall_ex(void)
 
 	/* IPv6 Filter rules */
 	ip6t_filter_rules(man_if, wan_if, lan_if, logaccept, logdrop, i_tcp_mss);
-#if defined (APP_NAPT66)
-	if (nvram_match("napt66_enable", "1"))
-		ip6t_disable_filter();
 #endif
+
+	t_rules = fw_msec();
+
+	ret = fw_family_apply(&fw_ipv4, i_diff);
+#if defined (USE_IPV6)
+	ret |= fw_family_apply(&fw_ipv6, i_diff);
 #endif
 
+	t_apply = fw_msec();
+
+	/* hooks below change the tables, next reload must restore them whole */
+	i_hooks = 0;
+#if defined (USE_IPV6) && defined (APP_NAPT66)
+	if (nvram_match("napt66_enable", "1")) {
+		ip6t_disable_filter();
+		i_hooks = 1;
+	}
+#endif
 #if defined (APP_SHADOWSOCKS)
-	if (check_if_file_exist(shadowsocks_iptables_script))
+	if (check_if_file_exist(shadowsocks_iptables_script)) {
 		doSystem("sh %s", shadowsocks_iptables_script);
+		i_hooks = 1;
+	}
 #endif
-	if (check_if_file_exist(int_iptables_script))
+	if (fw_script_has_commands(int_iptables_script)) {
 		doSystem("%s", int_iptables_script);
+		i_hooks = 1;
+	}
 
-	if (check_if_file_exist(opt_iptables_script))
+	if (check_if_file_exist(opt_iptables_script)) {
 		doSystem("%s update", opt_iptables_script);
+		i_hooks = 1;
+	}
+
+	if (!ret && !i_hooks)
+		create_file(FW_DIFF_STAMP);
+
+	fw_family_stat(&fw_ipv4, stat4, sizeof(stat4));
+#if defined (USE_IPV6)
+	fw_family_stat(&fw_ipv6, stat6, sizeof(stat6));
+	fw_ipv4.ms_diff += fw_ipv6.ms_diff;
+	fw_ipv4.ms_restore += fw_ipv6.ms_restore;
+#endif
+	logmessage("Firewall", "reload %lu ms (rules %lu, diff %lu, restore %lu, hooks %lu), IPv4 %s, IPv6 %s",
+		fw_msec() - t_start, t_rules - t_start, fw_ipv4.ms_diff, fw_ipv4.ms_restore,
+		fw_msec() - t_apply, stat4, stat6);
 
 	/* enable IPv4 forward */
 	set_ipv4_forward(1);
@@ -504,32 +504,43 @@ init_main_loop(void)
 	/* Setup signal handlers */
 	init_signals();
 
+	/* Event socket queues requests until init_router() is done */
+	start_rc_events();
+
 	/* block SIGUSR1 during init_router() */
 	control_signal(SIGUSR1, SIG_BLOCK);
 
 	/* block SIGUSR2 during notify_shutdown() */
 	control_signal(SIGUSR2, SIG_BLOCK);
 
-	/* Router init and start */
+	/* Router init and start, log spawned commands with their time */
+	spawn_trace("/tmp/rc_boot.trace");
 	init_router();
+	spawn_trace(NULL);
 
 	/* unblock SIGUSR1 */
 	control_signal(SIGUSR1, SIG_UNBLOCK);
 
 	/* Loop forever */
 	for (;;) {
+		int events_ready = 0;
 		sigset_t ss;
 		sigemptyset(&ss);
 		
 		/* Wait for user input or state change */
 		while ( !sig_usr1_received &&
-			!sig_alrm_received ) {
+			!sig_alrm_received &&
+			!events_ready ) {
 			if (!noconsole && (!shell_pid || kill(shell_pid, 0) != 0))
 				shell_pid = run_shell(0, 1);
 			else
-				sigsuspend(&ss);
+				events_ready = wait_rc_events(&ss);
 		}
 		
+		/* Handle event socket requests */
+		if (events_ready)
+			handle_rc_events();
+		
 		/* Handle SIGUSR1 signal */
 		if (sig_usr1_received) {
 			sig_usr1_received = 0;
@@ -154,9 +154,18 @@ void full_restart_ipv6(int ipv6_type_old)
 	stop_dns_dhcpd();
 
 	if (ipv6_type == IPV6_DISABLED) {
-		clear_all_route6();
-		clear_all_addr6();
-		clear_if_neigh6(IFNAME_BR);
+		FILE *fp = ip_batch_open();
+		if (fp) {
+			fprintf(fp, "route flush scope all\n");
+			fprintf(fp, "addr flush scope global\n");
+			if (is_interface_exist(IFNAME_BR))
+				fprintf(fp, "neigh flush dev %s\n", IFNAME_BR);
+			ip_batch_run(fp, 1);
+		} else {
+			clear_all_route6();
+			clear_all_addr6();
+			clear_if_neigh6(IFNAME_BR);
+		}
 		stop_sit_tunnel();
 		reset_lan6_vars();
 		reset_wan6_vars();
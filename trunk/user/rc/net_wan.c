@@ -877,7 +877,8 @@ start_wan(void)
 			continue;
 		
 		/* bring up physical WAN interface */
-		doSystem("ifconfig %s mtu %d up %s", wan_ifname, 1500, "0.0.0.0");
+		set_interface_mtu(wan_ifname, 1500);
+		ifconfig(wan_ifname, IFUP, "0.0.0.0", NULL);
 		
 		/* perform ApCli reconnect */
 		reconnect_apcli(wan_ifname, 0);
@@ -337,6 +337,7 @@ void wan6_up(char *wan_ifname, int unit)
 {
 	int ipv6_type, allow_ra;
 	char *wan_addr6, *wan_gate6, *wan_addr4, *wan_gate4;
+	FILE *fp;
 
 	ipv6_type = get_ipv6_type();
 	if (ipv6_type == IPV6_DISABLED)
@@ -367,12 +368,25 @@ void wan6_up(char *wan_ifname, int unit)
 			wan_gate6 = get_wan_unit_value(unit, "gate6");
 			control_if_ipv6_privacy(wan_ifname, 0);
 			control_if_ipv6_radv(wan_ifname, 0);
-			clear_if_addr6(wan_ifname);
-			if (*wan_addr6)
-				doSystem("ip -6 addr add %s dev %s", wan_addr6, wan_ifname);
-			if (*wan_gate6) {
-				doSystem("ip -6 route add %s dev %s", wan_gate6, wan_ifname);
-				doSystem("ip -6 route add default via %s metric %d", wan_gate6, 1);
+			fp = ip_batch_open();
+			if (fp) {
+				if (is_interface_exist(wan_ifname))
+					fprintf(fp, "addr flush dev %s scope global\n", wan_ifname);
+				if (*wan_addr6)
+					fprintf(fp, "addr add %s dev %s\n", wan_addr6, wan_ifname);
+				if (*wan_gate6) {
+					fprintf(fp, "route add %s dev %s\n", wan_gate6, wan_ifname);
+					fprintf(fp, "route add default via %s metric %d\n", wan_gate6, 1);
+				}
+				ip_batch_run(fp, 1);
+			} else {
+				clear_if_addr6(wan_ifname);
+				if (*wan_addr6)
+					doSystem("ip -6 addr add %s dev %s", wan_addr6, wan_ifname);
+				if (*wan_gate6) {
+					doSystem("ip -6 route add %s dev %s", wan_gate6, wan_ifname);
+					doSystem("ip -6 route add default via %s metric %d", wan_gate6, 1);
+				}
 			}
 		} else {
 			doSystem("ip -6 route add default dev %s metric %d", wan_ifname, 2048);
@@ -19,6 +19,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdarg.h>
 #include <net/if_arp.h>
 #include <sys/signal.h>
 #include <sys/types.h>
@@ -1699,6 +1700,26 @@ wl_ioctl(const char *ifname, int cmd, struct iwreq *pwrq)
 	return ret;
 }
 
+/* same as "iwpriv <ifname> set Key=Value", w/o spawning iwpriv */
+int
+iwpriv_set(const char *ifname, const char *fmt, ...)
+{
+	struct iwreq wrq;
+	char buf[128];
+	va_list args;
+
+	va_start(args, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+
+	memset(&wrq, 0, sizeof(wrq));
+	wrq.u.data.pointer = (caddr_t)buf;
+	wrq.u.data.length = strlen(buf) + 1;
+	wrq.u.data.flags = 0;
+
+	return wl_ioctl(ifname, RTPRIV_IOCTL_SET, &wrq);
+}
+
 int
 get_apcli_connected(const char *ifname)
 {
@@ -33,6 +33,9 @@
 #include <sys/time.h>
 #include <sys/wait.h>
 #include <dirent.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include <rstats.h>
 #if defined (USE_STORAGE)
@@ -1020,699 +1023,1148 @@ shutdown_router(int level)
 #endif
 }
 
-void 
-handle_notifications(void)
+static void
+rce_restart_reboot(void)
 {
-	int i, stop_handle = 0;
-	char notify_name[300];
+	sys_exit();
+}
 
-	DIR *directory = opendir(DIR_RC_NOTIFY);
-	if (!directory)
-		return;
+static void
+rce_flash_firmware(void)
+{
+	flash_firmware();
+}
 
-	// handle max 10 requests at once (prevent deadlock)
-	for (i=0; i < 10; i++)
-	{
-		struct dirent *entry;
-		FILE *test_fp;
-		
-		entry = readdir(directory);
-		if (!entry)
-			break;
-		if (strcmp(entry->d_name, ".") == 0)
-			continue;
-		if (strcmp(entry->d_name, "..") == 0)
-			continue;
-		
-		/* Remove the marker file. */
-		snprintf(notify_name, sizeof(notify_name), "%s/%s", DIR_RC_NOTIFY, entry->d_name);
-		remove(notify_name);
-		
-		printf("rc notification: %s\n", entry->d_name);
-		
-		/* Take the appropriate action. */
-		if (!strcmp(entry->d_name, RCN_RESTART_REBOOT))
-		{
-			stop_handle = 1;
-			sys_exit();
-		}
-		else if (!strcmp(entry->d_name, "flash_firmware"))
-		{
-			stop_handle = 1;
-			flash_firmware();
-		}
 #if defined (USE_IPV6)
-		else if (!strcmp(entry->d_name, RCN_RESTART_IPV6))
-		{
-			if (!get_ap_mode()) {
-				full_restart_ipv6(nvram_ipv6_type);
-				nvram_ipv6_type = get_ipv6_type();
-			}
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_RADV) == 0)
-		{
-			restart_dhcpd();
-		}
+static void
+rce_restart_ipv6(void)
+{
+	if (!get_ap_mode()) {
+		full_restart_ipv6(nvram_ipv6_type);
+		nvram_ipv6_type = get_ipv6_type();
+	}
+}
+
+static void
+rce_restart_radv(void)
+{
+	restart_dhcpd();
+}
 #endif
-		else if (!strcmp(entry->d_name, RCN_RESTART_WAN))
-		{
-			full_restart_wan();
-		}
-		else if (!strcmp(entry->d_name, RCN_RESTART_LAN))
-		{
-			full_restart_lan();
-		}
-		else if (!strcmp(entry->d_name, "stop_whole_wan"))
-		{
+
+static void
+rce_restart_wan(void)
+{
+	full_restart_wan();
+}
+
+static void
+rce_restart_lan(void)
+{
+	full_restart_lan();
+}
+
+static void
+rce_stop_whole_wan(void)
+{
+	stop_wan();
+}
+
+static void
+rce_restart_iptv(void)
+{
+	int is_ap_mode = get_ap_mode();
+	restart_iptv(is_ap_mode);
+	if (!is_ap_mode)
+		restart_firewall();
+}
+
+static void
+rce_deferred_wan_connect(void)
+{
+	deferred_wan_connect();
+}
+
+static void
+rce_auto_wan_reconnect(void)
+{
+	auto_wan_reconnect();
+}
+
+static void
+rce_auto_wan_reconnect_pause(void)
+{
+	auto_wan_reconnect_pause();
+}
+
+static void
+rce_manual_wan_reconnect(void)
+{
+	manual_wan_reconnect();
+}
+
+static void
+rce_manual_wan_disconnect(void)
+{
+	manual_wan_disconnect();
+}
+
+static void
+rce_manual_wisp_reassoc(void)
+{
+	manual_wisp_reassoc();
+}
+
+static void
+rce_manual_ddns_hostname_check(void)
+{
+	manual_ddns_hostname_check();
+}
+
+#if defined (USE_USB_SUPPORT)
+static void
+rce_restart_modem(void)
+{
+	int wan_stopped = 0;
+	int modules_reloaded = 0;
+	int need_restart_wan = get_usb_modem_wan(0);
+	int modem_rule = nvram_get_int("modem_rule");
+	int modem_type = nvram_get_int("modem_type");
+	if (nvram_modem_rule != modem_rule)
+	{
+		nvram_modem_rule = modem_rule;
+		if (need_restart_wan) {
+			wan_stopped = 1;
 			stop_wan();
 		}
-		else if (!strcmp(entry->d_name, RCN_RESTART_IPTV))
-		{
-			int is_ap_mode = get_ap_mode();
-			restart_iptv(is_ap_mode);
-			if (!is_ap_mode)
-				restart_firewall();
-		}
-		else if(!strcmp(entry->d_name, "deferred_wan_connect"))
-		{
-			deferred_wan_connect();
-		}
-		else if(!strcmp(entry->d_name, "auto_wan_reconnect"))
-		{
-			auto_wan_reconnect();
-		}
-		else if(!strcmp(entry->d_name, "auto_wan_reconnect_pause"))
-		{
-			auto_wan_reconnect_pause();
-		}
-		else if(!strcmp(entry->d_name, "manual_wan_reconnect"))
-		{
-			manual_wan_reconnect();
-		}
-		else if(!strcmp(entry->d_name, "manual_wan_disconnect"))
-		{
-			manual_wan_disconnect();
-		}
-		else if(!strcmp(entry->d_name, "manual_wisp_reassoc"))
-		{
-			manual_wisp_reassoc();
+		if (modem_rule > 0) {
+			modules_reloaded = 1;
+			reload_modem_modules(modem_type, 1);
+		} else {
+			unload_modem_modules();
 		}
-		else if(!strcmp(entry->d_name, "manual_ddns_hostname_check"))
-		{
-			manual_ddns_hostname_check();
+	}
+	if (nvram_modem_type != modem_type)
+	{
+		if (nvram_modem_type == 3 || modem_type == 3) {
+			if (modem_rule > 0 && !modules_reloaded) {
+				if (need_restart_wan && !wan_stopped)
+					stop_wan();
+				reload_modem_modules(modem_type, 1);
+			}
 		}
+		nvram_modem_type = modem_type;
+	}
+	if (need_restart_wan)
+		full_restart_wan();
+}
+
+static void
+rce_restart_spooler(void)
+{
+	restart_usb_printer_spoolers();
+}
+
+static void
+rce_on_hotplug_usb_printer(void)
+{
+	// deferred run usb printer daemons
+	nvram_set_int_temp("usb_hotplug_lp", 1);
+	alarm(5);
+}
+
+static void
+rce_on_unplug_usb_printer(void)
+{
+	// deferred stop usb printer daemons
+	nvram_set_int_temp("usb_unplug_lp", 1);
+	alarm(5);
+}
+
+static void
+rce_on_hotplug_usb_modem(void)
+{
+	// deferred run usb modem to wan
+	nvram_set_int_temp("usb_hotplug_md", 1);
+	alarm(5);
+}
+
+static void
+rce_on_unplug_usb_modem(void)
+{
+	// deferred restart wan
+	nvram_set_int_temp("usb_unplug_md", 1);
+	alarm(5);
+}
+#endif
+
+#if defined (USE_STORAGE)
+static void
+rce_on_hotplug_mass_storage(void)
+{
+	// deferred run stor apps
+	nvram_set_int_temp("usb_hotplug_ms", 1);
+	alarm(5);
+}
+
+static void
+rce_on_unplug_mass_storage(void)
+{
+	umount_ejected();
+}
+
+static void
+rce_restart_hddtune(void)
+{
+	system("/sbin/hddtune.sh");
+	set_pagecache_reclaim();
+}
+
+#if defined(APP_FTPD)
+static void
+rce_restart_ftpd(void)
+{
+	restart_ftpd();
+}
+#endif
+
+#if defined(APP_SMBD)
+static void
+rce_restart_smbd(void)
+{
+	restart_smbd();
+}
+#endif
+
+#if defined(APP_NFSD)
+static void
+rce_restart_nfsd(void)
+{
+	restart_nfsd();
+}
+#endif
+
+#if defined(APP_MINIDLNA)
+static void
+rce_restart_dms_rescan(void)
+{
+	restart_dms(1);
+}
+
+static void
+rce_restart_dms(void)
+{
+	restart_dms(0);
+}
+#endif
+
+#if defined(APP_FIREFLY)
+static void
+rce_restart_itunes(void)
+{
+	restart_itunes();
+}
+#endif
+
+#if defined(APP_TRMD)
+static void
+rce_restart_trmd(void)
+{
+	restart_torrent();
+}
+#endif
+
+#if defined(APP_ARIA)
+static void
+rce_restart_aria(void)
+{
+	restart_aria();
+}
+#endif
+#endif
+
+static void
+rce_restart_httpd(void)
+{
+	restart_httpd();
+}
+
+static void
+rce_restart_telnetd(void)
+{
+	stop_telnetd();
+	start_telnetd();
+}
+
+#if defined(APP_SSHD)
+static void
+rce_restart_sshd(void)
+{
+	restart_sshd();
+}
+#endif
+
+#if defined(APP_SCUT)
+static void
+rce_restart_scut(void)
+{
+	restart_scutclient();
+}
+
+static void
+rce_stop_scutclient(void)
+{
+	stop_scutclient();
+}
+#endif
+
+#if defined(APP_MENTOHUST)
+static void
+rce_restart_mentohust(void)
+{
+	restart_mentohust();
+}
+
+static void
+rce_stop_mentohust(void)
+{
+	stop_mentohust();
+}
+#endif
+
+#if defined(APP_TTYD)
+static void
+rce_restart_ttyd(void)
+{
+	restart_ttyd();
+}
+#endif
+
+#if defined(APP_SHADOWSOCKS)
+static void
+rce_restart_shadowsocks(void)
+{
+	restart_ss();
+}
+
+static void
+rce_restart_ss_tunnel(void)
+{
+	restart_ss_tunnel();
+}
+
+static void
+rce_restart_chnroute_upd(void)
+{
+	update_chnroute();
+}
+
+static void
+rce_restart_gfwlist_upd(void)
+{
+	update_gfwlist();
+}
+
+static void
+rce_restart_dlink(void)
+{
+	update_dlink();
+}
+
+static void
+rce_restart_redlink(void)
+{
+	reset_dlink();
+}
+#endif
+
+#if defined(APP_VLMCSD)
+static void
+rce_restart_vlmcsd(void)
+{
+	restart_vlmcsd();
+}
+#endif
+
+#if defined(APP_WYY)
+static void
+rce_restart_wyy(void)
+{
+	restart_wyy();
+}
+#endif
+
+#if defined(APP_ZEROTIER)
+static void
+rce_restart_zerotier(void)
+{
+	restart_zerotier();
+}
+#endif
+
+#if defined(APP_DDNSTO)
+static void
+rce_restart_ddnsto(void)
+{
+	restart_ddnsto();
+}
+#endif
+
+#if defined(APP_NATPIERCE)
+static void
+rce_restart_natpierce(void)
+{
+	restart_natpierce();
+}
+#endif
+
+#if defined(APP_KOOLPROXY)
+static void
+rce_restart_koolproxy(void)
+{
+	restart_koolproxy();
+}
+
+static void
+rce_restart_kpupdate(void)
+{
+	update_kp();
+}
+#endif
+
+#if defined(APP_ADBYBY)
+static void
+rce_restart_adbyby(void)
+{
+	restart_adbyby();
+}
+
+static void
+rce_restart_updateadb(void)
+{
+	update_adb();
+}
+#endif
+
+#if defined(APP_ADGUARDHOME)
+static void
+rce_restart_adguardhome(void)
+{
+	restart_adguardhome();
+}
+#endif
+
+#if defined(APP_SMARTDNS)
+static void
+rce_restart_smartdns(void)
+{
+	restart_smartdns();
+}
+#endif
+
+#if defined(APP_FRP)
+static void
+rce_restart_frp(void)
+{
+	restart_frp();
+}
+#endif
+
+#if defined(APP_BAFA)
+static void
+rce_restart_bafa(void)
+{
+	restart_bafa();
+}
+#endif
+
+#if defined(APP_VIRTUALHERE)
+static void
+rce_restart_virtualhere(void)
+{
+	restart_virtualhere();
+}
+#endif
+
+#if defined(APP_V2RAYA)
+static void
+rce_restart_v2raya(void)
+{
+	restart_v2raya();
+}
+#endif
+
+#if defined(APP_VNTS)
+static void
+rce_restart_vnts(void)
+{
+	restart_vnts();
+}
+#endif
+
+#if defined(APP_VNTCLI)
+static void
+rce_restart_vntcli(void)
+{
+	restart_vntcli();
+}
+#endif
+
+#if defined(APP_LUCKY)
+static void
+rce_restart_lucky(void)
+{
+	restart_lucky();
+}
+#endif
+
+#if defined(APP_ALIST)
+static void
+rce_restart_alist(void)
+{
+	restart_alist();
+}
+#endif
+
+#if defined(APP_TAILSCALE)
+static void
+rce_restart_tailscale(void)
+{
+	restart_tailscale();
+}
+#endif
+
+#if defined(APP_EASYTIER)
+static void
+rce_restart_easytier(void)
+{
+	restart_easytier();
+}
+#endif
+
+#if defined(APP_CLOUDFLARED)
+static void
+rce_restart_cloudflared(void)
+{
+	restart_cloudflared();
+}
+#endif
+
+#if defined(APP_WXSEND)
+static void
+rce_restart_wxsend(void)
+{
+	restart_wxsend();
+}
+#endif
+
+#if defined(APP_CADDY)
+static void
+rce_restart_caddy(void)
+{
+	restart_caddy();
+}
+#endif
+
+#if defined(APP_ALIDDNS)
+static void
+rce_restart_aliddns(void)
+{
+	restart_aliddns();
+}
+#endif
+
+#if defined(APP_CLOUDFLARE)
+static void
+rce_restart_cloudflare(void)
+{
+	restart_cloudflare();
+}
+#endif
+
+#if defined(APP_DNSFORWARDER)
+static void
+rce_restart_dnsforwarder(void)
+{
+	restart_dnsforwarder();
+}
+#endif
+
+#if defined(APP_NVPPROXY)
+static void
+rce_restart_nvpproxy(void)
+{
+	restart_nvpproxy();
+}
+#endif
+
+#if defined(APP_WIREGUARD)
+static void
+rce_restart_wireguard(void)
+{
+	restart_wireguard();
+}
+#endif
+
+#if defined(APP_ALDRIVER)
+static void
+rce_restart_aldriver(void)
+{
+	restart_aldriver();
+}
+#endif
+
+#if defined(APP_UUPLUGIN)
+static void
+rce_restart_uuplugin(void)
+{
+	restart_uuplugin();
+}
+#endif
+
+#if defined(APP_SMBD) || defined(APP_NMBD)
+static void
+rce_restart_nmbd(void)
+{
+	restart_nmbd();
+}
+
+static void
+rce_restart_wins(void)
+{
+	restart_nmbd();
+	restart_dhcpd();
+	reapply_vpn_server();
+}
+#endif
+
+static void
+rce_restart_lltd(void)
+{
+	restart_lltd();
+}
+
+static void
+rce_restart_adsc(void)
+{
+	restart_infosvr();
+}
+
+static void
+rce_restart_crond(void)
+{
+	restart_crond();
+}
+
+static void
+rce_reapply_vpnsvr(void)
+{
+	reapply_vpn_server();
+}
+
+static void
+rce_restart_vpnsvr(void)
+{
+	restart_vpn_server();
+}
+
+static void
+rce_restart_vpncli(void)
+{
+	restart_vpn_client();
+}
+
+static void
+rce_start_vpn_client(void)
+{
+	start_vpn_client();
+}
+
+static void
+rce_stop_vpn_client(void)
+{
+	stop_vpn_client();
+}
+
+static void
+rce_restart_ddns(void)
+{
+	stop_ddns();
+	start_ddns(1);
+}
+
+static void
+rce_restart_di(void)
+{
+	if (get_ap_mode() || has_wan_ip4(0))
+		notify_run_detect_internet(2);
+}
+
+static void
+rce_restart_dhcpd(void)
+{
+	if (get_ap_mode())
+		update_hosts_ap();
+	restart_dhcpd();
+}
+
+static void
+rce_restart_upnp(void)
+{
+	restart_upnp();
+}
+
+static void
+rce_restart_switch_cfg(void)
+{
+	config_bridge(get_ap_mode());
+	switch_config_base();
+	switch_config_storm();
+	switch_config_link();
+}
+
+static void
+rce_restart_switch_vlan(void)
+{
+	restart_switch_config_vlan();
+}
+
+static void
+rce_restart_syslog(void)
+{
+	stop_logger();
+	start_logger(0);
+}
+
+static void
+rce_restart_wdg(void)
+{
+	restart_watchdog_cpu();
+}
+
+static void
+rce_restart_tweaks(void)
+{
+	notify_leds_detect_link();
+}
+
+static void
+rce_restart_netfilter(void)
+{
+	update_router_mode();
+	reload_nat_modules();
+	restart_firewall();
+	flush_conntrack_table(NULL);
+}
+
+static void
+rce_restart_firewall(void)
+{
+	reload_nat_modules();
+	restart_firewall();
+}
+
+static void
+rce_restart_firewall_wan(void)
+{
+	restart_firewall();
+}
+
+static void
+rce_restart_ntpc(void)
+{
+	notify_watchdog_time();
+}
+
+static void
+rce_restart_time(void)
+{
+	stop_logger();
+	set_timezone();
+	notify_watchdog_time();
+	notify_rstats_time();
+	start_logger(0);
+	restart_crond();
+}
+
+static void
+rce_restart_sysctl(void)
+{
+	int nf_nat_type = nvram_get_int("nf_nat_type");
+	
+	restart_all_sysctl();
+	
+	/* flush conntrack after NAT model changing */
+	if (nvram_nf_nat_type != nf_nat_type) {
+		nvram_nf_nat_type = nf_nat_type;
+		flush_conntrack_table(NULL);
+	}
+}
+
+static void
+rce_restart_wifi5(void)
+{
+	int radio_on = get_enabled_radio_wl();
+	if (radio_on)
+		radio_on = is_radio_allowed_wl();
+	restart_wifi_wl(radio_on, 1);
+}
+
+static void
+rce_restart_wifi2(void)
+{
+	int radio_on = get_enabled_radio_rt();
+	if (radio_on)
+		radio_on = is_radio_allowed_rt();
+	restart_wifi_rt(radio_on, 1);
+}
+
+static void
+rce_control_wifi_guest_wl(void)
+{
+	int guest_on = is_guest_allowed_wl();
+	control_guest_wl(guest_on, 1);
+}
+
+static void
+rce_control_wifi_guest_rt(void)
+{
+	int guest_on = is_guest_allowed_rt();
+	control_guest_rt(guest_on, 1);
+}
+
+static void
+rce_control_wifi_guest_wl_on(void)
+{
+	control_guest_wl(1, 0);
+}
+
+static void
+rce_control_wifi_guest_wl_off(void)
+{
+	control_guest_wl(0, 0);
+}
+
+static void
+rce_control_wifi_guest_rt_on(void)
+{
+	control_guest_rt(1, 0);
+}
+
+static void
+rce_control_wifi_guest_rt_off(void)
+{
+	control_guest_rt(0, 0);
+}
+
+static void
+rce_control_wifi_radio_wl(void)
+{
+	int radio_on = get_enabled_radio_wl();
+	if (radio_on)
+		radio_on = is_radio_allowed_wl();
+	control_radio_wl(radio_on, 1);
+}
+
+static void
+rce_control_wifi_radio_rt(void)
+{
+	int radio_on = get_enabled_radio_rt();
+	if (radio_on)
+		radio_on = is_radio_allowed_rt();
+	control_radio_rt(radio_on, 1);
+}
+
+static void
+rce_control_wifi_radio_wl_on(void)
+{
+	control_radio_wl(1, 0);
+}
+
+static void
+rce_control_wifi_radio_wl_off(void)
+{
+	control_radio_wl(0, 0);
+}
+
+static void
+rce_control_wifi_radio_rt_on(void)
+{
+	control_radio_rt(1, 0);
+}
+
+static void
+rce_control_wifi_radio_rt_off(void)
+{
+	control_radio_rt(0, 0);
+}
+
+static void
+rce_control_wifi_config_wl(void)
+{
+	gen_ralink_config_5g(0);
+}
+
+static void
+rce_control_wifi_config_rt(void)
+{
+	gen_ralink_config_2g(0);
+}
+
+static const rc_event_t rc_events[] = {
+	{ RCN_RESTART_REBOOT, rce_restart_reboot, RCE_STOP },
+	{ "flash_firmware", rce_flash_firmware, RCE_STOP },
+#if defined (USE_IPV6)
+	{ RCN_RESTART_IPV6, rce_restart_ipv6, 0 },
+	{ RCN_RESTART_RADV, rce_restart_radv, 0 },
+#endif
+	{ RCN_RESTART_WAN, rce_restart_wan, 0 },
+	{ RCN_RESTART_LAN, rce_restart_lan, 0 },
+	{ "stop_whole_wan", rce_stop_whole_wan, 0 },
+	{ RCN_RESTART_IPTV, rce_restart_iptv, 0 },
+	{ "deferred_wan_connect", rce_deferred_wan_connect, 0 },
+	{ "auto_wan_reconnect", rce_auto_wan_reconnect, 0 },
+	{ "auto_wan_reconnect_pause", rce_auto_wan_reconnect_pause, 0 },
+	{ "manual_wan_reconnect", rce_manual_wan_reconnect, 0 },
+	{ "manual_wan_disconnect", rce_manual_wan_disconnect, 0 },
+	{ "manual_wisp_reassoc", rce_manual_wisp_reassoc, 0 },
+	{ "manual_ddns_hostname_check", rce_manual_ddns_hostname_check, 0 },
 #if defined (USE_USB_SUPPORT)
-		else if (!strcmp(entry->d_name, RCN_RESTART_MODEM))
-		{
-			int wan_stopped = 0;
-			int modules_reloaded = 0;
-			int need_restart_wan = get_usb_modem_wan(0);
-			int modem_rule = nvram_get_int("modem_rule");
-			int modem_type = nvram_get_int("modem_type");
-			if (nvram_modem_rule != modem_rule)
-			{
-				nvram_modem_rule = modem_rule;
-				if (need_restart_wan) {
-					wan_stopped = 1;
-					stop_wan();
-				}
-				if (modem_rule > 0) {
-					modules_reloaded = 1;
-					reload_modem_modules(modem_type, 1);
-				} else {
-					unload_modem_modules();
-				}
-			}
-			if (nvram_modem_type != modem_type)
-			{
-				if (nvram_modem_type == 3 || modem_type == 3) {
-					if (modem_rule > 0 && !modules_reloaded) {
-						if (need_restart_wan && !wan_stopped)
-							stop_wan();
-						reload_modem_modules(modem_type, 1);
-					}
-				}
-				nvram_modem_type = modem_type;
-			}
-			if (need_restart_wan)
-				full_restart_wan();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_SPOOLER) == 0)
-		{
-			restart_usb_printer_spoolers();
-		}
-		else if (!strcmp(entry->d_name, "on_hotplug_usb_printer"))
-		{
-			// deferred run usb printer daemons
-			nvram_set_int_temp("usb_hotplug_lp", 1);
-			alarm(5);
-		}
-		else if (!strcmp(entry->d_name, "on_unplug_usb_printer"))
-		{
-			// deferred stop usb printer daemons
-			nvram_set_int_temp("usb_unplug_lp", 1);
-			alarm(5);
-		}
-		else if (!strcmp(entry->d_name, "on_hotplug_usb_modem"))
-		{
-			// deferred run usb modem to wan
-			nvram_set_int_temp("usb_hotplug_md", 1);
-			alarm(5);
-		}
-		else if (!strcmp(entry->d_name, "on_unplug_usb_modem"))
-		{
-			// deferred restart wan
-			nvram_set_int_temp("usb_unplug_md", 1);
-			alarm(5);
-		}
+	{ RCN_RESTART_MODEM, rce_restart_modem, 0 },
+	{ RCN_RESTART_SPOOLER, rce_restart_spooler, 0 },
+	{ "on_hotplug_usb_printer", rce_on_hotplug_usb_printer, 0 },
+	{ "on_unplug_usb_printer", rce_on_unplug_usb_printer, 0 },
+	{ "on_hotplug_usb_modem", rce_on_hotplug_usb_modem, 0 },
+	{ "on_unplug_usb_modem", rce_on_unplug_usb_modem, 0 },
 #endif
 #if defined (USE_STORAGE)
-		else if (!strcmp(entry->d_name, "on_hotplug_mass_storage"))
-		{
-			// deferred run stor apps
-			nvram_set_int_temp("usb_hotplug_ms", 1);
-			alarm(5);
-		}
-		else if (!strcmp(entry->d_name, "on_unplug_mass_storage"))
-		{
-			umount_ejected();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_HDDTUNE) == 0)
-		{
-			system("/sbin/hddtune.sh");
-			set_pagecache_reclaim();
-		}
+	{ "on_hotplug_mass_storage", rce_on_hotplug_mass_storage, 0 },
+	{ "on_unplug_mass_storage", rce_on_unplug_mass_storage, 0 },
+	{ RCN_RESTART_HDDTUNE, rce_restart_hddtune, 0 },
 #if defined(APP_FTPD)
-		else if (strcmp(entry->d_name, RCN_RESTART_FTPD) == 0)
-		{
-			restart_ftpd();
-		}
+	{ RCN_RESTART_FTPD, rce_restart_ftpd, 0 },
 #endif
 #if defined(APP_SMBD)
-		else if (strcmp(entry->d_name, RCN_RESTART_SMBD) == 0)
-		{
-			restart_smbd();
-		}
+	{ RCN_RESTART_SMBD, rce_restart_smbd, 0 },
 #endif
 #if defined(APP_NFSD)
-		else if (strcmp(entry->d_name, RCN_RESTART_NFSD) == 0)
-		{
-			restart_nfsd();
-		}
+	{ RCN_RESTART_NFSD, rce_restart_nfsd, 0 },
 #endif
 #if defined(APP_MINIDLNA)
-		else if (strcmp(entry->d_name, "restart_dms_rescan") == 0)
-		{
-			restart_dms(1);
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_DMS) == 0)
-		{
-			restart_dms(0);
-		}
+	{ "restart_dms_rescan", rce_restart_dms_rescan, 0 },
+	{ RCN_RESTART_DMS, rce_restart_dms, 0 },
 #endif
 #if defined(APP_FIREFLY)
-		else if (strcmp(entry->d_name, RCN_RESTART_ITUNES) == 0)
-		{
-			restart_itunes();
-		}
+	{ RCN_RESTART_ITUNES, rce_restart_itunes, 0 },
 #endif
 #if defined(APP_TRMD)
-		else if (strcmp(entry->d_name, RCN_RESTART_TRMD) == 0)
-		{
-			restart_torrent();
-		}
+	{ RCN_RESTART_TRMD, rce_restart_trmd, 0 },
 #endif
 #if defined(APP_ARIA)
-		else if (strcmp(entry->d_name, RCN_RESTART_ARIA) == 0)
-		{
-			restart_aria();
-		}
+	{ RCN_RESTART_ARIA, rce_restart_aria, 0 },
 #endif
 #endif
-		else if (strcmp(entry->d_name, RCN_RESTART_HTTPD) == 0)
-		{
-			restart_httpd();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_TELNETD) == 0)
-		{
-			stop_telnetd();
-			start_telnetd();
-		}
+	{ RCN_RESTART_HTTPD, rce_restart_httpd, 0 },
+	{ RCN_RESTART_TELNETD, rce_restart_telnetd, 0 },
 #if defined(APP_SSHD)
-		else if (strcmp(entry->d_name, RCN_RESTART_SSHD) == 0)
-		{
-			restart_sshd();
-		}
+	{ RCN_RESTART_SSHD, rce_restart_sshd, 0 },
 #endif
 #if defined(APP_SCUT)
-		else if (strcmp(entry->d_name, RCN_RESTART_SCUT) == 0)
-		{
-			restart_scutclient();
-		}
-		else if (strcmp(entry->d_name, "stop_scutclient") == 0)
-		{
-			stop_scutclient();
-		}
+	{ RCN_RESTART_SCUT, rce_restart_scut, 0 },
+	{ "stop_scutclient", rce_stop_scutclient, 0 },
 #endif
 #if defined(APP_MENTOHUST)
-		else if (strcmp(entry->d_name, RCN_RESTART_MENTOHUST) == 0)
-		{
-			restart_mentohust();
-		}
-		else if (strcmp(entry->d_name, "stop_mentohust") == 0)
-		{
-			stop_mentohust();
-		}
+	{ RCN_RESTART_MENTOHUST, rce_restart_mentohust, 0 },
+	{ "stop_mentohust", rce_stop_mentohust, 0 },
 #endif
 #if defined(APP_TTYD)
-		else if (strcmp(entry->d_name, RCN_RESTART_TTYD) == 0)
-		{
-			restart_ttyd();
-		}
+	{ RCN_RESTART_TTYD, rce_restart_ttyd, 0 },
 #endif
 #if defined(APP_SHADOWSOCKS)
-		else if (strcmp(entry->d_name, RCN_RESTART_SHADOWSOCKS) == 0)
-		{
-			restart_ss();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_SS_TUNNEL) == 0)
-		{
-			restart_ss_tunnel();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_CHNROUTE_UPD) == 0)
-		{
-			update_chnroute();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_GFWLIST_UPD) == 0)
-		{
-			update_gfwlist();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_DLINK) == 0)
-		{
-			update_dlink();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_REDLINK) == 0)
-		{
-			reset_dlink();
-		}
+	{ RCN_RESTART_SHADOWSOCKS, rce_restart_shadowsocks, 0 },
+	{ RCN_RESTART_SS_TUNNEL, rce_restart_ss_tunnel, 0 },
+	{ RCN_RESTART_CHNROUTE_UPD, rce_restart_chnroute_upd, 0 },
+	{ RCN_RESTART_GFWLIST_UPD, rce_restart_gfwlist_upd, 0 },
+	{ RCN_RESTART_DLINK, rce_restart_dlink, 0 },
+	{ RCN_RESTART_REDLINK, rce_restart_redlink, 0 },
 #endif
 #if defined(APP_VLMCSD)
-		else if (strcmp(entry->d_name, RCN_RESTART_VLMCSD) == 0)
-		{
-			restart_vlmcsd();
-		}
+	{ RCN_RESTART_VLMCSD, rce_restart_vlmcsd, 0 },
 #endif
 #if defined(APP_WYY)
-		else if (strcmp(entry->d_name, RCN_RESTART_WYY) == 0)
-		{
-			restart_wyy();
-		}
+	{ RCN_RESTART_WYY, rce_restart_wyy, 0 },
 #endif
 #if defined(APP_ZEROTIER)
-		else if (strcmp(entry->d_name, RCN_RESTART_ZEROTIER) == 0)
-		{
-			restart_zerotier();
-		}
+	{ RCN_RESTART_ZEROTIER, rce_restart_zerotier, 0 },
 #endif
 #if defined(APP_DDNSTO)
-		else if (strcmp(entry->d_name, RCN_RESTART_DDNSTO) == 0)
-		{
-			restart_ddnsto();
-		}
+	{ RCN_RESTART_DDNSTO, rce_restart_ddnsto, 0 },
 #endif
 #if defined(APP_NATPIERCE)
-		else if (strcmp(entry->d_name, RCN_RESTART_NATPIERCE) == 0)
-		{
-			restart_natpierce();
-		}
+	{ RCN_RESTART_NATPIERCE, rce_restart_natpierce, 0 },
 #endif
 #if defined(APP_KOOLPROXY)
-		else if (strcmp(entry->d_name, RCN_RESTART_KOOLPROXY) == 0)
-		{
-			restart_koolproxy();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_KPUPDATE) == 0)
-		{
-			update_kp();
-		}
+	{ RCN_RESTART_KOOLPROXY, rce_restart_koolproxy, 0 },
+	{ RCN_RESTART_KPUPDATE, rce_restart_kpupdate, 0 },
 #endif
 #if defined(APP_ADBYBY)
-		else if (strcmp(entry->d_name, RCN_RESTART_ADBYBY) == 0)
-		{
-			restart_adbyby();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_UPDATEADB) == 0)
-		{
-			update_adb();
-		}
+	{ RCN_RESTART_ADBYBY, rce_restart_adbyby, 0 },
+	{ RCN_RESTART_UPDATEADB, rce_restart_updateadb, 0 },
 #endif
 #if defined(APP_ADGUARDHOME)
-		else if (strcmp(entry->d_name, RCN_RESTART_ADGUARDHOME) == 0)
-		{
-			restart_adguardhome();
-		}
+	{ RCN_RESTART_ADGUARDHOME, rce_restart_adguardhome, 0 },
 #endif
 #if defined(APP_SMARTDNS)
-		else if (strcmp(entry->d_name, RCN_RESTART_SMARTDNS) == 0)
-		{
-			restart_smartdns();
-		}
+	{ RCN_RESTART_SMARTDNS, rce_restart_smartdns, 0 },
 #endif
 #if defined(APP_FRP)
-		else if (strcmp(entry->d_name, RCN_RESTART_FRP) == 0)
-		{
-			restart_frp();
-		}
+	{ RCN_RESTART_FRP, rce_restart_frp, 0 },
 #endif
 #if defined(APP_BAFA)
-		else if (strcmp(entry->d_name, RCN_RESTART_BAFA) == 0)
-		{
-			restart_bafa();
-		}
+	{ RCN_RESTART_BAFA, rce_restart_bafa, 0 },
 #endif
 #if defined(APP_VIRTUALHERE)
-		else if (strcmp(entry->d_name, RCN_RESTART_VIRTUALHERE) == 0)
-		{
-			restart_virtualhere();
-		}
+	{ RCN_RESTART_VIRTUALHERE, rce_restart_virtualhere, 0 },
 #endif
 #if defined(APP_V2RAYA)
-		else if (strcmp(entry->d_name, RCN_RESTART_V2RAYA) == 0)
-		{
-			restart_v2raya();
-		}
+	{ RCN_RESTART_V2RAYA, rce_restart_v2raya, 0 },
 #endif
 #if defined(APP_VNTS)
-		else if (strcmp(entry->d_name, RCN_RESTART_VNTS) == 0)
-		{
-			restart_vnts();
-		}
+	{ RCN_RESTART_VNTS, rce_restart_vnts, 0 },
 #endif
 #if defined(APP_VNTCLI)
-		else if (strcmp(entry->d_name, RCN_RESTART_VNTCLI) == 0)
-		{
-			restart_vntcli();
-		}
+	{ RCN_RESTART_VNTCLI, rce_restart_vntcli, 0 },
 #endif
-/*#if defined(APP_NPC)
-		else if (strcmp(entry->d_name, RCN_RESTART_NPC) == 0)
-		{
-			restart_npc();
-		}
-#endif*/
 #if defined(APP_LUCKY)
-		else if (strcmp(entry->d_name, RCN_RESTART_LUCKY) == 0)
-		{
-			restart_lucky();
-		}
+	{ RCN_RESTART_LUCKY, rce_restart_lucky, 0 },
 #endif
 #if defined(APP_ALIST)
-		else if (strcmp(entry->d_name, RCN_RESTART_ALIST) == 0)
-		{
-			restart_alist();
-		}
+	{ RCN_RESTART_ALIST, rce_restart_alist, 0 },
 #endif
 #if defined(APP_TAILSCALE)
-		else if (strcmp(entry->d_name, RCN_RESTART_TAILSCALE) == 0)
-		{
-			restart_tailscale();
-		}
+	{ RCN_RESTART_TAILSCALE, rce_restart_tailscale, 0 },
 #endif
 #if defined(APP_EASYTIER)
-		else if (strcmp(entry->d_name, RCN_RESTART_EASYTIER) == 0)
-		{
-			restart_easytier();
-		}
+	{ RCN_RESTART_EASYTIER, rce_restart_easytier, 0 },
 #endif
 #if defined(APP_CLOUDFLARED)
-		else if (strcmp(entry->d_name, RCN_RESTART_CLOUDFLARED) == 0)
-		{
-			restart_cloudflared();
-		}
+	{ RCN_RESTART_CLOUDFLARED, rce_restart_cloudflared, 0 },
 #endif
 #if defined(APP_WXSEND)
-		else if (strcmp(entry->d_name, RCN_RESTART_WXSEND) == 0)
-		{
-			restart_wxsend();
-		}
+	{ RCN_RESTART_WXSEND, rce_restart_wxsend, 0 },
 #endif
 #if defined(APP_CADDY)
-		else if (strcmp(entry->d_name, RCN_RESTART_CADDY) == 0)
-		{
-			restart_caddy();
-		}
+	{ RCN_RESTART_CADDY, rce_restart_caddy, 0 },
 #endif
 #if defined(APP_ALIDDNS)
-		else if (strcmp(entry->d_name, RCN_RESTART_ALIDDNS) == 0)
-		{
-			restart_aliddns();
-		}
+	{ RCN_RESTART_ALIDDNS, rce_restart_aliddns, 0 },
 #endif
 #if defined(APP_CLOUDFLARE)
-		else if (strcmp(entry->d_name, RCN_RESTART_CLOUDFLARE) == 0)
-		{
-			restart_cloudflare();
-		}
+	{ RCN_RESTART_CLOUDFLARE, rce_restart_cloudflare, 0 },
 #endif
 #if defined(APP_DNSFORWARDER)
-		else if (strcmp(entry->d_name, RCN_RESTART_DNSFORWARDER) == 0)
-		{
-			restart_dnsforwarder();
-		}
+	{ RCN_RESTART_DNSFORWARDER, rce_restart_dnsforwarder, 0 },
 #endif
 #if defined(APP_NVPPROXY)
-		else if (strcmp(entry->d_name, RCN_RESTART_NVPPROXY) == 0)
-		{
-			restart_nvpproxy();
-		}
+	{ RCN_RESTART_NVPPROXY, rce_restart_nvpproxy, 0 },
 #endif
 #if defined(APP_WIREGUARD)
-		else if (strcmp(entry->d_name, RCN_RESTART_WIREGUARD) == 0)
-		{
-			restart_wireguard();
-		}
+	{ RCN_RESTART_WIREGUARD, rce_restart_wireguard, 0 },
 #endif
 #if defined(APP_ALDRIVER)
-		else if (strcmp(entry->d_name, RCN_RESTART_ALDRIVER) == 0)
-		{
-			restart_aldriver();
-		}
+	{ RCN_RESTART_ALDRIVER, rce_restart_aldriver, 0 },
 #endif
 #if defined(APP_UUPLUGIN)
-		else if (strcmp(entry->d_name, RCN_RESTART_UUPLUGIN) == 0)
-		{
-			restart_uuplugin();
-		}
+	{ RCN_RESTART_UUPLUGIN, rce_restart_uuplugin, 0 },
 #endif
 #if defined(APP_SMBD) || defined(APP_NMBD)
-		else if (strcmp(entry->d_name, RCN_RESTART_NMBD) == 0)
-		{
-			restart_nmbd();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_WINS) == 0)
-		{
-			restart_nmbd();
-			restart_dhcpd();
-			reapply_vpn_server();
-		}
-#endif
-		else if (strcmp(entry->d_name, RCN_RESTART_LLTD) == 0)
-		{
-			restart_lltd();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_ADSC) == 0)
-		{
-			restart_infosvr();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_CROND) == 0)
-		{
-			restart_crond();
-		}
-		else if (strcmp(entry->d_name, RCN_REAPPLY_VPNSVR) == 0)
-		{
-			reapply_vpn_server();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_VPNSVR) == 0)
-		{
-			restart_vpn_server();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_VPNCLI) == 0)
-		{
-			restart_vpn_client();
-		}
-		else if (strcmp(entry->d_name, "start_vpn_client") == 0)
-		{
-			start_vpn_client();
-		}
-		else if (strcmp(entry->d_name, "stop_vpn_client") == 0)
-		{
-			stop_vpn_client();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_DDNS) == 0)
-		{
-			stop_ddns();
-			start_ddns(1);
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_DI) == 0)
-		{
-			if (get_ap_mode() || has_wan_ip4(0))
-				notify_run_detect_internet(2);
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_DHCPD) == 0)
-		{
-			if (get_ap_mode())
-				update_hosts_ap();
-			restart_dhcpd();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_UPNP) == 0)
-		{
-			restart_upnp();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_SWITCH_CFG) == 0)
-		{
-			config_bridge(get_ap_mode());
-			switch_config_base();
-			switch_config_storm();
-			switch_config_link();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_SWITCH_VLAN) == 0)
-		{
-			restart_switch_config_vlan();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_SYSLOG) == 0)
-		{
-			stop_logger();
-			start_logger(0);
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_WDG) == 0)
-		{
-			restart_watchdog_cpu();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_TWEAKS) == 0)
-		{
-			notify_leds_detect_link();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_NETFILTER) == 0)
-		{
-			update_router_mode();
-			reload_nat_modules();
-			restart_firewall();
-			flush_conntrack_table(NULL);
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_FIREWALL) == 0)
-		{
-			reload_nat_modules();
-			restart_firewall();
-		}
-		else if (strcmp(entry->d_name, "restart_firewall_wan") == 0)
-		{
-			restart_firewall();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_NTPC) == 0)
-		{
-			notify_watchdog_time();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_TIME) == 0)
-		{
-			stop_logger();
-			set_timezone();
-			notify_watchdog_time();
-			notify_rstats_time();
-			start_logger(0);
-			restart_crond();
-		}
-		else if (strcmp(entry->d_name, RCN_RESTART_SYSCTL) == 0)
-		{
-			int nf_nat_type = nvram_get_int("nf_nat_type");
-			
-			restart_all_sysctl();
-			
-			/* flush conntrack after NAT model changing */
-			if (nvram_nf_nat_type != nf_nat_type) {
-				nvram_nf_nat_type = nf_nat_type;
-				flush_conntrack_table(NULL);
-			}
-		}
-		else if (!strcmp(entry->d_name, RCN_RESTART_WIFI5))
-		{
-			int radio_on = get_enabled_radio_wl();
-			if (radio_on)
-				radio_on = is_radio_allowed_wl();
-			restart_wifi_wl(radio_on, 1);
-		}
-		else if (!strcmp(entry->d_name, RCN_RESTART_WIFI2))
-		{
-			int radio_on = get_enabled_radio_rt();
-			if (radio_on)
-				radio_on = is_radio_allowed_rt();
-			restart_wifi_rt(radio_on, 1);
-		}
-		else if (!strcmp(entry->d_name, "control_wifi_guest_wl"))
-		{
-			int guest_on = is_guest_allowed_wl();
-			control_guest_wl(guest_on, 1);
-		}
-		else if (!strcmp(entry->d_name, "control_wifi_guest_rt"))
-		{
-			int guest_on = is_guest_allowed_rt();
-			control_guest_rt(guest_on, 1);
-		}
-		else if (!strcmp(entry->d_name, "control_wifi_guest_wl_on"))
-		{
-			control_guest_wl(1, 0);
-		}
-		else if (!strcmp(entry->d_name, "control_wifi_guest_wl_off"))
-		{
-			control_guest_wl(0, 0);
-		}
-		else if (!strcmp(entry->d_name, "control_wifi_guest_rt_on"))
-		{
-			control_guest_rt(1, 0);
-		}
-		else if (!strcmp(entry->d_name, "control_wifi_guest_rt_off"))
-		{
-			control_guest_rt(0, 0);
-		}
-		else if (!strcmp(entry->d_name, "control_wifi_radio_wl"))
-		{
-			int radio_on = get_enabled_radio_wl();
-			if (radio_on)
-				radio_on = is_radio_allowed_wl();
-			control_radio_wl(radio_on, 1);
-		}
-		else if (!strcmp(entry->d_name, "control_wifi_radio_rt"))
-		{
-			int radio_on = get_enabled_radio_rt();
-			if (radio_on)
-				radio_on = is_radio_allowed_rt();
-			control_radio_rt(radio_on, 1);
-		}
-		else if (!strcmp(entry->d_name, "control_wifi_radio_wl_on"))
-		{
-			control_radio_wl(1, 0);
-		}
-		else if (!strcmp(entry->d_name, "control_wifi_radio_wl_off"))
-		{
-			control_radio_wl(0, 0);
-		}
-		else if (!strcmp(entry->d_name, "control_wifi_radio_rt_on"))
-		{
-			control_radio_rt(1, 0);
-		}
-		else if (!strcmp(entry->d_name, "control_wifi_radio_rt_off"))
-		{
-			control_radio_rt(0, 0);
-		}
-		else if (!strcmp(entry->d_name, "control_wifi_config_wl"))
-		{
-			gen_ralink_config_5g(0);
-		}
-		else if (!strcmp(entry->d_name, "control_wifi_config_rt"))
-		{
-			gen_ralink_config_2g(0);
-		}
-		else
-		{
+	{ RCN_RESTART_NMBD, rce_restart_nmbd, 0 },
+	{ RCN_RESTART_WINS, rce_restart_wins, 0 },
+#endif
+	{ RCN_RESTART_LLTD, rce_restart_lltd, 0 },
+	{ RCN_RESTART_ADSC, rce_restart_adsc, 0 },
+	{ RCN_RESTART_CROND, rce_restart_crond, 0 },
+	{ RCN_REAPPLY_VPNSVR, rce_reapply_vpnsvr, 0 },
+	{ RCN_RESTART_VPNSVR, rce_restart_vpnsvr, 0 },
+	{ RCN_RESTART_VPNCLI, rce_restart_vpncli, 0 },
+	{ "start_vpn_client", rce_start_vpn_client, 0 },
+	{ "stop_vpn_client", rce_stop_vpn_client, 0 },
+	{ RCN_RESTART_DDNS, rce_restart_ddns, 0 },
+	{ RCN_RESTART_DI, rce_restart_di, 0 },
+	{ RCN_RESTART_DHCPD, rce_restart_dhcpd, 0 },
+	{ RCN_RESTART_UPNP, rce_restart_upnp, 0 },
+	{ RCN_RESTART_SWITCH_CFG, rce_restart_switch_cfg, 0 },
+	{ RCN_RESTART_SWITCH_VLAN, rce_restart_switch_vlan, 0 },
+	{ RCN_RESTART_SYSLOG, rce_restart_syslog, 0 },
+	{ RCN_RESTART_WDG, rce_restart_wdg, 0 },
+	{ RCN_RESTART_TWEAKS, rce_restart_tweaks, 0 },
+	{ RCN_RESTART_NETFILTER, rce_restart_netfilter, 0 },
+	{ RCN_RESTART_FIREWALL, rce_restart_firewall, 0 },
+	{ "restart_firewall_wan", rce_restart_firewall_wan, 0 },
+	{ RCN_RESTART_NTPC, rce_restart_ntpc, 0 },
+	{ RCN_RESTART_TIME, rce_restart_time, 0 },
+	{ RCN_RESTART_SYSCTL, rce_restart_sysctl, 0 },
+	{ RCN_RESTART_WIFI5, rce_restart_wifi5, 0 },
+	{ RCN_RESTART_WIFI2, rce_restart_wifi2, 0 },
+	{ "control_wifi_guest_wl", rce_control_wifi_guest_wl, 0 },
+	{ "control_wifi_guest_rt", rce_control_wifi_guest_rt, 0 },
+	{ "control_wifi_guest_wl_on", rce_control_wifi_guest_wl_on, 0 },
+	{ "control_wifi_guest_wl_off", rce_control_wifi_guest_wl_off, 0 },
+	{ "control_wifi_guest_rt_on", rce_control_wifi_guest_rt_on, 0 },
+	{ "control_wifi_guest_rt_off", rce_control_wifi_guest_rt_off, 0 },
+	{ "control_wifi_radio_wl", rce_control_wifi_radio_wl, 0 },
+	{ "control_wifi_radio_rt", rce_control_wifi_radio_rt, 0 },
+	{ "control_wifi_radio_wl_on", rce_control_wifi_radio_wl_on, 0 },
+	{ "control_wifi_radio_wl_off", rce_control_wifi_radio_wl_off, 0 },
+	{ "control_wifi_radio_rt_on", rce_control_wifi_radio_rt_on, 0 },
+	{ "control_wifi_radio_rt_off", rce_control_wifi_radio_rt_off, 0 },
+	{ "control_wifi_config_wl", rce_control_wifi_config_wl, 0 },
+	{ "control_wifi_config_rt", rce_control_wifi_config_rt, 0 },
+};
+
+/* rce_hash stores index+1 in unsigned char, grow RCE_EVENTS_MAX and RCE_HASH_SIZE together */
+typedef char rc_events_fit_check[(ARRAY_SIZE(rc_events) <= RCE_EVENTS_MAX) ? 1 : -1];
+
+void
+start_rc_events(void)
+{
+	rc_event_start(rc_events, ARRAY_SIZE(rc_events));
+}
+
+/* Legacy notification by marker file and SIGUSR1 */
+void 
+handle_notifications(void)
+{
+	int i, idx, stop_handle = 0;
+	char notify_name[300];
+
+	DIR *directory = opendir(DIR_RC_NOTIFY);
+	if (!directory)
+		return;
+
+	// handle max 10 requests at once (prevent deadlock)
+	for (i=0; i < 10; i++)
+	{
+		struct dirent *entry;
+		FILE *test_fp;
+		
+		entry = readdir(directory);
+		if (!entry)
+			break;
+		if (strcmp(entry->d_name, ".") == 0)
+			continue;
+		if (strcmp(entry->d_name, "..") == 0)
+			continue;
+		
+		/* Remove the marker file. */
+		snprintf(notify_name, sizeof(notify_name), "%s/%s", DIR_RC_NOTIFY, entry->d_name);
+		remove(notify_name);
+		
+		/* Take the appropriate action. */
+		idx = rc_event_find(entry->d_name);
+		if (idx >= 0) {
+			stop_handle = rc_event_run(idx);
+		} else {
 			dbg("WARNING: rc notified of unrecognized event `%s'.\n", entry->d_name);
 		}
 		
@@ -33,6 +33,8 @@
 #include <notify_rc.h>
 #include <bin_sem_asus.h>
 
+#include "rc_event.h"
+
 /* do not set current year, it used for ntp done check! */
 #define SYS_START_YEAR			2015
 
@@ -147,6 +149,7 @@ void setkernel_tz(void);
 void init_router(void);
 void shutdown_router(int level);
 void handle_notifications(void);
+void start_rc_events(void);
 void LED_CONTROL(int gpio_led, int flag);
 void storage_save_time(time_t delta);
 void write_storage_to_mtd(void);
@@ -195,6 +198,8 @@ int check_if_file_exist(const char *filepath);
 int check_if_dir_exist(const char *dirpath);
 int check_if_dev_exist(const char *devpath);
 int get_hotplug_action(const char *action);
+FILE *ip_batch_open(void);
+int ip_batch_run(FILE *fp, int ipv6);
 
 /* net.c */
 int  route_add(char *ifname, int metric, char *dst, char *gateway, char *genmask);
@@ -825,6 +830,7 @@ int getPIN(void);
 int setPIN(const char *pin);
 int getBootVer(void);
 int get_apcli_connected(const char *ifname);
+int iwpriv_set(const char *ifname, const char *fmt, ...);
 int check_regspec_code(const char *spec);
 
 /* watchdog.c */
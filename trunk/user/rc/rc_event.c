@@ -0,0 +1,255 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+/*
+ * rc event socket: notify_rc() requests arrive as datagrams, are looked
+ * up in the events table, merged while queued and answered to waiters
+ * when the handler is done.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <shutils.h>
+#include <notify_rc.h>
+
+#include "rc_event.h"
+
+#define RCE_HASH_SIZE		256	/* power of 2, > 2 * RCE_EVENTS_MAX */
+#define RCE_WAITERS_MAX		16
+
+struct rc_event_waiter {
+	int idx;
+	socklen_t addr_len;
+	struct sockaddr_un addr;
+};
+
+static const rc_event_t *rc_events = NULL;
+static int rc_event_fd = -1;
+static unsigned char rce_hash[RCE_HASH_SIZE];		/* index+1 in rc_events, 0 for empty */
+static unsigned char rce_pending[RCE_EVENTS_MAX];
+static unsigned char rce_queue[RCE_EVENTS_MAX];
+static int rce_queue_len = 0;
+static struct rc_event_waiter rce_waiters[RCE_WAITERS_MAX];
+static int rce_waiters_num = 0;
+
+static unsigned int
+rc_event_hash(const char *name)
+{
+	unsigned int h = 2166136261U;
+
+	while (*name)
+		h = (h ^ (unsigned char)*name++) * 16777619U;
+
+	return h & (RCE_HASH_SIZE - 1);
+}
+
+int
+rc_event_find(const char *name)
+{
+	unsigned int h = rc_event_hash(name);
+	int i;
+
+	while ((i = rce_hash[h]) != 0) {
+		if (strcmp(rc_events[i-1].name, name) == 0)
+			return i-1;
+		h = (h + 1) & (RCE_HASH_SIZE - 1);
+	}
+
+	return -1;
+}
+
+static void
+rc_event_reply(const struct sockaddr_un *addr, socklen_t addr_len, const char *name)
+{
+	if (rc_event_fd >= 0)
+		sendto(rc_event_fd, name, strlen(name), MSG_DONTWAIT, (const struct sockaddr *)addr, addr_len);
+}
+
+/* Queue event, repeated requests are merged while pending */
+static void
+rc_event_post(int idx)
+{
+	if (rce_pending[idx])
+		return;
+
+	rce_pending[idx] = 1;
+	rce_queue[rce_queue_len++] = idx;
+}
+
+/* Run event handler, returns nonzero to stop handling */
+int
+rc_event_run(int idx)
+{
+	printf("rc notification: %s\n", rc_events[idx].name);
+
+	rc_events[idx].handler();
+
+	return (rc_events[idx].flags & RCE_STOP);
+}
+
+/* Wake up senders waiting for event completion */
+static void
+rc_event_done(int idx)
+{
+	int i;
+
+	for (i = 0; i < rce_waiters_num; ) {
+		if (rce_waiters[i].idx == idx) {
+			rc_event_reply(&rce_waiters[i].addr, rce_waiters[i].addr_len, rc_events[idx].name);
+			rce_waiters[i] = rce_waiters[--rce_waiters_num];
+		} else {
+			i++;
+		}
+	}
+}
+
+static void
+rc_event_recv(void)
+{
+	struct sockaddr_un addr;
+	socklen_t addr_len;
+	char name[RC_EVENT_NAME_MAX+1];
+	int len, idx;
+
+	for (;;) {
+		addr_len = sizeof(addr);
+		len = recvfrom(rc_event_fd, name, sizeof(name)-1, MSG_DONTWAIT, (struct sockaddr *)&addr, &addr_len);
+		if (len < 0)
+			break;
+		name[len] = '\0';
+		
+		idx = rc_event_find(name);
+		if (idx < 0) {
+			dbg("WARNING: rc notified of unrecognized event `%s'.\n", name);
+			if (addr_len > sizeof(sa_family_t))
+				rc_event_reply(&addr, addr_len, name);
+			continue;
+		}
+		
+		rc_event_post(idx);
+		
+		/* Sender waits for completion */
+		if (addr_len > sizeof(sa_family_t)) {
+			if (rce_waiters_num >= RCE_WAITERS_MAX) {
+				/* event is queued, just don't keep sender waiting */
+				rc_event_reply(&addr, addr_len, RC_EVENT_BUSY);
+				continue;
+			}
+			rce_waiters[rce_waiters_num].idx = idx;
+			rce_waiters[rce_waiters_num].addr_len = addr_len;
+			memcpy(&rce_waiters[rce_waiters_num].addr, &addr, addr_len);
+			rce_waiters_num++;
+		}
+	}
+}
+
+/* Index events table and bind event socket */
+int
+rc_event_start(const rc_event_t *events, int num)
+{
+	struct sockaddr_un addr;
+	unsigned int h;
+	int i;
+
+	if (num > RCE_EVENTS_MAX) {
+		dbg("WARNING: rc events table has %d entries, only %d handled!\n", num, RCE_EVENTS_MAX);
+		num = RCE_EVENTS_MAX;
+	}
+
+	rc_events = events;
+	rce_queue_len = 0;
+	rce_waiters_num = 0;
+	memset(rce_pending, 0, sizeof(rce_pending));
+
+	memset(rce_hash, 0, sizeof(rce_hash));
+	for (i = 0; i < num; i++) {
+		h = rc_event_hash(rc_events[i].name);
+		while (rce_hash[h])
+			h = (h + 1) & (RCE_HASH_SIZE - 1);
+		rce_hash[h] = i + 1;
+	}
+
+	unlink(RC_EVENT_SOCK);
+
+	rc_event_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (rc_event_fd < 0)
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, RC_EVENT_SOCK);
+	if (bind(rc_event_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(rc_event_fd);
+		rc_event_fd = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Wait for event or signal, returns 1 if events are ready */
+int
+wait_rc_events(const sigset_t *ss)
+{
+	fd_set rfds;
+
+	if (rce_queue_len > 0)
+		return 1;
+
+	if (rc_event_fd < 0) {
+		sigsuspend(ss);
+		return 0;
+	}
+
+	FD_ZERO(&rfds);
+	FD_SET(rc_event_fd, &rfds);
+
+	return (pselect(rc_event_fd + 1, &rfds, NULL, NULL, NULL, ss) > 0);
+}
+
+void
+handle_rc_events(void)
+{
+	int i, idx, stop_handle;
+
+	if (rc_event_fd < 0)
+		return;
+
+	// handle max 10 requests at once (prevent deadlock)
+	for (i = 0; i < 10; i++) {
+		/* Merge requests arrived during previous handler */
+		rc_event_recv();
+		if (rce_queue_len < 1)
+			break;
+		
+		idx = rce_queue[0];
+		rce_queue_len--;
+		memmove(rce_queue, rce_queue + 1, rce_queue_len);
+		rce_pending[idx] = 0;
+		
+		stop_handle = rc_event_run(idx);
+		rc_event_done(idx);
+		if (stop_handle)
+			break;
+	}
+}
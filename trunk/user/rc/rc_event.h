@@ -0,0 +1,39 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#ifndef _rc_event_h_
+#define _rc_event_h_
+
+#include <signal.h>
+
+#define RCE_STOP		0x01	/* stop handling after this event */
+#define RCE_EVENTS_MAX		127
+
+typedef struct {
+	const char *name;
+	void (*handler)(void);
+	int flags;
+} rc_event_t;
+
+/* rc_event.c */
+int rc_event_start(const rc_event_t *events, int num);
+int rc_event_find(const char *name);
+int rc_event_run(int idx);
+int wait_rc_events(const sigset_t *ss);
+void handle_rc_events(void);
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Benchmark of rc event socket: notify_rc_and_wait() to completion
+ * latency of a no-op event. Server is rc_event.c with an events table
+ * of rc size, run in a child process like rc (init) does.
+ *
+ * Usage: rc_event_bench [requests]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <notify_rc.h>
+
+#include "../rc_event.h"
+
+#define EVENTS		100
+
+static char names[EVENTS][32];
+static rc_event_t events[EVENTS];
+static volatile sig_atomic_t noop_runs;
+
+static void
+rce_noop(void)
+{
+	noop_runs++;
+}
+
+static double
+now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void
+serve(int ready_fd)
+{
+	sigset_t ss;
+
+	sigemptyset(&ss);
+	if (!freopen("/dev/null", "w", stdout))
+		_exit(1);
+
+	if (rc_event_start(events, EVENTS) < 0)
+		_exit(1);
+	if (write(ready_fd, "1", 1) != 1)
+		_exit(1);
+	close(ready_fd);
+
+	for (;;) {
+		if (wait_rc_events(&ss))
+			handle_rc_events();
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	int requests = (argc > 1) ? atoi(argv[1]) : 20000;
+	int i, pfd[2];
+	double *lat, t, total;
+	char c;
+	pid_t pid;
+
+	for (i = 0; i < EVENTS; i++) {
+		sprintf(names[i], "restart_service_%d", i);
+		events[i].name = names[i];
+		events[i].handler = rce_noop;
+	}
+	strcpy(names[EVENTS - 1], "bench_noop");
+
+	/* Without server (or with a full queue) notify_rc() falls back to
+	 * SIGUSR1 to pid 1, so wait for bind and never flood the socket */
+	if (pipe(pfd) < 0)
+		return 1;
+	pid = fork();
+	if (pid < 0)
+		return 1;
+	if (pid == 0) {
+		close(pfd[0]);
+		serve(pfd[1]);
+	}
+	close(pfd[1]);
+	if (read(pfd[0], &c, 1) != 1) {
+		fprintf(stderr, "rc_event_bench: server failed to bind %s\n", RC_EVENT_SOCK);
+		return 1;
+	}
+
+	lat = malloc(requests * sizeof(double));
+	total = now_usec();
+	for (i = 0; i < requests; i++) {
+		t = now_usec();
+		notify_rc_and_wait("bench_noop", 5);
+		lat[i] = now_usec() - t;
+	}
+	total = now_usec() - total;
+
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+	unlink(RC_EVENT_SOCK);
+
+	qsort(lat, requests, sizeof(double), cmp_double);
+	printf("notify_rc_and_wait : %d requests, %.1f us avg, p50 %.1f us, p99 %.1f us, max %.1f us\n",
+		requests, total / requests, lat[requests / 2], lat[requests * 99 / 100], lat[requests - 1]);
+	printf("(marker file + SIGUSR1 path polls the marker every 1 s, a wait takes >= 1 s)\n");
+
+	free(lat);
+
+	return 0;
+}
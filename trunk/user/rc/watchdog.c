@@ -31,6 +31,7 @@
 #include <math.h>
 #include <string.h>
 #include <sys/wait.h>
+#include <poll.h>
 
 #include <sys/ioctl.h>
 
@@ -1240,6 +1241,9 @@ watchdog_main(int argc, char *argv[])
 {
 	FILE *fp;
 	pid_t pid;
+	int watch_fd;
+	struct pollfd pfd;
+	sigset_t sigs;
 	struct sigaction sa;
 
 	memset(&sa, 0, sizeof(sa));
@@ -1291,12 +1295,36 @@ watchdog_main(int argc, char *argv[])
 	cpu_gpio_irq_set(BOARD_GPIO_BTN_RESET, 0, 1, pid);
 #endif
 
+	/* pick up time zone change w/o waiting for SIGHUP */
+	watch_fd = nvram_watch_open();
+	if (watch_fd >= 0 && nvram_watch_add(watch_fd, "time_zone") < 0) {
+		close(watch_fd);
+		watch_fd = -1;
+	}
+
 	/* set timer */
 	wd_alarmtimer(WD_NORMAL_PERIOD, 0);
 
+	sigemptyset(&sigs);
+	sigaddset(&sigs, SIGALRM);
+	sigaddset(&sigs, SIGHUP);
+	sigaddset(&sigs, SIGUSR1);
+	sigaddset(&sigs, SIGUSR2);
+
 	/* most of time it goes to sleep */
 	while (1) {
-		pause();
+		if (watch_fd < 0) {
+			pause();
+			continue;
+		}
+		
+		pfd.fd = watch_fd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, -1) > 0 && nvram_watch_drain(watch_fd)) {
+			sigprocmask(SIG_BLOCK, &sigs, NULL);
+			watchdog_on_sighup();
+			sigprocmask(SIG_UNBLOCK, &sigs, NULL);
+		}
 	}
 
 	return 0;
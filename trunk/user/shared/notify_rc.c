@@ -22,15 +22,80 @@
 #include <sys/types.h>
 #include <signal.h>
 #include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
 
 #include "notify_rc.h"
 
+/* Returns 0 if rc took the request over event socket */
+static int notify_rc_socket(const char *event_name, int wait_sec)
+{
+	struct sockaddr_un addr;
+	struct timeval tv;
+	char reply[RC_EVENT_NAME_MAX+1];
+	int fd, len, ret = -1;
+	size_t name_len = strlen(event_name);
+
+	if (name_len < 1 || name_len > RC_EVENT_NAME_MAX)
+		return -1;
+
+	fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	/* rc can't wait for itself */
+	if (getpid() == 1)
+		wait_sec = 0;
+
+	if (wait_sec > 0) {
+		/* Autobind to abstract address for completion reply */
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (bind(fd, (struct sockaddr *)&addr, sizeof(sa_family_t)) < 0)
+			goto done;
+		tv.tv_sec = wait_sec;
+		tv.tv_usec = 0;
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, RC_EVENT_SOCK);
+
+	/* Don't block on full queue (rc is busy or notifies itself) */
+	if (sendto(fd, event_name, name_len, MSG_DONTWAIT, (struct sockaddr *)&addr, sizeof(addr)) != name_len)
+		goto done;
+
+	ret = 0;
+
+	if (wait_sec > 0) {
+		while ((len = recv(fd, reply, sizeof(reply)-1, 0)) >= 0) {
+			reply[len] = '\0';
+			if (strcmp(reply, event_name) == 0)
+				break;
+			if (strcmp(reply, RC_EVENT_BUSY) == 0) {
+				fprintf(stderr, "notify_rc: rc is busy, not waiting for %s\n", event_name);
+				break;
+			}
+		}
+	}
+
+done:
+	close(fd);
+
+	return ret;
+}
+
 static void notify_rc_internal(const char *event_name, int wait_sec)
 {
 	FILE *fp;
 	int i;
 	char *full_name;
 
+	if (notify_rc_socket(event_name, wait_sec) == 0)
+		return;
+
 	full_name = (char *)(malloc(strlen(event_name) + 32));
 	if (!full_name) {
 		fprintf(stderr, "notify_rc: failed to alloc event memory!\n");
@@ -106,6 +106,12 @@
 
 ////////////////////////////////////////////////////////////
 
+#ifndef RC_EVENT_SOCK
+#define RC_EVENT_SOCK			"/tmp/rc_event.sock"
+#endif
+#define RC_EVENT_NAME_MAX		64
+#define RC_EVENT_BUSY			"busy"	/* reply when rc can't track one more waiter */
+
 #define DIR_RC_NOTIFY			"/tmp/rc_notification"
 #define DIR_RC_INCOMPLETE		"/tmp/rc_action_incomplete"
 
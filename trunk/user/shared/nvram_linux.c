@@ -21,67 +21,431 @@
 #include <errno.h>
 #include <error.h>
 #include <string.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 
 #include <bcmnvram.h>
 
+#include "nvram_linux.h"
+
 #define PATH_DEV_NVRAM	"/dev/nvram"
+#define GET_MULTI_TRIES	3	/* reply may grow between ioctls */
 
-#define MAX_CACHE_LEN	(2*NVRAM_MAX_VALUE_LEN)
-#define MIN_CACHE_RES	32
+#define CACHE_HASH_SIZE	256
+#define CACHE_RETIRE_MAX	(64 * 1024)
+#define CACHE_UNSET_MAX		1024
 
-char *
-nvram_get_(const char *name)
+#define CACHE_STALE	0
+#define CACHE_SET	1
+#define CACHE_UNSET	2
+
+/*
+ * Per-process cache of nvram values. Entries are validated against the
+ * generation counter published by the driver in a read-only shared page,
+ * so a hit costs no syscall. Value buffers are never written after they
+ * are returned: a changed value gets a new buffer and the old one is
+ * retired, it is released only after CACHE_RETIRE_MAX bytes of newer
+ * values were retired, so pointers returned by nvram_get() keep their
+ * content while the caller uses them.
+ * Entries are created only once the driver replied. Unset names are
+ * cached too, but when more than CACHE_UNSET_MAX of them pile up (e.g.
+ * probing of generated names) they are all dropped.
+ */
+struct nvram_cache_value {
+	struct nvram_cache_value *next;	/* retire list */
+	uint32_t len;			/* including NUL */
+	char data[1];
+};
+
+struct nvram_cache_entry {
+	struct nvram_cache_entry *next;
+	char *value;			/* NULL for unset variable */
+	uint32_t gen;
+	int state;
+	char name[1];
+};
+
+static int nvram_fd = -1;
+static const volatile anvram_shm_t *nvram_shm = NULL;
+static struct nvram_cache_entry *nvram_cache[CACHE_HASH_SIZE];
+static struct nvram_cache_value *nvram_retire_head, *nvram_retire_tail;
+static size_t nvram_retire_size;
+static int nvram_unset_count;
+
+static int
+nvram_dev_open(void)
 {
-	static int  nvr_index = 0;
-	static char nvr_cache[MAX_CACHE_LEN] = {0};
-	int ret, i_cache, nvram_fd;
-	anvram_ioctl_t nvr;
+	void *shm;
 
-	nvram_fd = open(PATH_DEV_NVRAM, O_RDWR);
+	if (nvram_fd >= 0)
+		return nvram_fd;
+
+	nvram_fd = open(PATH_DEV_NVRAM, O_RDWR | O_CLOEXEC);
 	if (nvram_fd < 0) {
 		perror(PATH_DEV_NVRAM);
+		return -1;
+	}
+
+	if (nvram_shm)
+		return nvram_fd;
+
+	/* Old driver w/o shared page, cache always revalidated */
+	shm = mmap(NULL, sizeof(anvram_shm_t), PROT_READ, MAP_SHARED, nvram_fd, 0);
+	if (shm != MAP_FAILED) {
+		if (((const anvram_shm_t *)shm)->magic == NVRAM_MAGIC)
+			nvram_shm = shm;
+		else
+			munmap(shm, sizeof(anvram_shm_t));
+	}
+
+	return nvram_fd;
+}
+
+static int
+nvram_dev_ioctl_(int req, void *arg)
+{
+	int ret;
+
+	if (nvram_dev_open() < 0)
+		return -1;
+
+	ret = ioctl(nvram_fd, req, arg);
+	if (ret < 0 && (errno == EBADF || errno == ENOTTY)) {
+		/* Descriptor was closed behind us (daemonize etc), reopen */
+		nvram_fd = -1;
+		if (nvram_dev_open() < 0)
+			return -1;
+		ret = ioctl(nvram_fd, req, arg);
+	}
+
+	return ret;
+}
+
+static int
+nvram_dev_ioctl(int req, void *arg)
+{
+	int ret = nvram_dev_ioctl_(req, arg);
+
+	if (ret < 0)
+		perror(PATH_DEV_NVRAM);
+
+	return ret;
+}
+
+static inline uint32_t
+nvram_cache_hash(const char *s)
+{
+	uint32_t hash = 0;
+
+	while (*s)
+		hash = 31 * hash + (unsigned char)*s++;
+
+	return hash % CACHE_HASH_SIZE;
+}
+
+static struct nvram_cache_entry *
+nvram_cache_lookup(const char *name, int create)
+{
+	struct nvram_cache_entry *e, **head;
+	size_t len;
+
+	head = &nvram_cache[nvram_cache_hash(name)];
+	for (e = *head; e; e = e->next) {
+		if (!strcmp(e->name, name))
+			return e;
+	}
+
+	if (!create)
+		return NULL;
+
+	len = strlen(name);
+	if (len > (NVRAM_MAX_PARAM_LEN-1))
+		return NULL;
+
+	e = calloc(1, sizeof(struct nvram_cache_entry) + len);
+	if (!e)
 		return NULL;
+
+	memcpy(e->name, name, len + 1);
+	e->next = *head;
+	*head = e;
+
+	return e;
+}
+
+static inline struct nvram_cache_value *
+nvram_cache_value(char *value)
+{
+	return (struct nvram_cache_value *)(value - offsetof(struct nvram_cache_value, data));
+}
+
+static void
+nvram_cache_retire(struct nvram_cache_value *v)
+{
+	struct nvram_cache_value *old;
+
+	v->next = NULL;
+	if (nvram_retire_tail)
+		nvram_retire_tail->next = v;
+	else
+		nvram_retire_head = v;
+	nvram_retire_tail = v;
+	nvram_retire_size += v->len;
+
+	/* Release the oldest buffers, keep the newest one */
+	while (nvram_retire_size > CACHE_RETIRE_MAX && nvram_retire_head != v) {
+		old = nvram_retire_head;
+		nvram_retire_head = old->next;
+		nvram_retire_size -= old->len;
+		free(old);
+	}
+}
+
+static void
+nvram_cache_state(struct nvram_cache_entry *e, int state)
+{
+	if (e->state == CACHE_UNSET)
+		nvram_unset_count--;
+	if (state == CACHE_UNSET)
+		nvram_unset_count++;
+	e->state = state;
+}
+
+/* Drop all unset entries once there are too many, set ones are kept */
+static void
+nvram_cache_trim(void)
+{
+	struct nvram_cache_entry *e, **prev;
+	int i;
+
+	if (nvram_unset_count <= CACHE_UNSET_MAX)
+		return;
+
+	for (i = 0; i < CACHE_HASH_SIZE; i++) {
+		prev = &nvram_cache[i];
+		while ((e = *prev)) {
+			if (e->state != CACHE_UNSET) {
+				prev = &e->next;
+				continue;
+			}
+			*prev = e->next;
+			if (e->value)
+				nvram_cache_retire(nvram_cache_value(e->value));
+			free(e);
+		}
 	}
 
-	i_cache = nvr_index;
-	if ((MAX_CACHE_LEN - i_cache) < MIN_CACHE_RES)
-		i_cache = 0;
+	nvram_unset_count = 0;
+}
+
+static int
+nvram_cache_store(struct nvram_cache_entry *e, const char *value, uint32_t len)
+{
+	struct nvram_cache_value *v;
+
+	/* Unchanged value, keep the buffer callers may hold */
+	if (e->value) {
+		v = nvram_cache_value(e->value);
+		if (v->len == len && !memcmp(v->data, value, len - 1))
+			return 0;
+	}
+
+	v = malloc(sizeof(struct nvram_cache_value) + len);
+	if (!v)
+		return -1;
+
+	v->len = len;
+	memcpy(v->data, value, len);
+	v->data[len-1] = '\0';
+
+	if (e->value)
+		nvram_cache_retire(nvram_cache_value(e->value));
+	e->value = v->data;
+
+	return 0;
+}
+
+char *
+nvram_get_(const char *name)
+{
+	static char nvr_value[NVRAM_MAX_VALUE_LEN];
+	struct nvram_cache_entry *e;
+	anvram_ioctl_t nvr;
+	uint32_t gen = 0;
+	int ret;
+
+	if (!name)
+		return NULL;
+
+	if (nvram_dev_open() < 0)
+		return NULL;
+
+	e = nvram_cache_lookup(name, 0);
+	if (nvram_shm) {
+		gen = nvram_shm->generation;
+		if (e && e->state != CACHE_STALE && e->gen == gen)
+			return (e->state == CACHE_SET) ? e->value : NULL;
+	}
 
 	nvr.size = sizeof(nvr);
+	nvr.is_temp = 0;
 	nvr.len_param = strlen(name);
-	nvr.len_value = MAX_CACHE_LEN - i_cache;
+	nvr.len_value = sizeof(nvr_value);
 	nvr.param = (char*)name;
-	nvr.value = &nvr_cache[i_cache];
-
-	ret = ioctl(nvram_fd, NVRAM_IOCTL_GET, &nvr);
-	if (ret < 0) {
-		if (errno == EOVERFLOW && nvr.len_value > 0 && nvr.len_value <= MAX_CACHE_LEN) {
-			if ((MAX_CACHE_LEN - i_cache) < nvr.len_value)
-				i_cache = 0;
-			nvr.len_value = MAX_CACHE_LEN - i_cache;
-			nvr.value = &nvr_cache[i_cache];
-			ret = ioctl(nvram_fd, NVRAM_IOCTL_GET, &nvr);
+	nvr.value = nvr_value;
+
+	ret = nvram_dev_ioctl(NVRAM_IOCTL_GET, &nvr);
+	if (ret < 0)
+		return NULL;
+
+	if (!e)
+		e = nvram_cache_lookup(name, 1);
+
+	if (!e) {
+		/* Out of memory or bad name, pass through static buffer */
+		return (nvr.len_value < 1) ? NULL : nvr_value;
+	}
+
+	e->gen = gen;
+	if (nvr.len_value < 1) {
+		nvram_cache_state(e, CACHE_UNSET);
+		nvram_cache_trim();
+		return NULL;
+	}
+
+	if (nvram_cache_store(e, nvr_value, nvr.len_value) < 0) {
+		nvram_cache_state(e, CACHE_STALE);
+		return NULL;
+	}
+
+	nvram_cache_state(e, CACHE_SET);
+
+	return e->value;
+}
+
+static int
+nvram_cache_fresh(struct nvram_cache_entry *e, uint32_t gen)
+{
+	return (nvram_shm && e->state != CACHE_STALE && e->gen == gen);
+}
+
+/* Fetch many variables with one ioctl, pairs[i].value is set like nvram_get() */
+int
+nvram_get_multi(struct nvram_pair *pairs, int count)
+{
+	struct nvram_cache_entry *e;
+	anvram_ioctl_t nvr;
+	char *names, *out, *name, *value;
+	size_t len_names;
+	uint32_t gen = 0;
+	int i, ret, tries, len_out;
+
+	if (!pairs || count < 1)
+		return 0;
+
+	if (nvram_dev_open() < 0)
+		return -1;
+
+	if (nvram_shm)
+		gen = nvram_shm->generation;
+
+	names = malloc(count * NVRAM_MAX_PARAM_LEN + 1);
+	if (!names)
+		goto fallback;
+
+	/* Request only names missed in cache */
+	len_names = 0;
+	for (i = 0; i < count; i++) {
+		if (strlen(pairs[i].name) > (NVRAM_MAX_PARAM_LEN-1))
+			continue;
+		e = nvram_cache_lookup(pairs[i].name, 0);
+		if (e) {
+			if (nvram_cache_fresh(e, gen))
+				continue;
+			nvram_cache_state(e, CACHE_STALE);
 		}
-		if (ret < 0) {
-			perror(PATH_DEV_NVRAM);
-			close(nvram_fd);
-			return NULL;
+		len_names += sprintf(names + len_names, "%s", pairs[i].name) + 1;
+	}
+
+	if (len_names > 0) {
+		out = NULL;
+		nvr.size = sizeof(nvr);
+		nvr.is_temp = 0;
+		nvr.len_param = len_names;
+		nvr.len_value = NVRAM_MAX_VALUE_LEN;
+		nvr.param = names;
+		ret = -1;
+		for (tries = 0; tries < GET_MULTI_TRIES; tries++) {
+			len_out = nvr.len_value;
+			out = malloc(len_out);
+			if (!out)
+				break;
+			nvr.value = out;
+			ret = nvram_dev_ioctl_(NVRAM_IOCTL_GET_MULTI, &nvr);
+			if (ret == 0 || errno != EOVERFLOW)
+				break;
+			free(out);
+			out = NULL;
+			/* Retry with the size asked by driver, only if it grows and fits */
+			if (nvr.len_value <= len_out || nvr.len_value > NVRAM_SPACE)
+				break;
+		}
+
+		if (!out || ret < 0) {
+			/* Old driver or too large reply */
+			free(out);
+			free(names);
+			goto fallback;
+		}
+
+		/* Requested names absent in reply are unset */
+		for (name = names; name < names + len_names; name += strlen(name) + 1) {
+			if ((e = nvram_cache_lookup(name, 1))) {
+				e->gen = gen;
+				nvram_cache_state(e, CACHE_UNSET);
+			}
+		}
+
+		for (name = out; *name; name = value + strlen(value) + 1) {
+			value = strchr(name, '=');
+			if (!value)
+				break;
+			*value++ = '\0';
+			if (!(e = nvram_cache_lookup(name, 1)))
+				continue;
+			if (nvram_cache_store(e, value, strlen(value) + 1) < 0)
+				nvram_cache_state(e, CACHE_STALE);
+			else
+				nvram_cache_state(e, CACHE_SET);
 		}
+
+		free(out);
 	}
 
-	if (nvr.len_value < 1)
-		nvr.value = NULL;
-	else
-		nvr_index = i_cache + nvr.len_value;
+	free(names);
+
+	for (i = 0; i < count; i++) {
+		e = nvram_cache_lookup(pairs[i].name, 0);
+		if (e && e->state != CACHE_STALE && e->gen == gen)
+			pairs[i].value = (e->state == CACHE_SET) ? e->value : NULL;
+		else
+			pairs[i].value = nvram_get_(pairs[i].name);
+	}
+
+	nvram_cache_trim();
+
+	return 0;
 
-	close(nvram_fd);
+fallback:
+	for (i = 0; i < count; i++)
+		pairs[i].value = nvram_get_(pairs[i].name);
 
-	return nvr.value;
+	return 0;
 }
 
 char *
@@ -126,18 +490,12 @@ nvram_safe_get_int(const char* name, int val_def, int val_min, int val_max)
 int
 nvram_getall(char *buf, int count, int include_temp)
 {
-	int ret, nvram_fd;
+	int ret;
 	anvram_ioctl_t nvr;
 
 	if (!buf || count < 1)
 		return 0;
 
-	nvram_fd = open(PATH_DEV_NVRAM, O_RDWR);
-	if (nvram_fd < 0) {
-		perror(PATH_DEV_NVRAM);
-		return -1;
-	}
-
 	/* Get all variables */
 	*buf = '\0';
 
@@ -148,11 +506,7 @@ nvram_getall(char *buf, int count, int include_temp)
 	nvr.value = buf;
 	nvr.is_temp = include_temp;
 
-	ret = ioctl(nvram_fd, NVRAM_IOCTL_GET, &nvr);
-	if (ret < 0)
-		perror(PATH_DEV_NVRAM);
-
-	close(nvram_fd);
+	ret = nvram_dev_ioctl(NVRAM_IOCTL_GET, &nvr);
 
 	return ret;
 }
@@ -160,15 +514,9 @@ nvram_getall(char *buf, int count, int include_temp)
 int
 _nvram_set(const char *name, const char *value, int is_temp)
 {
-	int ret, nvram_fd;
+	int ret;
 	anvram_ioctl_t nvr;
 
-	nvram_fd = open(PATH_DEV_NVRAM, O_RDWR);
-	if (nvram_fd < 0) {
-		perror(PATH_DEV_NVRAM);
-		return -1;
-	}
-
 	nvr.size = sizeof(nvr);
 	nvr.len_param = strlen(name);
 	nvr.len_value = 0;
@@ -178,15 +526,79 @@ _nvram_set(const char *name, const char *value, int is_temp)
 	if (value)
 		nvr.len_value = strlen(value);
 
-	ret = ioctl(nvram_fd, NVRAM_IOCTL_SET, &nvr);
-	if (ret < 0)
-		perror(PATH_DEV_NVRAM);
+	ret = nvram_dev_ioctl(NVRAM_IOCTL_SET, &nvr);
+
+	return ret;
+}
+
+static int
+_nvram_set_multi(const struct nvram_pair *pairs, int count, int is_temp)
+{
+	anvram_ioctl_t nvr;
+	size_t len;
+	char *buf;
+	int i, ret;
+
+	if (!pairs || count < 1)
+		return 0;
+
+	len = 1;
+	for (i = 0; i < count; i++) {
+		len += strlen(pairs[i].name) + 1;
+		if (pairs[i].value)
+			len += strlen(pairs[i].value) + 1;
+	}
 
-	close(nvram_fd);
+	buf = malloc(len);
+	if (!buf)
+		goto fallback;
+
+	/* Pack "name=value\0" pairs, "name\0" for unset */
+	len = 0;
+	for (i = 0; i < count; i++) {
+		if (pairs[i].value)
+			len += sprintf(buf + len, "%s=%s", pairs[i].name, pairs[i].value) + 1;
+		else
+			len += sprintf(buf + len, "%s", pairs[i].name) + 1;
+	}
+
+	nvr.size = sizeof(nvr);
+	nvr.is_temp = is_temp;
+	nvr.len_param = len;
+	nvr.len_value = 0;
+	nvr.param = buf;
+	nvr.value = NULL;
+
+	ret = nvram_dev_ioctl_(NVRAM_IOCTL_SET_MULTI, &nvr);
+	free(buf);
+
+	if (ret == 0 || (errno != EINVAL && errno != EOVERFLOW)) {
+		if (ret < 0)
+			perror(PATH_DEV_NVRAM);
+		return ret;
+	}
+
+fallback:
+	/* Old driver or too large batch */
+	ret = 0;
+	for (i = 0; i < count; i++)
+		ret |= _nvram_set(pairs[i].name, pairs[i].value, is_temp);
 
 	return ret;
 }
 
+int
+nvram_set_multi(const struct nvram_pair *pairs, int count)
+{
+	return _nvram_set_multi(pairs, count, 0);
+}
+
+int
+nvram_set_multi_temp(const struct nvram_pair *pairs, int count)
+{
+	return _nvram_set_multi(pairs, count, 1);
+}
+
 int
 nvram_set(const char *name, const char *value)
 {
@@ -236,40 +648,60 @@ nvram_invmatch(const char *name, char *invmatch)
 int
 nvram_commit(void)
 {
-	int ret, nvram_fd;
+	int ret;
 
-	nvram_fd = open(PATH_DEV_NVRAM, O_RDWR);
-	if (nvram_fd < 0) {
-		perror(PATH_DEV_NVRAM);
-		return -1;
-	}
+	ret = nvram_dev_ioctl(NVRAM_IOCTL_COMMIT, NULL);
 
-	ret = ioctl(nvram_fd, NVRAM_IOCTL_COMMIT, 0);
-	if (ret < 0)
-		perror(PATH_DEV_NVRAM);
+	return ret;
+}
 
-	close(nvram_fd);
+int
+nvram_clear(void)
+{
+	int ret;
+
+	ret = nvram_dev_ioctl(NVRAM_IOCTL_CLEAR, NULL);
 
 	return ret;
 }
 
+
+/*
+ * Change notifications. Returned descriptor is readable (poll/select) when
+ * watched variables changed, read() returns "name\n" lines, "*\n" means
+ * any variable may have changed (clear or reader overrun).
+ */
 int
-nvram_clear(void)
+nvram_watch_open(void)
 {
-	int ret, nvram_fd;
+	return open(PATH_DEV_NVRAM, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+}
 
-	nvram_fd = open(PATH_DEV_NVRAM, O_RDWR);
-	if (nvram_fd < 0) {
-		perror(PATH_DEV_NVRAM);
-		return -1;
-	}
+int
+nvram_watch_add(int fd, const char *prefix)
+{
+	anvram_ioctl_t nvr;
 
-	ret = ioctl(nvram_fd, NVRAM_IOCTL_CLEAR, 0);
-	if (ret < 0)
-		perror(PATH_DEV_NVRAM);
+	if (!prefix)
+		prefix = "";
 
-	close(nvram_fd);
+	memset(&nvr, 0, sizeof(nvr));
+	nvr.size = sizeof(nvr);
+	nvr.len_param = strlen(prefix);
+	nvr.param = (char *)prefix;
 
-	return ret;
+	return ioctl(fd, NVRAM_IOCTL_WATCH, &nvr);
 }
 
+/* Discard pending notifications, returns 1 if any variable changed */
+int
+nvram_watch_drain(int fd)
+{
+	char buf[512];
+	int changed = 0;
+
+	while (read(fd, buf, sizeof(buf)) > 0)
+		changed = 1;
+
+	return changed;
+}
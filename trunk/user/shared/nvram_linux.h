@@ -14,6 +14,7 @@ extern char *nvram_safe_get(const char *name);
 extern int nvram_get_int(const char *name);
 extern int nvram_safe_get_int(const char* name, int val_def, int val_min, int val_max);
 extern int nvram_getall(char *buf, int count, int include_temp);
+extern int nvram_get_multi(struct nvram_pair *pairs, int count);
 
 extern int nvram_set(const char *name, const char *value);
 extern int nvram_set_int(const char *name, int value);
@@ -22,12 +23,19 @@ extern int nvram_unset(const char *name);
 extern int nvram_set_temp(const char *name, const char *value);
 extern int nvram_set_int_temp(const char *name, int value);
 
+extern int nvram_set_multi(const struct nvram_pair *pairs, int count);
+extern int nvram_set_multi_temp(const struct nvram_pair *pairs, int count);
+
 extern int nvram_match(const char *name, char *match);
 extern int nvram_invmatch(const char *name, char *invmatch);
 
 extern int nvram_commit(void);
 extern int nvram_clear(void);
 
+extern int nvram_watch_open(void);
+extern int nvram_watch_add(int fd, const char *prefix);
+extern int nvram_watch_drain(int fd);
+
 
 #endif
 
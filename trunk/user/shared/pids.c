@@ -440,21 +440,150 @@ int pids_main(char *appname)
 	return count;
 }
 
-int pids(char *appname)
+/* pid registry: last known pid of a process name, kept in PIDS_REG_DIR/<name>.
+ * A hit costs one /proc/<pid> lookup instead of the whole /proc walk,
+ * stale entries (exited or reused pid) fall back to the scan. */
+#define PIDS_REG_DIR	"/var/run/pids"
+
+static int proc_match(unsigned pid, const char *procName, int skip_kthreads)
 {
-	pid_t *pidList;
-	pid_t *pl;
-	int count = 0;
+	char buf[PROCPS_BUFSIZE];
+	char filename[sizeof("/proc//cmdline") + sizeof(int)*3];
+	char comm[16], *cp, *comm1;
+	unsigned ppid = 0;
+	int n, argv1idx;
 
-	pidList = find_pid_by_name(appname);
-	for (pl = pidList; *pl; pl++) {
-		count++;
-	}
-	free(pidList);
+	sprintf(filename, "/proc/%u/stat", pid);
+	if (read_to_buf(filename, buf) <= 0)
+		return 0;
+
+	cp = strrchr(buf, ')');
+	comm1 = strchr(buf, '(');
+	if (!cp || !comm1 || cp < comm1)
+		return 0;
+	cp[0] = '\0';
+	strncpy(comm, comm1 + 1, sizeof(comm));
+	comm[sizeof(comm)-1] = '\0';
+
+	if (sscanf(cp + 2, "%c %u", buf, &ppid) != 2 || buf[0] == 'Z')
+		return 0;
 
-	if (count)
+	/* kernel threads have no cmdline and are never our services */
+	if (skip_kthreads && (pid == 2 || ppid == 2))
+		return 0;
+
+	/* comm is not truncated - match */
+	if (strncmp(comm, procName, 15) == 0 && strlen(comm) < 15)
+		return 1;
+
+	sprintf(filename, "/proc/%u/cmdline", pid);
+	n = read_to_buf(filename, buf);
+	if (n <= 0)
+		return 0;
+
+	if (strcmp(bb_basename(buf), procName) == 0)
 		return 1;
-	else
+
+	/* truncated comm, check basename(argv[1]) for scripts */
+	if (strncmp(comm, procName, 15) != 0)
+		return 0;
+	argv1idx = strlen(buf) + 1;
+	if (argv1idx >= n)
+		return 0;
+
+	return (strcmp(bb_basename(buf + argv1idx), procName) == 0);
+}
+
+static int pids_reg_path(char *path, size_t size, const char *procName)
+{
+	procName = bb_basename(procName);
+	if (!*procName || strlen(procName) > 64)
+		return -1;
+
+	snprintf(path, size, "%s/%s", PIDS_REG_DIR, procName);
+	return 0;
+}
+
+void pids_register(const char *procName, pid_t pid)
+{
+	char path[128], buf[16];
+	int fd, len;
+
+	if (pid < 2 || pids_reg_path(path, sizeof(path), procName) < 0)
+		return;
+
+	mkdir(PIDS_REG_DIR, 0755);
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return;
+	len = sprintf(buf, "%u", (unsigned)pid);
+	write(fd, buf, len);
+	close(fd);
+}
+
+static pid_t pids_lookup(const char *procName)
+{
+	char path[128], buf[16];
+	unsigned pid;
+	int fd, n;
+
+	if (pids_reg_path(path, sizeof(path), procName) < 0)
+		return 0;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	n = read(fd, buf, sizeof(buf)-1);
+	close(fd);
+	if (n <= 0)
 		return 0;
+	buf[n] = '\0';
+
+	pid = bb_strtou(buf, NULL, 10);
+	if (!errno && pid > 1 && proc_match(pid, procName, 0))
+		return pid;
+
+	unlink(path);
+	return 0;
 }
 
+/* first running process with this name, stops at the first match */
+static pid_t find_first_pid_by_name(const char *procName)
+{
+	DIR *dir;
+	struct dirent *entry;
+	unsigned pid, found = 0;
+
+	dir = opendir("/proc");
+	if (!dir)
+		return 0;
+
+	while ((entry = readdir(dir)) != NULL) {
+		pid = bb_strtou(entry->d_name, NULL, 10);
+		if (errno)
+			continue;
+		if (proc_match(pid, procName, 1)) {
+			found = pid;
+			break;
+		}
+	}
+	closedir(dir);
+
+	return found;
+}
+
+int pids(char *appname)
+{
+	pid_t pid;
+
+	if (pids_lookup(appname))
+		return 1;
+
+	pid = find_first_pid_by_name(appname);
+	if (pid) {
+		pids_register(appname, pid);
+		return 1;
+	}
+
+	return 0;
+}
@@ -247,6 +247,51 @@ void recreate_passwd_unix(int force_create)
 	}
 }
 
+static int spawn_trace_fd = -1;
+
+static unsigned long
+spawn_msec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Log start time, duration and command line of every spawned command
+ * @param	path	trace file to append to or NULL to stop tracing
+ */
+void
+spawn_trace(const char *path)
+{
+	if (spawn_trace_fd >= 0)
+		close(spawn_trace_fd);
+	spawn_trace_fd = -1;
+
+	if (path)
+		spawn_trace_fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+}
+
+static void
+spawn_trace_log(unsigned long start, const char *mode, char *const argv[])
+{
+	char buf[256];
+	int i, len;
+
+	if (spawn_trace_fd < 0)
+		return;
+
+	len = snprintf(buf, sizeof(buf), "%8lu %6lu %-4s", start, spawn_msec() - start, mode);
+	for (i = 0; argv[i] && len < sizeof(buf) - 2; i++)
+		len += snprintf(buf + len, sizeof(buf) - 1 - len, " %s", argv[i]);
+	if (len > sizeof(buf) - 2)
+		len = sizeof(buf) - 2;
+	buf[len++] = '\n';
+
+	write(spawn_trace_fd, buf, len);
+}
+
 int
 _eval(char *const argv[], char *path, int timeout, int *ppid)
 {
@@ -256,6 +301,7 @@ _eval(char *const argv[], char *path, int timeout, int *ppid)
 	int fd;
 	int flags;
 	int sig, i;
+	unsigned long start = spawn_msec();
 
 	switch (pid = fork()) {
 	case -1:	/* error */
@@ -306,12 +352,14 @@ _eval(char *const argv[], char *path, int timeout, int *ppid)
 	default:	/* parent */
 		if (ppid) {
 			*ppid = pid;
+			pids_register(argv[0], pid);
 			return 0;
 		} else {
 			do
 				ret = waitpid(pid, &status, 0);
 			while ((ret == -1) && (errno == EINTR));
 			
+			spawn_trace_log(start, "eval", argv);
 			if (ret != pid) {
 				perror("waitpid");
 				return errno;
@@ -437,19 +485,120 @@ ether_etoa3(const unsigned char *e, char *a)
 	return a;
 }
 
+/* command needs /bin/sh (redirects, pipes, quoting, globs, variables...) */
+static int
+need_shell(const char *cmd)
+{
+	const char *p;
+
+	if (strpbrk(cmd, "|&;<>()$`\\\"'*?[]{}~#\n"))
+		return 1;
+
+	/* VAR=value prefix */
+	p = cmd + strspn(cmd, " \t");
+	p = strpbrk(p, "= \t");
+	if (p && *p == '=')
+		return 1;
+
+	return 0;
+}
+
 /*
- *  * description: parse va and do system
+ * Run command without shell and wait for it, like system()
+ * @param	argv	argument list
+ * @return	wait status of command or -1
+ */
+static int
+spawn_wait(char *const argv[])
+{
+	sigset_t set, old;
+	struct sigaction sa, sa_int, sa_quit;
+	pid_t pid;
+	int status = -1;
+
+	/* same as system(), keep SIGCHLD handlers from reaping our child */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = SIG_IGN;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, &sa_int);
+	sigaction(SIGQUIT, &sa, &sa_quit);
+	sigemptyset(&set);
+	sigaddset(&set, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &set, &old);
+
+	/* not vfork(), the child restores signal state before exec */
+	pid = fork();
+	if (pid == 0) {
+		sigaction(SIGINT, &sa_int, NULL);
+		sigaction(SIGQUIT, &sa_quit, NULL);
+		sigprocmask(SIG_SETMASK, &old, NULL);
+		execvp(argv[0], argv);
+		_exit(127);
+	}
+
+	if (pid > 0) {
+		while (waitpid(pid, &status, 0) < 0) {
+			if (errno != EINTR) {
+				status = -1;
+				break;
+			}
+		}
+	}
+
+	sigaction(SIGINT, &sa_int, NULL);
+	sigaction(SIGQUIT, &sa_quit, NULL);
+	sigprocmask(SIG_SETMASK, &old, NULL);
+
+	return status;
+}
+
+/*
+ *  * description: parse va and do system, simple commands are
+ *  * executed directly without /bin/sh
  *   */
 int doSystem(const char *fmt, ...)
 {
-	char cmd_buf[512];
+	char cmd_buf[512], *argv[32], *p;
+	unsigned long start;
 	va_list pargv;
+	int argc, ret;
 
 	va_start(pargv, fmt);
 	vsnprintf(cmd_buf, sizeof(cmd_buf), fmt, pargv);
 	va_end(pargv);
 
-	return system(cmd_buf);
+	start = spawn_msec();
+
+	/* too many words for argv[], let the shell split them */
+	argc = 0;
+	for (p = cmd_buf; *p; ) {
+		p += strspn(p, " \t");
+		if (!*p)
+			break;
+		argc++;
+		p += strcspn(p, " \t");
+	}
+
+	if (argc >= ARRAY_SIZE(argv) || need_shell(cmd_buf)) {
+		ret = system(cmd_buf);
+		argv[0] = cmd_buf;
+		argv[1] = NULL;
+		spawn_trace_log(start, "sh", argv);
+		return ret;
+	}
+
+	argc = 0;
+	for (p = strtok(cmd_buf, " \t"); p; p = strtok(NULL, " \t"))
+		argv[argc++] = p;
+	argv[argc] = NULL;
+
+	if (!argc)
+		return 0;
+
+	ret = spawn_wait(argv);
+	spawn_trace_log(start, "exec", argv);
+
+	return ret;
 }
 
 unsigned long
@@ -43,6 +43,7 @@ extern int waitfor(int fd, int timeout);
 extern void time_zone_x_mapping();
 
 extern int doSystem(const char *fmt, ...);
+extern void spawn_trace(const char *path);
 
 extern unsigned long get_swap_size(void);
 extern unsigned int get_mtd_size(const char *mtd);
@@ -70,6 +71,7 @@ extern int kill_pidfile(char *pidfile);
 extern int kill_pidfile_s(char *pidfile, int sig);
 
 extern int pids(char *appname);
+extern void pids_register(const char *procName, pid_t pid);
 extern int pids_main(char *appname);
 
 /*
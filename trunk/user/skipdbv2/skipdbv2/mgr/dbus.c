@@ -395,6 +395,9 @@ static void help(void) {
     printf("dbus event key path_of_shell.sh\n");
     printf("dbus inc key=value\n");
     printf("dbus desc key=value\n");
+    printf("dbus count prefix\n");
+    printf("dbus commit\n");
+    printf("dbus stats\n");
 }
 
 static int prefix_set_command(dbclient* client, int argc, char **argv)
@@ -569,6 +572,28 @@ int main(int argc, char **argv, char * envp[])
 
             setnonblock(remote_fd);
             n1 = parse_get_result(gclient);
+        } else if(!strcmp("count", argv[1])) {
+            if(argc < 3) {
+                err = -12;
+                break;
+            }
+            strcpy(client->command, "scan");
+            n1 = strlen(argv[2]) + 2 + strlen(client->command) + 10;//"count 0 0 "
+            check_buf(client, n1 + HEADER_PREFIX);
+            n2 = snprintf(client->buf, client->buf_max, "%s%07d %s count 0 0 %s\n", MAGIC, n1, client->command, argv[2]);
+            write(remote_fd, client->buf, n2);
+
+            setnonblock(remote_fd);
+            n1 = parse_get_result(gclient);
+        } else if(!strcmp("commit", argv[1]) || !strcmp("stats", argv[1])) {
+            strcpy(client->command, argv[1]);
+            n1 = strlen(client->command) + 3;
+            check_buf(client, n1 + HEADER_PREFIX);
+            n2 = snprintf(client->buf, client->buf_max, "%s%07d %s -\n", MAGIC, n1, client->command);
+            write(remote_fd, client->buf, n2);
+
+            //commit may take longer than read timeout, wait in blocking mode
+            n1 = parse_get_result(gclient);
         } else if(!strcmp("ram", argv[1])) {
             if((argc < 3) || (NULL == strstr(argv[2], "="))) {
                 err = -16;
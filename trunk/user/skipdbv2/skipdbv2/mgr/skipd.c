@@ -32,7 +32,16 @@ typedef struct _skipd_server {
     int socket_len;
 
     ev_timer watcher;
-    int to_commit;
+    int to_commit;          /* writes not yet committed */
+    double commit_window;   /* max delay of first uncommitted write, sec */
+    int commit_max_pending; /* commit at once when this many writes are pending */
+
+    /* commit stats */
+    unsigned int commits;
+    unsigned int commit_writes;
+    double commit_last;
+    double commit_max;
+    double commit_total;
 
     SkipDB *db;
     int curr_db;
@@ -115,7 +124,8 @@ typedef struct _time_cmd {
 extern int SkipDB_maxPos(SkipDB* self);
 extern SkipDBRecord* SkipDB_list_first(SkipDB* self, Datum k, SkipDBCursor** pcur);
 extern SkipDBRecord* SkipDB_list_next(SkipDB* self, Datum k, SkipDBCursor* cursor);
-static void server_sync(EV_P_ skipd_server* server);
+static void server_sync(EV_P_ skipd_server* server, int writes);
+static void server_commit(EV_P_ skipd_server* server);
 static void server_switch(skipd_server* server);
 
 void skipd_daemonize(char * path);
@@ -128,6 +138,19 @@ skipd_server* global_server;
 ev_signal signal_watcher;
 ev_signal signal_watcher2;
 
+/* group commit */
+#define COMMIT_WINDOW 2.0
+#define COMMIT_MAX_PENDING 256
+
+/* scan replies are packed into frames of about this size */
+#define SCAN_CHUNK 8192
+
+enum scan_mode {
+    scan_all = 0,
+    scan_keys,
+    scan_count
+};
+
 #define STATIC_BUF_LEN 511
 char static_buffer[STATIC_BUF_LEN+1];
 
@@ -391,6 +414,48 @@ static int client_send(EV_P_ skipd_client* client, char* buf, int len) {
             , buf, len);
 }
 
+static char* client_chunk_grow(skipd_client* client, int len) {
+    char* p;
+    int n = client->send_len + len;
+
+    if(n > client->send_max) {
+        n = _max(n, client->send_max * 2);
+        p = (char*)realloc(client->send, n + 1);
+        if(NULL == p) {
+            return NULL;
+        }
+        client->send = p;
+        client->send_max = n;
+    }
+
+    return client->send + client->send_len;
+}
+
+//start a reply which is filled by client_chunk_grow
+static int client_chunk_begin(skipd_client* client, char* cmd, char* key) {
+    if(NULL == client_chunk_grow(client, HEADER_PREFIX + strlen(cmd) + strlen(key) + 2)) {
+        return -1;
+    }
+
+    client->send_len = HEADER_PREFIX;
+    client->send_len += sprintf(client->send + HEADER_PREFIX, "%s %s ", cmd, key);
+    return 0;
+}
+
+static void client_chunk_end(EV_P_ skipd_client* client) {
+    char pref_buf[HEADER_PREFIX+1];
+
+    memcpy(pref_buf, global_magic, MAGIC_LEN);
+    sprintf(pref_buf + MAGIC_LEN, "%07d ", client->send_len - HEADER_PREFIX);
+    memcpy(client->send, pref_buf, HEADER_PREFIX);
+    client->send[client->send_len] = '\0';
+    client->send_pos = 0;
+
+    memset(&client->ccr_write, 0, sizeof(struct ccrContextTag));
+    ev_io_stop(EV_A_ &client->io_read);
+    ev_io_start(EV_A_ &client->io_write);
+}
+
 static int client_ccr_write(EV_P_ skipd_client* client) {
     struct ccrContextTag* ctx = &client->ccr_write;
 
@@ -497,7 +562,7 @@ static int client_ccr_read_util(skipd_client* client, int step_len) {
 
 static int client_run_command(EV_P_ skipd_client* client)
 {
-    char *p1, *p2;
+    char *p1, *p2, *p3;
     time_t t1, t2, epoch;
     int tmpi, tmp2;
     struct tm tm1, tm2, *tnow;
@@ -512,6 +577,9 @@ static int client_run_command(EV_P_ skipd_client* client)
     SkipDBCursor* cursor;
     SkipDBRecord* record;
     Datum skey;
+    int mode;
+    int left;
+    int sent;
     ccrEndContext(ctx);
 
     ccrBegin(ctx);
@@ -543,7 +611,7 @@ static int client_run_command(EV_P_ skipd_client* client)
         SkipDB_at_put_(client->server->db, dkey, dvalue);
         //SkipDB_commitTransaction(client->server->db);
 	    //SkipDB_sync(client->server->db);
-        server_sync(EV_A_ client->server);
+        server_sync(EV_A_ client->server, 1);
         //print_time("endset");
 
         p1 = "ok\n";
@@ -602,7 +670,7 @@ static int client_run_command(EV_P_ skipd_client* client)
             SkipDB_beginTransaction(client->server->db);
             SkipDB_at_put_(client->server->db, dkey, dvalue);
             //SkipDB_commitTransaction(client->server->db);
-            server_sync(EV_A_ client->server);
+            server_sync(EV_A_ client->server, 1);
         } */
         dvalue = Datum_FromData_length_((unsigned char*)p1, client->data_len - (p1 - client->origin));
         SkipDB_beginTransaction(client->server->db);
@@ -613,7 +681,7 @@ static int client_run_command(EV_P_ skipd_client* client)
             p1 = "none\n";
             client_send(EV_A_ client, p1, strlen(p1));
         }
-        server_sync(EV_A_ client->server);
+        server_sync(EV_A_ client->server, 1);
         ccrReturn(ctx, ccr_error_ok1);
     } else if(!strcmp(client->command, "list")) {
         p1 = p2+1;
@@ -642,6 +710,159 @@ static int client_run_command(EV_P_ skipd_client* client)
         }
         client->server->in_doing--;
 
+        ccrReturn(ctx, ccr_error_ok1);
+    } else if(!strcmp(client->command, "scan")) {
+        /* scan mode offset limit prefix, mode is all/keys/count, limit 0 for no limit.
+         * Records go out packed in frames of "key len value\n" (or "key\n"),
+         * then "end prefix n\n" with the number of records sent or counted */
+        p1 = p2+1;
+        p2 = strchr(p1, ' ');
+        if(NULL == p2) {
+            ccrStop(ctx, ccr_error_err2);
+        }
+        *p2 = '\0';
+        if(!strcmp(p1, "all")) {
+            CS->mode = scan_all;
+        } else if(!strcmp(p1, "keys")) {
+            CS->mode = scan_keys;
+        } else if(!strcmp(p1, "count")) {
+            CS->mode = scan_count;
+        } else {
+            ccrStop(ctx, ccr_error_err2);
+        }
+
+        CS->n = strtol(p2+1, &p1, 10);
+        CS->left = strtol(p1, &p2, 10);
+        if(p1 == p2 || ' ' != *p2 || CS->n < 0 || CS->left < 0) {
+            ccrStop(ctx, ccr_error_err2);
+        }
+        if(0 == CS->left || scan_count == CS->mode) {
+            CS->left = INT_MAX;
+        }
+        CS->sent = 0;
+        client->key = p2+1;
+
+        client->server->in_doing++;
+        CS->skey = Datum_FromCString_(client->key);
+        CS->record = SkipDB_list_first(client->server->db, CS->skey, &CS->cursor);
+        for(; NULL != CS->record && CS->left > 0
+                ; CS->record = SkipDB_list_next(client->server->db, CS->skey, CS->cursor)) {
+            if(CS->n > 0) {
+                CS->n--;
+                continue;
+            }
+            CS->sent++;
+            CS->left--;
+            if(scan_count == CS->mode) {
+                continue;
+            }
+
+            dkey = SkipDBRecord_keyDatum(CS->record);
+            dvalue = SkipDBRecord_valueDatum(CS->record);
+            if(dvalue.size > 0 && '\0' == dvalue.data[dvalue.size-1]) {
+                //same encoding as mset, without the stored NUL
+                dvalue.size--;
+            }
+            tmpi = strlen((char*)dkey.data);
+            if(0 == client->send_len && 0 != client_chunk_begin(client, client->command, client->key)) {
+                break;
+            }
+            p1 = client_chunk_grow(client, tmpi + 14 + dvalue.size);
+            if(NULL == p1) {
+                break;
+            }
+            memcpy(p1, dkey.data, tmpi);
+            if(scan_all == CS->mode) {
+                tmpi += sprintf(p1 + tmpi, " %d ", (int)dvalue.size);
+                memcpy(p1 + tmpi, dvalue.data, dvalue.size);
+                tmpi += dvalue.size;
+            }
+            p1[tmpi++] = '\n';
+            client->send_len += tmpi;
+
+            if(client->send_len >= SCAN_CHUNK) {
+                client_chunk_end(EV_A_ client);
+                ccrReturn(ctx, ccr_error_ok);
+            }
+        }
+
+        if(client->send_len > 0) {
+            client_chunk_end(EV_A_ client);
+            ccrReturn(ctx, ccr_error_ok);
+        }
+
+        if(NULL != CS->cursor) {
+            SkipDBCursor_release(CS->cursor);
+        }
+        client->server->in_doing--;
+
+        tmpi = sprintf(static_buffer, "%d\n", CS->sent);
+        client_send_key(EV_A_ client, "end", client->key, static_buffer, tmpi);
+        ccrReturn(ctx, ccr_error_ok1);
+    } else if(!strcmp(client->command, "mset")) {
+        /* "key len value\n" records, len -1 removes key, all in one commit */
+        p3 = client->origin + client->data_len - 1;
+
+        /* validate whole batch first */
+        for(p1 = p2+1; p1 < p3; p1 += tmpi + 1) {
+            p2 = strchr(p1, ' ');
+            if(NULL == p2 || p2 == p1) {
+                ccrStop(ctx, ccr_error_err2);
+            }
+            *p2 = '\0';
+            tmpi = strtol(p2+1, &p1, 10);
+            if(' ' != *p1 || tmpi < -1 || tmpi > p3 - (p1+1)) {
+                ccrStop(ctx, ccr_error_err2);
+            }
+            p1++;
+            if(tmpi < 0) {
+                tmpi = 0;
+            }
+            if(p1 + tmpi < p3 && '\n' != p1[tmpi]) {
+                ccrStop(ctx, ccr_error_err2);
+            }
+        }
+
+        SkipDB_beginTransaction(client->server->db);
+        tmp2 = 0;
+        for(p1 = client->command + strlen(client->command) + 1; p1 < p3; p1 += tmpi + 1, tmp2++) {
+            client->key = p1;
+            tmpi = strtol(p1 + strlen(p1) + 1, &p1, 10);
+            p1++;
+            dkey = Datum_FromCString_(client->key);
+            if(tmpi < 0) {
+                SkipDB_removeAt_(client->server->db, dkey);
+                tmpi = 0;
+            } else {
+                //stored NUL terminated, as set does
+                p1[tmpi] = '\0';
+                dvalue = Datum_FromData_length_((unsigned char*)p1, tmpi + 1);
+                SkipDB_at_put_(client->server->db, dkey, dvalue);
+            }
+        }
+        server_sync(EV_A_ client->server, tmp2);
+
+        //no single key to reply with
+        client->key = "-";
+        p1 = "ok\n";
+        client_send(EV_A_ client, p1, strlen(p1));
+        ccrReturn(ctx, ccr_error_ok1);
+    } else if(!strcmp(client->command, "commit")) {
+        client->key = p2+1;
+        server_commit(EV_A_ client->server);
+        p1 = "ok\n";
+        client_send(EV_A_ client, p1, strlen(p1));
+        ccrReturn(ctx, ccr_error_ok1);
+    } else if(!strcmp(client->command, "stats")) {
+        client->key = p2+1;
+        tmpi = client->server->commits;
+        snprintf(static_buffer, STATIC_BUF_LEN, "commits=%u writes=%u pending=%d window_ms=%d max_pending=%d"
+                " last_ms=%.1f max_ms=%.1f avg_ms=%.1f\n"
+                , client->server->commits, client->server->commit_writes, client->server->to_commit
+                , (int)(client->server->commit_window * 1000), client->server->commit_max_pending
+                , client->server->commit_last * 1000, client->server->commit_max * 1000
+                , (tmpi > 0) ? client->server->commit_total * 1000 / tmpi : 0.0);
+        client_send(EV_A_ client, static_buffer, strlen(static_buffer));
         ccrReturn(ctx, ccr_error_ok1);
     } else if(!strcmp(client->command, "remove")) {
         p1 = p2+1;
@@ -653,7 +874,7 @@ static int client_run_command(EV_P_ skipd_client* client)
         SkipDB_beginTransaction(client->server->db);
         SkipDB_removeAt_(client->server->db, dkey);
         //SkipDB_commitTransaction(client->server->db);
-        server_sync(EV_A_ client->server);
+        server_sync(EV_A_ client->server, 1);
         p1 = "ok\n";
         client_send(EV_A_ client, p1, strlen(p1));
         ccrReturn(ctx, ccr_error_ok1);
@@ -714,7 +935,7 @@ static int client_run_command(EV_P_ skipd_client* client)
             SkipDB_beginTransaction(client->server->db);
             SkipDB_at_put_(client->server->db, dkey, dvalue);
             //SkipDB_commitTransaction(client->server->db);
-            server_sync(EV_A_ client->server);
+            server_sync(EV_A_ client->server, 1);
             ccrReturn(ctx, ccr_error_ok1);
         } */
 
@@ -724,11 +945,11 @@ static int client_run_command(EV_P_ skipd_client* client)
             free(delay_obj);
             client_send(EV_A_ client, p1, strlen(p1));
 
-            server_sync(EV_A_ client->server);
+            server_sync(EV_A_ client->server, 1);
             ccrReturn(ctx, ccr_error_ok1);
         }
         //SkipDB_commitTransaction(client->server->db);
-        server_sync(EV_A_ client->server);
+        server_sync(EV_A_ client->server, 1);
 
         ev_timer_init(&delay_obj->watcher, delay_cmd_cb, delay_obj->tick, delay_obj->tick);
         ev_timer_start(EV_A_ &delay_obj->watcher);
@@ -798,11 +1019,11 @@ static int client_run_command(EV_P_ skipd_client* client)
             client_send(EV_A_ client, p1, strlen(p1));
             free(time_obj);
 
-            server_sync(EV_A_ client->server);
+            server_sync(EV_A_ client->server, 1);
             ccrReturn(ctx, ccr_error_ok1);
         }
         //SkipDB_commitTransaction(client->server->db);
-        server_sync(EV_A_ client->server);
+        server_sync(EV_A_ client->server, 1);
 
         t1 = time(NULL);
         tnow = localtime(&t1);
@@ -1224,6 +1445,8 @@ static struct option options[] = {
     { "db_path", required_argument,	NULL, 'd' },
     { "sock_path", required_argument,	NULL, 's' },
     { "daemon", 	required_argument,	NULL, 'D' },
+    { "commit_window", required_argument,	NULL, 'w' },
+    { "commit_max_pending", required_argument,	NULL, 'm' },
     { NULL, 0, 0, 0 }
 };
 
@@ -1357,24 +1580,41 @@ static void server_cmd_init(EV_P_ ev_timer *w, int revents) {
     server_init_time(EV_A_ server);
 }
 
-static void server_sync(EV_P_ skipd_server* server) {
-    ev_timer_again(EV_A_ &server->watcher);
-
-    server->to_commit = 1;
-    SkipDB_sync(server->db);
+/* Group commit: writes are committed together, at most commit_window after
+ * the first uncommitted one, or at once when too many are pending.
+ * writes is the number of records the request changed */
+static void server_sync(EV_P_ skipd_server* server, int writes) {
+    server->to_commit += writes;
+
+    if((server->to_commit >= server->commit_max_pending) || (server->commit_window <= 0)) {
+        server_commit(EV_A_ server);
+    } else if(!ev_is_active(&server->watcher)) {
+        server->watcher.repeat = server->commit_window;
+        ev_timer_again(EV_A_ &server->watcher);
+    }
 }
 
-static void server_sync_tick(EV_P_ ev_timer *w, int revents) {
-    skipd_server *server = global_server;
+static void server_commit(EV_P_ skipd_server* server) {
+    ev_tstamp t;
 
-    if(server->to_commit) {
-        server->to_commit = 0;
-        ev_timer_stop(EV_A_ w);
-        skipd_log(SKIPD_DEBUG, "sync tick\n");
+    ev_timer_stop(EV_A_ &server->watcher);
 
+    if(server->to_commit) {
+        t = ev_time();
         //Do transaction
         SkipDB_beginTransaction(server->db);
         SkipDB_commitTransaction(server->db);
+        t = ev_time() - t;
+
+        server->commits++;
+        server->commit_writes += server->to_commit;
+        server->commit_last = t;
+        server->commit_total += t;
+        if(t > server->commit_max) {
+            server->commit_max = t;
+        }
+        skipd_log(SKIPD_DEBUG, "commit %d writes %.1fms\n", server->to_commit, t * 1000);
+        server->to_commit = 0;
     }
 
     if((0 == server->in_doing) && (SkipDB_maxPos(server->db) > server->switch_mark)) {
@@ -1382,6 +1622,10 @@ static void server_sync_tick(EV_P_ ev_timer *w, int revents) {
     }
 }
 
+static void server_sync_tick(EV_P_ ev_timer *w, int revents) {
+    server_commit(EV_A_ global_server);
+}
+
 static int check_dbpath(skipd_server* server)
 {
     struct stat s;
@@ -1419,6 +1663,8 @@ int main(int argc, char **argv)
     server = global_server;
 
     strcpy(server->sock_path, "/tmp/.skipd_server_sock");
+    server->commit_window = COMMIT_WINDOW;
+    server->commit_max_pending = COMMIT_MAX_PENDING;
 
 #if 1
     strcpy(server->pid_path, "/tmp/.skipd_pid");
@@ -1427,7 +1673,7 @@ int main(int argc, char **argv)
 #endif
 
     while (n >= 0) {
-            n = getopt_long(argc, argv, "hd:D:s:", options, NULL);
+            n = getopt_long(argc, argv, "hd:D:s:w:m:", options, NULL);
             if (n < 0)
                     continue;
             switch (n) {
@@ -1442,6 +1688,13 @@ int main(int argc, char **argv)
             case 's':
                 strcpy(server->sock_path, optarg);
                 break;
+            case 'w':
+                //msec
+                server->commit_window = atoi(optarg) / 1000.0;
+                break;
+            case 'm':
+                server->commit_max_pending = _max(atoi(optarg), 1);
+                break;
             case 'h':
                 fprintf(stderr, "Usage: skipd xxx todo\n");
                 exit(1);
@@ -1486,8 +1739,8 @@ int main(int argc, char **argv)
     //ev_periodic_start(EV_A_ &every_few_seconds);
     ev_timer_init(EV_A_ &init_watcher, server_cmd_init, 5.0, 0.0);
     ev_timer_start(EV_A_ &init_watcher);
-    //update at 2s after write
-    ev_timer_init(EV_A_ &server->watcher, server_sync_tick, 0.0, 2.0);
+    //commit at most commit_window after first write
+    ev_timer_init(EV_A_ &server->watcher, server_sync_tick, 0.0, server->commit_window);
     //ev_timer_start(EV_A_ &server->watcher);
 
     // Run our loop, ostensibly forever
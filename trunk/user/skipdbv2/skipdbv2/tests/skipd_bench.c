@@ -0,0 +1,207 @@
+/*
+ * skipd write benchmark: sets/s of single "set" and batched "mset" with
+ * group commit off and with several commit_window/commit_max settings,
+ * and skipd "stats" after each run.
+ *
+ * usage: skipd_bench [path of skipd binary, default ./skipd]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "../mgr/skipd.h"
+
+#define BENCH_SETS 5000
+#define BENCH_MSET_KEYS 50
+
+static char buf[READ_MAX + HEADER_PREFIX + 1];
+
+static double now_sec(void) {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static int write_all(int fd, const char* p, int len) {
+    int n;
+
+    while(len > 0) {
+        n = write(fd, p, len);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int read_all(int fd, char* p, int len) {
+    int n;
+
+    while(len > 0) {
+        n = read(fd, p, len);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* send "command body" and read one reply into buf, returns body length */
+static int request(int fd, const char* command, const char* body, int nb) {
+    int n1, n2;
+
+    n1 = strlen(command) + 1 + nb;
+    n2 = sprintf(buf, "%s%07d %s ", MAGIC, n1, command);
+    memcpy(buf + n2, body, nb);
+    if(0 != write_all(fd, buf, n2 + nb)) {
+        return -1;
+    }
+
+    if(0 != read_all(fd, buf, HEADER_PREFIX) || 0 != memcmp(buf, MAGIC, MAGIC_LEN)) {
+        return -1;
+    }
+    buf[HEADER_PREFIX-1] = '\0';
+    if(S2ISUCCESS != str2int(&n1, buf + MAGIC_LEN, 10) || n1 < 0 || n1 > READ_MAX) {
+        return -1;
+    }
+    if(0 != read_all(fd, buf, n1)) {
+        return -1;
+    }
+    buf[n1] = '\0';
+    return n1;
+}
+
+static int connect_skipd(const char* sock_path) {
+    struct sockaddr_un addr;
+    int i, fd;
+
+    for(i = 0; i < 200; i++) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, sock_path);
+        if(0 == connect(fd, (struct sockaddr*)&addr, sizeof(addr))) {
+            return fd;
+        }
+        close(fd);
+        usleep(10000);
+    }
+    return -1;
+}
+
+static pid_t start_skipd(const char* skipd, const char* dir, const char* sock_path, int window_ms, int max_pending) {
+    char sw[16], sm[16];
+    pid_t pid;
+
+    snprintf(sw, sizeof(sw), "%d", window_ms);
+    snprintf(sm, sizeof(sm), "%d", max_pending);
+    pid = fork();
+    if(0 == pid) {
+        freopen("/dev/null", "w", stderr);
+        execl(skipd, "skipd", "-D", "0", "-d", dir, "-s", sock_path, "-w", sw, "-m", sm, NULL);
+        _exit(127);
+    }
+    return pid;
+}
+
+static void run(const char* skipd, const char* title, int window_ms, int max_pending) {
+    char dir[] = "/tmp/skipd_bench.XXXXXX";
+    char sock_path[64], cmd[128], body[BENCH_MSET_KEYS * 48];
+    double t, t_set, t_mset, t_commit;
+    int i, j, n, fd;
+    char* p;
+    pid_t pid;
+
+    if(NULL == mkdtemp(dir)) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    snprintf(sock_path, sizeof(sock_path), "%s/skipd.sock", dir);
+
+    pid = start_skipd(skipd, dir, sock_path, window_ms, max_pending);
+    fd = connect_skipd(sock_path);
+    if(fd < 0) {
+        fprintf(stderr, "skipd_bench: can't connect to %s\n", skipd);
+        kill(pid, SIGKILL);
+        exit(1);
+    }
+
+    t = now_sec();
+    for(i = 0; i < BENCH_SETS; i++) {
+        n = snprintf(body, sizeof(body), "bench_set_%d value_%d\n", i, i);
+        if(request(fd, "set", body, n) < 0) {
+            fprintf(stderr, "skipd_bench: set failed\n");
+            exit(1);
+        }
+    }
+    t_set = now_sec() - t;
+
+    t = now_sec();
+    for(i = 0; i < BENCH_SETS; i += BENCH_MSET_KEYS) {
+        for(n = 0, j = i; j < i + BENCH_MSET_KEYS; j++) {
+            n += sprintf(body + n, "bench_mset_%d %d value_%06d\n", j, 12, j);
+        }
+        if(request(fd, "mset", body, n) < 0 || strcmp(buf, "mset - ok\n")) {
+            fprintf(stderr, "skipd_bench: mset failed\n");
+            exit(1);
+        }
+    }
+    t_mset = now_sec() - t;
+
+    //what is still pending is written at most commit_window later
+    t = now_sec();
+    request(fd, "commit", "-\n", 2);
+    t_commit = now_sec() - t;
+
+    request(fd, "stats", "-\n", 2);
+    //every key of an mset is a write of its own
+    p = strstr(buf, "writes=");
+    if(NULL == p || atoi(p + strlen("writes=")) != 2 * BENCH_SETS) {
+        fprintf(stderr, "skipd_bench: skipd counted %s", buf);
+        exit(1);
+    }
+
+    printf("%-26s: set %7.0f sets/s, mset %8.0f sets/s, final commit %6.1f ms\n"
+            , title, BENCH_SETS / t_set, BENCH_SETS / t_mset, t_commit * 1000);
+    printf("%-26s  %s", "", buf + strlen("stats - "));
+
+    close(fd);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    system(cmd);
+}
+
+int main(int argc, char** argv) {
+    const char* skipd = (argc > 1) ? argv[1] : "./skipd";
+
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("skipd_bench: %d sets, mset of %d keys\n", BENCH_SETS, BENCH_MSET_KEYS);
+    run(skipd, "group commit off", 0, 1);
+    run(skipd, "window 2000ms, max 256", 2000, 256);
+    run(skipd, "window 2000ms, max 16", 2000, 16);
+    run(skipd, "window 2000ms, max 4096", 2000, 4096);
+    run(skipd, "window 100ms, max 256", 100, 256);
+
+    return 0;
+}